@@ -132,6 +132,69 @@
 #   define PJ_DNS_RESOLVER_INVALID_TTL		    60
 #endif
 
+/**
+ * Number of shards of the resolver response cache. Each shard has its
+ * own hash table, LRU list, and lock, so lookups of cached responses
+ * in different shards don't contend with each other, nor with the
+ * resolver lock which is used to transmit queries.
+ *
+ * Default: 8
+ */
+#ifndef PJ_DNS_RESOLVER_CACHE_SHARDS
+#   define PJ_DNS_RESOLVER_CACHE_SHARDS		    8
+#endif
+
+/**
+ * Maximum number of responses kept in the resolver response cache. When
+ * the limit is reached, the least recently used responses are evicted.
+ * Entries added with #pj_dns_resolver_add_entry() without TTL are never
+ * evicted. The limit is divided evenly among the cache shards.
+ *
+ * Default: 1024
+ */
+#ifndef PJ_DNS_RESOLVER_CACHE_MAX_ENTRIES
+#   define PJ_DNS_RESOLVER_CACHE_MAX_ENTRIES	    1024
+#endif
+
+/**
+ * Maximum number of negative responses (responses with non-zero RCODE or
+ * without answer, see #PJ_DNS_RESOLVER_INVALID_TTL) kept in the resolver
+ * response cache, so that lookups of many non-existent names can't push
+ * the valid responses out of the cache. Like the total limit, it is
+ * divided among the cache shards, with at least one entry per shard.
+ *
+ * Default: 256
+ */
+#ifndef PJ_DNS_RESOLVER_CACHE_MAX_NEG_ENTRIES
+#   define PJ_DNS_RESOLVER_CACHE_MAX_NEG_ENTRIES    256
+#endif
+
+/**
+ * Refresh a cached response in the background when it is used while its
+ * remaining lifetime is below this percentage of its TTL, so that busy
+ * names don't expire from the cache under load. Set to zero to disable
+ * the prefetch.
+ *
+ * Default: 10
+ *
+ * @see PJ_DNS_RESOLVER_PREFETCH_MIN_HITS
+ */
+#ifndef PJ_DNS_RESOLVER_PREFETCH_PCT
+#   define PJ_DNS_RESOLVER_PREFETCH_PCT		    10
+#endif
+
+/**
+ * Minimum number of times a cached response must have been used before
+ * it is considered for prefetch.
+ *
+ * Default: 2
+ *
+ * @see PJ_DNS_RESOLVER_PREFETCH_PCT
+ */
+#ifndef PJ_DNS_RESOLVER_PREFETCH_MIN_HITS
+#   define PJ_DNS_RESOLVER_PREFETCH_MIN_HITS	    2
+#endif
+
 /**
  * The interval on which nameservers which are known to be good to be 
  * probed again to determine whether they are still good. Note that
@@ -196,6 +259,56 @@
 #endif
 
 
+/**
+ * Number of UDP sockets per address family that the resolver sends queries
+ * from, when it is created with #PJ_DNS_RESOLVER_UDP_POOL option. Each
+ * query is sent from a randomly selected socket, which randomizes the
+ * source port of the queries.
+ *
+ * Default: 4
+ */
+#ifndef PJ_DNS_RESOLVER_UDP_SOCK_CNT
+#   define PJ_DNS_RESOLVER_UDP_SOCK_CNT		    4
+#endif
+
+
+/**
+ * Size of the receive buffer and each of the two transmit buffers of the
+ * TCP connection to a nameserver, used by #PJ_DNS_RESOLVER_TCP_FALLBACK
+ * option. This limits the size of responses received over TCP.
+ *
+ * Default: 8192
+ */
+#ifndef PJ_DNS_RESOLVER_TCP_BUF_SIZE
+#   define PJ_DNS_RESOLVER_TCP_BUF_SIZE		    8192
+#endif
+
+
+/**
+ * Number of receive operations that the DNS server (#pj_dns_server_create())
+ * keeps pending on its socket. When several threads poll the ioqueue,
+ * this is the number of queries that can be handled in parallel.
+ *
+ * Default: 4
+ */
+#ifndef PJ_DNS_SERVER_ASYNC_CNT
+#   define PJ_DNS_SERVER_ASYNC_CNT		    4
+#endif
+
+
+/**
+ * Maximum number of prebuilt answers kept by the DNS server. The answer to
+ * each distinct question is encoded once and copied to the response of
+ * subsequent queries, until the records are changed. When the limit is
+ * reached, answers to new questions are encoded for every query.
+ *
+ * Default: 1024
+ */
+#ifndef PJ_DNS_SERVER_MAX_ANSWERS
+#   define PJ_DNS_SERVER_MAX_ANSWERS		    1024
+#endif
+
+
 /* **************************************************************************
  * SCANNER CONFIGURATION
  */
@@ -255,6 +368,33 @@
 #endif
 
 
+/**
+ * Specifies whether SHA1 and CRC32 may use CPU instructions when they are
+ * available: the SHA extensions (SHA-NI) and PCLMULQDQ on x86, whose
+ * support is detected at run time, and the ARMv8 SHA1 and CRC32
+ * instructions when the compiler targets them. HMAC-SHA1 (STUN
+ * MESSAGE-INTEGRITY) and the STUN FINGERPRINT benefit from this.
+ *
+ * Default: 1
+ */
+#ifndef PJ_CRYPTO_HAS_HW_ACCEL
+#   define PJ_CRYPTO_HAS_HW_ACCEL		    1
+#endif
+
+
+/**
+ * Specifies whether SHA1 and MD5 should use the block functions of
+ * OpenSSL libcrypto when no CPU instructions are available for them
+ * (see PJ_CRYPTO_HAS_HW_ACCEL). The application must then link with
+ * libcrypto.
+ *
+ * Default: 0
+ */
+#ifndef PJ_CRYPTO_HAS_OPENSSL
+#   define PJ_CRYPTO_HAS_OPENSSL		    0
+#endif
+
+
 /* **************************************************************************
  * HTTP Client configuration
  */
@@ -84,6 +84,21 @@ PJ_DECL(pj_uint32_t) pj_crc32_final(pj_crc32_context *ctx);
 PJ_DECL(pj_uint32_t) pj_crc32_calc(const pj_uint8_t *data,
 				   pj_size_t nbytes);
 
+/**
+ * Enable or disable the use of CPU instructions for CRC32, i.e: PCLMULQDQ
+ * on x86 or the ARMv8 CRC32 instructions (see PJ_CRYPTO_HAS_HW_ACCEL).
+ * It is enabled by default, disabling it is mainly useful for testing
+ * and benchmarking. This affects all contexts, so it should not be
+ * called while CRC32 is in use.
+ *
+ * @param enable    PJ_TRUE to use the fastest implementation available,
+ *		    PJ_FALSE to use the portable C implementation.
+ *
+ * @return	    Name of the implementation used, e.g. "PCLMULQDQ",
+ *		    "ARMv8" or "C table".
+ */
+PJ_DECL(const char*) pj_crc32_set_accel(pj_bool_t enable);
+
 
 /**
  * @}
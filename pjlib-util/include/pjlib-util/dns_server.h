@@ -35,7 +35,21 @@ PJ_BEGIN_DECL
  * @{
  * This contains a simple but fully working DNS server implementation, 
  * mostly for testing purposes. It supports serving various DNS resource 
- * records such as SRV, CNAME, A, and AAAA.
+ * records such as SRV, CNAME, A, and AAAA. Other record types, such as
+ * NAPTR, can be served by giving their resource data in wire format in
+ * the \a data and \a rdlength fields of #pj_dns_parsed_rr.
+ *
+ * The server is authoritative for all the records it has. Records of
+ * the same name and type are answered together as one record set, and
+ * the answer to SRV queries carries the addresses of the targets in the
+ * additional section.
+ *
+ * The answer to each question is encoded once and kept in wire format,
+ * so that subsequent queries are answered by copying the prebuilt answer
+ * (see #PJ_DNS_SERVER_MAX_ANSWERS). The prebuilt answers are discarded
+ * whenever records are added or removed. The server keeps several
+ * receive operations pending (see #PJ_DNS_SERVER_ASYNC_CNT), so queries
+ * are handled in parallel when more than one thread polls the ioqueue.
  */
 
 /**
@@ -77,7 +91,11 @@ PJ_DECL(pj_status_t) pj_dns_server_destroy(pj_dns_server *srv);
 
 
 /**
- * Add generic resource record entries to the server.
+ * Add generic resource record entries to the server. Records with the
+ * same class, type, and name as existing ones are added to the record
+ * set, except for CNAME which must be unique. The contents of the records
+ * are not copied, so they must remain valid as long as the server uses
+ * them.
  *
  * @param srv	    The DNS server instance.
  * @param count	    Number of records to be added.
@@ -90,7 +108,7 @@ PJ_DECL(pj_status_t) pj_dns_server_add_rec(pj_dns_server *srv,
 					   const pj_dns_parsed_rr rr[]);
 
 /**
- * Remove the specified record from the server.
+ * Remove the specified record set from the server.
  *
  * @param srv	    The DNS server instance.
  * @param dns_class The resource's DNS class. Valid value is PJ_DNS_CLASS_IN.
@@ -48,6 +48,17 @@ typedef struct pj_hmac_sha1_context
     pj_uint8_t	    k_opad[64];	/**< opad xor-ed with key   */
 } pj_hmac_sha1_context;
 
+/**
+ * Precomputed HMAC-SHA1 key. This holds the SHA1 states after the
+ * key xor-ed with ipad and opad have been hashed, so that messages
+ * authenticated with the same key don't need to redo the key schedule.
+ */
+typedef struct pj_hmac_sha1_key
+{
+    pj_sha1_context inner;	/**< SHA1 state after K xor ipad    */
+    pj_sha1_context outer;	/**< SHA1 state after K xor opad    */
+} pj_hmac_sha1_key;
+
 
 /**
  * Calculate HMAC-SHA1 digest for the specified input and key with this
@@ -95,6 +106,41 @@ PJ_DECL(void) pj_hmac_sha1_final(pj_hmac_sha1_context *hctx,
 				 pj_uint8_t digest[20]);
 
 
+/**
+ * Precompute the HMAC-SHA1 key schedule for the specified key.
+ *
+ * @param hkey		The precomputed key to be initialized.
+ * @param key		Pointer to the authentication key.
+ * @param key_len	Length of the authentication key.
+ */
+PJ_DECL(void) pj_hmac_sha1_key_init(pj_hmac_sha1_key *hkey,
+				    const pj_uint8_t *key, unsigned key_len);
+
+/**
+ * Initiate HMAC-SHA1 context for incremental hashing with a precomputed
+ * key. This is equivalent to pj_hmac_sha1_init(), but only copies the
+ * inner SHA1 state. The context must be finished with
+ * pj_hmac_sha1_final_key() using the same precomputed key.
+ *
+ * @param hctx		HMAC-SHA1 context.
+ * @param hkey		The precomputed key.
+ */
+PJ_DECL(void) pj_hmac_sha1_init_key(pj_hmac_sha1_context *hctx,
+				    const pj_hmac_sha1_key *hkey);
+
+/**
+ * Finish the message started with pj_hmac_sha1_init_key() and return
+ * the digest.
+ *
+ * @param hctx		HMAC-SHA1 context.
+ * @param hkey		The precomputed key.
+ * @param digest	Buffer to be filled with HMAC SHA1 digest.
+ */
+PJ_DECL(void) pj_hmac_sha1_final_key(pj_hmac_sha1_context *hctx,
+				     const pj_hmac_sha1_key *hkey,
+				     pj_uint8_t digest[20]);
+
+
 /**
  * @}
  */
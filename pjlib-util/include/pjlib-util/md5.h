@@ -25,7 +25,7 @@
  * @brief MD5 Functions
  */
 
-#include <pj/types.h>
+#include <pjlib-util/types.h>
 
 PJ_BEGIN_DECL
 
@@ -63,6 +63,16 @@ PJ_DECL(void) pj_md5_update( pj_md5_context *pms,
  */
 PJ_DECL(void) pj_md5_final(pj_md5_context *pms, pj_uint8_t digest[16]);
 
+/** Enable or disable the accelerated MD5 implementation, i.e: OpenSSL
+ *  when PJ_CRYPTO_HAS_OPENSSL is enabled. It is enabled by default,
+ *  disabling it is mainly useful for testing and benchmarking. This
+ *  affects all contexts, so it should not be called while MD5 is in use.
+ *  @param enable	PJ_TRUE to use the fastest implementation available,
+ *			PJ_FALSE to use the portable C implementation.
+ *  @return		Name of the implementation used, "OpenSSL" or "C".
+ */
+PJ_DECL(const char*) pj_md5_set_accel(pj_bool_t enable);
+
 
 /**
  * @}
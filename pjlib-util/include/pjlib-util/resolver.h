@@ -184,6 +184,33 @@ typedef void pj_dns_callback(void *user_data,
 			     pj_dns_parsed_packet *response);
 
 
+/**
+ * Resolver options, to be specified when creating the resolver with
+ * #pj_dns_resolver_create(), or in the \a options field of
+ * #pj_dns_settings.
+ */
+typedef enum pj_dns_resolver_option
+{
+    /**
+     * Send queries from a pool of #PJ_DNS_RESOLVER_UDP_SOCK_CNT UDP
+     * sockets per address family instead of a single socket. Each query
+     * gets a random transaction ID and is sent from a randomly selected
+     * socket, and the response is only accepted on that socket. This
+     * option is only effective when creating the resolver.
+     */
+    PJ_DNS_RESOLVER_UDP_POOL = 1,
+
+    /**
+     * Retry queries whose UDP response is truncated over a persistent
+     * TCP connection to the nameserver that sent the response. Queries
+     * on the connection are pipelined, and the connection is kept open
+     * for subsequent truncated responses.
+     */
+    PJ_DNS_RESOLVER_TCP_FALLBACK = 2
+
+} pj_dns_resolver_option;
+
+
 /**
  * This structure describes resolver settings.
  */
@@ -285,7 +312,7 @@ PJ_DECL(void) pj_dns_settings_default(pj_dns_settings *s);
  * @param pf	     Pool factory where the memory pool will be created from.
  * @param name	     Optional resolver name to identify the instance in 
  *		     the log.
- * @param options    Optional options, must be zero for now.
+ * @param options    Optional options, bitmask of #pj_dns_resolver_option.
  * @param timer	     Optional timer heap instance to be used by the resolver.
  *		     If timer heap is not specified, an internal timer will be
  *		     created, and application would need to poll the resolver
@@ -396,7 +423,8 @@ PJ_DECL(pj_status_t) pj_dns_resolver_destroy(pj_dns_resolver *resolver,
  * If response is available in the cache, the callback will be called 
  * immediately before this function returns. In this case, if \a p_query
  * argument is not NULL, the value will be set to NULL since no new query
- * is started.
+ * is started. The TTL of the answers in the cached response is the time
+ * left until the cache entry expires.
  *
  * @param resolver  The resolver object.
  * @param name	    The name to be resolved.
@@ -495,6 +523,50 @@ PJ_DECL(pj_status_t) pj_dns_resolver_add_entry(pj_dns_resolver *resolver,
 PJ_DECL(unsigned) pj_dns_resolver_get_cached_count(pj_dns_resolver *resolver);
 
 
+/**
+ * This structure describes the statistics of a nameserver, as part of
+ * #pj_dns_resolver_stat.
+ */
+typedef struct pj_dns_ns_stat
+{
+    pj_sockaddr	addr;		/**< Nameserver address.		    */
+    unsigned	tx_cnt;		/**< Number of queries sent over UDP.	    */
+    unsigned	tcp_tx_cnt;	/**< Number of queries sent over TCP.	    */
+    unsigned	rx_cnt;		/**< Number of responses received.	    */
+    unsigned	rtt;		/**< Last response time sample, in msec.  */
+    unsigned	srtt;		/**< Smoothed response time, in msec.	    */
+    pj_bool_t	tcp_connected;	/**< TCP connection is established.	    */
+} pj_dns_ns_stat;
+
+
+/**
+ * This structure describes the resolver statistics, see
+ * #pj_dns_resolver_get_stat().
+ */
+typedef struct pj_dns_resolver_stat
+{
+    unsigned	in_flight;	/**< Number of pending queries.		    */
+    unsigned	max_in_flight;	/**< Peak number of pending queries.	    */
+    unsigned	truncated_cnt;	/**< Number of truncated UDP responses.   */
+    unsigned	udp_sock_cnt;	/**< Number of UDP sockets.		    */
+    unsigned	ns_count;	/**< Number of nameservers.		    */
+    pj_dns_ns_stat ns[PJ_DNS_RESOLVER_MAX_NS]; /**< Nameserver statistics. */
+} pj_dns_resolver_stat;
+
+
+/**
+ * Get the resolver statistics, such as the number of pending queries and
+ * the response time of each nameserver.
+ *
+ * @param resolver  The resolver instance.
+ * @param stat	    Structure to receive the statistics.
+ *
+ * @return	    PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_dns_resolver_get_stat(pj_dns_resolver *resolver,
+					      pj_dns_resolver_stat *stat);
+
+
 /**
  * Dump resolver state to the log.
  *
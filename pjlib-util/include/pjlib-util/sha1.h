@@ -25,7 +25,7 @@
  * @brief SHA1 encryption implementation
  */
 
-#include <pj/types.h>
+#include <pjlib-util/types.h>
 
 PJ_BEGIN_DECL
 
@@ -68,6 +68,18 @@ PJ_DECL(void) pj_sha1_update(pj_sha1_context *ctx,
 PJ_DECL(void) pj_sha1_final(pj_sha1_context *ctx, 
 			    pj_uint8_t digest[PJ_SHA1_DIGEST_SIZE]);
 
+/** Enable or disable the accelerated SHA1 implementation, i.e: CPU
+ *  instructions or OpenSSL (see PJ_CRYPTO_HAS_HW_ACCEL and
+ *  PJ_CRYPTO_HAS_OPENSSL). It is enabled by default, disabling it is
+ *  mainly useful for testing and benchmarking. This affects all
+ *  contexts, so it should not be called while SHA1 is in use.
+ *  @param enable	PJ_TRUE to use the fastest implementation available,
+ *			PJ_FALSE to use the portable C implementation.
+ *  @return		Name of the implementation used, e.g. "SHA-NI",
+ *			"ARMv8", "OpenSSL" or "C".
+ */
+PJ_DECL(const char*) pj_sha1_set_accel(pj_bool_t enable);
+
 
 /**
  * @}
@@ -142,6 +142,12 @@ typedef struct pj_dns_srv_record
 
     } entry[PJ_DNS_SRV_MAX_ADDR];
 
+    /** The lowest TTL, in seconds, of the DNS SRV and A/AAAA records used
+     *  to build this result, which tells how long the result may be
+     *  reused.
+     */
+    unsigned	ttl;
+
 } pj_dns_srv_record;
 
 
@@ -408,6 +408,36 @@ static int rfc2202_test(void)
 	}
     }
 
+    PJ_LOG(3, (THIS_FILE, "  HMAC-SHA1 with precomputed key.."));
+    for (i=0; i<PJ_ARRAY_SIZE(rfc2202_test_vector); ++i) {
+	pj_hmac_sha1_key hkey;
+	pj_hmac_sha1_context ctx;
+	pj_uint8_t digest[20];
+	unsigned n;
+
+	if (rfc2202_test_vector[i].sha1_digest == NULL)
+	    continue;
+
+	pj_hmac_sha1_key_init(&hkey,
+			      (pj_uint8_t*)rfc2202_test_vector[i].key,
+			      rfc2202_test_vector[i].key_len);
+
+	/* The same precomputed key must be reusable */
+	for (n=0; n<2; ++n) {
+	    pj_hmac_sha1_init_key(&ctx, &hkey);
+	    pj_hmac_sha1_update(&ctx,
+				(pj_uint8_t*)rfc2202_test_vector[i].input,
+				rfc2202_test_vector[i].input_len);
+	    pj_hmac_sha1_final_key(&ctx, &hkey, digest);
+
+	    if (pj_memcmp(rfc2202_test_vector[i].sha1_digest, digest, 20)) {
+		PJ_LOG(3, (THIS_FILE, "    error: digest mismatch on test %d",
+			   i));
+		return -80;
+	    }
+	}
+    }
+
 
     /* Success */
     return 0;
@@ -627,6 +657,88 @@ static int base64_test(void)
 }
 
 
+/*
+ * Compare the accelerated SHA1, MD5 and CRC32 (see pj_sha1_set_accel())
+ * with the portable implementation, with lengths and alignments that
+ * exercise both the block and the tail processing.
+ */
+static int accel_test(void)
+{
+    enum { MAX_LEN = 1100 };
+    pj_uint8_t data[MAX_LEN + 4];
+    unsigned len, off, i;
+    const char *sha1_impl, *md5_impl, *crc32_impl;
+    int rc = 0;
+
+    for (i=0; i<sizeof(data); ++i)
+	data[i] = (pj_uint8_t)(i * 151 + (i >> 8));
+
+    sha1_impl = pj_sha1_set_accel(PJ_TRUE);
+    md5_impl = pj_md5_set_accel(PJ_TRUE);
+    crc32_impl = pj_crc32_set_accel(PJ_TRUE);
+
+    PJ_LOG(3, (THIS_FILE, "  comparing %s SHA1, %s MD5 and %s CRC32 with "
+			  "the C implementation..",
+	       sha1_impl, md5_impl, crc32_impl));
+
+    for (len=0; len<MAX_LEN && rc==0; len += (len < 200 ? 1 : 37)) {
+	for (off=0; off<4 && rc==0; ++off) {
+	    const pj_uint8_t *in = data + off;
+	    pj_uint8_t sha1[2][PJ_SHA1_DIGEST_SIZE], md5[2][16];
+	    pj_uint32_t crc[2];
+
+	    for (i=0; i<2; ++i) {
+		pj_sha1_context sha1_ctx;
+		pj_md5_context md5_ctx;
+		pj_crc32_context crc_ctx;
+
+		pj_sha1_set_accel(i);
+		pj_md5_set_accel(i);
+		pj_crc32_set_accel(i);
+
+		/* Feed in two parts to test the buffering too */
+		pj_sha1_init(&sha1_ctx);
+		pj_sha1_update(&sha1_ctx, in, len / 3);
+		pj_sha1_update(&sha1_ctx, in + len / 3, len - len / 3);
+		pj_sha1_final(&sha1_ctx, sha1[i]);
+
+		pj_md5_init(&md5_ctx);
+		pj_md5_update(&md5_ctx, in, len / 3);
+		pj_md5_update(&md5_ctx, in + len / 3, len - len / 3);
+		pj_md5_final(&md5_ctx, md5[i]);
+
+		pj_crc32_init(&crc_ctx);
+		pj_crc32_update(&crc_ctx, in, len / 3);
+		pj_crc32_update(&crc_ctx, in + len / 3, len - len / 3);
+		crc[i] = pj_crc32_final(&crc_ctx);
+	    }
+
+	    if (pj_memcmp(sha1[0], sha1[1], sizeof(sha1[0]))) {
+		PJ_LOG(3, (THIS_FILE, "    error: SHA1 mismatch, len=%d off=%d",
+			   len, off));
+		rc = -100;
+	    } else if (pj_memcmp(md5[0], md5[1], sizeof(md5[0]))) {
+		PJ_LOG(3, (THIS_FILE, "    error: MD5 mismatch, len=%d off=%d",
+			   len, off));
+		rc = -110;
+	    } else if (crc[0] != crc[1] ||
+		       crc[1] != pj_crc32_calc(in, len))
+	    {
+		PJ_LOG(3, (THIS_FILE, "    error: CRC32 mismatch, len=%d off=%d",
+			   len, off));
+		rc = -120;
+	    }
+	}
+    }
+
+    pj_sha1_set_accel(PJ_TRUE);
+    pj_md5_set_accel(PJ_TRUE);
+    pj_crc32_set_accel(PJ_TRUE);
+
+    return rc;
+}
+
+
 int encryption_test()
 {
     int rc;
@@ -651,6 +763,10 @@ int encryption_test()
     if (rc != 0)
 	return rc;
 
+    rc = accel_test();
+    if (rc != 0)
+	return rc;
+
     return 0;
 }
 
@@ -665,6 +781,68 @@ static void crc32_final(pj_crc32_context *ctx, pj_uint32_t *digest)
     *digest = pj_crc32_final(ctx);
 }
 
+/* HMAC-SHA1 of STUN sized messages, in messages per second */
+static void hmac_sha1_benchmark(const char *impl)
+{
+    enum { MSG_LEN = 100, MSG_COUNT = 100000 };
+    pj_uint8_t msg[MSG_LEN], key[16], digest[PJ_SHA1_DIGEST_SIZE];
+    pj_timestamp t1, t2;
+    pj_uint32_t usec;
+    unsigned i;
+
+    pj_memset(msg, 0x55, sizeof(msg));
+    pj_memset(key, 0x11, sizeof(key));
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<MSG_COUNT; ++i) {
+	msg[0] = (pj_uint8_t)i;
+	pj_hmac_sha1(msg, sizeof(msg), key, sizeof(key), digest);
+    }
+    pj_get_timestamp(&t2);
+
+    usec = pj_elapsed_usec(&t1, &t2);
+    if (usec == 0)
+	usec = 1;
+
+    PJ_LOG(3, (THIS_FILE, "    HMAC-SHA1 (%s, %d bytes):%8d usec (%d msg/sec)",
+	       impl, MSG_LEN, usec,
+	       (unsigned)((pj_uint64_t)MSG_COUNT * 1000000 / usec)));
+}
+
+/* Same as above, with the key schedule precomputed once */
+static void hmac_sha1_key_benchmark(const char *impl)
+{
+    enum { MSG_LEN = 100, MSG_COUNT = 100000 };
+    pj_uint8_t msg[MSG_LEN], key[16], digest[PJ_SHA1_DIGEST_SIZE];
+    pj_hmac_sha1_key hkey;
+    pj_hmac_sha1_context ctx;
+    pj_timestamp t1, t2;
+    pj_uint32_t usec;
+    unsigned i;
+
+    pj_memset(msg, 0x55, sizeof(msg));
+    pj_memset(key, 0x11, sizeof(key));
+
+    pj_get_timestamp(&t1);
+    pj_hmac_sha1_key_init(&hkey, key, sizeof(key));
+    for (i=0; i<MSG_COUNT; ++i) {
+	msg[0] = (pj_uint8_t)i;
+	pj_hmac_sha1_init_key(&ctx, &hkey);
+	pj_hmac_sha1_update(&ctx, msg, sizeof(msg));
+	pj_hmac_sha1_final_key(&ctx, &hkey, digest);
+    }
+    pj_get_timestamp(&t2);
+
+    usec = pj_elapsed_usec(&t1, &t2);
+    if (usec == 0)
+	usec = 1;
+
+    PJ_LOG(3, (THIS_FILE, "    HMAC-SHA1 (%s, %d bytes, precomputed key):"
+			  "%8d usec (%d msg/sec)",
+	       impl, MSG_LEN, usec,
+	       (unsigned)((pj_uint64_t)MSG_COUNT * 1000000 / usec)));
+}
+
 int encryption_benchmark()
 {
     pj_pool_t *pool;
@@ -678,26 +856,32 @@ int encryption_benchmark()
     struct algorithm
     {
 	const char *name;
+	const char* (*set_accel)(pj_bool_t);
 	void (*init_context)(void*);
 	void (*update)(void*, const pj_uint8_t*, unsigned);
 	void (*final)(void*, void*);
-	pj_uint32_t t;
+	const char *impl[2];
+	pj_uint32_t t[2];
+	pj_uint8_t digest[2][32];
     } algorithms[] = 
     {
 	{
 	    "MD5  ",
+	    &pj_md5_set_accel,
 	    (void (*)(void*))&pj_md5_init,
 	    (void (*)(void*, const pj_uint8_t*, unsigned))&pj_md5_update,
 	    (void (*)(void*, void*))&pj_md5_final
 	},
 	{
 	    "SHA1 ",
+	    &pj_sha1_set_accel,
 	    (void (*)(void*))&pj_sha1_init,
 	    (void (*)(void*, const pj_uint8_t*, unsigned))&pj_sha1_update,
 	    (void (*)(void*, void*))&pj_sha1_final
 	},
 	{
 	    "CRC32",
+	    &pj_crc32_set_accel,
 	    (void (*)(void*))&pj_crc32_init,
 	    (void (*)(void*, const pj_uint8_t*, unsigned))&crc32_update,
 	    (void (*)(void*, void*))&crc32_final
@@ -708,7 +892,7 @@ int encryption_benchmark()
 #else
     enum { LOOP = 10000 };
 #endif
-    unsigned i;
+    unsigned i, accel;
     double total_len;
 
     input_len = 2048;
@@ -730,33 +914,57 @@ int encryption_benchmark()
 	algorithms[i].final(&context, digest);
     }
 
-    /* Run */
-    for (i=0; i<PJ_ARRAY_SIZE(algorithms); ++i) {
-	int j;
-	pj_timestamp t1, t2;
-
-	pj_get_timestamp(&t1);
-	algorithms[i].init_context(&context);
-	for (j=0; j<LOOP; ++j) {
-	    algorithms[i].update(&context, input, (unsigned)input_len);
+    /* Run, with the portable and then the accelerated implementation */
+    for (accel=0; accel<2; ++accel) {
+	for (i=0; i<PJ_ARRAY_SIZE(algorithms); ++i) {
+	    int j;
+	    pj_timestamp t1, t2;
+
+	    algorithms[i].impl[accel] = algorithms[i].set_accel(accel);
+
+	    pj_get_timestamp(&t1);
+	    algorithms[i].init_context(&context);
+	    for (j=0; j<LOOP; ++j) {
+		algorithms[i].update(&context, input, (unsigned)input_len);
+	    }
+	    algorithms[i].final(&context, algorithms[i].digest[accel]);
+	    pj_get_timestamp(&t2);
+
+	    algorithms[i].t[accel] = pj_elapsed_usec(&t1, &t2);
+	    if (algorithms[i].t[accel] == 0)
+		algorithms[i].t[accel] = 1;
 	}
-	algorithms[i].final(&context, digest);
-	pj_get_timestamp(&t2);
-
-	algorithms[i].t = pj_elapsed_usec(&t1, &t2);
     }
 
     /* Results */
     for (i=0; i<PJ_ARRAY_SIZE(algorithms); ++i) {
-	double bytes;
+	for (accel=0; accel<2; ++accel) {
+	    double bytes;
+
+	    bytes = (total_len * 1000000 / algorithms[i].t[accel]);
+	    PJ_LOG(3, (THIS_FILE, "    %s %-9s:%8d usec (%4d.%03d Mbytes/sec)",
+		       algorithms[i].name, algorithms[i].impl[accel],
+		       algorithms[i].t[accel],
+		       (unsigned)(bytes / 1024 / 1024),
+		       ((unsigned)(bytes) % (1024 * 1024)) / 1024));
+	}
 
-	bytes = (total_len * 1000000 / algorithms[i].t);
-	PJ_LOG(3, (THIS_FILE, "    %s:%8d usec (%3d.%03d Mbytes/sec)",
-		   algorithms[i].name, algorithms[i].t,
-		   (unsigned)(bytes / 1024 / 1024),
-		   ((unsigned)(bytes) % (1024 * 1024)) / 1024));
+	if (pj_memcmp(algorithms[i].digest[0], algorithms[i].digest[1],
+		      sizeof(algorithms[i].digest[0])))
+	{
+	    PJ_LOG(3, (THIS_FILE, "    error: %s digest mismatch",
+		       algorithms[i].name));
+	    pj_pool_release(pool);
+	    return -10;
+	}
     }
 
+    hmac_sha1_benchmark(pj_sha1_set_accel(PJ_FALSE));
+    hmac_sha1_benchmark(pj_sha1_set_accel(PJ_TRUE));
+    hmac_sha1_key_benchmark(pj_sha1_set_accel(PJ_FALSE));
+    hmac_sha1_key_benchmark(pj_sha1_set_accel(PJ_TRUE));
+
+    pj_pool_release(pool);
     return 0;
 }
 
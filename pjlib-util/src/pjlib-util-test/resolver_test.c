@@ -1844,6 +1844,740 @@ static int srv_resolver_many_test(void)
 }
 
 
+////////////////////////////////////////////////////////////////////////////
+/* Cache size limit test */
+
+static pj_bool_t cache_cb_called;
+
+static void cache_limit_cb(void *user_data,
+			   pj_status_t status,
+			   pj_dns_parsed_packet *resp)
+{
+    PJ_UNUSED_ARG(user_data);
+    PJ_UNUSED_ARG(status);
+    PJ_UNUSED_ARG(resp);
+
+    cache_cb_called = PJ_TRUE;
+}
+
+static int cache_limit_test(void)
+{
+    enum { MAX_CNT = PJ_DNS_RESOLVER_CACHE_MAX_ENTRIES };
+    pj_dns_parsed_packet pkt;
+    pj_dns_parsed_query q;
+    pj_dns_parsed_rr rr;
+    char name_buf[32];
+    pj_str_t name;
+    unsigned i, count;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  cache size limit test"));
+
+    pj_bzero(&pkt, sizeof(pkt));
+    pj_bzero(&q, sizeof(q));
+    pj_bzero(&rr, sizeof(rr));
+    pkt.hdr.flags = PJ_DNS_SET_QR(1);
+    pkt.hdr.qdcount = 1;
+    pkt.q = &q;
+    q.type = PJ_DNS_TYPE_A;
+    q.dnsclass = 1;
+    rr.type = PJ_DNS_TYPE_A;
+    rr.dnsclass = 1;
+    rr.ttl = 600;
+    rr.rdata.a.ip_addr.s_addr = IP_ADDR0;
+
+    /* Fill the cache well beyond its limit with positive entries */
+    for (i=0; i<MAX_CNT*2; ++i) {
+	pj_ansi_snprintf(name_buf, sizeof(name_buf), "cache%u", i);
+	name = pj_str(name_buf);
+	q.name = rr.name = name;
+	pkt.hdr.anscount = 1;
+	pkt.ans = &rr;
+
+	status = pj_dns_resolver_add_entry(resolver, &pkt, PJ_TRUE);
+	if (status != PJ_SUCCESS)
+	    return -2000;
+    }
+
+    count = pj_dns_resolver_get_cached_count(resolver);
+    if (count > MAX_CNT) {
+	PJ_LOG(3,(THIS_FILE, "  error: %u cached entries, limit is %u",
+		  count, MAX_CNT));
+	return -2010;
+    }
+
+    /* The most recently added entry must still be in the cache, so the
+     * callback is called before start_query() returns.
+     */
+    cache_cb_called = PJ_FALSE;
+    status = pj_dns_resolver_start_query(resolver, &name, PJ_DNS_TYPE_A, 0,
+					 &cache_limit_cb, NULL, NULL);
+    if (status != PJ_SUCCESS || !cache_cb_called)
+	return -2020;
+
+    /* Negative entries must not exceed their own limit */
+    for (i=0; i<PJ_DNS_RESOLVER_CACHE_MAX_NEG_ENTRIES*2; ++i) {
+	pj_ansi_snprintf(name_buf, sizeof(name_buf), "nxcache%u", i);
+	q.name = pj_str(name_buf);
+	pkt.hdr.anscount = 0;
+	pkt.ans = NULL;
+
+	status = pj_dns_resolver_add_entry(resolver, &pkt, PJ_TRUE);
+	if (status != PJ_SUCCESS)
+	    return -2030;
+    }
+
+    /* The total limit still holds with the negative entries */
+    count = pj_dns_resolver_get_cached_count(resolver);
+    if (count > MAX_CNT) {
+	PJ_LOG(3,(THIS_FILE, "  error: %u cached entries, limit is %u",
+		  count, MAX_CNT));
+	return -2040;
+    }
+
+    pj_dns_resolver_dump(resolver, PJ_FALSE);
+
+    return 0;
+}
+
+
+static pj_uint32_t cache_ttl;
+
+static void cache_ttl_cb(void *user_data,
+			 pj_status_t status,
+			 pj_dns_parsed_packet *resp)
+{
+    PJ_UNUSED_ARG(user_data);
+
+    if (status == PJ_SUCCESS && resp && resp->hdr.anscount == 1)
+	cache_ttl = resp->ans[0].ttl;
+}
+
+/* Response from the cache must carry the remaining TTL, not the TTL of
+ * the response when it was added.
+ */
+static int cache_ttl_test(void)
+{
+    enum { TTL = 60 };
+    pj_dns_parsed_packet pkt;
+    pj_dns_parsed_query q;
+    pj_dns_parsed_rr rr;
+    pj_str_t name = pj_str("cachettl");
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  cache TTL test"));
+
+    pj_bzero(&pkt, sizeof(pkt));
+    pj_bzero(&q, sizeof(q));
+    pj_bzero(&rr, sizeof(rr));
+    pkt.hdr.flags = PJ_DNS_SET_QR(1);
+    pkt.hdr.qdcount = 1;
+    pkt.hdr.anscount = 1;
+    pkt.q = &q;
+    pkt.ans = &rr;
+    q.type = PJ_DNS_TYPE_A;
+    q.dnsclass = 1;
+    q.name = name;
+    rr.type = PJ_DNS_TYPE_A;
+    rr.dnsclass = 1;
+    rr.name = name;
+    rr.ttl = TTL;
+    rr.rdata.a.ip_addr.s_addr = IP_ADDR0;
+
+    status = pj_dns_resolver_add_entry(resolver, &pkt, PJ_TRUE);
+    if (status != PJ_SUCCESS)
+	return -2100;
+
+    pj_thread_sleep(1100);
+
+    cache_ttl = 0;
+    status = pj_dns_resolver_start_query(resolver, &name, PJ_DNS_TYPE_A, 0,
+					 &cache_ttl_cb, NULL, NULL);
+    if (status != PJ_SUCCESS)
+	return -2110;
+    if (cache_ttl == 0 || cache_ttl >= TTL || cache_ttl < TTL - 3) {
+	PJ_LOG(3,(THIS_FILE, "  error: cached TTL is %u, expecting "
+		  "less than %u", cache_ttl, TTL));
+	return -2120;
+    }
+
+    return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+/* UDP socket pool and TCP fallback tests */
+
+static struct tcp_server_t
+{
+    pj_sock_t	    lsock;	/* Listening socket.	    */
+    pj_sock_t	    sock;	/* Accepted connection.	    */
+    unsigned	    pkt_count;	/* Number of queries.	    */
+} g_tcp_server[2];
+
+static pj_bool_t tcp_thread_quit;
+
+/* Build DNS A response for the query */
+static void make_a_response(const pj_dns_parsed_packet *pkt,
+			    pj_dns_parsed_packet *res,
+			    pj_bool_t truncated)
+{
+    pj_bzero(res, sizeof(*res));
+    res->hdr.id = pkt->hdr.id;
+    res->hdr.flags = PJ_DNS_SET_QR(1) | PJ_DNS_SET_TC(truncated);
+    res->hdr.qdcount = 1;
+    res->q = PJ_POOL_ZALLOC_T(pool, pj_dns_parsed_query);
+    res->q[0] = pkt->q[0];
+
+    /* Truncated response carries no answer */
+    if (truncated)
+	return;
+
+    res->hdr.anscount = 1;
+    res->ans = PJ_POOL_ZALLOC_T(pool, pj_dns_parsed_rr);
+    res->ans[0].type = PJ_DNS_TYPE_A;
+    res->ans[0].dnsclass = 1;
+    res->ans[0].name = pkt->q[0].name;
+    res->ans[0].ttl = 1;
+    res->ans[0].rdata.a.ip_addr.s_addr = IP_ADDR0;
+}
+
+static void action_a(const pj_dns_parsed_packet *pkt,
+		     pj_dns_parsed_packet **p_res)
+{
+    *p_res = PJ_POOL_ZALLOC_T(pool, pj_dns_parsed_packet);
+    make_a_response(pkt, *p_res, PJ_FALSE);
+}
+
+static void action_tc(const pj_dns_parsed_packet *pkt,
+		      pj_dns_parsed_packet **p_res)
+{
+    *p_res = PJ_POOL_ZALLOC_T(pool, pj_dns_parsed_packet);
+    make_a_response(pkt, *p_res, PJ_TRUE);
+}
+
+/* Answer the (possibly pipelined) queries received on the connection */
+static void tcp_server_read(struct tcp_server_t *srv)
+{
+    pj_uint8_t buf[1024];
+    pj_uint8_t *p = buf;
+    pj_ssize_t len = sizeof(buf);
+
+    if (pj_sock_recv(srv->sock, buf, &len, 0) != PJ_SUCCESS || len <= 0) {
+	pj_sock_close(srv->sock);
+	srv->sock = PJ_INVALID_SOCKET;
+	return;
+    }
+
+    /* Queries are small, assume they are not split across reads */
+    while (len >= 2) {
+	unsigned qlen = (p[0] << 8) | p[1];
+	pj_dns_parsed_packet *req, res;
+	pj_uint8_t out[600];
+	pj_ssize_t out_len;
+
+	if (len < (pj_ssize_t)qlen + 2 ||
+	    pj_dns_parse_packet(pool, p + 2, qlen, &req) != PJ_SUCCESS)
+	{
+	    break;
+	}
+	srv->pkt_count++;
+
+	make_a_response(req, &res, PJ_FALSE);
+	out_len = print_packet(&res, out + 2, sizeof(out) - 2);
+	write16(out, (pj_uint16_t)out_len);
+	out_len += 2;
+	pj_sock_send(srv->sock, out, &out_len, 0);
+
+	p += qlen + 2;
+	len -= qlen + 2;
+    }
+}
+
+static int tcp_server_thread(void *p)
+{
+    PJ_UNUSED_ARG(p);
+
+    while (!tcp_thread_quit) {
+	pj_fd_set_t rset;
+	pj_time_val timeout = {0, 100};
+	int i, nfds = 0;
+
+	PJ_FD_ZERO(&rset);
+	for (i=0; i<2; ++i) {
+	    struct tcp_server_t *srv = &g_tcp_server[i];
+	    pj_sock_t s = (srv->sock != PJ_INVALID_SOCKET) ?
+			  srv->sock : srv->lsock;
+
+	    PJ_FD_SET(s, &rset);
+	    if ((int)s + 1 > nfds)
+		nfds = (int)s + 1;
+	}
+
+	if (pj_sock_select(nfds, &rset, NULL, NULL, &timeout) < 1)
+	    continue;
+
+	for (i=0; i<2; ++i) {
+	    struct tcp_server_t *srv = &g_tcp_server[i];
+
+	    if (srv->sock == PJ_INVALID_SOCKET) {
+		if (PJ_FD_ISSET(srv->lsock, &rset))
+		    pj_sock_accept(srv->lsock, &srv->sock, NULL, NULL);
+	    } else if (PJ_FD_ISSET(srv->sock, &rset)) {
+		tcp_server_read(srv);
+	    }
+	}
+    }
+
+    return 0;
+}
+
+static void pool_test_cb(void *user_data,
+			 pj_status_t status,
+			 pj_dns_parsed_packet *resp)
+{
+    pj_status_t *p_status = (pj_status_t*) user_data;
+
+    /* The response must be complete */
+    if (status == PJ_SUCCESS &&
+	(!resp || PJ_DNS_GET_TC(resp->hdr.flags) || resp->hdr.anscount != 1))
+    {
+	status = PJ_EINVALIDOP;
+    }
+    *p_status = status;
+
+    pj_sem_post(sem);
+}
+
+/* Resolve several names at once and check that all succeed */
+static int resolve_names(pj_dns_resolver *resv, const char *prefix,
+			 int err_base)
+{
+    enum { NAME_CNT = 6 };
+    pj_status_t st[NAME_CNT];
+    char names[NAME_CNT][16];
+    unsigned i;
+
+    for (i=0; i<NAME_CNT; ++i) {
+	pj_str_t name;
+	pj_status_t status;
+
+	pj_ansi_snprintf(names[i], sizeof(names[i]), "%s%u", prefix, i);
+	name = pj_str(names[i]);
+	st[i] = PJ_EPENDING;
+	status = pj_dns_resolver_start_query(resv, &name, PJ_DNS_TYPE_A, 0,
+					     &pool_test_cb, &st[i], NULL);
+	if (status != PJ_SUCCESS)
+	    return err_base;
+    }
+
+    for (i=0; i<NAME_CNT; ++i)
+	pj_sem_wait(sem);
+
+    for (i=0; i<NAME_CNT; ++i) {
+	if (st[i] != PJ_SUCCESS) {
+	    app_perror("  query failed", st[i]);
+	    return err_base - 10;
+	}
+    }
+
+    return 0;
+}
+
+static int udp_pool_test(void)
+{
+    pj_dns_resolver *resv;
+    pj_dns_resolver_stat stat;
+    pj_str_t nameserver = pj_str("127.0.0.1");
+    pj_uint16_t port = g_server[0].port;
+    int rc;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  UDP socket pool test"));
+
+    g_server[0].action = ACTION_CB;
+    g_server[0].action_cb = &action_a;
+
+    status = pj_dns_resolver_create(mem, "pooltest", PJ_DNS_RESOLVER_UDP_POOL,
+				    timer_heap, ioqueue, &resv);
+    if (status != PJ_SUCCESS)
+	return -3000;
+
+    pj_dns_resolver_set_ns(resv, 1, &nameserver, &port);
+
+    rc = resolve_names(resv, "pool", -3010);
+    if (rc == 0) {
+	pj_dns_resolver_get_stat(resv, &stat);
+	if (stat.udp_sock_cnt < PJ_DNS_RESOLVER_UDP_SOCK_CNT ||
+	    stat.in_flight != 0 || stat.max_in_flight == 0 ||
+	    stat.ns[0].rx_cnt == 0)
+	{
+	    rc = -3030;
+	}
+    }
+
+    pj_dns_resolver_destroy(resv, PJ_FALSE);
+    return rc;
+}
+
+static void id_test_cb(void *user_data,
+		       pj_status_t status,
+		       pj_dns_parsed_packet *resp)
+{
+    PJ_UNUSED_ARG(user_data);
+    PJ_UNUSED_ARG(status);
+    PJ_UNUSED_ARG(resp);
+}
+
+/* With every transaction ID in use, new query must fail rather than
+ * searching for free ID forever.
+ */
+static int id_exhaust_test(void)
+{
+    pj_dns_resolver *resv;
+    pj_sock_t sock;
+    pj_sockaddr addr;
+    int addr_len = sizeof(addr);
+    pj_str_t nameserver = pj_str("127.0.0.1");
+    pj_uint16_t port;
+    unsigned i;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  transaction ID exhaustion test"));
+
+    /* Nameserver which never answers, so all queries stay pending */
+    status = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &sock);
+    if (status != PJ_SUCCESS)
+	return -3100;
+    pj_sockaddr_init(pj_AF_INET(), &addr, &nameserver, 0);
+    if (pj_sock_bind(sock, &addr, pj_sockaddr_get_len(&addr)) ||
+	pj_sock_getsockname(sock, &addr, &addr_len))
+    {
+	pj_sock_close(sock);
+	return -3105;
+    }
+    port = pj_sockaddr_get_port(&addr);
+
+    status = pj_dns_resolver_create(mem, "idtest", 0, NULL, NULL, &resv);
+    if (status != PJ_SUCCESS) {
+	pj_sock_close(sock);
+	return -3110;
+    }
+
+    pj_dns_resolver_set_ns(resv, 1, &nameserver, &port);
+
+    for (i=0; i<0xFFFF; ++i) {
+	char buf[16];
+	pj_str_t name;
+
+	pj_ansi_snprintf(buf, sizeof(buf), "id%u", i);
+	name = pj_str(buf);
+	status = pj_dns_resolver_start_query(resv, &name, PJ_DNS_TYPE_A, 0,
+					     &id_test_cb, NULL, NULL);
+	if (status != PJ_SUCCESS) {
+	    app_perror("  query failed", status);
+	    rc = -3120;
+	    break;
+	}
+    }
+
+    if (rc == 0) {
+	pj_str_t name = pj_str("id-last");
+
+	status = pj_dns_resolver_start_query(resv, &name, PJ_DNS_TYPE_A, 0,
+					     &id_test_cb, NULL, NULL);
+	if (status != PJ_ETOOMANY)
+	    rc = -3130;
+    }
+
+    pj_dns_resolver_destroy(resv, PJ_FALSE);
+    pj_sock_close(sock);
+    return rc;
+}
+
+static int tcp_fallback_test(void)
+{
+    pj_dns_resolver_stat stat;
+    pj_dns_settings tcp_set;
+    pj_thread_t *thread;
+    unsigned i, tcp_cnt;
+    int rc;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  TCP fallback test"));
+
+    /* The TCP servers listen on the same ports as the UDP servers */
+    for (i=0; i<2; ++i) {
+	pj_sockaddr addr;
+
+	g_tcp_server[i].sock = PJ_INVALID_SOCKET;
+	g_tcp_server[i].pkt_count = 0;
+
+	status = pj_sock_socket(pj_AF_INET(), pj_SOCK_STREAM(), 0,
+				&g_tcp_server[i].lsock);
+	if (status != PJ_SUCCESS)
+	    return -3100;
+
+	pj_sockaddr_init(pj_AF_INET(), &addr, NULL, g_server[i].port);
+	status = pj_sock_bind(g_tcp_server[i].lsock, &addr,
+			      pj_sockaddr_get_len(&addr));
+	if (status == PJ_SUCCESS)
+	    status = pj_sock_listen(g_tcp_server[i].lsock, 5);
+	if (status != PJ_SUCCESS)
+	    return -3110;
+    }
+
+    tcp_thread_quit = PJ_FALSE;
+    status = pj_thread_create(pool, NULL, &tcp_server_thread, NULL, 0, 0,
+			      &thread);
+    if (status != PJ_SUCCESS)
+	return -3120;
+
+    /* UDP servers only send truncated responses */
+    g_server[0].action = ACTION_CB;
+    g_server[0].action_cb = &action_tc;
+    g_server[1].action = ACTION_CB;
+    g_server[1].action_cb = &action_tc;
+
+    tcp_set = set;
+    tcp_set.options |= PJ_DNS_RESOLVER_TCP_FALLBACK;
+    pj_dns_resolver_set_settings(resolver, &tcp_set);
+
+    /* The queries are pipelined over the TCP connection */
+    rc = resolve_names(resolver, "tcp", -3130);
+    if (rc == 0) {
+	pj_dns_resolver_get_stat(resolver, &stat);
+
+	tcp_cnt = 0;
+	for (i=0; i<stat.ns_count; ++i)
+	    tcp_cnt += stat.ns[i].tcp_tx_cnt;
+
+	if (stat.truncated_cnt == 0 || tcp_cnt == 0 ||
+	    g_tcp_server[0].pkt_count + g_tcp_server[1].pkt_count == 0)
+	{
+	    rc = -3150;
+	}
+    }
+
+    pj_dns_resolver_dump(resolver, PJ_FALSE);
+    pj_dns_resolver_set_settings(resolver, &set);
+
+    tcp_thread_quit = PJ_TRUE;
+    pj_thread_join(thread);
+    for (i=0; i<2; ++i) {
+	if (g_tcp_server[i].sock != PJ_INVALID_SOCKET)
+	    pj_sock_close(g_tcp_server[i].sock);
+	pj_sock_close(g_tcp_server[i].lsock);
+    }
+
+    return rc;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+/* Embedded DNS server test */
+
+struct server_result
+{
+    pj_status_t	    status;
+    unsigned	    flags;
+    unsigned	    anscount;
+    unsigned	    arcount;
+    pj_dns_type	    type;
+    unsigned	    rdlength;
+    pj_uint8_t	    data[32];
+};
+
+static void server_query_cb(void *user_data,
+			    pj_status_t status,
+			    pj_dns_parsed_packet *response)
+{
+    struct server_result *res = (struct server_result*) user_data;
+
+    pj_bzero(res, sizeof(*res));
+    res->status = status;
+    if (response) {
+	res->flags = response->hdr.flags;
+	res->anscount = response->hdr.anscount;
+	res->arcount = response->hdr.arcount;
+	if (response->hdr.anscount) {
+	    res->type = (pj_dns_type)response->ans[0].type;
+	    res->rdlength = response->ans[0].rdlength;
+	    if (response->ans[0].data &&
+		response->ans[0].rdlength <= sizeof(res->data))
+	    {
+		pj_memcpy(res->data, response->ans[0].data,
+			  response->ans[0].rdlength);
+	    }
+	}
+    }
+
+    pj_sem_post(sem);
+}
+
+static int server_query(pj_dns_resolver *resv, const char *name,
+			pj_dns_type type, struct server_result *res)
+{
+    pj_str_t qname = pj_str((char*)name);
+    pj_status_t status;
+
+    status = pj_dns_resolver_start_query(resv, &qname, type, 0,
+					 &server_query_cb, res, NULL);
+    if (status != PJ_SUCCESS)
+	return -1;
+
+    pj_sem_wait(sem);
+    return 0;
+}
+
+static int dns_server_test(void)
+{
+    /* NAPTR rdata: order 100, pref 10, "s", "SIP+D2U", "", target */
+    static const pj_uint8_t naptr_data[] = {
+	0, 100, 0, 10, 1, 's', 7, 'S', 'I', 'P', '+', 'D', '2', 'U', 0,
+	4, '_', 's', 'i', 'p', 4, '_', 'u', 'd', 'p', 0
+    };
+    pj_str_t srv_name = pj_str("_sip._udp.dnssrv.test");
+    pj_str_t naptr_name = pj_str("dnssrv.test");
+    pj_str_t target1 = pj_str("sip1.dnssrv.test");
+    pj_str_t target2 = pj_str("sip2.dnssrv.test");
+    pj_str_t alias = pj_str("alias.dnssrv.test");
+    pj_str_t nameserver = pj_str("127.0.0.1");
+    pj_uint16_t port = 5555;
+    pj_dns_parsed_rr rr[7];
+    pj_dns_server *srv;
+    pj_dns_resolver *resv;
+    pj_dns_settings resv_set;
+    struct server_result res;
+    pj_in_addr addr;
+    pj_in6_addr addr6;
+    unsigned i;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  DNS server test"));
+
+    status = pj_dns_server_create(mem, ioqueue, pj_AF_INET(), port, 0, &srv);
+    if (status != PJ_SUCCESS)
+	return -3200;
+
+    pj_bzero(&addr6, sizeof(addr6));
+    addr6.s6_addr[15] = 1;
+
+    pj_dns_init_srv_rr(&rr[0], &srv_name, PJ_DNS_CLASS_IN, 60, 1, 1, 5060,
+		       &target1);
+    pj_dns_init_srv_rr(&rr[1], &srv_name, PJ_DNS_CLASS_IN, 60, 2, 1, 5060,
+		       &target2);
+    addr = pj_inet_addr2("1.1.1.1");
+    pj_dns_init_a_rr(&rr[2], &target1, PJ_DNS_CLASS_IN, 60, &addr);
+    addr = pj_inet_addr2("1.1.1.2");
+    pj_dns_init_a_rr(&rr[3], &target1, PJ_DNS_CLASS_IN, 60, &addr);
+    pj_dns_init_aaaa_rr(&rr[4], &target2, PJ_DNS_CLASS_IN, 60, &addr6);
+
+    pj_bzero(&rr[5], sizeof(rr[5]));
+    rr[5].name = naptr_name;
+    rr[5].type = PJ_DNS_TYPE_NAPTR;
+    rr[5].dnsclass = PJ_DNS_CLASS_IN;
+    rr[5].ttl = 60;
+    rr[5].rdlength = sizeof(naptr_data);
+    rr[5].data = (void*)naptr_data;
+
+    pj_dns_init_cname_rr(&rr[6], &alias, PJ_DNS_CLASS_IN, 60, &target1);
+
+    status = pj_dns_server_add_rec(srv, PJ_ARRAY_SIZE(rr), rr);
+    if (status != PJ_SUCCESS) {
+	pj_dns_server_destroy(srv);
+	return -3210;
+    }
+
+    status = pj_dns_resolver_create(mem, "srvtest", 0, timer_heap, ioqueue,
+				    &resv);
+    if (status != PJ_SUCCESS) {
+	pj_dns_server_destroy(srv);
+	return -3220;
+    }
+
+    /* Disable the resolver cache, so that every query reaches the server */
+    pj_dns_resolver_get_settings(resv, &resv_set);
+    resv_set.cache_max_ttl = 0;
+    pj_dns_resolver_set_settings(resv, &resv_set);
+    pj_dns_resolver_set_ns(resv, 1, &nameserver, &port);
+
+    /* The second query is answered from the prebuilt answer */
+    for (i=0; i<2 && rc==0; ++i) {
+	if (server_query(resv, srv_name.ptr, PJ_DNS_TYPE_SRV, &res) != 0)
+	    rc = -3230;
+	else if (res.status != PJ_SUCCESS || res.anscount != 2 ||
+		 res.arcount != 3 || !PJ_DNS_GET_QR(res.flags) ||
+		 !PJ_DNS_GET_AA(res.flags))
+	    rc = -3240;
+    }
+
+    if (rc == 0) {
+	if (server_query(resv, naptr_name.ptr, PJ_DNS_TYPE_NAPTR, &res) != 0)
+	    rc = -3250;
+	else if (res.status != PJ_SUCCESS || res.anscount != 1 ||
+		 res.type != PJ_DNS_TYPE_NAPTR ||
+		 res.rdlength != sizeof(naptr_data) ||
+		 pj_memcmp(res.data, naptr_data, sizeof(naptr_data)) != 0)
+	    rc = -3260;
+    }
+
+    for (i=0; i<2 && rc==0; ++i) {
+	if (server_query(resv, "none.dnssrv.test", PJ_DNS_TYPE_A, &res) != 0)
+	    rc = -3270;
+	else if (res.status !=
+		 PJ_STATUS_FROM_DNS_RCODE(PJ_DNS_RCODE_NXDOMAIN))
+	    rc = -3280;
+    }
+
+    /* The answer to CNAME query has the A records of the canonical name,
+     * other queries only have the records of the query type.
+     */
+    if (rc == 0) {
+	if (server_query(resv, alias.ptr, PJ_DNS_TYPE_CNAME, &res) != 0)
+	    rc = -3282;
+	else if (res.status != PJ_SUCCESS || res.anscount != 3 ||
+		 res.type != PJ_DNS_TYPE_CNAME)
+	    rc = -3284;
+    }
+    if (rc == 0) {
+	if (server_query(resv, alias.ptr, PJ_DNS_TYPE_AAAA, &res) != 0)
+	    rc = -3286;
+	else if (res.status != PJ_SUCCESS || res.anscount != 1 ||
+		 res.type != PJ_DNS_TYPE_CNAME)
+	    rc = -3288;
+    }
+
+    /* Adding a record discards the prebuilt answers */
+    if (rc == 0) {
+	if (server_query(resv, target1.ptr, PJ_DNS_TYPE_A, &res) != 0 ||
+	    res.status != PJ_SUCCESS || res.anscount != 2)
+	{
+	    rc = -3290;
+	}
+    }
+
+    if (rc == 0) {
+	addr = pj_inet_addr2("1.1.1.3");
+	pj_dns_init_a_rr(&rr[0], &target1, PJ_DNS_CLASS_IN, 60, &addr);
+	pj_dns_server_add_rec(srv, 1, rr);
+
+	if (server_query(resv, target1.ptr, PJ_DNS_TYPE_A, &res) != 0 ||
+	    res.status != PJ_SUCCESS || res.anscount != 3)
+	{
+	    rc = -3300;
+	}
+    }
+
+    pj_dns_resolver_destroy(resv, PJ_FALSE);
+    pj_dns_server_destroy(srv);
+
+    return rc;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////
 
 
@@ -1871,6 +2605,30 @@ int resolver_test(void)
     if (rc != 0)
 	goto on_error;
 
+    rc = cache_limit_test();
+    if (rc != 0)
+	goto on_error;
+
+    rc = cache_ttl_test();
+    if (rc != 0)
+	goto on_error;
+
+    rc = udp_pool_test();
+    if (rc != 0)
+	goto on_error;
+
+    rc = id_exhaust_test();
+    if (rc != 0)
+	goto on_error;
+
+    rc = tcp_fallback_test();
+    if (rc != 0)
+	goto on_error;
+
+    rc = dns_server_test();
+    if (rc != 0)
+	goto on_error;
+
     srv_resolver_test();
     srv_resolver_fallback_test();
     srv_resolver_many_test();
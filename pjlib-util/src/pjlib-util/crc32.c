@@ -10,10 +10,250 @@
  * this file is put on public domain as well.
  */
 #include <pjlib-util/crc32.h>
+#include <pj/string.h>
 
 
 #define CRC32_NEGL  0xffffffffL
 
+/*
+ * CPU instructions for CRC32. Note that the SSE4.2 crc32 instruction
+ * computes CRC-32C (Castagnoli), not the ITU-T V.42 polynomial used here,
+ * so on x86 the CRC is folded with carry-less multiplication (PCLMULQDQ)
+ * instead. The functions work on the bit reflected CRC register (i.e.
+ * before the final inversion), process a multiple of their block size
+ * from the start of the data, and return the number of bytes processed.
+ */
+#if defined(PJ_CRYPTO_HAS_HW_ACCEL) && PJ_CRYPTO_HAS_HW_ACCEL != 0 && \
+    defined(PJ_IS_LITTLE_ENDIAN) && PJ_IS_LITTLE_ENDIAN != 0
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#   define CRC32_HAS_PCLMUL	1
+#   include <cpuid.h>
+#   include <immintrin.h>
+#   define CRC32_PCLMUL_FUNC	__attribute__((target("pclmul,sse4.1")))
+
+static pj_bool_t crc32_cpu_has_pclmul(void)
+{
+    unsigned a, b, c, d;
+
+    return __get_cpuid(1, &a, &b, &c, &d) &&
+	   (c & (bit_PCLMUL | bit_SSE4_1)) == (bit_PCLMUL | bit_SSE4_1);
+}
+
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#   define CRC32_HAS_PCLMUL	1
+#   include <intrin.h>
+#   include <immintrin.h>
+#   define CRC32_PCLMUL_FUNC
+
+static pj_bool_t crc32_cpu_has_pclmul(void)
+{
+    int info[4];
+
+    __cpuid(info, 1);
+    return (info[2] & ((1 << 1) | (1 << 19))) == ((1 << 1) | (1 << 19));
+}
+
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#   define CRC32_HAS_ARMV8	1
+#   include <arm_acle.h>
+#endif
+
+#endif	/* PJ_CRYPTO_HAS_HW_ACCEL */
+
+
+#if defined(CRC32_HAS_PCLMUL)
+
+/* Minimum length to use PCLMULQDQ */
+#define CRC32_HW_MIN_LEN    64
+
+/*
+ * Fold 64 bytes at a time with carry-less multiplication, then reduce
+ * with Barrett reduction, see "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction" by Intel. The constants are
+ * for the bit reflected 0x04C11DB7 polynomial.
+ */
+CRC32_PCLMUL_FUNC
+static pj_size_t crc32_blocks_pclmul(pj_uint32_t *crc, const pj_uint8_t *buf,
+				     pj_size_t len)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+    const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124LL);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+    pj_size_t done;
+
+    len &= ~(pj_size_t)15;
+    done = len;
+
+    x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)*crc));
+    buf += 64;
+    len -= 64;
+
+    /* Fold four blocks of 16 bytes in parallel */
+    x0 = k1k2;
+    while (len >= 64) {
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+	x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+	x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+	x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+	x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+			   _mm_loadu_si128((const __m128i*)(buf + 0x00)));
+	x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),
+			   _mm_loadu_si128((const __m128i*)(buf + 0x10)));
+	x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),
+			   _mm_loadu_si128((const __m128i*)(buf + 0x20)));
+	x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),
+			   _mm_loadu_si128((const __m128i*)(buf + 0x30)));
+	buf += 64;
+	len -= 64;
+    }
+
+    /* Fold into 128 bits */
+    x0 = k3k4;
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    /* Fold the remaining blocks of 16 bytes */
+    while (len >= 16) {
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+			   _mm_loadu_si128((const __m128i*)buf));
+	buf += 16;
+	len -= 16;
+    }
+
+    /* Fold 128 bits to 64 bits */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+    x0 = k5k0;
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = poly;
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    *crc = (pj_uint32_t)_mm_extract_epi32(x1, 1);
+    return done;
+}
+
+#elif defined(CRC32_HAS_ARMV8)
+
+#define CRC32_HW_MIN_LEN    8
+
+static pj_size_t crc32_blocks_armv8(pj_uint32_t *crc, const pj_uint8_t *buf,
+				    pj_size_t len)
+{
+    pj_uint32_t c = *crc;
+    pj_size_t i;
+
+    len &= ~(pj_size_t)7;
+    for (i = 0; i < len; i += 8) {
+	pj_uint64_t v;
+
+	pj_memcpy(&v, buf + i, 8);
+	c = __crc32d(c, v);
+    }
+
+    *crc = c;
+    return len;
+}
+
+#endif
+
+
+#if defined(CRC32_HW_MIN_LEN)
+
+static pj_size_t (*crc32_blocks)(pj_uint32_t*, const pj_uint8_t*, pj_size_t);
+static pj_bool_t crc32_selected;
+
+static void crc32_select_impl(void)
+{
+#if defined(CRC32_HAS_PCLMUL)
+    crc32_blocks = crc32_cpu_has_pclmul() ? &crc32_blocks_pclmul : NULL;
+#else
+    crc32_blocks = &crc32_blocks_armv8;
+#endif
+    crc32_selected = PJ_TRUE;
+}
+
+/* Process the start of the data with the CPU instructions, if any */
+#define CRC32_HW_UPDATE(crc, data, nbytes)				\
+    if (crc32_blocks && nbytes >= CRC32_HW_MIN_LEN) {			\
+	pj_size_t done = (*crc32_blocks)(&crc, data, nbytes);		\
+	data += done;							\
+	nbytes -= done;							\
+    }
+
+#define CRC32_SELECT_IMPL()	if (!crc32_selected) crc32_select_impl()
+
+#else
+#   define CRC32_HW_UPDATE(crc, data, nbytes)
+#   define CRC32_SELECT_IMPL()
+#endif
+
+
+PJ_DEF(const char*) pj_crc32_set_accel(pj_bool_t enable)
+{
+#if defined(CRC32_HW_MIN_LEN)
+    if (enable) {
+	crc32_select_impl();
+    } else {
+	crc32_blocks = NULL;
+	crc32_selected = PJ_TRUE;
+    }
+
+    if (crc32_blocks) {
+#   if defined(CRC32_HAS_PCLMUL)
+	return "PCLMULQDQ";
+#   else
+	return "ARMv8";
+#   endif
+    }
+#else
+    PJ_UNUSED_ARG(enable);
+#endif
+
+#if defined(PJ_CRC32_HAS_TABLES) && PJ_CRC32_HAS_TABLES!=0
+    return "C table";
+#else
+    return "C";
+#endif
+}
+
+
 #if defined(PJ_CRC32_HAS_TABLES) && PJ_CRC32_HAS_TABLES!=0
 // crc.cpp - written and placed in the public domain by Wei Dai
 
@@ -150,6 +390,7 @@ static const pj_uint32_t crc_tab[] = {
 
 PJ_DEF(void) pj_crc32_init(pj_crc32_context *ctx)
 {
+    CRC32_SELECT_IMPL();
     ctx->crc_state = 0;
 }
 
@@ -159,6 +400,8 @@ PJ_DEF(pj_uint32_t) pj_crc32_update(pj_crc32_context *ctx,
 {
     pj_uint32_t crc = ctx->crc_state ^ CRC32_NEGL;
 
+    CRC32_HW_UPDATE(crc, data, nbytes);
+
     for( ; (((unsigned long)(pj_ssize_t)data) & 0x03) && nbytes > 0; --nbytes) {
 	crc = crc_tab[CRC32_INDEX(crc) ^ *data++] ^ CRC32_SHIFTED(crc);
     }
@@ -192,6 +435,7 @@ PJ_DEF(pj_uint32_t) pj_crc32_final(pj_crc32_context *ctx)
 
 PJ_DEF(void) pj_crc32_init(pj_crc32_context *ctx)
 {
+    CRC32_SELECT_IMPL();
     ctx->crc_state = CRC32_NEGL;
 }
 
@@ -203,6 +447,8 @@ PJ_DEF(pj_uint32_t) pj_crc32_update(pj_crc32_context *ctx,
 {
     pj_uint32_t crc = ctx->crc_state;
     
+    CRC32_HW_UPDATE(crc, octets, len);
+
     while (len--) {
 	pj_uint32_t temp;
 	int j;
@@ -21,8 +21,11 @@
 #include <pjlib-util/errno.h>
 #include <pj/activesock.h>
 #include <pj/assert.h>
+#include <pj/ctype.h>
+#include <pj/hash.h>
 #include <pj/list.h>
 #include <pj/log.h>
+#include <pj/os.h>
 #include <pj/pool.h>
 #include <pj/string.h>
 
@@ -31,6 +34,9 @@
 #define MAX_PKT	    1500
 #define MAX_LABEL   32
 
+/* Maximum length of the question section (name, type, and class) */
+#define MAX_QUESTION	(255 + 4)
+
 struct label_tab
 {
     unsigned count;
@@ -48,13 +54,32 @@ struct rr
 };
 
 
+/* Prebuilt answer in wire format, indexed by the question section of the
+ * query (with the name in lowercase).
+ */
+struct answer
+{
+    pj_hash_entry_buf	 hbuf;
+    pj_uint8_t		*key;
+    unsigned		 keylen;
+    pj_uint8_t		*pkt;
+    unsigned		 len;
+};
+
 struct pj_dns_server
 {
     pj_pool_t		*pool;
     pj_pool_factory	*pf;
+    pj_sock_t		 sock;
     pj_activesock_t	*asock;
-    pj_ioqueue_op_key_t	 send_key;
+    pj_rwmutex_t	*lock;
     struct rr		 rr_list;
+
+    /* Prebuilt answers, discarded whenever the records change */
+    pj_pool_t		*ans_pool;
+    pj_hash_table_t	*ans_table;
+    unsigned		 ans_cnt;
+    unsigned		 ans_gen;	/* Incremented when discarded	    */
 };
 
 
@@ -65,6 +90,12 @@ static pj_bool_t on_data_recvfrom(pj_activesock_t *asock,
 				  int addr_len,
 				  pj_status_t status);
 
+static pj_status_t create_answers(pj_dns_server *srv,
+				  pj_pool_t **p_pool,
+				  pj_hash_table_t **p_table);
+static void set_answers(pj_dns_server *srv, pj_pool_t *pool,
+			pj_hash_table_t *table);
+
 
 PJ_DEF(pj_status_t) pj_dns_server_create( pj_pool_factory *pf,
 				          pj_ioqueue_t *ioqueue,
@@ -76,7 +107,10 @@ PJ_DEF(pj_status_t) pj_dns_server_create( pj_pool_factory *pf,
     pj_pool_t *pool;
     pj_dns_server *srv;
     pj_sockaddr sock_addr;
+    pj_activesock_cfg asock_cfg;
     pj_activesock_cb sock_cb;
+    pj_pool_t *ans_pool;
+    pj_hash_table_t *ans_table;
     pj_status_t status;
 
     PJ_ASSERT_RETURN(pf && ioqueue && p_srv && flags==0, PJ_EINVAL);
@@ -86,22 +120,48 @@ PJ_DEF(pj_status_t) pj_dns_server_create( pj_pool_factory *pf,
     srv = (pj_dns_server*) PJ_POOL_ZALLOC_T(pool, pj_dns_server);
     srv->pool = pool;
     srv->pf = pf;
+    srv->sock = PJ_INVALID_SOCKET;
     pj_list_init(&srv->rr_list);
 
+    status = pj_rwmutex_create(pool, "dnsserver", &srv->lock);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    status = create_answers(srv, &ans_pool, &ans_table);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+    set_answers(srv, ans_pool, ans_table);
+
     pj_bzero(&sock_addr, sizeof(sock_addr));
     sock_addr.addr.sa_family = (pj_uint16_t)af;
     pj_sockaddr_set_port(&sock_addr, (pj_uint16_t)port);
-    
+
+    /* Answers are sent directly with the socket, so that queries can be
+     * handled concurrently without sharing an ioqueue send key.
+     */
+    status = pj_sock_socket(af, pj_SOCK_DGRAM(), 0, &srv->sock);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    status = pj_sock_bind(srv->sock, &sock_addr,
+			  pj_sockaddr_get_len(&sock_addr));
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    pj_activesock_cfg_default(&asock_cfg);
+    asock_cfg.async_cnt = PJ_DNS_SERVER_ASYNC_CNT;
+    asock_cfg.concurrency = 1;
+    asock_cfg.whole_data = PJ_FALSE;
+
     pj_bzero(&sock_cb, sizeof(sock_cb));
     sock_cb.on_data_recvfrom = &on_data_recvfrom;
 
-    status = pj_activesock_create_udp(pool, &sock_addr, NULL, ioqueue,
-				      &sock_cb, srv, &srv->asock, NULL);
+    status = pj_activesock_create(pool, srv->sock, pj_SOCK_DGRAM(),
+				  &asock_cfg, ioqueue, &sock_cb, srv,
+				  &srv->asock);
     if (status != PJ_SUCCESS)
 	goto on_error;
 
-    pj_ioqueue_op_key_init(&srv->send_key, sizeof(srv->send_key));
-
     status = pj_activesock_start_recvfrom(srv->asock, pool, MAX_PKT, 0);
     if (status != PJ_SUCCESS)
 	goto on_error;
@@ -122,6 +182,17 @@ PJ_DEF(pj_status_t) pj_dns_server_destroy(pj_dns_server *srv)
     if (srv->asock) {
 	pj_activesock_close(srv->asock);
 	srv->asock = NULL;
+	srv->sock = PJ_INVALID_SOCKET;
+    } else if (srv->sock != PJ_INVALID_SOCKET) {
+	pj_sock_close(srv->sock);
+	srv->sock = PJ_INVALID_SOCKET;
+    }
+
+    pj_pool_safe_release(&srv->ans_pool);
+
+    if (srv->lock) {
+	pj_rwmutex_destroy(srv->lock);
+	srv->lock = NULL;
     }
 
     pj_pool_safe_release(&srv->pool);
@@ -130,6 +201,37 @@ PJ_DEF(pj_status_t) pj_dns_server_destroy(pj_dns_server *srv)
 }
 
 
+/* Create an empty table for the prebuilt answers. It's created before the
+ * records are changed, so that the change can't fail half way.
+ */
+static pj_status_t create_answers(pj_dns_server *srv,
+				  pj_pool_t **p_pool,
+				  pj_hash_table_t **p_table)
+{
+    *p_pool = pj_pool_create(srv->pf, "dnssrvans", 1000, 1000, NULL);
+    if (!*p_pool)
+	return PJ_ENOMEM;
+
+    *p_table = pj_hash_create(*p_pool, PJ_DNS_SERVER_MAX_ANSWERS);
+    return PJ_SUCCESS;
+}
+
+
+/* Discard the prebuilt answers, replacing them with the table created by
+ * create_answers(). Must be called with the write lock held, or before
+ * the server runs.
+ */
+static void set_answers(pj_dns_server *srv, pj_pool_t *pool,
+			pj_hash_table_t *table)
+{
+    pj_pool_safe_release(&srv->ans_pool);
+    srv->ans_pool = pool;
+    srv->ans_table = table;
+    srv->ans_cnt = 0;
+    ++srv->ans_gen;
+}
+
+
 static struct rr* find_rr( pj_dns_server *srv,
 			   unsigned dns_class,
 			   unsigned type	/* pj_dns_type */,
@@ -155,16 +257,33 @@ PJ_DEF(pj_status_t) pj_dns_server_add_rec( pj_dns_server *srv,
 					   unsigned count,
 					   const pj_dns_parsed_rr rr_param[])
 {
+    pj_pool_t *ans_pool;
+    pj_hash_table_t *ans_table;
     unsigned i;
+    pj_status_t status;
 
     PJ_ASSERT_RETURN(srv && count && rr_param, PJ_EINVAL);
 
+    status = create_answers(srv, &ans_pool, &ans_table);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    pj_rwmutex_lock_write(srv->lock);
+
     for (i=0; i<count; ++i) {
 	struct rr *rr;
 
-	PJ_ASSERT_RETURN(find_rr(srv, rr_param[i].dnsclass, rr_param[i].type,
-				 &rr_param[i].name) == NULL,
-			 PJ_EEXISTS);
+	/* Records of the same name and type form a set, except CNAME which
+	 * must be unique.
+	 */
+	if (rr_param[i].type == PJ_DNS_TYPE_CNAME &&
+	    find_rr(srv, rr_param[i].dnsclass, rr_param[i].type,
+		    &rr_param[i].name) != NULL)
+	{
+	    pj_assert(!"Duplicate CNAME record");
+	    status = PJ_EEXISTS;
+	    break;
+	}
 
 	rr = (struct rr*) PJ_POOL_ZALLOC_T(srv->pool, struct rr);
 	pj_memcpy(&rr->rec, &rr_param[i], sizeof(pj_dns_parsed_rr));
@@ -172,7 +291,14 @@ PJ_DEF(pj_status_t) pj_dns_server_add_rec( pj_dns_server *srv,
 	pj_list_push_back(&srv->rr_list, rr);
     }
 
-    return PJ_SUCCESS;
+    if (i > 0)
+	set_answers(srv, ans_pool, ans_table);
+    else
+	pj_pool_release(ans_pool);
+
+    pj_rwmutex_unlock_write(srv->lock);
+
+    return status;
 }
 
 
@@ -182,14 +308,34 @@ PJ_DEF(pj_status_t) pj_dns_server_del_rec( pj_dns_server *srv,
 					   const pj_str_t *name)
 {
     struct rr *rr;
+    pj_pool_t *ans_pool;
+    pj_hash_table_t *ans_table;
+    pj_status_t status;
 
     PJ_ASSERT_RETURN(srv && type && name, PJ_EINVAL);
 
+    status = create_answers(srv, &ans_pool, &ans_table);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    pj_rwmutex_lock_write(srv->lock);
+
     rr = find_rr(srv, dns_class, type, name);
-    if (!rr)
+    if (!rr) {
+	pj_rwmutex_unlock_write(srv->lock);
+	pj_pool_release(ans_pool);
 	return PJ_ENOTFOUND;
+    }
 
-    pj_list_erase(rr);
+    /* Remove the whole record set */
+    while (rr) {
+	pj_list_erase(rr);
+	rr = find_rr(srv, dns_class, type, name);
+    }
+
+    set_answers(srv, ans_pool, ans_table);
+
+    pj_rwmutex_unlock_write(srv->lock);
 
     return PJ_SUCCESS;
 }
@@ -201,6 +347,11 @@ static void write16(pj_uint8_t *p, pj_uint16_t val)
     p[1] = (pj_uint8_t)(val & 0xFF);
 }
 
+static pj_uint16_t read16(const pj_uint8_t *p)
+{
+    return (pj_uint16_t)((p[0] << 8) | p[1]);
+}
+
 static void write32(pj_uint8_t *p, pj_uint32_t val)
 {
     val = pj_htonl(val);
@@ -357,6 +508,20 @@ static int print_rr(pj_uint8_t *pkt, int size, pj_uint8_t *pos,
 	p += (len + 8);
 	size -= (len + 8);
 
+    } else if (rr->data) {
+
+	/* Other types such as NAPTR are written from the raw resource
+	 * data in wire format.
+	 */
+	if (size < rr->rdlength + 2)
+	    return -1;
+
+	write16(p, rr->rdlength);
+	pj_memcpy(p+2, rr->data, rr->rdlength);
+
+	p += (rr->rdlength + 2);
+	size -= (rr->rdlength + 2);
+
     } else {
 	pj_assert(!"Not supported");
 	return -1;
@@ -446,26 +611,77 @@ static int print_packet(const pj_dns_parsed_packet *rec, pj_uint8_t *pkt,
 }
 
 
-static pj_bool_t on_data_recvfrom(pj_activesock_t *asock,
-				  void *data,
-				  pj_size_t size,
-				  const pj_sockaddr_t *src_addr,
-				  int addr_len,
-				  pj_status_t status)
+/* Add all records of the name and type to the section */
+static void add_rr_set(pj_dns_server *srv, pj_dns_parsed_rr *sect,
+		       pj_uint16_t *count, unsigned dns_class, unsigned type,
+		       const pj_str_t *name)
+{
+    struct rr *r;
+
+    for (r=srv->rr_list.next; r!=&srv->rr_list && *count<MAX_ANS;
+	 r=r->next)
+    {
+	if (r->rec.dnsclass == dns_class && r->rec.type == type && 
+	    pj_stricmp(&r->rec.name, name)==0)
+	{
+	    pj_memcpy(&sect[*count], &r->rec, sizeof(pj_dns_parsed_rr));
+	    ++(*count);
+	}
+    }
+}
+
+
+/* Get the length of the question section of the query, or zero if the
+ * query can't be answered from the prebuilt answers.
+ */
+static unsigned get_question(const pj_uint8_t *pkt, pj_size_t size,
+			     pj_uint8_t key[MAX_QUESTION])
+{
+    unsigned pos = sizeof(pj_dns_hdr), len;
+
+    if (size < sizeof(pj_dns_hdr) || read16(pkt+4) != 1)
+	return 0;
+
+    while (pos < size && pkt[pos] != 0) {
+	/* No name compression in the question */
+	if (pkt[pos] & 0xC0)
+	    return 0;
+	pos += pkt[pos] + 1;
+    }
+
+    /* Terminating zero, type, and class */
+    pos += 5;
+    len = pos - sizeof(pj_dns_hdr);
+    if (pos > size || len > MAX_QUESTION)
+	return 0;
+
+    /* Names are case insensitive */
+    for (pos=0; pos<len-4; ++pos)
+	key[pos] = (pj_uint8_t)pj_tolower(pkt[sizeof(pj_dns_hdr)+pos]);
+    pj_memcpy(key+len-4, pkt+sizeof(pj_dns_hdr)+len-4, 4);
+
+    return len;
+}
+
+
+/* Build the answer from the records, and save it as prebuilt answer. The
+ * answer is built with the read lock held, so that queries are still
+ * answered in parallel; the write lock is only taken to save it.
+ */
+static pj_ssize_t build_answer(pj_dns_server *srv, void *data,
+			       pj_size_t size, const pj_sockaddr_t *src_addr,
+			       const pj_uint8_t *key, unsigned keylen)
 {
-    pj_dns_server *srv;
     pj_pool_t *pool;
     pj_dns_parsed_packet *req;
     pj_dns_parsed_packet ans;
-    struct rr *rr;
-    pj_ssize_t pkt_len;
-    unsigned i;
-
-    if (status != PJ_SUCCESS)
-	return PJ_TRUE;
+    pj_ssize_t pkt_len = -1;
+    pj_status_t status;
+    unsigned i, gen;
 
-    srv = (pj_dns_server*) pj_activesock_get_user_data(asock);
     pool = pj_pool_create(srv->pf, "dnssrvrx", 512, 256, NULL);
+    if (!pool)
+	return -1;
 
     status = pj_dns_parse_packet(pool, data, (unsigned)size, &req);
     if (status != PJ_SUCCESS) {
@@ -473,7 +689,8 @@ static pj_bool_t on_data_recvfrom(pj_activesock_t *asock,
 	pj_sockaddr_print(src_addr, addrinfo, sizeof(addrinfo), 3);
 	PJ_PERROR(4,(THIS_FILE, status, "Error parsing query from %s",
 		     addrinfo));
-	goto on_return;
+	pj_pool_release(pool);
+	return -1;
     }
 
     /* Init answer */
@@ -484,82 +701,163 @@ static pj_bool_t on_data_recvfrom(pj_activesock_t *asock,
     pj_memcpy(ans.q, req->q, sizeof(pj_dns_parsed_query));
 
     if (req->hdr.qdcount != 1) {
-	ans.hdr.flags = PJ_DNS_SET_RCODE(PJ_DNS_RCODE_FORMERR);
-	goto send_pkt;
+	ans.hdr.flags = PJ_DNS_SET_QR(1) |
+			PJ_DNS_SET_RCODE(PJ_DNS_RCODE_FORMERR);
+	pkt_len = print_packet(&ans, (pj_uint8_t*)data, MAX_PKT);
+	pj_pool_release(pool);
+	return pkt_len;
     }
 
-    if (req->q[0].dnsclass != PJ_DNS_CLASS_IN) {
-	ans.hdr.flags = PJ_DNS_SET_RCODE(PJ_DNS_RCODE_NOTIMPL);
-	goto send_pkt;
-    }
+    ans.hdr.flags = PJ_DNS_SET_QR(1) | PJ_DNS_SET_AA(1) |
+		    (req->hdr.flags & PJ_DNS_SET_RD(1));
 
-    /* Find the record */
-    rr = find_rr(srv, req->q->dnsclass, req->q->type, &req->q->name);
-    if (rr == NULL) {
-	ans.hdr.flags = PJ_DNS_SET_RCODE(PJ_DNS_RCODE_NXDOMAIN);
-	goto send_pkt;
+    pj_rwmutex_lock_read(srv->lock);
+
+    if (req->q[0].dnsclass != PJ_DNS_CLASS_IN) {
+	ans.hdr.flags |= PJ_DNS_SET_RCODE(PJ_DNS_RCODE_NOTIMPL);
+	goto print_pkt;
     }
 
-    /* Init answer record */
-    ans.hdr.anscount = 0;
     ans.ans = (pj_dns_parsed_rr*)
 	      pj_pool_calloc(pool, MAX_ANS, sizeof(pj_dns_parsed_rr));
+    ans.arr = (pj_dns_parsed_rr*)
+	      pj_pool_calloc(pool, MAX_ANS, sizeof(pj_dns_parsed_rr));
 
-    /* DNS SRV query needs special treatment since it returns multiple
-     * records
-     */
-    if (req->q->type == PJ_DNS_TYPE_SRV) {
-	struct rr *r;
-
-	r = srv->rr_list.next;
-	while (r != &srv->rr_list) {
-	    if (r->rec.dnsclass == req->q->dnsclass && 
-		r->rec.type == PJ_DNS_TYPE_SRV && 
-		pj_stricmp(&r->rec.name, &req->q->name)==0 &&
-		ans.hdr.anscount < MAX_ANS)
-	    {
-		pj_memcpy(&ans.ans[ans.hdr.anscount], &r->rec,
-			  sizeof(pj_dns_parsed_rr));
-		++ans.hdr.anscount;
-	    }
-	    r = r->next;
+    /* The whole record set of the name and type */
+    add_rr_set(srv, ans.ans, &ans.hdr.anscount, req->q->dnsclass,
+	       req->q->type, &req->q->name);
+
+    /* Otherwise follow the CNAME of the name, if any */
+    if (ans.hdr.anscount == 0 && req->q->type != PJ_DNS_TYPE_CNAME) {
+	add_rr_set(srv, ans.ans, &ans.hdr.anscount, req->q->dnsclass,
+		   PJ_DNS_TYPE_CNAME, &req->q->name);
+	if (ans.hdr.anscount) {
+	    add_rr_set(srv, ans.ans, &ans.hdr.anscount, req->q->dnsclass,
+		       req->q->type, &ans.ans[0].rdata.cname.name);
 	}
-    } else {
-	/* Otherwise just copy directly from the server record */
-	pj_memcpy(&ans.ans[ans.hdr.anscount], &rr->rec,
-			  sizeof(pj_dns_parsed_rr));
-	++ans.hdr.anscount;
     }
 
-    /* For each CNAME entry, add A entry */
+    if (ans.hdr.anscount == 0) {
+	ans.hdr.flags |= PJ_DNS_SET_RCODE(PJ_DNS_RCODE_NXDOMAIN);
+	goto print_pkt;
+    }
+
+    /* The answer to a CNAME query also has the A records of the canonical
+     * names, as the DNS server has always given. Other queries already
+     * have the records of the query type of the canonical name above.
+     */
     for (i=0; i<ans.hdr.anscount && ans.hdr.anscount < MAX_ANS; ++i) {
-	if (ans.ans[i].type == PJ_DNS_TYPE_CNAME) {
-	    struct rr *r;
-
-	    r = find_rr(srv, ans.ans[i].dnsclass, PJ_DNS_TYPE_A,
-		        &ans.ans[i].name);
-	    pj_memcpy(&ans.ans[ans.hdr.anscount], &r->rec,
-			      sizeof(pj_dns_parsed_rr));
-	    ++ans.hdr.anscount;
+	if (ans.ans[i].type == PJ_DNS_TYPE_CNAME &&
+	    req->q->type == PJ_DNS_TYPE_CNAME)
+	{
+	    add_rr_set(srv, ans.ans, &ans.hdr.anscount, ans.ans[i].dnsclass,
+		       PJ_DNS_TYPE_A, &ans.ans[i].rdata.cname.name);
+	}
+    }
+
+    /* Put the addresses of the SRV targets in the additional section, so
+     * that the client doesn't need to query them.
+     */
+    for (i=0; i<ans.hdr.anscount; ++i) {
+	if (ans.ans[i].type == PJ_DNS_TYPE_SRV) {
+	    add_rr_set(srv, ans.arr, &ans.hdr.arcount, ans.ans[i].dnsclass,
+		       PJ_DNS_TYPE_A, &ans.ans[i].rdata.srv.target);
+	    add_rr_set(srv, ans.arr, &ans.hdr.arcount, ans.ans[i].dnsclass,
+		       PJ_DNS_TYPE_AAAA, &ans.ans[i].rdata.srv.target);
 	}
     }
 
-send_pkt:
+print_pkt:
     pkt_len = print_packet(&ans, (pj_uint8_t*)data, MAX_PKT);
+    gen = srv->ans_gen;
+
+    pj_rwmutex_unlock_read(srv->lock);
+    pj_pool_release(pool);
+
+    if (pkt_len < 1 || keylen == 0)
+	return pkt_len;
+
+    /* Save the answer, unless the records have changed meanwhile */
+    pj_rwmutex_lock_write(srv->lock);
+
+    if (srv->ans_gen == gen && srv->ans_cnt < PJ_DNS_SERVER_MAX_ANSWERS &&
+	pj_hash_get(srv->ans_table, key, keylen, NULL) == NULL)
+    {
+	struct answer *a;
+
+	a = PJ_POOL_ZALLOC_T(srv->ans_pool, struct answer);
+	a->key = (pj_uint8_t*) pj_pool_alloc(srv->ans_pool, keylen);
+	pj_memcpy(a->key, key, keylen);
+	a->keylen = keylen;
+	a->pkt = (pj_uint8_t*) pj_pool_alloc(srv->ans_pool, pkt_len);
+	pj_memcpy(a->pkt, data, pkt_len);
+	a->len = (unsigned)pkt_len;
+
+	pj_hash_set_np(srv->ans_table, a->key, a->keylen, 0, a->hbuf, a);
+	++srv->ans_cnt;
+    }
+
+    pj_rwmutex_unlock_write(srv->lock);
+
+    return pkt_len;
+}
+
+
+static pj_bool_t on_data_recvfrom(pj_activesock_t *asock,
+				  void *data,
+				  pj_size_t size,
+				  const pj_sockaddr_t *src_addr,
+				  int addr_len,
+				  pj_status_t status)
+{
+    pj_dns_server *srv;
+    pj_uint8_t *pkt = (pj_uint8_t*)data;
+    pj_uint8_t key[MAX_QUESTION];
+    unsigned keylen;
+    pj_uint16_t req_flags;
+    struct answer *a;
+    pj_ssize_t pkt_len = -1;
+
+    if (status != PJ_SUCCESS || size < sizeof(pj_dns_hdr))
+	return PJ_TRUE;
+
+    /* Ignore responses */
+    req_flags = read16(pkt+2);
+    if (PJ_DNS_GET_QR(req_flags))
+	return PJ_TRUE;
+
+    srv = (pj_dns_server*) pj_activesock_get_user_data(asock);
+
+    /* Copy the prebuilt answer over the query, keeping the query ID */
+    keylen = get_question(pkt, size, key);
+    if (keylen) {
+	pj_rwmutex_lock_read(srv->lock);
+	a = (struct answer*)pj_hash_get(srv->ans_table, key, keylen, NULL);
+	if (a) {
+	    pj_memcpy(pkt+2, a->pkt+2, a->len-2);
+	    pkt_len = a->len;
+	}
+	pj_rwmutex_unlock_read(srv->lock);
+
+	if (pkt_len > 0) {
+	    write16(pkt+2, (pj_uint16_t)((read16(pkt+2) & ~PJ_DNS_SET_RD(1)) |
+					 (req_flags & PJ_DNS_SET_RD(1))));
+	}
+    }
+
+    if (pkt_len < 0)
+	pkt_len = build_answer(srv, data, size, src_addr, key, keylen);
+
     if (pkt_len < 1) {
 	PJ_LOG(4,(THIS_FILE, "Error: answer too large"));
-	goto on_return;
+	return PJ_TRUE;
     }
 
-    status = pj_activesock_sendto(srv->asock, &srv->send_key, data, &pkt_len,
-				  0, src_addr, addr_len);
-    if (status != PJ_SUCCESS && status != PJ_EPENDING) {
+    status = pj_sock_sendto(srv->sock, data, &pkt_len, 0, src_addr,
+			    addr_len);
+    if (status != PJ_SUCCESS) {
 	PJ_PERROR(4,(THIS_FILE, status, "Error sending answer"));
-	goto on_return;
     }
 
-on_return:
-    pj_pool_release(pool);
     return PJ_TRUE;
 }
-
@@ -82,6 +82,38 @@ PJ_DEF(void) pj_hmac_sha1_final(pj_hmac_sha1_context *hctx,
     pj_sha1_final(&hctx->context, digest);
 }
 
+PJ_DEF(void) pj_hmac_sha1_key_init(pj_hmac_sha1_key *hkey,
+				   const pj_uint8_t *key, unsigned key_len)
+{
+    pj_hmac_sha1_context hctx;
+
+    pj_hmac_sha1_init(&hctx, key, key_len);
+    pj_memcpy(&hkey->inner, &hctx.context, sizeof(hkey->inner));
+
+    pj_sha1_init(&hkey->outer);
+    pj_sha1_update(&hkey->outer, hctx.k_opad, 64);
+}
+
+PJ_DEF(void) pj_hmac_sha1_init_key(pj_hmac_sha1_context *hctx,
+				   const pj_hmac_sha1_key *hkey)
+{
+    pj_memcpy(&hctx->context, &hkey->inner, sizeof(hctx->context));
+}
+
+PJ_DEF(void) pj_hmac_sha1_final_key(pj_hmac_sha1_context *hctx,
+				    const pj_hmac_sha1_key *hkey,
+				    pj_uint8_t digest[20])
+{
+    pj_sha1_final(&hctx->context, digest);
+
+    /*
+     * perform outer SHA1 from the precomputed state
+     */
+    pj_memcpy(&hctx->context, &hkey->outer, sizeof(hctx->context));
+    pj_sha1_update(&hctx->context, digest, 20);
+    pj_sha1_final(&hctx->context, digest);
+}
+
 PJ_DEF(void) pj_hmac_sha1(const pj_uint8_t *input, unsigned input_len, 
 			  const pj_uint8_t *key, unsigned key_len, 
 			  pj_uint8_t digest[20] )
@@ -50,6 +50,61 @@ static void byteReverse(unsigned char *buf, unsigned longs)
 
 static void MD5Transform(pj_uint32_t buf[4], pj_uint32_t const in[16]);
 
+/* MD5 block function: hash the specified number of 64-byte blocks */
+typedef void (*md5_blocks_func)(pj_uint32_t buf[4],
+				const pj_uint8_t *data,
+				pj_size_t blocks);
+
+static void md5_blocks_c(pj_uint32_t buf[4], const pj_uint8_t *data,
+			 pj_size_t blocks)
+{
+    pj_uint32_t in[16];
+
+    for (; blocks; --blocks, data += 64) {
+	pj_memcpy(in, data, 64);
+	byteReverse((unsigned char*)in, 16);
+	MD5Transform(buf, in);
+    }
+}
+
+#if defined(PJ_CRYPTO_HAS_OPENSSL) && PJ_CRYPTO_HAS_OPENSSL != 0
+#define OPENSSL_SUPPRESS_DEPRECATED
+#include <openssl/md5.h>
+
+static void md5_blocks_openssl(pj_uint32_t buf[4], const pj_uint8_t *data,
+			       pj_size_t blocks)
+{
+    MD5_CTX c;
+
+    c.A = buf[0]; c.B = buf[1]; c.C = buf[2]; c.D = buf[3];
+
+    for (; blocks; --blocks, data += 64)
+	MD5_Transform(&c, data);
+
+    buf[0] = c.A; buf[1] = c.B; buf[2] = c.C; buf[3] = c.D;
+}
+
+#   define MD5_DEFAULT_IMPL	    &md5_blocks_openssl
+#   define MD5_DEFAULT_IMPL_NAME    "OpenSSL"
+#else
+#   define MD5_DEFAULT_IMPL	    &md5_blocks_c
+#   define MD5_DEFAULT_IMPL_NAME    "C"
+#endif
+
+static md5_blocks_func md5_blocks = MD5_DEFAULT_IMPL;
+
+
+PJ_DEF(const char*) pj_md5_set_accel(pj_bool_t enable)
+{
+    if (enable) {
+	md5_blocks = MD5_DEFAULT_IMPL;
+	return MD5_DEFAULT_IMPL_NAME;
+    } else {
+	md5_blocks = &md5_blocks_c;
+	return "C";
+    }
+}
+
 
 /*
  * Start MD5 accumulation.  Set bit count to 0 and buffer to mysterious
@@ -95,19 +150,16 @@ PJ_DEF(void) pj_md5_update( pj_md5_context *ctx,
 	    return;
 	}
 	pj_memcpy(p, buf, t);
-	byteReverse(ctx->in, 16);
-	MD5Transform(ctx->buf, (pj_uint32_t *) ctx->in);
+	(*md5_blocks)(ctx->buf, ctx->in, 1);
 	buf += t;
 	len -= t;
     }
     /* Process data in 64-byte chunks */
 
-    while (len >= 64) {
-	pj_memcpy(ctx->in, buf, 64);
-	byteReverse(ctx->in, 16);
-	MD5Transform(ctx->buf, (pj_uint32_t *) ctx->in);
-	buf += 64;
-	len -= 64;
+    if (len >= 64) {
+	(*md5_blocks)(ctx->buf, buf, len / 64);
+	buf += len & ~63;
+	len &= 63;
     }
 
     /* Handle any remaining bytes of data. */
@@ -139,8 +191,7 @@ PJ_DEF(void) pj_md5_final(pj_md5_context *ctx, unsigned char digest[16])
     if (count < 8) {
 	/* Two lots of padding:  Pad the first block to 64 bytes */
 	pj_bzero(p, count);
-	byteReverse(ctx->in, 16);
-	MD5Transform(ctx->buf, (pj_uint32_t *) ctx->in);
+	(*md5_blocks)(ctx->buf, ctx->in, 1);
 
 	/* Now fill the next block with 56 bytes */
 	pj_bzero(ctx->in, 56);
@@ -148,15 +199,14 @@ PJ_DEF(void) pj_md5_final(pj_md5_context *ctx, unsigned char digest[16])
 	/* Pad block to 56 bytes */
 	pj_bzero(p, count - 8);
     }
-    byteReverse(ctx->in, 14);
 
-    /* Append length in bits and transform */
-    //((pj_uint32_t *) ctx->in)[14] = ctx->bits[0];
-    //((pj_uint32_t *) ctx->in)[15] = ctx->bits[1];
-    pj_memcpy(&ctx->in[14 << 2], &ctx->bits[0], sizeof(ctx->bits[0]));
-    pj_memcpy(&ctx->in[15 << 2], &ctx->bits[1], sizeof(ctx->bits[1]));
+    /* Append length in bits (little endian) and transform */
+    for (count = 0; count < 8; ++count) {
+	ctx->in[56 + count] = (unsigned char)
+			      (ctx->bits[count >> 2] >> ((count & 3) * 8));
+    }
 
-    MD5Transform(ctx->buf, (pj_uint32_t *) ctx->in);
+    (*md5_blocks)(ctx->buf, ctx->in, 1);
     byteReverse((unsigned char *) ctx->buf, 4);
     pj_memcpy(digest, ctx->buf, 16);
     pj_bzero(ctx, sizeof(*ctx));	/* In case it's sensitive */
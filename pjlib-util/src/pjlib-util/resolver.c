@@ -19,12 +19,16 @@
  */
 #include <pjlib-util/resolver.h>
 #include <pjlib-util/errno.h>
+#include <pjlib-util/sha1.h>
 #include <pj/compat/socket.h>
+#include <pj/activesock.h>
 #include <pj/assert.h>
 #include <pj/ctype.h>
 #include <pj/except.h>
+#include <pj/guid.h>
 #include <pj/hash.h>
 #include <pj/ioqueue.h>
+#include <pj/lock.h>
 #include <pj/log.h>
 #include <pj/os.h>
 #include <pj/pool.h>
@@ -46,15 +50,35 @@
 #endif
 
 
-#define RES_HASH_TABLE_SIZE 127		/**< Hash table size (must be 2^n-1 */
+#define RES_HASH_TABLE_SIZE 31		/**< Hash table size per cache shard
+					     (must be 2^n-1)		    */
 #define PORT		    53		/**< Default NS port.		    */
 #define Q_HASH_TABLE_SIZE   127		/**< Query hash table size	    */
 #define TIMER_SIZE	    127		/**< Initial number of timers.	    */
-#define MAX_FD		    3		/**< Maximum internal sockets.	    */
+#define MAX_FD		    (PJ_DNS_RESOLVER_UDP_SOCK_CNT*2 + \
+			     PJ_DNS_RESOLVER_MAX_NS + 1)
+					/**< Maximum internal sockets.	    */
 
 #define RES_BUF_SZ	    PJ_DNS_RESOLVER_RES_BUF_SIZE
 #define UDPSZ		    PJ_DNS_RESOLVER_MAX_UDP_SIZE
 #define TMP_SZ		    PJ_DNS_RESOLVER_TMP_BUF_SIZE
+#define TCP_BUF_SZ	    PJ_DNS_RESOLVER_TCP_BUF_SIZE
+
+#if PJ_HAS_IPV6
+#   define MAX_UDP_SOCK	    (PJ_DNS_RESOLVER_UDP_SOCK_CNT * 2)
+#else
+#   define MAX_UDP_SOCK	    PJ_DNS_RESOLVER_UDP_SOCK_CNT
+#endif
+
+#define MAX_ID_TRIES	    16		/**< Attempts to find unused random
+					     transaction ID.		    */
+#define CACHED_ANS_CNT	    16		/**< Answers of a cache hit copied
+					     on the stack.		    */
+
+/* Key of pending query in the hquerybyid table. Queries sent from
+ * different UDP sockets may use the same transaction ID.
+ */
+#define QUERY_HKEY(udp_idx, id)	(((pj_uint32_t)(udp_idx) << 16) | (id))
 
 
 /* Nameserver state */
@@ -90,6 +114,13 @@ struct nameserver
     /* For calculating rt_delay: */
     pj_uint16_t	    q_id;		/**< Query ID.			    */
     pj_time_val	    sent_time;		/**< Time this query is sent.	    */
+
+    /* Statistics */
+    unsigned	    tx_cnt;		/**< Queries sent over UDP.	    */
+    unsigned	    tcp_tx_cnt;		/**< Queries sent over TCP.	    */
+    unsigned	    rx_cnt;		/**< Responses received.	    */
+    unsigned	    rtt;		/**< Last RTT sample, in msec.	    */
+    unsigned	    srtt;		/**< Smoothed RTT, in msec.	    */
 };
 
 
@@ -134,6 +165,11 @@ struct pj_dns_async_query
     pj_uint16_t		 id;		/**< Transaction ID.		    */
 
     unsigned		 transmit_cnt;	/**< Number of transmissions.	    */
+    pj_time_val		 sent_time;	/**< Time of last transmission.	    */
+    unsigned		 udp_idx;	/**< UDP socket index in the pool.  */
+    pj_uint32_t		 hkey;		/**< Key in hquerybyid.		    */
+    pj_bool_t		 use_tcp;	/**< Retrying over TCP?		    */
+    unsigned		 tcp_ns;	/**< Nameserver for TCP retry.	    */
 
     struct res_key	 key;		/**< Key to index this query.	    */
     pj_hash_entry_buf	 hbufid;	/**< Hash buffer 1		    */
@@ -151,17 +187,94 @@ struct pj_dns_async_query
  */
 struct cached_res
 {
-    PJ_DECL_LIST_MEMBER(struct cached_res);
+    PJ_DECL_LIST_MEMBER(struct cached_res); /**< LRU list member.	    */
 
     pj_pool_t		    *pool;	    /**< Cache's pool.		    */
     struct res_key	     key;	    /**< Resource key.		    */
+    pj_uint32_t		     hval;	    /**< Hash value of the key.	    */
     pj_hash_entry_buf	     hbuf;	    /**< Hash buffer		    */
     pj_time_val		     expiry_time;   /**< Expiration time.	    */
+    unsigned		     ttl;	    /**< TTL, zero if no expiry.    */
+    pj_bool_t		     negative;	    /**< Negative response?	    */
+    pj_bool_t		     prefetching;   /**< Prefetch has been started. */
+    unsigned		     hit_cnt;	    /**< Number of cache hits.	    */
     pj_dns_parsed_packet    *pkt;	    /**< The response packet.	    */
     unsigned		     ref_cnt;	    /**< Reference counter.	    */
 };
 
 
+/* Cached response list head */
+struct cache_list
+{
+    PJ_DECL_LIST_MEMBER(struct cached_res);
+};
+
+
+/* One shard of the response cache. The shard lock protects everything
+ * in the shard, including the reference counter of its entries. The
+ * resolver lock may be held when acquiring the shard lock, but never
+ * the other way around.
+ */
+struct cache_shard
+{
+    pj_lock_t		    *lock;	    /**< Shard lock.		    */
+    pj_hash_table_t	    *ht;	    /**< Cached responses by key.   */
+    struct cache_list	     lru;	    /**< Most recently used first.  */
+    unsigned		     count;	    /**< Number of entries.	    */
+    unsigned		     neg_count;	    /**< Number of negative entries */
+
+    /* Statistics */
+    unsigned		     hits;	    /**< Cache hits.		    */
+    unsigned		     misses;	    /**< Cache misses.		    */
+    unsigned		     evictions;	    /**< Evicted by size limit.	    */
+    unsigned		     prefetches;    /**< Prefetch queries started.  */
+};
+
+
+/* UDP socket to send queries from and receive responses with */
+struct udp_sock
+{
+    pj_dns_resolver	*resolver;	/**< The resolver instance.	    */
+    int			 af;		/**< Address family.		    */
+    unsigned		 idx;		/**< Index in the address family.   */
+    pj_sock_t		 sock;		/**< UDP socket.		    */
+    pj_ioqueue_key_t	*key;		/**< UDP socket ioqueue key.	    */
+    unsigned char	 rx_pkt[UDPSZ];	/**< UDP receive buffer.	    */
+    unsigned char	 tx_pkt[UDPSZ];	/**< UDP transmit buffer.	    */
+    pj_ioqueue_op_key_t	 op_rx_key;	/**< UDP read operation key.	    */
+    pj_ioqueue_op_key_t	 op_tx_key;	/**< UDP write operation key.	    */
+    pj_sockaddr		 src_addr;	/**< Source address of packet	    */
+    int			 addr_len;	/**< Source address length.	    */
+    char		 tmp_pool[TMP_SZ];/**< Temporary pool buffer.	    */
+};
+
+
+/* Persistent TCP connection to a nameserver, to retry queries whose UDP
+ * response is truncated. Queries are pipelined: queries queued while the
+ * connection is being established or while a send is in progress are
+ * sent together in the next send.
+ *
+ * The socket and buffers of each connection are allocated from its own
+ * pool, which is released by the connection's group lock once the ioqueue
+ * is done with the socket.
+ */
+struct tcp_conn
+{
+    pj_dns_resolver	*resolver;	/**< The resolver instance.	    */
+    unsigned		 ns_idx;	/**< Nameserver index.		    */
+    pj_pool_t		*pool;		/**< Connection's pool.		    */
+    pj_grp_lock_t	*grp_lock;	/**< Connection's group lock.	    */
+    pj_activesock_t	*asock;		/**< Active socket, NULL if closed. */
+    pj_bool_t		 connected;	/**< Connection established?	    */
+    pj_bool_t		 sending;	/**< Send in progress?		    */
+    pj_ioqueue_op_key_t	 send_key;	/**< Send operation key.	    */
+    unsigned char	*rx_buf;	/**< Receive buffer.		    */
+    unsigned char	*tx_buf;	/**< Buffer being sent.		    */
+    unsigned char	*tx_pending;	/**< Queries waiting to be sent.    */
+    unsigned		 tx_pending_len;/**< Length of queued queries.	    */
+};
+
+
 /* Resolver entry */
 struct pj_dns_resolver
 {
@@ -174,29 +287,13 @@ struct pj_dns_resolver
     pj_timer_heap_t	*timer;		/**< Timer instance.		    */
     pj_bool_t		 own_ioqueue;	/**< Do we own ioqueue?		    */
     pj_ioqueue_t	*ioqueue;	/**< Ioqueue instance.		    */
-    char		 tmp_pool[TMP_SZ];/**< Temporary pool buffer.	    */
-
-    /* Socket */
-    pj_sock_t		 udp_sock;	/**< UDP socket.		    */
-    pj_ioqueue_key_t	*udp_key;	/**< UDP socket ioqueue key.	    */
-    unsigned char	 udp_rx_pkt[UDPSZ];/**< UDP receive buffer.	    */
-    unsigned char	 udp_tx_pkt[UDPSZ];/**< UDP transmit buffer.	    */
-    pj_ioqueue_op_key_t	 udp_op_rx_key;	/**< UDP read operation key.	    */
-    pj_ioqueue_op_key_t	 udp_op_tx_key;	/**< UDP write operation key.	    */
-    pj_sockaddr		 udp_src_addr;	/**< Source address of packet	    */
-    int			 udp_addr_len;	/**< Source address length.	    */
 
-#if PJ_HAS_IPV6
-    /* IPv6 socket */
-    pj_sock_t		 udp6_sock;	/**< UDP socket.		    */
-    pj_ioqueue_key_t	*udp6_key;	/**< UDP socket ioqueue key.	    */
-    unsigned char	 udp6_rx_pkt[UDPSZ];/**< UDP receive buffer.	    */
-    //unsigned char	 udp6_tx_pkt[UDPSZ];/**< UDP transmit buffer.	    */
-    pj_ioqueue_op_key_t	 udp6_op_rx_key;/**< UDP read operation key.	    */
-    pj_ioqueue_op_key_t	 udp6_op_tx_key;/**< UDP write operation key.	    */
-    pj_sockaddr		 udp6_src_addr;	/**< Source address of packet	    */
-    int			 udp6_addr_len;	/**< Source address length.	    */
-#endif
+    /* Sockets */
+    struct udp_sock	 udp[MAX_UDP_SOCK];/**< UDP sockets, IPv4 first.    */
+    unsigned		 udp4_cnt;	/**< Number of IPv4 UDP sockets.    */
+    unsigned		 udp6_cnt;	/**< Number of IPv6 UDP sockets.    */
+    pj_bool_t		 udp_pool;	/**< Using UDP socket pool?	    */
+    struct tcp_conn	 tcp[PJ_DNS_RESOLVER_MAX_NS];/**< TCP connections.  */
 
     /* Settings */
     pj_dns_settings	 settings;	/**< Resolver settings.		    */
@@ -208,10 +305,18 @@ struct pj_dns_resolver
     /* Last DNS transaction ID used. */
     pj_uint16_t		 last_id;
 
-    /* Hash table for cached response */
-    pj_hash_table_t	*hrescache;	/**< Cached response in hash table  */
+    /* Generator of random transaction IDs, see get_rand() */
+    pj_uint8_t		 rand_key[PJ_SHA1_DIGEST_SIZE];
+    pj_uint8_t		 rand_buf[PJ_SHA1_DIGEST_SIZE];
+    pj_uint32_t		 rand_ctr;
+    unsigned		 rand_pos;
 
-    /* Pending asynchronous query, hashed by transaction ID. */
+    /* Cached responses */
+    struct cache_shard	 cache[PJ_DNS_RESOLVER_CACHE_SHARDS];
+
+    /* Pending asynchronous query, hashed by UDP socket index and
+     * transaction ID (see QUERY_HKEY()).
+     */
     pj_hash_table_t	*hquerybyid;
 
     /* Pending asynchronous query, hashed by "res_key" */
@@ -219,6 +324,10 @@ struct pj_dns_resolver
 
     /* Query entries free list */
     struct query_head	 query_free_nodes;
+
+    /* Statistics */
+    unsigned		 max_in_flight;	/**< Peak number of pending queries */
+    unsigned		 truncated_cnt;	/**< Truncated UDP responses.	    */
 };
 
 
@@ -227,6 +336,13 @@ static void on_read_complete(pj_ioqueue_key_t *key,
                              pj_ioqueue_op_key_t *op_key, 
                              pj_ssize_t bytes_read);
 
+/* Send query over TCP connection to nameserver */
+static pj_status_t tcp_send_query(pj_dns_resolver *resolver,
+				  pj_dns_async_query *q);
+
+/* Close TCP connection to nameserver */
+static void tcp_close(struct tcp_conn *conn);
+
 /* Callback to be called when query has timed out */
 static void on_timeout( pj_timer_heap_t *timer_heap,
 			struct pj_timer_entry *entry);
@@ -239,47 +355,102 @@ static pj_status_t select_nameservers(pj_dns_resolver *resolver,
 /* Destructor */
 static void dns_resolver_on_destroy(void *member);
 
-/* Close UDP socket */
-static void close_sock(pj_dns_resolver *resv)
+/* Seed the generator of random transaction IDs. The key is derived from
+ * a GUID, which comes from the system random source on most platforms,
+ * and the current timestamp.
+ */
+static void init_rand(pj_dns_resolver *resv)
+{
+    char guid_buf[PJ_GUID_MAX_LENGTH];
+    pj_str_t guid;
+    pj_timestamp ts;
+    pj_sha1_context ctx;
+
+    guid.ptr = guid_buf;
+    pj_generate_unique_string(&guid);
+    pj_get_timestamp(&ts);
+
+    pj_sha1_init(&ctx);
+    pj_sha1_update(&ctx, (const pj_uint8_t*)guid.ptr, guid.slen);
+    pj_sha1_update(&ctx, (const pj_uint8_t*)&ts, sizeof(ts));
+    pj_sha1_final(&ctx, resv->rand_key);
+
+    resv->rand_pos = sizeof(resv->rand_buf);
+}
+
+/* Get random number for the transaction ID, which makes it hard to
+ * spoof responses. Unlike pj_rand(), the output doesn't reveal the state:
+ * the numbers are taken from the SHA-1 digest of the secret key and a
+ * counter.
+ */
+static pj_uint32_t get_rand(pj_dns_resolver *resv)
 {
-    /* Close existing socket */
-    if (resv->udp_key != NULL) {
-	pj_ioqueue_unregister(resv->udp_key);
-	resv->udp_key = NULL;
-	resv->udp_sock = PJ_INVALID_SOCKET;
-    } else if (resv->udp_sock != PJ_INVALID_SOCKET) {
-	pj_sock_close(resv->udp_sock);
-	resv->udp_sock = PJ_INVALID_SOCKET;
+    pj_uint32_t r;
+
+    if (resv->rand_pos + sizeof(r) > sizeof(resv->rand_buf)) {
+	pj_sha1_context ctx;
+
+	++resv->rand_ctr;
+	pj_sha1_init(&ctx);
+	pj_sha1_update(&ctx, resv->rand_key, sizeof(resv->rand_key));
+	pj_sha1_update(&ctx, (const pj_uint8_t*)&resv->rand_ctr,
+		       sizeof(resv->rand_ctr));
+	pj_sha1_final(&ctx, resv->rand_buf);
+	resv->rand_pos = 0;
     }
 
-#if PJ_HAS_IPV6
-    if (resv->udp6_key != NULL) {
-	pj_ioqueue_unregister(resv->udp6_key);
-	resv->udp6_key = NULL;
-	resv->udp6_sock = PJ_INVALID_SOCKET;
-    } else if (resv->udp6_sock != PJ_INVALID_SOCKET) {
-	pj_sock_close(resv->udp6_sock);
-	resv->udp6_sock = PJ_INVALID_SOCKET;
+    pj_memcpy(&r, resv->rand_buf + resv->rand_pos, sizeof(r));
+    resv->rand_pos += sizeof(r);
+    return r;
+}
+
+/* Close UDP sockets */
+static void close_sock(pj_dns_resolver *resv)
+{
+    unsigned i;
+
+    /* Close existing sockets */
+    for (i=0; i<MAX_UDP_SOCK; ++i) {
+	struct udp_sock *us = &resv->udp[i];
+
+	if (us->key != NULL) {
+	    pj_ioqueue_unregister(us->key);
+	    us->key = NULL;
+	    us->sock = PJ_INVALID_SOCKET;
+	} else if (us->sock != PJ_INVALID_SOCKET) {
+	    pj_sock_close(us->sock);
+	    us->sock = PJ_INVALID_SOCKET;
+	}
     }
-#endif
+
+    resv->udp4_cnt = resv->udp6_cnt = 0;
 }
 
 
-/* Initialize UDP socket */
-static pj_status_t init_sock(pj_dns_resolver *resv)
+/* Initialize one UDP socket */
+static pj_status_t init_udp_sock(pj_dns_resolver *resv,
+				 struct udp_sock *us,
+				 int af,
+				 unsigned idx)
 {
     pj_ioqueue_callback socket_cb;
     pj_sockaddr bound_addr;
     pj_ssize_t rx_pkt_size;
     pj_status_t status;
 
+    us->resolver = resv;
+    us->af = af;
+    us->idx = idx;
+
     /* Create the UDP socket */
-    status = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &resv->udp_sock);
+    status = pj_sock_socket(af, pj_SOCK_DGRAM(), 0, &us->sock);
     if (status != PJ_SUCCESS)
 	return status;
 
     /* Bind to any address/port */
-    status = pj_sock_bind_in(resv->udp_sock, 0, 0);
+    pj_sockaddr_init(af, &bound_addr, NULL, 0);
+    status = pj_sock_bind(us->sock, &bound_addr,
+			  pj_sockaddr_get_len(&bound_addr));
     if (status != PJ_SUCCESS)
 	return status;
 
@@ -287,74 +458,62 @@ static pj_status_t init_sock(pj_dns_resolver *resv)
     pj_bzero(&socket_cb, sizeof(socket_cb));
     socket_cb.on_read_complete = &on_read_complete;
     status = pj_ioqueue_register_sock2(resv->pool, resv->ioqueue,
-				       resv->udp_sock, resv->grp_lock,
-				       resv, &socket_cb, &resv->udp_key);
+				       us->sock, resv->grp_lock,
+				       us, &socket_cb, &us->key);
     if (status != PJ_SUCCESS)
 	return status;
 
-    pj_ioqueue_op_key_init(&resv->udp_op_rx_key, sizeof(resv->udp_op_rx_key));
-    pj_ioqueue_op_key_init(&resv->udp_op_tx_key, sizeof(resv->udp_op_tx_key));
+    pj_ioqueue_op_key_init(&us->op_rx_key, sizeof(us->op_rx_key));
+    pj_ioqueue_op_key_init(&us->op_tx_key, sizeof(us->op_tx_key));
 
     /* Start asynchronous read to the UDP socket */
-    rx_pkt_size = sizeof(resv->udp_rx_pkt);
-    resv->udp_addr_len = sizeof(resv->udp_src_addr);
-    status = pj_ioqueue_recvfrom(resv->udp_key, &resv->udp_op_rx_key,
-				 resv->udp_rx_pkt, &rx_pkt_size,
+    rx_pkt_size = sizeof(us->rx_pkt);
+    us->addr_len = sizeof(us->src_addr);
+    status = pj_ioqueue_recvfrom(us->key, &us->op_rx_key,
+				 us->rx_pkt, &rx_pkt_size,
 				 PJ_IOQUEUE_ALWAYS_ASYNC,
-				 &resv->udp_src_addr, &resv->udp_addr_len);
+				 &us->src_addr, &us->addr_len);
     if (status != PJ_EPENDING)
 	return status;
 
+    return PJ_SUCCESS;
+}
 
-#if PJ_HAS_IPV6
-    /* Also setup IPv6 socket */
-
-    /* Create the UDP socket */
-    status = pj_sock_socket(pj_AF_INET6(), pj_SOCK_DGRAM(), 0,
-			    &resv->udp6_sock);
-    if (status != PJ_SUCCESS) {
-	/* Skip IPv6 socket on system without IPv6 (see ticket #1953) */
-	if (status == PJ_STATUS_FROM_OS(OSERR_EAFNOSUPPORT)) {
-	    PJ_LOG(3,(resv->name.ptr,
-		      "System does not support IPv6, resolver will "
-		      "ignore any IPv6 nameservers"));
-	    return PJ_SUCCESS;
-	}
-	return status;
-    }
 
-    /* Bind to any address/port */
-    pj_sockaddr_init(pj_AF_INET6(), &bound_addr, NULL, 0);
-    status = pj_sock_bind(resv->udp6_sock, &bound_addr,
-			  pj_sockaddr_get_len(&bound_addr));
-    if (status != PJ_SUCCESS)
-	return status;
+/* Initialize UDP sockets. With PJ_DNS_RESOLVER_UDP_POOL option, there are
+ * PJ_DNS_RESOLVER_UDP_SOCK_CNT sockets per address family.
+ */
+static pj_status_t init_sock(pj_dns_resolver *resv)
+{
+    unsigned i, cnt;
+    pj_status_t status;
 
-    /* Register to ioqueue */
-    pj_bzero(&socket_cb, sizeof(socket_cb));
-    socket_cb.on_read_complete = &on_read_complete;
-    status = pj_ioqueue_register_sock2(resv->pool, resv->ioqueue,
-				       resv->udp6_sock, resv->grp_lock,
-				       resv, &socket_cb, &resv->udp6_key);
-    if (status != PJ_SUCCESS)
-	return status;
+    cnt = resv->udp_pool ? PJ_DNS_RESOLVER_UDP_SOCK_CNT : 1;
 
-    pj_ioqueue_op_key_init(&resv->udp6_op_rx_key,
-			   sizeof(resv->udp6_op_rx_key));
-    pj_ioqueue_op_key_init(&resv->udp6_op_tx_key,
-			   sizeof(resv->udp6_op_tx_key));
+    for (i=0; i<cnt; ++i) {
+	status = init_udp_sock(resv, &resv->udp[i], pj_AF_INET(), i);
+	if (status != PJ_SUCCESS)
+	    return status;
+	++resv->udp4_cnt;
+    }
 
-    /* Start asynchronous read to the UDP socket */
-    rx_pkt_size = sizeof(resv->udp6_rx_pkt);
-    resv->udp6_addr_len = sizeof(resv->udp6_src_addr);
-    status = pj_ioqueue_recvfrom(resv->udp6_key, &resv->udp6_op_rx_key,
-				 resv->udp6_rx_pkt, &rx_pkt_size,
-				 PJ_IOQUEUE_ALWAYS_ASYNC,
-				 &resv->udp6_src_addr, &resv->udp6_addr_len);
-    if (status != PJ_EPENDING)
-	return status;
-#else
-    PJ_UNUSED_ARG(bound_addr);
+#if PJ_HAS_IPV6
+    /* Also setup IPv6 sockets */
+    for (i=0; i<cnt; ++i) {
+	status = init_udp_sock(resv, &resv->udp[resv->udp4_cnt + i],
+			       pj_AF_INET6(), i);
+	if (status != PJ_SUCCESS) {
+	    /* Skip IPv6 socket on system without IPv6 (see ticket #1953) */
+	    if (status == PJ_STATUS_FROM_OS(OSERR_EAFNOSUPPORT)) {
+		PJ_LOG(3,(resv->name.ptr,
+			  "System does not support IPv6, resolver will "
+			  "ignore any IPv6 nameservers"));
+		return PJ_SUCCESS;
+	    }
+	    return status;
+	}
+	++resv->udp6_cnt;
+    }
 #endif
 
     return PJ_SUCCESS;
@@ -385,6 +544,7 @@ PJ_DEF(pj_status_t) pj_dns_resolver_create( pj_pool_factory *pf,
 {
     pj_pool_t *pool;
     pj_dns_resolver *resv;
+    unsigned i;
     pj_status_t status;
 
     /* Sanity check */
@@ -401,7 +561,11 @@ PJ_DEF(pj_status_t) pj_dns_resolver_create( pj_pool_factory *pf,
     /* Create pool and name */
     resv = PJ_POOL_ZALLOC_T(pool, struct pj_dns_resolver);
     resv->pool = pool;
-    resv->udp_sock = PJ_INVALID_SOCKET;
+    for (i=0; i<MAX_UDP_SOCK; ++i)
+	resv->udp[i].sock = PJ_INVALID_SOCKET;
+    for (i=0; i<PJ_DNS_RESOLVER_MAX_NS; ++i)
+	resv->tcp[i].resolver = resv;
+    resv->udp_pool = (options & PJ_DNS_RESOLVER_UDP_POOL) != 0;
     pj_strdup2_with_null(pool, &resv->name, name);
     
     /* Create group lock */
@@ -417,6 +581,7 @@ PJ_DEF(pj_status_t) pj_dns_resolver_create( pj_pool_factory *pf,
     resv->timer = timer;
     resv->ioqueue = ioqueue;
     resv->last_id = 1;
+    init_rand(resv);
 
     pj_dns_settings_default(&resv->settings);
     resv->settings.options = options;
@@ -437,8 +602,17 @@ PJ_DEF(pj_status_t) pj_dns_resolver_create( pj_pool_factory *pf,
 	    goto on_error;
     }
 
-    /* Response cache hash table */
-    resv->hrescache = pj_hash_create(pool, RES_HASH_TABLE_SIZE);
+    /* Response cache shards */
+    for (i=0; i<PJ_DNS_RESOLVER_CACHE_SHARDS; ++i) {
+	struct cache_shard *shard = &resv->cache[i];
+
+	status = pj_lock_create_simple_mutex(pool, "dnscache", &shard->lock);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+	shard->ht = pj_hash_create(pool, RES_HASH_TABLE_SIZE);
+	pj_list_init(&shard->lru);
+    }
 
     /* Query hash table and free list. */
     resv->hquerybyid = pj_hash_create(pool, Q_HASH_TABLE_SIZE);
@@ -463,6 +637,14 @@ on_error:
 void dns_resolver_on_destroy(void *member)
 {
     pj_dns_resolver *resolver = (pj_dns_resolver*)member;
+    unsigned i;
+
+    for (i=0; i<PJ_DNS_RESOLVER_CACHE_SHARDS; ++i) {
+	if (resolver->cache[i].lock) {
+	    pj_lock_destroy(resolver->cache[i].lock);
+	    resolver->cache[i].lock = NULL;
+	}
+    }
     pj_pool_safe_release(&resolver->pool);
 }
 
@@ -474,6 +656,8 @@ PJ_DEF(pj_status_t) pj_dns_resolver_destroy( pj_dns_resolver *resolver,
 					     pj_bool_t notify)
 {
     pj_hash_iterator_t it_buf, *it;
+    unsigned i;
+
     PJ_ASSERT_RETURN(resolver, PJ_EINVAL);
 
     if (notify) {
@@ -499,16 +683,20 @@ PJ_DEF(pj_status_t) pj_dns_resolver_destroy( pj_dns_resolver *resolver,
     }
 
     /* Destroy cached entries */
-    it = pj_hash_first(resolver->hrescache, &it_buf);
-    while (it) {
-	struct cached_res *cache;
+    for (i=0; i<PJ_DNS_RESOLVER_CACHE_SHARDS; ++i) {
+	struct cache_shard *shard = &resolver->cache[i];
 
-	cache = (struct cached_res*) pj_hash_this(resolver->hrescache, it);
-	pj_hash_set(NULL, resolver->hrescache, &cache->key, 
-		    sizeof(cache->key), 0, NULL);
-	pj_pool_release(cache->pool);
+	if (shard->ht == NULL)
+	    continue;
+
+	while (!pj_list_empty(&shard->lru)) {
+	    struct cached_res *cache = shard->lru.next;
 
-	it = pj_hash_first(resolver->hrescache, &it_buf);
+	    pj_list_erase(cache);
+	    pj_hash_set(NULL, shard->ht, &cache->key, sizeof(cache->key),
+			cache->hval, NULL);
+	    pj_pool_release(cache->pool);
+	}
     }
 
     if (resolver->own_timer && resolver->timer) {
@@ -516,6 +704,9 @@ PJ_DEF(pj_status_t) pj_dns_resolver_destroy( pj_dns_resolver *resolver,
 	resolver->timer = NULL;
     }
 
+    for (i=0; i<PJ_DNS_RESOLVER_MAX_NS; ++i)
+	tcp_close(&resolver->tcp[i]);
+
     close_sock(resolver);
 
     if (resolver->own_ioqueue && resolver->ioqueue) {
@@ -550,6 +741,10 @@ PJ_DEF(pj_status_t) pj_dns_resolver_set_ns( pj_dns_resolver *resolver,
     if (count > PJ_DNS_RESOLVER_MAX_NS)
 	count = PJ_DNS_RESOLVER_MAX_NS;
 
+    /* Close TCP connections to the old nameservers */
+    for (i=0; i<PJ_DNS_RESOLVER_MAX_NS; ++i)
+	tcp_close(&resolver->tcp[i]);
+
     resolver->ns_count = 0;
     pj_bzero(resolver->ns, sizeof(resolver->ns));
 
@@ -668,6 +863,8 @@ static pj_status_t transmit_query(pj_dns_resolver *resolver,
     unsigned pkt_size;
     unsigned i, server_cnt, send_cnt;
     unsigned servers[PJ_DNS_RESOLVER_MAX_NS];
+    struct udp_sock *us4, *us6;
+    pj_bool_t has_sock;
     pj_time_val now;
     pj_str_t name;
     pj_time_val delay;
@@ -701,15 +898,32 @@ static pj_status_t transmit_query(pj_dns_resolver *resolver,
 	return status;
     }
 
-    /* Check if the socket is available for sending */
-    if (pj_ioqueue_is_pending(resolver->udp_key, &resolver->udp_op_tx_key)
-#if PJ_HAS_IPV6
-	|| (resolver->udp6_key &&
-	    pj_ioqueue_is_pending(resolver->udp6_key,
-				  &resolver->udp6_op_tx_key))
-#endif
-	)
-    {
+    /* Retransmit over TCP if the UDP response has been truncated */
+    if (q->use_tcp && q->tcp_ns < resolver->ns_count) {
+	status = tcp_send_query(resolver, q);
+	if (status != PJ_SUCCESS) {
+	    pj_timer_heap_cancel(resolver->timer, &q->timer_entry);
+	    return status;
+	}
+	++q->transmit_cnt;
+	return PJ_SUCCESS;
+    }
+    q->use_tcp = PJ_FALSE;
+
+    /* Sockets selected for this query. A socket that is still sending
+     * its previous packet can't be used, since its transmit buffer is in
+     * use.
+     */
+    us4 = (q->udp_idx < resolver->udp4_cnt) ?
+	  &resolver->udp[q->udp_idx] : NULL;
+    us6 = (q->udp_idx < resolver->udp6_cnt) ?
+	  &resolver->udp[resolver->udp4_cnt + q->udp_idx] : NULL;
+    has_sock = (us4 || us6);
+    if (us4 && pj_ioqueue_is_pending(us4->key, &us4->op_tx_key))
+	us4 = NULL;
+    if (us6 && pj_ioqueue_is_pending(us6->key, &us6->op_tx_key))
+	us6 = NULL;
+    if (has_sock && !us4 && !us6) {
 	++q->transmit_cnt;
 	PJ_LOG(4,(resolver->name.ptr,
 		  "Socket busy in transmitting DNS %s query for %s%s",
@@ -720,14 +934,22 @@ static pj_status_t transmit_query(pj_dns_resolver *resolver,
 	return PJ_SUCCESS;
     }
 
-    /* Create DNS query packet */
-    pkt_size = sizeof(resolver->udp_tx_pkt);
+    /* Create DNS query packet in the transmit buffer of the sockets */
     name = pj_str(q->key.name);
-    status = pj_dns_make_query(resolver->udp_tx_pkt, &pkt_size,
-			       q->id, q->key.qtype, &name);
-    if (status != PJ_SUCCESS) {
-	pj_timer_heap_cancel(resolver->timer, &q->timer_entry);
-	return status;
+    pkt_size = 0;
+    for (i=0; i<2; ++i) {
+	struct udp_sock *us = (i==0 ? us4 : us6);
+
+	if (!us)
+	    continue;
+
+	pkt_size = sizeof(us->tx_pkt);
+	status = pj_dns_make_query(us->tx_pkt, &pkt_size,
+				   q->id, q->key.qtype, &name);
+	if (status != PJ_SUCCESS) {
+	    pj_timer_heap_cancel(resolver->timer, &q->timer_entry);
+	    return status;
+	}
     }
 
     /* Get current time. */
@@ -739,29 +961,20 @@ static pj_status_t transmit_query(pj_dns_resolver *resolver,
         char addr[PJ_INET6_ADDRSTRLEN];
 	pj_ssize_t sent  = (pj_ssize_t) pkt_size;
 	struct nameserver *ns = &resolver->ns[servers[i]];
+	struct udp_sock *us;
 
-	if (ns->addr.addr.sa_family == pj_AF_INET()) {
-	    status = pj_ioqueue_sendto(resolver->udp_key,
-				       &resolver->udp_op_tx_key,
-				       resolver->udp_tx_pkt, &sent, 0,
-				       &ns->addr,
-				       pj_sockaddr_get_len(&ns->addr));
-	    if (status == PJ_SUCCESS || status == PJ_EPENDING)
-		send_cnt++;
-	}
-#if PJ_HAS_IPV6
-	else if (resolver->udp6_key) {
-	    status = pj_ioqueue_sendto(resolver->udp6_key,
-				       &resolver->udp6_op_tx_key,
-				       resolver->udp_tx_pkt, &sent, 0,
-				       &ns->addr,
-				       pj_sockaddr_get_len(&ns->addr));
-	    if (status == PJ_SUCCESS || status == PJ_EPENDING)
-		send_cnt++;
-	}
-#endif
-	else {
+	/* Send from the socket selected for this query */
+	us = (ns->addr.addr.sa_family == pj_AF_INET() ? us4 : us6);
+	if (!us)
 	    continue;
+
+	status = pj_ioqueue_sendto(us->key, &us->op_tx_key,
+				   us->tx_pkt, &sent, 0,
+				   &ns->addr,
+				   pj_sockaddr_get_len(&ns->addr));
+	if (status == PJ_SUCCESS || status == PJ_EPENDING) {
+	    send_cnt++;
+	    ns->tx_cnt++;
 	}
 
 	PJ_PERROR(4,(resolver->name.ptr, status,
@@ -785,6 +998,7 @@ static pj_status_t transmit_query(pj_dns_resolver *resolver,
     }
 
     ++q->transmit_cnt;
+    q->sent_time = now;
 
     return PJ_SUCCESS;
 }
@@ -853,185 +1067,417 @@ static void free_entry(pj_dns_resolver *resolver, struct cached_res *cache)
     pj_pool_release(cache->pool);
 }
 
+/* Get the cache shard of the key with the specified hash value */
+static struct cache_shard *get_shard(pj_dns_resolver *resolver,
+				     pj_uint32_t hval)
+{
+    /* The low bits select the hash table bucket within the shard */
+    return &resolver->cache[(hval >> 16) % PJ_DNS_RESOLVER_CACHE_SHARDS];
+}
 
-/*
- * Create and start asynchronous DNS query for a single resource.
+/* Remove the entry from the shard, without releasing the reference of
+ * the cache. Shard lock must be held.
  */
-PJ_DEF(pj_status_t) pj_dns_resolver_start_query( pj_dns_resolver *resolver,
-						 const pj_str_t *name,
-						 int type,
-						 unsigned options,
-						 pj_dns_callback *cb,
-						 void *user_data,
-						 pj_dns_async_query **p_query)
+static void unlink_entry(struct cache_shard *shard, struct cached_res *cache)
 {
-    pj_time_val now;
-    struct res_key key;
-    struct cached_res *cache;
-    pj_dns_async_query *q, *p_q = NULL;
-    pj_uint32_t hval;
-    pj_status_t status = PJ_SUCCESS;
+    /* Remove the entry before releasing its pool (see ticket #1710) */
+    pj_hash_set(NULL, shard->ht, &cache->key, sizeof(cache->key),
+		cache->hval, NULL);
+    pj_list_erase(cache);
+
+    --shard->count;
+    if (cache->negative)
+	--shard->neg_count;
+}
 
-    /* Validate arguments */
-    PJ_ASSERT_RETURN(resolver && name && type, PJ_EINVAL);
+/* Remove the entry from the shard and release the reference of the
+ * cache. The entry is freed when it's not being used by callback.
+ */
+static void remove_entry(pj_dns_resolver *resolver,
+			 struct cache_shard *shard,
+			 struct cached_res *cache)
+{
+    unlink_entry(shard, cache);
+    if (--cache->ref_cnt <= 0)
+	free_entry(resolver, cache);
+}
 
-    /* Check name is not too long. */
-    PJ_ASSERT_RETURN(name->slen>0 && name->slen < PJ_MAX_HOSTNAME,
-		     PJ_ENAMETOOLONG);
+/* Evict the least recently used entries while the shard is over the
+ * total or negative entry limit. Shard lock must be held.
+ */
+static void enforce_cache_limits(pj_dns_resolver *resolver,
+				 struct cache_shard *shard)
+{
+    const unsigned max_cnt = (PJ_DNS_RESOLVER_CACHE_MAX_ENTRIES >
+			      PJ_DNS_RESOLVER_CACHE_SHARDS) ?
+			     PJ_DNS_RESOLVER_CACHE_MAX_ENTRIES /
+			     PJ_DNS_RESOLVER_CACHE_SHARDS : 1;
+    const unsigned max_neg = (PJ_DNS_RESOLVER_CACHE_MAX_NEG_ENTRIES >
+			      PJ_DNS_RESOLVER_CACHE_SHARDS) ?
+			     PJ_DNS_RESOLVER_CACHE_MAX_NEG_ENTRIES /
+			     PJ_DNS_RESOLVER_CACHE_SHARDS : 1;
+    struct cached_res *cache = shard->lru.prev;
+
+    while (cache != (struct cached_res*)&shard->lru &&
+	   (shard->count > max_cnt || shard->neg_count > max_neg))
+    {
+	struct cached_res *prev = cache->prev;
 
-    /* Check type */
-    PJ_ASSERT_RETURN(type > 0 && type < 0xFFFF, PJ_EINVAL);
+	/* Entries without TTL are added by application, keep them. If only
+	 * the negative limit is exceeded, evict only negative entries.
+	 */
+	if (cache->ttl != 0 && (shard->count > max_cnt || cache->negative)) {
+	    remove_entry(resolver, shard, cache);
+	    ++shard->evictions;
+	}
+	cache = prev;
+    }
+}
 
-    /* Build resource key for looking up hash tables */
-    init_res_key(&key, type, name);
 
-    /* Start working with the resolver */
-    pj_grp_lock_acquire(resolver->grp_lock);
+/* Create and send a new query for the key. Resolver lock must be held. */
+static pj_status_t send_new_query(pj_dns_resolver *resolver,
+				  const struct res_key *key,
+				  unsigned options,
+				  pj_dns_callback *cb,
+				  void *user_data,
+				  pj_dns_async_query **p_q)
+{
+    pj_dns_async_query *q;
+    unsigned i, max_tries, cnt;
+    pj_status_t status;
 
-    /* Get current time. */
-    pj_gettimeofday(&now);
+    q = alloc_qnode(resolver, options, user_data, cb);
 
-    /* First, check if we have cached response for the specified name/type,
-     * and the cached entry has not expired.
+    /* Save the ID and key. With the UDP socket pool, pick random unused
+     * ID and socket, to make it harder to spoof the response, and give up
+     * after a few attempts since most of the ID space is in use then.
      */
-    hval = 0;
-    cache = (struct cached_res *) pj_hash_get(resolver->hrescache, &key, 
-    					      sizeof(key), &hval);
-    if (cache) {
-	/* We've found a cached entry. */
-
-	/* Check for expiration */
-	if (PJ_TIME_VAL_GT(cache->expiry_time, now)) {
-
-	    /* Log */
-	    PJ_LOG(5,(resolver->name.ptr, 
-		      "Picked up DNS %s record for %.*s from cache, ttl=%d",
-		      pj_dns_get_type_name(type),
-		      (int)name->slen, name->ptr,
-		      (int)(cache->expiry_time.sec - now.sec)));
-
-	    /* Map DNS Rcode in the response into PJLIB status name space */
-	    status = PJ_DNS_GET_RCODE(cache->pkt->hdr.flags);
-	    status = PJ_STATUS_FROM_DNS_RCODE(status);
-
-	    /* Workaround for deadlock problem. Need to increment the cache's
-	     * ref counter first before releasing mutex, so the cache won't be
-	     * destroyed by other thread while in callback.
-	     */
-	    cache->ref_cnt++;
-	    pj_grp_lock_release(resolver->grp_lock);
-
-	    /* This cached response is still valid. Just return this
-	     * response to caller.
-	     */
-	    if (cb) {
-		(*cb)(user_data, status, cache->pkt);
-	    }
-
-	    /* Done. No host resolution is necessary */
-	    pj_grp_lock_acquire(resolver->grp_lock);
-
-	    /* Decrement the ref counter. Also check if it is time to free
-	     * the cache (as it has been expired).
-	     */
-	    cache->ref_cnt--;
-	    if (cache->ref_cnt <= 0)
-		free_entry(resolver, cache);
+    max_tries = resolver->udp_pool ? MAX_ID_TRIES : 0xFFFF;
+    for (i=0; i<max_tries; ++i) {
+	if (resolver->udp_pool) {
+	    pj_uint32_t r = get_rand(resolver);
 
-	    /* Must return PJ_SUCCESS */
-	    status = PJ_SUCCESS;
-
-	    /*
-	     * We cannot write to *p_query after calling cb because what
-	     * p_query points to may have been freed by cb.
-             * Refer to ticket #1974.
-	     */
-	    pj_grp_lock_release(resolver->grp_lock);
-	    return status;
+	    q->id = (pj_uint16_t)r;
+	    q->udp_idx = (r >> 16) % PJ_DNS_RESOLVER_UDP_SOCK_CNT;
+	} else {
+	    q->id = resolver->last_id++;
+	    if (resolver->last_id == 0)
+		resolver->last_id = 1;
 	}
+	q->hkey = QUERY_HKEY(q->udp_idx, q->id);
 
-	/* At this point, we have a cached entry, but this entry has expired.
-	 * Remove this entry from the cached list.
-	 */
-	pj_hash_set(NULL, resolver->hrescache, &key, sizeof(key), 0, NULL);
-
-	/* Also free the cache, if it is not being used (by callback). */
-	cache->ref_cnt--;
-	if (cache->ref_cnt <= 0)
-	    free_entry(resolver, cache);
-
-	/* Must continue with creating a query now */
+	if (q->id != 0 &&
+	    pj_hash_get(resolver->hquerybyid, &q->hkey, sizeof(q->hkey),
+			NULL) == NULL)
+	{
+	    break;
+	}
     }
-
-    /* Next, check if we have pending query on the same resource */
-    q = (pj_dns_async_query *) pj_hash_get(resolver->hquerybyres, &key, 
-    					   sizeof(key), NULL);
-    if (q) {
-	/* Yes, there's another pending query to the same key.
-	 * Just create a new child query and add this query to
-	 * pending query's child queries.
-	 */
-	pj_dns_async_query *nq;
-
-	nq = alloc_qnode(resolver, options, user_data, cb);
-	pj_list_push_back(&q->child_head, nq);
-
-	/* Done. This child query will be notified once the "parent"
-	 * query completes.
-	 */
-	p_q = nq;
-	status = PJ_SUCCESS;
-	goto on_return;
-    } 
-
-    /* There's no pending query to the same key, initiate a new one. */
-    q = alloc_qnode(resolver, options, user_data, cb);
-
-    /* Save the ID and key */
-    /* TODO: dnsext-forgery-resilient: randomize id for security */
-    q->id = resolver->last_id++;
-    if (resolver->last_id == 0)
-	resolver->last_id = 1;
-    pj_memcpy(&q->key, &key, sizeof(struct res_key));
+    if (i == max_tries) {
+	PJ_LOG(4,(resolver->name.ptr, "No free transaction ID for DNS "
+		  "query, %u queries pending",
+		  pj_hash_count(resolver->hquerybyid)));
+	pj_list_push_back(&resolver->query_free_nodes, q);
+	return PJ_ETOOMANY;
+    }
+    pj_memcpy(&q->key, key, sizeof(struct res_key));
 
     /* Send the query */
     status = transmit_query(resolver, q);
     if (status != PJ_SUCCESS) {
 	pj_list_push_back(&resolver->query_free_nodes, q);
-	goto on_return;
+	return status;
     }
 
     /* Add query entry to the hash tables */
-    pj_hash_set_np(resolver->hquerybyid, &q->id, sizeof(q->id), 
+    pj_hash_set_np(resolver->hquerybyid, &q->hkey, sizeof(q->hkey),
 		   0, q->hbufid, q);
     pj_hash_set_np(resolver->hquerybyres, &q->key, sizeof(q->key),
 		   0, q->hbufkey, q);
 
-    p_q = q;
-
-on_return:
-    if (p_query)
-	*p_query = p_q;
+    cnt = pj_hash_count(resolver->hquerybyid);
+    if (cnt > resolver->max_in_flight)
+	resolver->max_in_flight = cnt;
 
-    pj_grp_lock_release(resolver->grp_lock);
-    return status;
+    if (p_q)
+	*p_q = q;
+    return PJ_SUCCESS;
 }
 
 
-/*
- * Cancel a pending query.
+/* Refresh the cached response of the key in the background, unless there
+ * is already a pending query for it. The response will update the cache.
  */
-PJ_DEF(pj_status_t) pj_dns_resolver_cancel_query(pj_dns_async_query *query,
-						 pj_bool_t notify)
+static void prefetch_entry(pj_dns_resolver *resolver,
+			   const struct res_key *key)
 {
-    pj_dns_callback *cb;
+    pj_status_t status;
 
-    PJ_ASSERT_RETURN(query, PJ_EINVAL);
+    pj_grp_lock_acquire(resolver->grp_lock);
 
-    pj_grp_lock_acquire(query->resolver->grp_lock);
+    if (pj_hash_get(resolver->hquerybyres, key, sizeof(*key), NULL)==NULL) {
+	PJ_LOG(5,(resolver->name.ptr, "Prefetching DNS %s record for %s",
+		  pj_dns_get_type_name(key->qtype), key->name));
 
-    if (query->timer_entry.id == 1) {
-	pj_timer_heap_cancel_if_active(query->resolver->timer,
+	status = send_new_query(resolver, key, 0, NULL, NULL, NULL);
+	if (status != PJ_SUCCESS) {
+	    PJ_PERROR(4,(resolver->name.ptr, status,
+			 "Error sending prefetch query"));
+	}
+    }
+
+    pj_grp_lock_release(resolver->grp_lock);
+}
+
+
+/* Get the response to give to the callback of a cache hit, with the TTL
+ * of the answers lowered to the remaining lifetime of the entry, so the
+ * callback gets the time left rather than the TTL of the response when it
+ * was received. The cached packet is shared by concurrent cache hits and
+ * is not modified: the header is copied to dst and the answers to ans_buf,
+ * or if there are more than CACHED_ANS_CNT answers, to *p_pool which is
+ * created here. The records data is still shared. Shard lock must be held.
+ */
+static pj_dns_parsed_packet *get_cached_pkt(pj_dns_resolver *resolver,
+					    const struct cached_res *cache,
+					    const pj_time_val *now,
+					    pj_dns_parsed_packet *dst,
+					    pj_dns_parsed_rr ans_buf[],
+					    pj_pool_t **p_pool)
+{
+    pj_dns_parsed_packet *pkt = cache->pkt;
+    pj_size_t ans_size;
+    pj_uint32_t ttl;
+    unsigned i;
+
+    /* Entries added by application without expiry keep their TTL */
+    if (cache->ttl == 0)
+	return pkt;
+
+    ttl = (pj_uint32_t)(cache->expiry_time.sec - now->sec);
+    for (i=0; i<pkt->hdr.anscount && pkt->ans[i].ttl <= ttl; ++i)
+	;
+    if (i == pkt->hdr.anscount)
+	return pkt;
+
+    *dst = *pkt;
+    ans_size = pkt->hdr.anscount * sizeof(pj_dns_parsed_rr);
+    if (pkt->hdr.anscount <= CACHED_ANS_CNT) {
+	dst->ans = ans_buf;
+    } else {
+	*p_pool = pj_pool_create(resolver->pool->factory, "dnsttl",
+				 ans_size + 256, 256, NULL);
+	if (*p_pool == NULL)
+	    return pkt;
+	dst->ans = (pj_dns_parsed_rr*) pj_pool_alloc(*p_pool, ans_size);
+    }
+
+    pj_memcpy(dst->ans, pkt->ans, ans_size);
+    for (i=0; i<dst->hdr.anscount; ++i) {
+	if (dst->ans[i].ttl > ttl)
+	    dst->ans[i].ttl = ttl;
+    }
+    return dst;
+}
+
+/* Look for a valid cached response for the key, and if found, call the
+ * callback with it. Only the shard lock is held here, so cache hits
+ * don't contend with query processing on the resolver lock.
+ *
+ * Return PJ_TRUE if the query has been answered from the cache.
+ */
+static pj_bool_t query_from_cache(pj_dns_resolver *resolver,
+				  const struct res_key *key,
+				  pj_uint32_t hval,
+				  pj_dns_callback *cb,
+				  void *user_data)
+{
+    struct cache_shard *shard = get_shard(resolver, hval);
+    struct cached_res *cache;
+    pj_dns_parsed_packet pkt_buf, *pkt;
+    pj_dns_parsed_rr ans_buf[CACHED_ANS_CNT];
+    pj_pool_t *pool = NULL;
+    pj_bool_t prefetch = PJ_FALSE;
+    pj_time_val now;
+    pj_status_t status;
+
+    pj_lock_acquire(shard->lock);
+
+    cache = (struct cached_res *) pj_hash_get(shard->ht, key, sizeof(*key),
+					      &hval);
+    if (cache == NULL) {
+	++shard->misses;
+	pj_lock_release(shard->lock);
+	return PJ_FALSE;
+    }
+
+    /* Check for expiration */
+    pj_gettimeofday(&now);
+    if (!PJ_TIME_VAL_GT(cache->expiry_time, now)) {
+	/* The entry has expired, remove it from the cache. It will also be
+	 * freed, if it is not being used (by callback).
+	 */
+	remove_entry(resolver, shard, cache);
+	++shard->misses;
+	pj_lock_release(shard->lock);
+	return PJ_FALSE;
+    }
+
+    /* Log */
+    PJ_LOG(5,(resolver->name.ptr, 
+	      "Picked up DNS %s record for %s from cache, ttl=%d",
+	      pj_dns_get_type_name(key->qtype), key->name,
+	      (int)(cache->expiry_time.sec - now.sec)));
+
+    /* Map DNS Rcode in the response into PJLIB status name space */
+    status = PJ_DNS_GET_RCODE(cache->pkt->hdr.flags);
+    status = PJ_STATUS_FROM_DNS_RCODE(status);
+
+    pkt = get_cached_pkt(resolver, cache, &now, &pkt_buf, ans_buf, &pool);
+
+    /* Move to the head of the LRU list */
+    pj_list_erase(cache);
+    pj_list_push_front(&shard->lru, cache);
+    ++cache->hit_cnt;
+    ++shard->hits;
+
+    /* Refresh hot entries shortly before they expire */
+    if (PJ_DNS_RESOLVER_PREFETCH_PCT && cache->ttl && !cache->negative &&
+	!cache->prefetching &&
+	cache->hit_cnt >= PJ_DNS_RESOLVER_PREFETCH_MIN_HITS &&
+	(pj_uint64_t)(cache->expiry_time.sec - now.sec) * 100 <=
+	    (pj_uint64_t)cache->ttl * PJ_DNS_RESOLVER_PREFETCH_PCT)
+    {
+	cache->prefetching = PJ_TRUE;
+	prefetch = PJ_TRUE;
+	++shard->prefetches;
+    }
+
+    /* Workaround for deadlock problem. Need to increment the cache's
+     * ref counter first before releasing mutex, so the cache won't be
+     * destroyed by other thread while in callback.
+     */
+    cache->ref_cnt++;
+    pj_lock_release(shard->lock);
+
+    /* This cached response is still valid. Just return this
+     * response to caller.
+     */
+    if (cb) {
+	(*cb)(user_data, status, pkt);
+    }
+    if (pool)
+	pj_pool_release(pool);
+
+    /* Decrement the ref counter. Also check if it is time to free
+     * the cache (as it has been expired).
+     */
+    pj_lock_acquire(shard->lock);
+    cache->ref_cnt--;
+    if (cache->ref_cnt <= 0)
+	free_entry(resolver, cache);
+    pj_lock_release(shard->lock);
+
+    if (prefetch)
+	prefetch_entry(resolver, key);
+
+    return PJ_TRUE;
+}
+
+
+/*
+ * Create and start asynchronous DNS query for a single resource.
+ */
+PJ_DEF(pj_status_t) pj_dns_resolver_start_query( pj_dns_resolver *resolver,
+						 const pj_str_t *name,
+						 int type,
+						 unsigned options,
+						 pj_dns_callback *cb,
+						 void *user_data,
+						 pj_dns_async_query **p_query)
+{
+    struct res_key key;
+    pj_dns_async_query *q, *p_q = NULL;
+    pj_uint32_t hval;
+    pj_status_t status = PJ_SUCCESS;
+
+    /* Validate arguments */
+    PJ_ASSERT_RETURN(resolver && name && type, PJ_EINVAL);
+
+    /* Check name is not too long. */
+    PJ_ASSERT_RETURN(name->slen>0 && name->slen < PJ_MAX_HOSTNAME,
+		     PJ_ENAMETOOLONG);
+
+    /* Check type */
+    PJ_ASSERT_RETURN(type > 0 && type < 0xFFFF, PJ_EINVAL);
+
+    /* Build resource key for looking up hash tables */
+    init_res_key(&key, type, name);
+    hval = pj_hash_calc(0, &key, sizeof(key));
+
+    /* First, check if we have cached response for the specified name/type,
+     * and the cached entry has not expired.
+     */
+    if (query_from_cache(resolver, &key, hval, cb, user_data)) {
+	/*
+	 * We cannot write to *p_query after calling cb because what
+	 * p_query points to may have been freed by cb.
+	 * Refer to ticket #1974.
+	 */
+	return PJ_SUCCESS;
+    }
+
+    /* Start working with the resolver */
+    pj_grp_lock_acquire(resolver->grp_lock);
+
+    /* Next, check if we have pending query on the same resource */
+    q = (pj_dns_async_query *) pj_hash_get(resolver->hquerybyres, &key, 
+    					   sizeof(key), NULL);
+    if (q) {
+	/* Yes, there's another pending query to the same key.
+	 * Just create a new child query and add this query to
+	 * pending query's child queries.
+	 */
+	pj_dns_async_query *nq;
+
+	nq = alloc_qnode(resolver, options, user_data, cb);
+	pj_list_push_back(&q->child_head, nq);
+
+	/* Done. This child query will be notified once the "parent"
+	 * query completes.
+	 */
+	p_q = nq;
+	status = PJ_SUCCESS;
+	goto on_return;
+    } 
+
+    /* There's no pending query to the same key, initiate a new one. */
+    status = send_new_query(resolver, &key, options, cb, user_data, &p_q);
+
+on_return:
+    if (p_query)
+	*p_query = p_q;
+
+    pj_grp_lock_release(resolver->grp_lock);
+    return status;
+}
+
+
+/*
+ * Cancel a pending query.
+ */
+PJ_DEF(pj_status_t) pj_dns_resolver_cancel_query(pj_dns_async_query *query,
+						 pj_bool_t notify)
+{
+    pj_dns_callback *cb;
+
+    PJ_ASSERT_RETURN(query, PJ_EINVAL);
+
+    pj_grp_lock_acquire(query->resolver->grp_lock);
+
+    if (query->timer_entry.id == 1) {
+	pj_timer_heap_cancel_if_active(query->resolver->timer,
 				       &query->timer_entry, 0);
     }
 
@@ -1452,25 +1898,16 @@ static void update_res_cache(pj_dns_resolver *resolver,
 			     pj_bool_t set_expiry,
 			     const pj_dns_parsed_packet *pkt)
 {
+    struct cache_shard *shard;
     struct cached_res *cache;
-    pj_uint32_t hval=0, ttl;
-
-    /* If status is unsuccessful, clear the same entry from the cache */
-    if (status != PJ_SUCCESS) {
-	cache = (struct cached_res *) pj_hash_get(resolver->hrescache, key, 
-						  sizeof(*key), &hval);
-	/* Remove the entry before releasing its pool (see ticket #1710) */
-	pj_hash_set(NULL, resolver->hrescache, key, sizeof(*key), hval, NULL);
-	
-	/* Free the entry */
-	if (cache && --cache->ref_cnt <= 0)
-	    free_entry(resolver, cache);
-    }
+    pj_uint32_t hval, ttl;
+    pj_bool_t negative;
 
+    negative = (pkt->hdr.anscount == 0 || status != PJ_SUCCESS);
 
     /* Calculate expiration time. */
     if (set_expiry) {
-	if (pkt->hdr.anscount == 0 || status != PJ_SUCCESS) {
+	if (negative) {
 	    /* If we don't have answers for the name, then give a different
 	     * ttl value (note: PJ_DNS_RESOLVER_INVALID_TTL may be zero, 
 	     * which means that invalid names won't be kept in the cache)
@@ -1494,38 +1931,42 @@ static void update_res_cache(pj_dns_resolver *resolver,
     if (ttl > resolver->settings.cache_max_ttl)
 	ttl = resolver->settings.cache_max_ttl;
 
-    /* Get a cache response entry */
-    cache = (struct cached_res *) pj_hash_get(resolver->hrescache, key,
-    					      sizeof(*key), &hval);
+    hval = pj_hash_calc(0, key, sizeof(*key));
+    shard = get_shard(resolver, hval);
 
-    /* If TTL is zero, clear the same entry in the hash table */
-    if (ttl == 0) {
-	/* Remove the entry before releasing its pool (see ticket #1710) */
-	pj_hash_set(NULL, resolver->hrescache, key, sizeof(*key), hval, NULL);
+    pj_lock_acquire(shard->lock);
 
-	/* Free the entry */
-	if (cache && --cache->ref_cnt <= 0)
+    /* Get a cache response entry, and take it out of the shard */
+    cache = (struct cached_res *) pj_hash_get(shard->ht, key, sizeof(*key),
+					      &hval);
+    if (cache)
+	unlink_entry(shard, cache);
+
+    /* If status is unsuccessful or TTL is zero, don't reuse the entry */
+    if (cache && (status != PJ_SUCCESS || ttl == 0)) {
+	if (--cache->ref_cnt <= 0)
 	    free_entry(resolver, cache);
+	cache = NULL;
+    }
+
+    /* If TTL is zero, the response is not kept in the cache */
+    if (ttl == 0) {
+	pj_lock_release(shard->lock);
 	return;
     }
 
     if (cache == NULL) {
 	cache = alloc_entry(resolver);
+    } else if (cache->ref_cnt > 1) {
+	/* When cache entry is being used by callback (to app),
+	 * just decrement ref_cnt so it will be freed after
+	 * the callback returns and allocate new entry.
+	 */
+	cache->ref_cnt--;
+	cache = alloc_entry(resolver);
     } else {
-	/* Remove the entry before resetting its pool (see ticket #1710) */
-	pj_hash_set(NULL, resolver->hrescache, key, sizeof(*key), hval, NULL);
-
-	if (cache->ref_cnt > 1) {
-	    /* When cache entry is being used by callback (to app),
-	     * just decrement ref_cnt so it will be freed after
-	     * the callback returns and allocate new entry.
-	     */
-	    cache->ref_cnt--;
-	    cache = alloc_entry(resolver);
-	} else {
-	    /* Reset cache to avoid bloated cache pool */
-	    reset_entry(&cache);
-	}
+	/* Reset cache to avoid bloated cache pool */
+	reset_entry(&cache);
     }
 
     /* Duplicate the packet.
@@ -1542,18 +1983,29 @@ static void update_res_cache(pj_dns_resolver *resolver,
     if (set_expiry) {
 	pj_gettimeofday(&cache->expiry_time);
 	cache->expiry_time.sec += ttl;
+	cache->ttl = ttl;
     } else {
 	cache->expiry_time.sec = 0x7FFFFFFFL;
 	cache->expiry_time.msec = 0;
+	cache->ttl = 0;
     }
+    cache->negative = negative;
 
     /* Copy key to the cached response */
     pj_memcpy(&cache->key, key, sizeof(*key));
+    cache->hval = hval;
 
-    /* Update the hash table */
-    pj_hash_set_np(resolver->hrescache, &cache->key, sizeof(*key), hval,
+    /* Update the hash table and the LRU list */
+    pj_hash_set_np(shard->ht, &cache->key, sizeof(*key), hval,
 		   cache->hbuf, cache);
+    pj_list_push_front(&shard->lru, cache);
+    ++shard->count;
+    if (negative)
+	++shard->neg_count;
+
+    enforce_cache_limits(resolver, shard);
 
+    pj_lock_release(shard->lock);
 }
 
 
@@ -1576,7 +2028,9 @@ static void on_timeout( pj_timer_heap_t *timer_heap,
      * possibility of race condition (timer elapsed while at the same time
      * response arrives)
      */
-    if (pj_hash_get(resolver->hquerybyid, &q->id, sizeof(q->id), NULL)==NULL) {
+    if (pj_hash_get(resolver->hquerybyid, &q->hkey, sizeof(q->hkey),
+		    NULL) == NULL)
+    {
 	/* Yeah, this query is done. */
 	pj_grp_lock_release(resolver->grp_lock);
 	return;
@@ -1601,7 +2055,8 @@ static void on_timeout( pj_timer_heap_t *timer_heap,
     }
 
     /* Clear hash table entries */
-    pj_hash_set(NULL, resolver->hquerybyid, &q->id, sizeof(q->id), 0, NULL);
+    pj_hash_set(NULL, resolver->hquerybyid, &q->hkey, sizeof(q->hkey), 0,
+		NULL);
     pj_hash_set(NULL, resolver->hquerybyres, &q->key, sizeof(q->key), 0, NULL);
 
     /* Workaround for deadlock problem in #1565 (similar to #1108) */
@@ -1641,74 +2096,89 @@ static void on_timeout( pj_timer_heap_t *timer_heap,
 }
 
 
-/* Callback from ioqueue when packet is received */
-static void on_read_complete(pj_ioqueue_key_t *key, 
-                             pj_ioqueue_op_key_t *op_key, 
-                             pj_ssize_t bytes_read)
+/* Find the index of nameserver with the specified address, or -1 */
+static int find_nameserver(pj_dns_resolver *resolver,
+			   const pj_sockaddr *addr)
 {
-    pj_dns_resolver *resolver;
-    pj_pool_t *pool = NULL;
-    pj_dns_parsed_packet *dns_pkt;
-    pj_dns_async_query *q;
-    char addr[PJ_INET6_ADDRSTRLEN];
-    pj_sockaddr *src_addr;
-    int *src_addr_len;
-    unsigned char *rx_pkt;
-    pj_ssize_t rx_pkt_size;
-    pj_status_t status;
-    PJ_USE_EXCEPTION;
-
-
-    resolver = (pj_dns_resolver *) pj_ioqueue_get_user_data(key);
-    pj_assert(resolver);
+    unsigned i;
 
-#if PJ_HAS_IPV6
-    if (key == resolver->udp6_key) {
-	src_addr = &resolver->udp6_src_addr;
-	src_addr_len = &resolver->udp6_addr_len;
-	rx_pkt = resolver->udp6_rx_pkt;
-	rx_pkt_size = sizeof(resolver->udp6_rx_pkt);
-    } else 
-#endif
-    {
-	src_addr = &resolver->udp_src_addr;
-	src_addr_len = &resolver->udp_addr_len;
-	rx_pkt = resolver->udp_rx_pkt;
-	rx_pkt_size = sizeof(resolver->udp_rx_pkt);
+    for (i=0; i<resolver->ns_count; ++i) {
+	if (pj_sockaddr_cmp(&resolver->ns[i].addr, addr) == 0)
+	    return i;
     }
+    return -1;
+}
 
-    pj_grp_lock_acquire(resolver->grp_lock);
+/* Update nameserver statistics with the response to the query */
+static void update_ns_stat(pj_dns_resolver *resolver,
+			   unsigned ns_idx,
+			   const pj_dns_async_query *q,
+			   pj_bool_t via_tcp)
+{
+    struct nameserver *ns = &resolver->ns[ns_idx];
 
+    ++ns->rx_cnt;
 
-    /* Check for errors */
-    if (bytes_read < 0) {
-	status = (pj_status_t)-bytes_read;
-	PJ_PERROR(4,(resolver->name.ptr, status, "DNS resolver read error"));
+    /* Response to a retransmitted query can't tell which transmission
+     * it belongs to, so only sample the RTT of queries sent once.
+     */
+    if (!via_tcp && q->transmit_cnt == 1) {
+	pj_time_val rt;
+	unsigned msec;
 
-	goto read_next_packet;
+	pj_gettimeofday(&rt);
+	PJ_TIME_VAL_SUB(rt, q->sent_time);
+	msec = PJ_TIME_VAL_MSEC(rt);
+
+	ns->rtt = msec;
+	ns->srtt = ns->srtt ? (ns->srtt * 7 + msec) / 8 : msec;
     }
+}
 
-    PJ_LOG(5,(resolver->name.ptr, 
-	      "Received %d bytes DNS response from %s:%d",
-	      (int)bytes_read, 
-	      pj_sockaddr_print(src_addr, addr, sizeof(addr), 2),
-	      pj_sockaddr_get_port(src_addr)));
+/* Find pending query with the transaction ID which is being retried over
+ * TCP to the nameserver. Resolver lock must be held.
+ */
+static pj_dns_async_query *find_tcp_query(pj_dns_resolver *resolver,
+					  unsigned ns_idx,
+					  pj_uint16_t id)
+{
+    unsigned i;
 
+    for (i=0; i<PJ_DNS_RESOLVER_UDP_SOCK_CNT; ++i) {
+	pj_uint32_t hkey = QUERY_HKEY(i, id);
+	pj_dns_async_query *q;
 
-    /* Check for zero packet */
-    if (bytes_read == 0)
-	goto read_next_packet;
+	q = (pj_dns_async_query*)
+	    pj_hash_get(resolver->hquerybyid, &hkey, sizeof(hkey), NULL);
+	if (q && q->use_tcp && q->tcp_ns == ns_idx)
+	    return q;
+    }
+    return NULL;
+}
 
-    /* Create temporary pool from a fixed buffer */
-    pool = pj_pool_create_on_buf("restmp", resolver->tmp_pool, 
-				 sizeof(resolver->tmp_pool));
+/* Process DNS response packet, received by the UDP socket us, or over
+ * TCP connection if us is NULL. Resolver lock must be held; it will be
+ * released temporarily while calling the callbacks.
+ */
+static void handle_response(pj_dns_resolver *resolver,
+			    pj_pool_t *pool,
+			    const pj_sockaddr *src_addr,
+			    const void *pkt,
+			    unsigned size,
+			    const struct udp_sock *us)
+{
+    pj_dns_parsed_packet *dns_pkt;
+    pj_dns_async_query *q;
+    char addr[PJ_INET6_ADDRSTRLEN];
+    int ns_idx;
+    pj_status_t status;
+    PJ_USE_EXCEPTION;
 
     /* Parse DNS response */
     status = -1;
     dns_pkt = NULL;
     PJ_TRY {
-	status = pj_dns_parse_packet(pool, rx_pkt, 
-				     (unsigned)bytes_read, &dns_pkt);
+	status = pj_dns_parse_packet(pool, pkt, size, &dns_pkt);
     }
     PJ_CATCH_ANY {
 	status = PJ_ENOMEM;
@@ -1724,20 +2194,67 @@ static void on_read_complete(pj_ioqueue_key_t *key,
 		     "Error parsing DNS response from %s:%d", 
 		     pj_sockaddr_print(src_addr, addr, sizeof(addr), 2),
 		     pj_sockaddr_get_port(src_addr)));
-	goto read_next_packet;
+	return;
     }
 
-    /* Find the query based on the transaction ID */
-    q = (pj_dns_async_query*) 
-        pj_hash_get(resolver->hquerybyid, &dns_pkt->hdr.id,
-		    sizeof(dns_pkt->hdr.id), NULL);
+    /* Find the query based on the transaction ID and the socket it was
+     * sent from, so response arriving on other socket is not accepted.
+     */
+    ns_idx = find_nameserver(resolver, src_addr);
+    if (us) {
+	pj_uint32_t hkey = QUERY_HKEY(us->idx, dns_pkt->hdr.id);
+
+	q = (pj_dns_async_query*)
+	    pj_hash_get(resolver->hquerybyid, &hkey, sizeof(hkey), NULL);
+    } else {
+	q = (ns_idx >= 0) ?
+	    find_tcp_query(resolver, ns_idx, dns_pkt->hdr.id) : NULL;
+    }
     if (!q) {
 	PJ_LOG(5,(resolver->name.ptr, 
 		  "DNS response from %s:%d id=%d discarded",
 		  pj_sockaddr_print(src_addr, addr, sizeof(addr), 2),
 		  pj_sockaddr_get_port(src_addr),
 		  (unsigned)dns_pkt->hdr.id));
-	goto read_next_packet;
+	return;
+    }
+
+    if (ns_idx >= 0)
+	update_ns_stat(resolver, ns_idx, q, (us == NULL));
+
+    /* Retry truncated UDP response over TCP, if enabled */
+    if (us && PJ_DNS_GET_TC(dns_pkt->hdr.flags)) {
+	++resolver->truncated_cnt;
+
+	/* The query is already being retried over TCP */
+	if (q->use_tcp)
+	    return;
+
+	if ((resolver->settings.options & PJ_DNS_RESOLVER_TCP_FALLBACK) &&
+	    ns_idx >= 0)
+	{
+	    /* Responses over TCP are matched by nameserver and ID, only
+	     * one query with the ID may use the connection.
+	     */
+	    if (find_tcp_query(resolver, ns_idx, q->id) == NULL) {
+		q->tcp_ns = ns_idx;
+		status = tcp_send_query(resolver, q);
+	    } else {
+		status = PJ_EEXISTS;
+	    }
+	    if (status == PJ_SUCCESS) {
+		PJ_LOG(5,(resolver->name.ptr,
+			  "Truncated DNS %s response for %s, retrying "
+			  "over TCP",
+			  pj_dns_get_type_name(q->key.qtype), q->key.name));
+		q->use_tcp = PJ_TRUE;
+		return;
+	    }
+
+	    /* Deliver the truncated response */
+	    PJ_PERROR(4,(resolver->name.ptr, status,
+			 "Error retrying DNS query over TCP"));
+	}
     }
 
     /* Map DNS Rcode in the response into PJLIB status name space */
@@ -1749,7 +2266,8 @@ static void on_read_complete(pj_ioqueue_key_t *key,
     q->timer_entry.id = 0;
 
     /* Clear hash table entries */
-    pj_hash_set(NULL, resolver->hquerybyid, &q->id, sizeof(q->id), 0, NULL);
+    pj_hash_set(NULL, resolver->hquerybyid, &q->hkey, sizeof(q->hkey), 0,
+		NULL);
     pj_hash_set(NULL, resolver->hquerybyres, &q->key, sizeof(q->key), 0, NULL);
 
     /* Workaround for deadlock problem in #1108 */
@@ -1795,6 +2313,56 @@ static void on_read_complete(pj_ioqueue_key_t *key,
 	}
     }
     pj_list_push_back(&resolver->query_free_nodes, q);
+}
+
+/* Callback from ioqueue when packet is received */
+static void on_read_complete(pj_ioqueue_key_t *key, 
+                             pj_ioqueue_op_key_t *op_key, 
+                             pj_ssize_t bytes_read)
+{
+    struct udp_sock *us;
+    pj_dns_resolver *resolver;
+    pj_pool_t *pool = NULL;
+    char addr[PJ_INET6_ADDRSTRLEN];
+    pj_ssize_t rx_pkt_size;
+    pj_status_t status;
+
+    us = (struct udp_sock *) pj_ioqueue_get_user_data(key);
+    pj_assert(us);
+    resolver = us->resolver;
+    rx_pkt_size = sizeof(us->rx_pkt);
+
+    pj_grp_lock_acquire(resolver->grp_lock);
+
+
+    /* Check for errors */
+    if (bytes_read < 0) {
+	status = (pj_status_t)-bytes_read;
+	PJ_PERROR(4,(resolver->name.ptr, status, "DNS resolver read error"));
+
+	goto read_next_packet;
+    }
+
+    PJ_LOG(5,(resolver->name.ptr, 
+	      "Received %d bytes DNS response from %s:%d",
+	      (int)bytes_read, 
+	      pj_sockaddr_print(&us->src_addr, addr, sizeof(addr), 2),
+	      pj_sockaddr_get_port(&us->src_addr)));
+
+
+    /* Check for zero packet */
+    if (bytes_read == 0)
+	goto read_next_packet;
+
+    /* Create temporary pool from the socket's fixed buffer. The packet is
+     * still used by the callbacks after the resolver lock is released, so
+     * the buffer must not be shared with the other sockets.
+     */
+    pool = pj_pool_create_on_buf("restmp", us->tmp_pool, 
+				 sizeof(us->tmp_pool));
+
+    handle_response(resolver, pool, &us->src_addr, us->rx_pkt,
+		    (unsigned)bytes_read, us);
 
 read_next_packet:
     if (pool) {
@@ -1802,9 +2370,10 @@ read_next_packet:
 	pj_pool_release(pool);
     }
 
-    status = pj_ioqueue_recvfrom(key, op_key, rx_pkt, &rx_pkt_size,
+    us->addr_len = sizeof(us->src_addr);
+    status = pj_ioqueue_recvfrom(key, op_key, us->rx_pkt, &rx_pkt_size,
 				 PJ_IOQUEUE_ALWAYS_ASYNC,
-				 src_addr, src_addr_len);
+				 &us->src_addr, &us->addr_len);
 
     if (status != PJ_EPENDING && status != PJ_ECANCELLED) {
 	PJ_PERROR(4,(resolver->name.ptr, status,
@@ -1817,6 +2386,375 @@ read_next_packet:
 }
 
 
+/* Group lock handlers of TCP connection, called when the ioqueue is done
+ * with the connection's socket.
+ */
+static void tcp_conn_on_destroy(void *member)
+{
+    pj_pool_release((pj_pool_t*)member);
+}
+
+static void tcp_conn_release_resolver(void *member)
+{
+    pj_dns_resolver *resolver = (pj_dns_resolver*)member;
+
+    pj_grp_lock_dec_ref(resolver->grp_lock);
+}
+
+/* Close TCP connection. Queries sent over it will be retransmitted over
+ * a new connection when they time out.
+ */
+static void tcp_close(struct tcp_conn *conn)
+{
+    if (conn->asock) {
+	pj_activesock_close(conn->asock);
+	conn->asock = NULL;
+    }
+    if (conn->grp_lock) {
+	/* The connection's pool is released with the last reference */
+	pj_grp_lock_dec_ref(conn->grp_lock);
+	conn->grp_lock = NULL;
+    }
+    conn->pool = NULL;
+    conn->rx_buf = conn->tx_buf = conn->tx_pending = NULL;
+    conn->connected = PJ_FALSE;
+    conn->sending = PJ_FALSE;
+    conn->tx_pending_len = 0;
+}
+
+/* Send the queued queries, if the connection is ready for sending */
+static pj_status_t tcp_flush(struct tcp_conn *conn)
+{
+    while (conn->connected && !conn->sending && conn->tx_pending_len) {
+	unsigned char *buf = conn->tx_buf;
+	pj_ssize_t size = conn->tx_pending_len;
+	pj_status_t status;
+
+	/* Send all queued queries at once, and queue the next ones in
+	 * the other buffer.
+	 */
+	conn->tx_buf = conn->tx_pending;
+	conn->tx_pending = buf;
+	conn->tx_pending_len = 0;
+	conn->sending = PJ_TRUE;
+
+	status = pj_activesock_send(conn->asock, &conn->send_key,
+				    conn->tx_buf, &size, 0);
+	if (status == PJ_EPENDING)
+	    break;
+
+	conn->sending = PJ_FALSE;
+	if (status != PJ_SUCCESS) {
+	    PJ_PERROR(4,(conn->resolver->name.ptr, status,
+			 "Error sending DNS query over TCP"));
+	    tcp_close(conn);
+	    return status;
+	}
+    }
+
+    return PJ_SUCCESS;
+}
+
+/* TCP connection has been established */
+static pj_status_t tcp_on_connected(struct tcp_conn *conn)
+{
+    void *readbuf[1];
+    pj_status_t status;
+
+    conn->connected = PJ_TRUE;
+
+    PJ_LOG(5,(conn->resolver->name.ptr, "TCP connection to NS %d "
+	      "established", conn->ns_idx));
+
+    readbuf[0] = conn->rx_buf;
+    status = pj_activesock_start_read2(conn->asock, conn->pool,
+				       TCP_BUF_SZ, readbuf, 0);
+    if (status != PJ_SUCCESS) {
+	PJ_PERROR(4,(conn->resolver->name.ptr, status,
+		     "Error reading from TCP connection"));
+	tcp_close(conn);
+	return status;
+    }
+
+    return tcp_flush(conn);
+}
+
+static pj_bool_t on_tcp_connect_complete(pj_activesock_t *asock,
+					 pj_status_t status)
+{
+    struct tcp_conn *conn;
+    pj_dns_resolver *resolver;
+    pj_bool_t alive;
+
+    conn = (struct tcp_conn*) pj_activesock_get_user_data(asock);
+    resolver = conn->resolver;
+
+    pj_grp_lock_acquire(resolver->grp_lock);
+
+    if (conn->asock != asock) {
+	pj_grp_lock_release(resolver->grp_lock);
+	return PJ_FALSE;
+    }
+
+    if (status != PJ_SUCCESS) {
+	PJ_PERROR(4,(resolver->name.ptr, status,
+		     "TCP connection to NS %d failed", conn->ns_idx));
+	tcp_close(conn);
+    } else {
+	tcp_on_connected(conn);
+    }
+
+    alive = (conn->asock == asock);
+    pj_grp_lock_release(resolver->grp_lock);
+
+    return alive;
+}
+
+static pj_bool_t on_tcp_data_sent(pj_activesock_t *asock,
+				  pj_ioqueue_op_key_t *send_key,
+				  pj_ssize_t sent)
+{
+    struct tcp_conn *conn;
+    pj_dns_resolver *resolver;
+    pj_bool_t alive;
+
+    PJ_UNUSED_ARG(send_key);
+
+    conn = (struct tcp_conn*) pj_activesock_get_user_data(asock);
+    resolver = conn->resolver;
+
+    pj_grp_lock_acquire(resolver->grp_lock);
+
+    if (conn->asock != asock) {
+	pj_grp_lock_release(resolver->grp_lock);
+	return PJ_FALSE;
+    }
+
+    conn->sending = PJ_FALSE;
+    if (sent <= 0) {
+	PJ_PERROR(4,(resolver->name.ptr, (pj_status_t)-sent,
+		     "Error sending DNS query over TCP"));
+	tcp_close(conn);
+    } else {
+	tcp_flush(conn);
+    }
+
+    alive = (conn->asock == asock);
+    pj_grp_lock_release(resolver->grp_lock);
+
+    return alive;
+}
+
+static pj_bool_t on_tcp_data_read(pj_activesock_t *asock,
+				  void *data,
+				  pj_size_t size,
+				  pj_status_t status,
+				  pj_size_t *remainder)
+{
+    struct tcp_conn *conn;
+    pj_dns_resolver *resolver;
+    pj_uint8_t *p = (pj_uint8_t*) data;
+    pj_sockaddr src_addr;
+
+    conn = (struct tcp_conn*) pj_activesock_get_user_data(asock);
+    resolver = conn->resolver;
+
+    pj_grp_lock_acquire(resolver->grp_lock);
+
+    if (conn->asock != asock) {
+	pj_grp_lock_release(resolver->grp_lock);
+	return PJ_FALSE;
+    }
+
+    if (status != PJ_SUCCESS) {
+	PJ_PERROR(4,(resolver->name.ptr, status,
+		     "TCP connection to NS %d closed", conn->ns_idx));
+	tcp_close(conn);
+	pj_grp_lock_release(resolver->grp_lock);
+	return PJ_FALSE;
+    }
+
+    /* The nameserver array may change while the lock is released */
+    pj_sockaddr_cp(&src_addr, &resolver->ns[conn->ns_idx].addr);
+
+    /* Process the complete responses, each prefixed with its length */
+    while (size >= 2) {
+	unsigned len = (p[0] << 8) | p[1];
+	pj_pool_t *pool;
+
+	if (len + 2 > TCP_BUF_SZ) {
+	    PJ_LOG(4,(resolver->name.ptr, "DNS response of %d bytes over "
+		      "TCP is too large", len));
+	    tcp_close(conn);
+	    pj_grp_lock_release(resolver->grp_lock);
+	    return PJ_FALSE;
+	}
+	if (size < len + 2)
+	    break;
+
+	PJ_LOG(5,(resolver->name.ptr, "Received %d bytes DNS response over "
+		  "TCP from NS %d", len, conn->ns_idx));
+
+	pool = pj_pool_create(resolver->pool->factory, "dnstcp",
+			      TMP_SZ, TMP_SZ, NULL);
+	handle_response(resolver, pool, &src_addr, p + 2, len, NULL);
+	pj_pool_release(pool);
+
+	/* The connection may have been closed by the callbacks */
+	if (conn->asock != asock) {
+	    pj_grp_lock_release(resolver->grp_lock);
+	    return PJ_FALSE;
+	}
+
+	p += len + 2;
+	size -= len + 2;
+    }
+
+    /* Keep the partial response for the next read */
+    if (size && p != data)
+	pj_memmove(data, p, size);
+    *remainder = size;
+
+    pj_grp_lock_release(resolver->grp_lock);
+
+    return PJ_TRUE;
+}
+
+/* Connect to the nameserver */
+static pj_status_t tcp_connect(pj_dns_resolver *resolver, unsigned ns_idx)
+{
+    struct tcp_conn *conn = &resolver->tcp[ns_idx];
+    struct nameserver *ns = &resolver->ns[ns_idx];
+    pj_pool_t *pool;
+    pj_activesock_cfg cfg;
+    pj_activesock_cb cb;
+    pj_sock_t sock;
+    pj_status_t status;
+
+    /* Each connection has its own pool and group lock, so that the memory
+     * is released when the connection is closed.
+     */
+    pool = pj_pool_create(resolver->pool->factory, "dnstcp%p",
+			  3 * TCP_BUF_SZ + 1000, 1000, NULL);
+    if (!pool)
+	return PJ_ENOMEM;
+
+    status = pj_grp_lock_create_w_handler(pool, NULL, pool,
+					  &tcp_conn_on_destroy,
+					  &conn->grp_lock);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(pool);
+	return status;
+    }
+    conn->pool = pool;
+
+    /* The connection keeps the resolver alive until its socket is done */
+    pj_grp_lock_add_ref(conn->grp_lock);
+    pj_grp_lock_add_ref(resolver->grp_lock);
+    pj_grp_lock_add_handler(conn->grp_lock, NULL, resolver,
+			    &tcp_conn_release_resolver);
+
+    conn->rx_buf = (unsigned char*)pj_pool_alloc(pool, TCP_BUF_SZ);
+    conn->tx_buf = (unsigned char*)pj_pool_alloc(pool, TCP_BUF_SZ);
+    conn->tx_pending = (unsigned char*)pj_pool_alloc(pool, TCP_BUF_SZ);
+    conn->ns_idx = ns_idx;
+
+    status = pj_sock_socket(ns->addr.addr.sa_family, pj_SOCK_STREAM(), 0,
+			    &sock);
+    if (status != PJ_SUCCESS) {
+	tcp_close(conn);
+	return status;
+    }
+
+    /* The callbacks acquire the resolver lock, they must not be called
+     * with the connection's lock held.
+     */
+    pj_activesock_cfg_default(&cfg);
+    cfg.grp_lock = conn->grp_lock;
+    cfg.concurrency = 1;
+
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_connect_complete = &on_tcp_connect_complete;
+    cb.on_data_read = &on_tcp_data_read;
+    cb.on_data_sent = &on_tcp_data_sent;
+
+    status = pj_activesock_create(pool, sock, pj_SOCK_STREAM(),
+				  &cfg, resolver->ioqueue, &cb, conn,
+				  &conn->asock);
+    if (status != PJ_SUCCESS) {
+	pj_sock_close(sock);
+	conn->asock = NULL;
+	tcp_close(conn);
+	return status;
+    }
+
+    pj_ioqueue_op_key_init(&conn->send_key, sizeof(conn->send_key));
+    conn->connected = PJ_FALSE;
+    conn->sending = PJ_FALSE;
+    conn->tx_pending_len = 0;
+
+    PJ_LOG(5,(resolver->name.ptr, "Connecting to NS %d over TCP", ns_idx));
+
+    status = pj_activesock_start_connect(conn->asock, pool, &ns->addr,
+					 pj_sockaddr_get_len(&ns->addr));
+    if (status == PJ_SUCCESS) {
+	return tcp_on_connected(conn);
+    } else if (status != PJ_EPENDING) {
+	tcp_close(conn);
+	return status;
+    }
+
+    return PJ_SUCCESS;
+}
+
+/* Send query over TCP connection to nameserver q->tcp_ns, connecting
+ * first if necessary. Resolver lock must be held.
+ */
+static pj_status_t tcp_send_query(pj_dns_resolver *resolver,
+				  pj_dns_async_query *q)
+{
+    struct tcp_conn *conn = &resolver->tcp[q->tcp_ns];
+    unsigned pkt_size;
+    pj_uint8_t *p;
+    pj_str_t name;
+    pj_status_t status;
+
+    if (conn->asock == NULL) {
+	status = tcp_connect(resolver, q->tcp_ns);
+	if (status != PJ_SUCCESS)
+	    return status;
+    }
+
+    /* Queue the query after the other queued queries, prefixed with its
+     * length.
+     */
+    if (conn->tx_pending_len + 2 >= TCP_BUF_SZ)
+	return PJ_ETOOMANY;
+
+    p = conn->tx_pending + conn->tx_pending_len;
+    pkt_size = TCP_BUF_SZ - conn->tx_pending_len - 2;
+    name = pj_str(q->key.name);
+    status = pj_dns_make_query(p + 2, &pkt_size, q->id, q->key.qtype,
+			       &name);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    p[0] = (pj_uint8_t)(pkt_size >> 8);
+    p[1] = (pj_uint8_t)(pkt_size & 0xFF);
+    conn->tx_pending_len += pkt_size + 2;
+
+    ++resolver->ns[q->tcp_ns].tcp_tx_cnt;
+
+    PJ_LOG(4,(resolver->name.ptr,
+	      "Transmitting %d bytes to NS %d over TCP: DNS %s query for %s",
+	      (int)pkt_size, q->tcp_ns,
+	      pj_dns_get_type_name(q->key.qtype), q->key.name));
+
+    return tcp_flush(conn);
+}
+
+
+
 /*
  * Put the specified DNS packet into DNS cache. This function is mainly used
  * for testing the resolver, however it can also be used to inject entries
@@ -1872,15 +2810,57 @@ PJ_DEF(pj_status_t) pj_dns_resolver_add_entry( pj_dns_resolver *resolver,
  */
 PJ_DEF(unsigned) pj_dns_resolver_get_cached_count(pj_dns_resolver *resolver)
 {
-    unsigned count;
+    unsigned i, count;
 
     PJ_ASSERT_RETURN(resolver, 0);
 
+    count = 0;
+    for (i=0; i<PJ_DNS_RESOLVER_CACHE_SHARDS; ++i) {
+	pj_lock_acquire(resolver->cache[i].lock);
+	count += resolver->cache[i].count;
+	pj_lock_release(resolver->cache[i].lock);
+    }
+
+    return count;
+}
+
+
+/*
+ * Get the resolver statistics.
+ */
+PJ_DEF(pj_status_t) pj_dns_resolver_get_stat(pj_dns_resolver *resolver,
+					     pj_dns_resolver_stat *stat)
+{
+    unsigned i;
+
+    PJ_ASSERT_RETURN(resolver && stat, PJ_EINVAL);
+
+    pj_bzero(stat, sizeof(*stat));
+
     pj_grp_lock_acquire(resolver->grp_lock);
-    count = pj_hash_count(resolver->hrescache);
+
+    stat->in_flight = pj_hash_count(resolver->hquerybyid);
+    stat->max_in_flight = resolver->max_in_flight;
+    stat->truncated_cnt = resolver->truncated_cnt;
+    stat->udp_sock_cnt = resolver->udp4_cnt + resolver->udp6_cnt;
+    stat->ns_count = resolver->ns_count;
+
+    for (i=0; i<resolver->ns_count; ++i) {
+	const struct nameserver *ns = &resolver->ns[i];
+	pj_dns_ns_stat *ns_stat = &stat->ns[i];
+
+	pj_sockaddr_cp(&ns_stat->addr, &ns->addr);
+	ns_stat->tx_cnt = ns->tx_cnt;
+	ns_stat->tcp_tx_cnt = ns->tcp_tx_cnt;
+	ns_stat->rx_cnt = ns->rx_cnt;
+	ns_stat->rtt = ns->rtt;
+	ns_stat->srtt = ns->srtt;
+	ns_stat->tcp_connected = resolver->tcp[i].connected;
+    }
+
     pj_grp_lock_release(resolver->grp_lock);
 
-    return count;
+    return PJ_SUCCESS;
 }
 
 
@@ -1891,7 +2871,7 @@ PJ_DEF(void) pj_dns_resolver_dump(pj_dns_resolver *resolver,
 				  pj_bool_t detail)
 {
 #if PJ_LOG_MAX_LEVEL >= 3
-    unsigned i;
+    unsigned i, cnt[6] = { 0, 0, 0, 0, 0, 0 };
     pj_time_val now;
 
     pj_grp_lock_acquire(resolver->grp_lock);
@@ -1913,26 +2893,55 @@ PJ_DEF(void) pj_dns_resolver_dump(pj_dns_resolver *resolver,
 		  state_names[ns->state],
 		  ns->state_expiry.sec - now.sec,
 		  PJ_TIME_VAL_MSEC(ns->rt_delay)));
+	PJ_LOG(3,(resolver->name.ptr,
+		  "     tx=%u (tcp=%u), rx=%u, srtt=%u ms, tcp %s",
+		  ns->tx_cnt, ns->tcp_tx_cnt, ns->rx_cnt, ns->srtt,
+		  (resolver->tcp[i].connected ? "connected" :
+		   (resolver->tcp[i].asock ? "connecting" : "closed"))));
     }
-
-    PJ_LOG(3,(resolver->name.ptr, "  Nb. of cached responses: %u",
-	      pj_hash_count(resolver->hrescache)));
+    PJ_LOG(3,(resolver->name.ptr, "  Nb. of UDP sockets: %u, truncated "
+	      "responses: %u", resolver->udp4_cnt + resolver->udp6_cnt,
+	      resolver->truncated_cnt));
+
+    for (i=0; i<PJ_DNS_RESOLVER_CACHE_SHARDS; ++i) {
+	struct cache_shard *shard = &resolver->cache[i];
+
+	pj_lock_acquire(shard->lock);
+	cnt[0] += shard->count;
+	cnt[1] += shard->neg_count;
+	cnt[2] += shard->hits;
+	cnt[3] += shard->misses;
+	cnt[4] += shard->evictions;
+	cnt[5] += shard->prefetches;
+	pj_lock_release(shard->lock);
+    }
+    PJ_LOG(3,(resolver->name.ptr, "  Nb. of cached responses: %u "
+	      "(%u negative)", cnt[0], cnt[1]));
+    PJ_LOG(3,(resolver->name.ptr, "  Cache hits: %u, misses: %u, "
+	      "evictions: %u, prefetches: %u",
+	      cnt[2], cnt[3], cnt[4], cnt[5]));
     if (detail) {
-	pj_hash_iterator_t itbuf, *it;
-	it = pj_hash_first(resolver->hrescache, &itbuf);
-	while (it) {
+	for (i=0; i<PJ_DNS_RESOLVER_CACHE_SHARDS; ++i) {
+	    struct cache_shard *shard = &resolver->cache[i];
 	    struct cached_res *cache;
-	    cache = (struct cached_res*)pj_hash_this(resolver->hrescache, it);
-	    PJ_LOG(3,(resolver->name.ptr, 
-		      "   Type %s: %s",
-		      pj_dns_get_type_name(cache->key.qtype), 
-		      cache->key.name));
-	    it = pj_hash_next(resolver->hrescache, it);
+
+	    pj_lock_acquire(shard->lock);
+	    cache = shard->lru.next;
+	    while (cache != (struct cached_res*)&shard->lru) {
+		PJ_LOG(3,(resolver->name.ptr, 
+			  "   Type %s: %s",
+			  pj_dns_get_type_name(cache->key.qtype), 
+			  cache->key.name));
+		cache = cache->next;
+	    }
+	    pj_lock_release(shard->lock);
 	}
     }
-    PJ_LOG(3,(resolver->name.ptr, "  Nb. of pending queries: %u (%u)",
+    PJ_LOG(3,(resolver->name.ptr, "  Nb. of pending queries: %u (%u), "
+	      "peak: %u",
 	      pj_hash_count(resolver->hquerybyid),
-	      pj_hash_count(resolver->hquerybyres)));
+	      pj_hash_count(resolver->hquerybyres),
+	      resolver->max_in_flight));
     if (detail) {
 	pj_hash_iterator_t itbuf, *it;
 	it = pj_hash_first(resolver->hquerybyid, &itbuf);
@@ -105,7 +105,16 @@ A million repetitions of "a"
 #undef SHA1HANDSOFF
 
 
-static void SHA1_Transform(pj_uint32_t state[5], pj_uint8_t buffer[64]);
+/* SHA1 block function: hash the specified number of 64-byte blocks */
+typedef void (*sha1_blocks_func)(pj_uint32_t state[5],
+				 const pj_uint8_t *data,
+				 pj_size_t blocks);
+
+static void SHA1Transform(pj_uint32_t state[5], pj_uint8_t buffer[64]);
+static void sha1_select_impl(void);
+
+static sha1_blocks_func sha1_blocks;
+static const char *sha1_impl_name;
 
 #define rol(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
 
@@ -131,7 +140,7 @@ static void SHA1_Transform(pj_uint32_t state[5], pj_uint8_t buffer[64]);
 
 
 /* Hash a single 512-bit block. This is the core of the algorithm. */
-static void SHA1_Transform(pj_uint32_t state[5], pj_uint8_t buffer[64])
+static void SHA1Transform(pj_uint32_t state[5], pj_uint8_t buffer[64])
 {
     pj_uint32_t a, b, c, d, e;
     typedef union {
@@ -189,9 +198,274 @@ static void SHA1_Transform(pj_uint32_t state[5], pj_uint8_t buffer[64])
 }
 
 
+static void sha1_blocks_c(pj_uint32_t state[5], const pj_uint8_t *data,
+			  pj_size_t blocks)
+{
+    pj_uint8_t tmp[64];
+
+    /* SHA1Transform() modifies the buffer */
+    for (; blocks; --blocks, data += 64) {
+	pj_memcpy(tmp, data, 64);
+	SHA1Transform(state, tmp);
+    }
+}
+
+
+#if defined(PJ_CRYPTO_HAS_HW_ACCEL) && PJ_CRYPTO_HAS_HW_ACCEL != 0 && \
+    defined(PJ_IS_LITTLE_ENDIAN) && PJ_IS_LITTLE_ENDIAN != 0
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+/*
+ * x86 SHA extensions (SHA-NI), the CPU support is detected at run time.
+ */
+#   define SHA1_HAS_SHANI   1
+#   include <cpuid.h>
+#   include <immintrin.h>
+#   define SHA1_SHANI_FUNC  __attribute__((target("sha,sse4.1,ssse3")))
+
+static pj_bool_t sha1_cpu_has_shani(void)
+{
+    unsigned a, b, c, d;
+
+    if (!__get_cpuid(1, &a, &b, &c, &d) ||
+	(c & (bit_SSSE3 | bit_SSE4_1)) != (bit_SSSE3 | bit_SSE4_1))
+    {
+	return PJ_FALSE;
+    }
+    if (__get_cpuid_max(0, NULL) < 7)
+	return PJ_FALSE;
+
+    __cpuid_count(7, 0, a, b, c, d);
+    return (b & (1 << 29)) != 0;
+}
+
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#   define SHA1_HAS_SHANI   1
+#   include <intrin.h>
+#   include <immintrin.h>
+#   define SHA1_SHANI_FUNC
+
+static pj_bool_t sha1_cpu_has_shani(void)
+{
+    int info[4];
+
+    __cpuid(info, 1);
+    if ((info[2] & ((1 << 9) | (1 << 19))) != ((1 << 9) | (1 << 19)))
+	return PJ_FALSE;
+
+    __cpuid(info, 0);
+    if (info[0] < 7)
+	return PJ_FALSE;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 29)) != 0;
+}
+
+#elif defined(__aarch64__) && \
+      (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2))
+/*
+ * ARMv8 Cryptographic Extension, enabled when the compiler targets it.
+ */
+#   define SHA1_HAS_ARMV8   1
+#   include <arm_neon.h>
+#endif
+
+
+#if defined(SHA1_HAS_SHANI)
+
+/* Four rounds, g is the round group (0-19). The message schedule is kept
+ * in four registers, w[g&3] holds W[4g..4g+3].
+ */
+#define SHANI_ROUNDS(g)							\
+    if (g >= 4) {							\
+	w[(g)&3] = _mm_sha1msg2_epu32(					\
+			_mm_xor_si128(_mm_sha1msg1_epu32(w[(g)&3],	\
+							 w[((g)+1)&3]), \
+				      w[((g)+2)&3]),			\
+			w[((g)+3)&3]);					\
+    }									\
+    e = (g == 0) ? _mm_add_epi32(e0, w[0]) :				\
+		   _mm_sha1nexte_epu32(prev, w[(g)&3]);			\
+    prev = abcd;							\
+    abcd = _mm_sha1rnds4_epu32(abcd, e, (g)/5)
+
+SHA1_SHANI_FUNC
+static void sha1_blocks_shani(pj_uint32_t state[5], const pj_uint8_t *data,
+			      pj_size_t blocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607LL,
+					0x08090a0b0c0d0e0fLL);
+    __m128i abcd, abcd_save, e0, e0_save, e, prev, w[4];
+
+    abcd = _mm_loadu_si128((const __m128i*)state);
+    abcd = _mm_shuffle_epi32(abcd, 0x1B);
+    e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+
+    for (; blocks; --blocks, data += 64) {
+	abcd_save = abcd;
+	e0_save = e0;
+
+	w[0] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), mask);
+	w[1] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data+16)),
+				mask);
+	w[2] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data+32)),
+				mask);
+	w[3] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data+48)),
+				mask);
+
+	SHANI_ROUNDS(0);  SHANI_ROUNDS(1);  SHANI_ROUNDS(2);  SHANI_ROUNDS(3);
+	SHANI_ROUNDS(4);  SHANI_ROUNDS(5);  SHANI_ROUNDS(6);  SHANI_ROUNDS(7);
+	SHANI_ROUNDS(8);  SHANI_ROUNDS(9);  SHANI_ROUNDS(10); SHANI_ROUNDS(11);
+	SHANI_ROUNDS(12); SHANI_ROUNDS(13); SHANI_ROUNDS(14); SHANI_ROUNDS(15);
+	SHANI_ROUNDS(16); SHANI_ROUNDS(17); SHANI_ROUNDS(18); SHANI_ROUNDS(19);
+
+	e0 = _mm_sha1nexte_epu32(prev, e0_save);
+	abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    abcd = _mm_shuffle_epi32(abcd, 0x1B);
+    _mm_storeu_si128((__m128i*)state, abcd);
+    state[4] = (pj_uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+#undef SHANI_ROUNDS
+
+#elif defined(SHA1_HAS_ARMV8)
+
+/* Four rounds, g is the round group (0-19), see SHANI_ROUNDS() */
+#define ARMV8_ROUNDS(g, op, k)						\
+    if (g >= 4) {							\
+	w[(g)&3] = vsha1su1q_u32(vsha1su0q_u32(w[(g)&3], w[((g)+1)&3],	\
+					       w[((g)+2)&3]),		\
+				 w[((g)+3)&3]);				\
+    }									\
+    e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));				\
+    abcd = op(abcd, e, vaddq_u32(w[(g)&3], vdupq_n_u32(k)));		\
+    e = e1
+
+static void sha1_blocks_armv8(pj_uint32_t state[5], const pj_uint8_t *data,
+			      pj_size_t blocks)
+{
+    uint32x4_t abcd, abcd_save, w[4];
+    uint32_t e, e1, e_save;
+    unsigned i;
+
+    abcd = vld1q_u32(state);
+    e = state[4];
+
+    for (; blocks; --blocks, data += 64) {
+	abcd_save = abcd;
+	e_save = e;
+
+	for (i = 0; i < 4; ++i) {
+	    w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i*16)));
+	}
+
+	ARMV8_ROUNDS(0, vsha1cq_u32, 0x5A827999);
+	ARMV8_ROUNDS(1, vsha1cq_u32, 0x5A827999);
+	ARMV8_ROUNDS(2, vsha1cq_u32, 0x5A827999);
+	ARMV8_ROUNDS(3, vsha1cq_u32, 0x5A827999);
+	ARMV8_ROUNDS(4, vsha1cq_u32, 0x5A827999);
+	ARMV8_ROUNDS(5, vsha1pq_u32, 0x6ED9EBA1);
+	ARMV8_ROUNDS(6, vsha1pq_u32, 0x6ED9EBA1);
+	ARMV8_ROUNDS(7, vsha1pq_u32, 0x6ED9EBA1);
+	ARMV8_ROUNDS(8, vsha1pq_u32, 0x6ED9EBA1);
+	ARMV8_ROUNDS(9, vsha1pq_u32, 0x6ED9EBA1);
+	ARMV8_ROUNDS(10, vsha1mq_u32, 0x8F1BBCDC);
+	ARMV8_ROUNDS(11, vsha1mq_u32, 0x8F1BBCDC);
+	ARMV8_ROUNDS(12, vsha1mq_u32, 0x8F1BBCDC);
+	ARMV8_ROUNDS(13, vsha1mq_u32, 0x8F1BBCDC);
+	ARMV8_ROUNDS(14, vsha1mq_u32, 0x8F1BBCDC);
+	ARMV8_ROUNDS(15, vsha1pq_u32, 0xCA62C1D6);
+	ARMV8_ROUNDS(16, vsha1pq_u32, 0xCA62C1D6);
+	ARMV8_ROUNDS(17, vsha1pq_u32, 0xCA62C1D6);
+	ARMV8_ROUNDS(18, vsha1pq_u32, 0xCA62C1D6);
+	ARMV8_ROUNDS(19, vsha1pq_u32, 0xCA62C1D6);
+
+	abcd = vaddq_u32(abcd, abcd_save);
+	e += e_save;
+    }
+
+    vst1q_u32(state, abcd);
+    state[4] = e;
+}
+
+#undef ARMV8_ROUNDS
+
+#endif	/* SHA1_HAS_ARMV8 */
+
+#endif	/* PJ_CRYPTO_HAS_HW_ACCEL */
+
+
+#if defined(PJ_CRYPTO_HAS_OPENSSL) && PJ_CRYPTO_HAS_OPENSSL != 0
+/*
+ * OpenSSL libcrypto block function, which has its own assembly (and
+ * CPU dispatch) for most platforms.
+ */
+#define OPENSSL_SUPPRESS_DEPRECATED
+#include <openssl/sha.h>
+
+static void sha1_blocks_openssl(pj_uint32_t state[5], const pj_uint8_t *data,
+				pj_size_t blocks)
+{
+    SHA_CTX c;
+
+    c.h0 = state[0]; c.h1 = state[1]; c.h2 = state[2];
+    c.h3 = state[3]; c.h4 = state[4];
+
+    for (; blocks; --blocks, data += 64)
+	SHA1_Transform(&c, data);
+
+    state[0] = c.h0; state[1] = c.h1; state[2] = c.h2;
+    state[3] = c.h3; state[4] = c.h4;
+}
+#endif	/* PJ_CRYPTO_HAS_OPENSSL */
+
+
+/* Select the fastest implementation available */
+static void sha1_select_impl(void)
+{
+#if defined(SHA1_HAS_SHANI)
+    if (sha1_cpu_has_shani()) {
+	sha1_impl_name = "SHA-NI";
+	sha1_blocks = &sha1_blocks_shani;
+	return;
+    }
+#elif defined(SHA1_HAS_ARMV8)
+    sha1_impl_name = "ARMv8";
+    sha1_blocks = &sha1_blocks_armv8;
+    return;
+#endif
+
+#if defined(PJ_CRYPTO_HAS_OPENSSL) && PJ_CRYPTO_HAS_OPENSSL != 0
+    sha1_impl_name = "OpenSSL";
+    sha1_blocks = &sha1_blocks_openssl;
+#else
+    sha1_impl_name = "C";
+    sha1_blocks = &sha1_blocks_c;
+#endif
+}
+
+
+PJ_DEF(const char*) pj_sha1_set_accel(pj_bool_t enable)
+{
+    if (enable) {
+	sha1_select_impl();
+    } else {
+	sha1_impl_name = "C";
+	sha1_blocks = &sha1_blocks_c;
+    }
+    return sha1_impl_name;
+}
+
+
 /* SHA1Init - Initialize new context */
 PJ_DEF(void) pj_sha1_init(pj_sha1_context* context)
 {
+    if (sha1_blocks == NULL)
+	sha1_select_impl();
+
     /* SHA1 initialization constants */
     context->state[0] = 0x67452301;
     context->state[1] = 0xEFCDAB89;
@@ -213,13 +487,15 @@ PJ_DEF(void) pj_sha1_update(pj_sha1_context* context,
 	context->count[1]++;
     context->count[1] += ((pj_uint32_t)len >> 29);
     if ((j + len) > 63) {
+	pj_size_t blocks;
+
         pj_memcpy(&context->buffer[j], data, (i = 64-j));
-        SHA1_Transform(context->state, context->buffer);
-        for ( ; i + 63 < len; i += 64) {
-	    pj_uint8_t tmp[64];
-	    pj_memcpy(tmp, data + i, 64);
-            SHA1_Transform(context->state, tmp);
-        }
+	(*sha1_blocks)(context->state, context->buffer, 1);
+	blocks = (len - i) / 64;
+	if (blocks) {
+	    (*sha1_blocks)(context->state, data + i, blocks);
+	    i += blocks * 64;
+	}
         j = 0;
     }
     else i = 0;
@@ -232,18 +508,25 @@ PJ_DEF(void) pj_sha1_update(pj_sha1_context* context,
 PJ_DEF(void) pj_sha1_final(pj_sha1_context* context, 
 			   pj_uint8_t digest[PJ_SHA1_DIGEST_SIZE])
 {
-    pj_uint32_t i;
+    pj_uint32_t i, j;
     pj_uint8_t  finalcount[8];
 
     for (i = 0; i < 8; i++) {
         finalcount[i] = (unsigned char)((context->count[(i >= 4 ? 0 : 1)]
          >> ((3-(i & 3)) * 8) ) & 255);  /* Endian independent */
     }
-    pj_sha1_update(context, (pj_uint8_t *)"\200", 1);
-    while ((context->count[0] & 504) != 448) {
-        pj_sha1_update(context, (pj_uint8_t *)"\0", 1);
+
+    /* Pad in place: 0x80, zeros up to 56 mod 64, then the bit count */
+    j = (context->count[0] >> 3) & 63;
+    context->buffer[j++] = 0x80;
+    if (j > 56) {
+	pj_bzero(&context->buffer[j], 64 - j);
+	(*sha1_blocks)(context->state, context->buffer, 1);
+	j = 0;
     }
-    pj_sha1_update(context, finalcount, 8);  /* Should cause a SHA1_Transform() */
+    pj_bzero(&context->buffer[j], 56 - j);
+    pj_memcpy(&context->buffer[56], finalcount, 8);
+    (*sha1_blocks)(context->state, context->buffer, 1);
     for (i = 0; i < PJ_SHA1_DIGEST_SIZE; i++) {
         digest[i] = (pj_uint8_t)
          ((context->state[i>>2] >> ((3-(i & 3)) * 8) ) & 255);
@@ -257,7 +540,7 @@ PJ_DEF(void) pj_sha1_final(pj_sha1_context* context,
     pj_memset(finalcount, 0, 8);	/* SWR */
 
 #ifdef SHA1HANDSOFF  /* make SHA1Transform overwrite its own static vars */
-    SHA1_Transform(context->state, context->buffer);
+    SHA1Transform(context->state, context->buffer);
 #endif
 }
 
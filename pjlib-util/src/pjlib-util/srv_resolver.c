@@ -83,8 +83,15 @@ struct pj_dns_srv_async_query
     /* Number of hosts in SRV records that the IP address has been resolved */
     unsigned		     host_resolved;
 
+    /* Lowest TTL of the records used, or NO_TTL */
+    pj_uint32_t		     ttl;
+
 };
 
+#define NO_TTL		    0xFFFFFFFFUL
+
+#define UPDATE_TTL(q, rr)   if ((rr)->ttl < (q)->ttl) (q)->ttl = (rr)->ttl
+
 
 /* Async resolver callback, forward decl. */
 static void dns_callback(void *user_data,
@@ -138,6 +145,7 @@ PJ_DEF(pj_status_t) pj_dns_srv_resolve( const pj_str_t *domain_name,
     query_job->domain_part.ptr = target_name.ptr + len;
     query_job->domain_part.slen = target_name.slen - len;
     query_job->def_port = (pj_uint16_t)def_port;
+    query_job->ttl = NO_TTL;
 
     /* Normalize query job option PJ_DNS_SRV_RESOLVE_AAAA_ONLY */
     if (query_job->option & PJ_DNS_SRV_RESOLVE_AAAA_ONLY)
@@ -252,6 +260,7 @@ static void build_server_entries(pj_dns_srv_async_query *query_job,
 	srv->port = rr->rdata.srv.port;
 	srv->priority = rr->rdata.srv.prio;
 	srv->weight = rr->rdata.srv.weight;
+	UPDATE_TTL(query_job, rr);
 	
 	++query_job->srv_cnt;
     }
@@ -385,6 +394,8 @@ static void build_server_entries(pj_dns_srv_async_query *query_job,
 		if (query_job->srv[j].addr_cnt == 0)
 		    ++query_job->host_resolved;
 
+		UPDATE_TTL(query_job, rr);
+
 		++query_job->srv[j].addr_cnt;
 		break;
 	    }
@@ -720,6 +731,10 @@ static void dns_callback(void *user_data,
 
 	    pj_assert(rec.addr_count != 0);
 
+	    /* The answer may also contain the CNAME chain */
+	    for (i=0; i<pkt->hdr.anscount; ++i)
+		UPDATE_TTL(query_job, &pkt->ans[i]);
+
 	    /* Update CNAME alias, if present. */
 	    if (srv->cname.slen==0 && rec.alias.slen) {
 		pj_assert(rec.alias.slen <= (int)sizeof(srv->cname_buf));
@@ -798,6 +813,7 @@ static void dns_callback(void *user_data,
 	pj_dns_srv_record srv_rec;
 
 	srv_rec.count = 0;
+	srv_rec.ttl = (query_job->ttl == NO_TTL) ? 0 : query_job->ttl;
 	for (i=0; i<query_job->srv_cnt; ++i) {
 	    unsigned j;
 	    struct srv_target *srv2 = &query_job->srv[i];
@@ -181,6 +181,50 @@ PJ_DECL(pj_status_t) pj_getaddrinfo(int af, const pj_str_t *name,
 				    unsigned *count, pj_addrinfo ai[]);
 
 
+/**
+ * Callback to receive the result of #pj_getaddrinfo_async().
+ *
+ * @param user_data The user data specified in #pj_getaddrinfo_async().
+ * @param status    PJ_SUCCESS if the name was resolved, or the error
+ *		    code returned by #pj_getaddrinfo().
+ * @param count	    The number of address info in \a ai, zero on error.
+ * @param ai	    The address info. The array is only valid during the
+ *		    callback.
+ */
+typedef void pj_getaddrinfo_cb(void *user_data, pj_status_t status,
+			       unsigned count, const pj_addrinfo ai[]);
+
+/**
+ * Asynchronous version of #pj_getaddrinfo(). The blocking lookup is run
+ * by resolver threads (see #PJ_GETADDRINFO_ASYNC_THREAD_CNT), so the
+ * calling thread never blocks on name resolution. Results, including
+ * failures, are cached for #PJ_GETADDRINFO_ASYNC_CACHE_TTL and
+ * #PJ_GETADDRINFO_ASYNC_NEG_TTL seconds respectively, and concurrent
+ * queries for the same name are merged into a single lookup. At most
+ * #PJ_GETADDRINFO_ASYNC_MAX_ADDR addresses are reported.
+ *
+ * The callback is called directly from this function when the result is
+ * available immediately (address literal or cache hit), otherwise it is
+ * called later from a resolver thread. Pending queries cannot be
+ * cancelled, so the user data must remain valid until the callback is
+ * called.
+ *
+ * @param af	    The desired address family to query. Valid values
+ *		    are pj_AF_INET(), pj_AF_INET6(), or pj_AF_UNSPEC().
+ * @param name	    Descriptive name or an address string, such as host
+ *		    name.
+ * @param cb	    The callback to receive the result.
+ * @param user_data Arbitrary data to be given to the callback.
+ *
+ * @return	    PJ_SUCCESS if the callback has been called, PJ_EPENDING
+ *		    if the callback will be called later, or other error
+ *		    code, in which case the callback will not be called.
+ */
+PJ_DECL(pj_status_t) pj_getaddrinfo_async(int af, const pj_str_t *name,
+					  pj_getaddrinfo_cb *cb,
+					  void *user_data);
+
+
 
 /** @} */
 
@@ -658,6 +658,58 @@
 #  define PJ_MAX_HOSTNAME	    (128)
 #endif
 
+/**
+ * Number of resolver threads used by #pj_getaddrinfo_async() to run the
+ * blocking #pj_getaddrinfo(). If zero, or when threads are disabled, the
+ * lookup is run by the calling thread.
+ *
+ * Default: 2
+ */
+#ifndef PJ_GETADDRINFO_ASYNC_THREAD_CNT
+#   define PJ_GETADDRINFO_ASYNC_THREAD_CNT	2
+#endif
+
+/**
+ * Number of names kept in the #pj_getaddrinfo_async() result cache. This
+ * also limits the number of names being resolved at the same time.
+ *
+ * Default: 64
+ */
+#ifndef PJ_GETADDRINFO_ASYNC_CACHE_SIZE
+#   define PJ_GETADDRINFO_ASYNC_CACHE_SIZE	64
+#endif
+
+/**
+ * Maximum number of addresses kept and reported per name by
+ * #pj_getaddrinfo_async().
+ *
+ * Default: 8
+ */
+#ifndef PJ_GETADDRINFO_ASYNC_MAX_ADDR
+#   define PJ_GETADDRINFO_ASYNC_MAX_ADDR	8
+#endif
+
+/**
+ * Time to keep a successful #pj_getaddrinfo_async() result in the cache,
+ * in seconds. The system resolver doesn't report the record TTL.
+ *
+ * Default: 60
+ */
+#ifndef PJ_GETADDRINFO_ASYNC_CACHE_TTL
+#   define PJ_GETADDRINFO_ASYNC_CACHE_TTL	60
+#endif
+
+/**
+ * Time to keep a failed #pj_getaddrinfo_async() result in the cache, in
+ * seconds, so that an unresolvable name doesn't keep the resolver
+ * threads busy.
+ *
+ * Default: 5
+ */
+#ifndef PJ_GETADDRINFO_ASYNC_NEG_TTL
+#   define PJ_GETADDRINFO_ASYNC_NEG_TTL		5
+#endif
+
 /**
  * Maximum consecutive identical error for accept() operation before
  * activesock stops calling the next ioqueue accept.
@@ -1025,6 +1077,38 @@
 #endif
 
 
+/**
+ * Maximum number of SSL contexts shared by the secure sockets (OpenSSL
+ * backend only). Sockets with the same role, protocol, curves, and
+ * certificate share one context, instead of loading the certificate and
+ * keys for every connection. Sharing the context also lets accepted
+ * sockets resume the sessions and tickets issued by the listener. A
+ * certificate file that is modified gives a new context, and a context is
+ * released when the last socket using it is closed. Set to zero to create
+ * a new context for every socket.
+ *
+ * Default: 8
+ */
+#ifndef PJ_SSL_SOCK_CTX_CACHE_SIZE
+#  define PJ_SSL_SOCK_CTX_CACHE_SIZE	8
+#endif
+
+
+/**
+ * Maximum number of client sessions kept for resumption (OpenSSL backend
+ * only, and only when #PJ_SSL_SOCK_CTX_CACHE_SIZE is not zero). The last
+ * session or ticket received from each server is offered when connecting
+ * to the same server again, so that reconnections can skip the full
+ * handshake. Only sessions whose server certificate verification
+ * succeeded are kept. Set to zero to disable client session resumption.
+ *
+ * Default: 32
+ */
+#ifndef PJ_SSL_SOCK_SESS_CACHE_SIZE
+#  define PJ_SSL_SOCK_SESS_CACHE_SIZE	32
+#endif
+
+
 /**
  * Disable WSAECONNRESET error for UDP sockets on Win32 platforms. See
  * https://trac.pjsip.org/repos/ticket/1197.
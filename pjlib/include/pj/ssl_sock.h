@@ -786,9 +786,60 @@ typedef struct pj_ssl_sock_info
      */
     pj_grp_lock_t *grp_lock;
 
+    /**
+     * Describes whether the handshake resumed a previous session, using
+     * either a session ID or a session ticket, instead of performing the
+     * full handshake. This will only be set when connection is established.
+     */
+    pj_bool_t session_reused;
+
+    /**
+     * Duration of the handshake, in milliseconds. This will only be set
+     * when connection is established.
+     */
+    unsigned handshake_time;
+
 } pj_ssl_sock_info;
 
 
+/**
+ * Handshake statistics of all secure sockets, see #pj_ssl_sock_get_stat().
+ */
+typedef struct pj_ssl_sock_stat
+{
+    /**
+     * Number of successful full handshakes.
+     */
+    unsigned full_cnt;
+
+    /**
+     * Total duration of the full handshakes, in milliseconds.
+     */
+    pj_uint32_t full_time;
+
+    /**
+     * Number of successful handshakes that resumed a previous session.
+     */
+    unsigned reused_cnt;
+
+    /**
+     * Total duration of the resumed handshakes, in milliseconds.
+     */
+    pj_uint32_t reused_time;
+
+    /**
+     * Number of failed handshakes.
+     */
+    unsigned failed_cnt;
+
+    /**
+     * Duration of the longest successful handshake, in milliseconds.
+     */
+    unsigned max_time;
+
+} pj_ssl_sock_stat;
+
+
 /**
  * Definition of secure socket creation parameters.
  */
@@ -1200,6 +1251,17 @@ PJ_DECL(pj_status_t) pj_ssl_sock_get_info(pj_ssl_sock_t *ssock,
 					  pj_ssl_sock_info *info);
 
 
+/**
+ * Retrieve the handshake statistics of all secure sockets. Comparing the
+ * average duration of full and resumed handshakes shows the gain of
+ * session resumption (see #PJ_SSL_SOCK_SESS_CACHE_SIZE).
+ *
+ * @param stat		The structure to receive the statistics.
+ * @param reset		Reset the statistics after retrieving them.
+ */
+PJ_DECL(void) pj_ssl_sock_get_stat(pj_ssl_sock_stat *stat, pj_bool_t reset);
+
+
 /**
  * Starts read operation on this secure socket. This function will create
  * \a async_cnt number of buffers (the \a async_cnt parameter was given
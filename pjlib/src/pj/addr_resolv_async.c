@@ -0,0 +1,415 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/addr_resolv.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/hash.h>
+#include <pj/list.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+
+/*
+ * Asynchronous wrapper of pj_getaddrinfo().
+ *
+ * The blocking pj_getaddrinfo() is run by a small pool of resolver
+ * threads. Results (including failures) are kept in a fixed size LRU
+ * cache, and concurrent queries for the same name are coalesced into
+ * a single pj_getaddrinfo() call.
+ */
+
+#define THIS_FILE	"addr_resolv_async.c"
+
+#if !defined(PJ_HAS_THREADS) || PJ_HAS_THREADS==0
+#   undef PJ_GETADDRINFO_ASYNC_THREAD_CNT
+#   define PJ_GETADDRINFO_ASYNC_THREAD_CNT  0
+#endif
+
+/* Key is the address family index followed by the host name */
+#define MAX_KEY_LEN	(PJ_MAX_HOSTNAME + 1)
+
+/* Application waiting for a pending query */
+typedef struct ai_waiter
+{
+    PJ_DECL_LIST_MEMBER(struct ai_waiter);
+    pj_getaddrinfo_cb	*cb;
+    void		*user_data;
+} ai_waiter;
+
+/* Cache entry, which is also the pending query */
+typedef struct ai_entry
+{
+    PJ_DECL_LIST_MEMBER(struct ai_entry);   /* LRU list or job list	*/
+    pj_hash_entry_buf	 hbuf;
+    char		 key[MAX_KEY_LEN];
+    unsigned		 keylen;
+    int			 af;
+    pj_bool_t		 pending;
+    pj_time_val		 expiry;
+    pj_status_t		 status;
+    unsigned		 count;
+    pj_addrinfo		 ai[PJ_GETADDRINFO_ASYNC_MAX_ADDR];
+    ai_waiter		 waiters;
+} ai_entry;
+
+/* The resolver */
+static struct ai_resolver
+{
+    pj_caching_pool	 cp;
+    pj_pool_t		*pool;
+    pj_mutex_t		*mutex;
+    pj_hash_table_t	*hash;
+    ai_entry		 lru;	    /* Completed entries, MRU first	*/
+    ai_entry		 free_ent;  /* Unused entries			*/
+    ai_waiter		 free_wt;   /* Recycled waiters			*/
+#if PJ_GETADDRINFO_ASYNC_THREAD_CNT > 0
+    ai_entry		 jobs;	    /* Pending entries, FIFO		*/
+    pj_sem_t		*sem;
+    pj_bool_t		 quit;
+    pj_thread_t		*threads[PJ_GETADDRINFO_ASYNC_THREAD_CNT];
+#endif
+} ai_res;
+
+/* 0: not initialized, 1: initializing, 2: ready */
+static volatile int ai_res_state;
+
+
+static void ai_resolver_shutdown(void)
+{
+#if PJ_GETADDRINFO_ASYNC_THREAD_CNT > 0
+    unsigned i;
+
+    ai_res.quit = PJ_TRUE;
+    for (i=0; ai_res.sem && i<PJ_ARRAY_SIZE(ai_res.threads); ++i)
+	pj_sem_post(ai_res.sem);
+
+    for (i=0; i<PJ_ARRAY_SIZE(ai_res.threads); ++i) {
+	if (ai_res.threads[i]) {
+	    pj_thread_join(ai_res.threads[i]);
+	    pj_thread_destroy(ai_res.threads[i]);
+	}
+    }
+    if (ai_res.sem)
+	pj_sem_destroy(ai_res.sem);
+#endif
+
+    /* Pending waiters are discarded without their callback being called */
+    if (ai_res.mutex)
+	pj_mutex_destroy(ai_res.mutex);
+    pj_pool_release(ai_res.pool);
+    pj_caching_pool_destroy(&ai_res.cp);
+
+    pj_bzero(&ai_res, sizeof(ai_res));
+    ai_res_state = 0;
+}
+
+
+/* Run one query and complete its entry, then notify the waiters */
+static void ai_run_query(ai_entry *ent)
+{
+    pj_addrinfo ai[PJ_GETADDRINFO_ASYNC_MAX_ADDR];
+    ai_waiter waiters;
+    pj_str_t name;
+    unsigned count = PJ_ARRAY_SIZE(ai);
+    pj_status_t status;
+
+    pj_strset(&name, ent->key+1, ent->keylen-1);
+    status = pj_getaddrinfo(ent->af, &name, &count, ai);
+    if (status != PJ_SUCCESS)
+	count = 0;
+
+    pj_mutex_lock(ai_res.mutex);
+
+    pj_gettickcount(&ent->expiry);
+    ent->expiry.sec += (status == PJ_SUCCESS ? PJ_GETADDRINFO_ASYNC_CACHE_TTL :
+					       PJ_GETADDRINFO_ASYNC_NEG_TTL);
+    ent->status = status;
+    ent->count = count;
+    pj_memcpy(ent->ai, ai, count * sizeof(pj_addrinfo));
+    ent->pending = PJ_FALSE;
+    pj_list_push_front(&ai_res.lru, ent);
+
+    /* Take over the waiter list so callbacks run without the lock */
+    pj_list_init(&waiters);
+    pj_list_merge_last(&waiters, &ent->waiters);
+
+    pj_mutex_unlock(ai_res.mutex);
+
+    while (!pj_list_empty(&waiters)) {
+	ai_waiter *w = waiters.next;
+
+	pj_list_erase(w);
+	(*w->cb)(w->user_data, status, count, ai);
+
+	pj_mutex_lock(ai_res.mutex);
+	pj_list_push_back(&ai_res.free_wt, w);
+	pj_mutex_unlock(ai_res.mutex);
+    }
+}
+
+
+#if PJ_GETADDRINFO_ASYNC_THREAD_CNT > 0
+static int ai_worker_thread(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+
+    for (;;) {
+	ai_entry *ent = NULL;
+
+	pj_sem_wait(ai_res.sem);
+	if (ai_res.quit)
+	    break;
+
+	pj_mutex_lock(ai_res.mutex);
+	if (!pj_list_empty(&ai_res.jobs)) {
+	    ent = ai_res.jobs.next;
+	    pj_list_erase(ent);
+	}
+	pj_mutex_unlock(ai_res.mutex);
+
+	if (ent)
+	    ai_run_query(ent);
+    }
+
+    return 0;
+}
+#endif
+
+
+static pj_status_t ai_resolver_init(void)
+{
+    unsigned i;
+    pj_status_t status;
+
+    pj_caching_pool_init(&ai_res.cp, NULL, 0);
+    ai_res.pool = pj_pool_create(&ai_res.cp.factory, "getaddrinfo",
+				 4000, 4000, NULL);
+    if (!ai_res.pool) {
+	pj_caching_pool_destroy(&ai_res.cp);
+	return PJ_ENOMEM;
+    }
+
+    status = pj_mutex_create_simple(ai_res.pool, "getaddrinfo",
+				    &ai_res.mutex);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    ai_res.hash = pj_hash_create(ai_res.pool,
+				 PJ_GETADDRINFO_ASYNC_CACHE_SIZE);
+    pj_list_init(&ai_res.lru);
+    pj_list_init(&ai_res.free_ent);
+    pj_list_init(&ai_res.free_wt);
+
+    for (i=0; i<PJ_GETADDRINFO_ASYNC_CACHE_SIZE; ++i) {
+	ai_entry *ent = PJ_POOL_ZALLOC_T(ai_res.pool, ai_entry);
+	pj_list_init(&ent->waiters);
+	pj_list_push_back(&ai_res.free_ent, ent);
+    }
+
+#if PJ_GETADDRINFO_ASYNC_THREAD_CNT > 0
+    pj_list_init(&ai_res.jobs);
+
+    status = pj_sem_create(ai_res.pool, "getaddrinfo", 0,
+			   PJ_GETADDRINFO_ASYNC_CACHE_SIZE +
+			   PJ_GETADDRINFO_ASYNC_THREAD_CNT, &ai_res.sem);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    for (i=0; i<PJ_ARRAY_SIZE(ai_res.threads); ++i) {
+	status = pj_thread_create(ai_res.pool, "getaddrinfo%p",
+				  &ai_worker_thread, NULL, 0, 0,
+				  &ai_res.threads[i]);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+    }
+#endif
+
+    pj_atexit(&ai_resolver_shutdown);
+    return PJ_SUCCESS;
+
+on_error:
+    PJ_PERROR(4,(THIS_FILE, status, "Error creating getaddrinfo resolver"));
+    ai_resolver_shutdown();
+    return status;
+}
+
+
+/* Find the entry for the key, or reuse an expired or the least recently
+ * used entry. Must be called with the mutex held.
+ */
+static ai_entry *ai_get_entry(const char *key, unsigned keylen,
+			      pj_uint32_t hval, pj_bool_t *p_found)
+{
+    ai_entry *ent;
+
+    ent = (ai_entry*)pj_hash_get_lower(ai_res.hash, key, keylen, &hval);
+    if (ent) {
+	*p_found = PJ_TRUE;
+	return ent;
+    }
+
+    *p_found = PJ_FALSE;
+    if (!pj_list_empty(&ai_res.free_ent)) {
+	ent = ai_res.free_ent.next;
+    } else if (!pj_list_empty(&ai_res.lru)) {
+	ent = ai_res.lru.prev;
+	pj_hash_set_np_lower(ai_res.hash, ent->key, ent->keylen, 0,
+			     ent->hbuf, NULL);
+    } else {
+	/* Every entry is a pending query */
+	return NULL;
+    }
+    pj_list_erase(ent);
+
+    pj_memcpy(ent->key, key, keylen);
+    ent->keylen = keylen;
+    pj_hash_set_np_lower(ai_res.hash, ent->key, ent->keylen, hval,
+			 ent->hbuf, ent);
+    return ent;
+}
+
+
+PJ_DEF(pj_status_t) pj_getaddrinfo_async(int af, const pj_str_t *name,
+					 pj_getaddrinfo_cb *cb,
+					 void *user_data)
+{
+    char key[MAX_KEY_LEN];
+    unsigned keylen;
+    pj_uint32_t hval = 0;
+    pj_in6_addr dummy;
+    ai_entry *ent;
+    ai_waiter *w;
+    pj_bool_t found;
+    pj_time_val now;
+
+    PJ_ASSERT_RETURN(name && cb, PJ_EINVAL);
+    PJ_ASSERT_RETURN(af==PJ_AF_INET || af==PJ_AF_INET6 ||
+		     af==PJ_AF_UNSPEC, PJ_EAFNOTSUP);
+    PJ_ASSERT_RETURN(name->slen > 0, PJ_EINVAL);
+
+    if (name->slen >= PJ_MAX_HOSTNAME)
+	return PJ_ENAMETOOLONG;
+
+    /* Address literals never block, no need to go thru the threads */
+    if (pj_inet_pton(PJ_AF_INET, name, &dummy) == PJ_SUCCESS ||
+	pj_inet_pton(PJ_AF_INET6, name, &dummy) == PJ_SUCCESS)
+    {
+	pj_addrinfo ai[PJ_GETADDRINFO_ASYNC_MAX_ADDR];
+	unsigned count = PJ_ARRAY_SIZE(ai);
+	pj_status_t status;
+
+	status = pj_getaddrinfo(af, name, &count, ai);
+	(*cb)(user_data, status, status==PJ_SUCCESS? count : 0, ai);
+	return PJ_SUCCESS;
+    }
+
+    /* Lazy initialization, pj_enter_critical_section() must not be held
+     * while allocating memory so it only guards the state.
+     */
+    if (ai_res_state != 2) {
+	pj_bool_t init = PJ_FALSE;
+
+	pj_enter_critical_section();
+	if (ai_res_state == 0) {
+	    ai_res_state = 1;
+	    init = PJ_TRUE;
+	}
+	pj_leave_critical_section();
+
+	if (init) {
+	    pj_status_t status = ai_resolver_init();
+	    if (status != PJ_SUCCESS)
+		return status;
+	    ai_res_state = 2;
+	} else {
+	    while (ai_res_state == 1)
+		pj_thread_sleep(1);
+	    if (ai_res_state != 2)
+		return PJ_EINVALIDOP;
+	}
+    }
+
+    key[0] = (char)(af==PJ_AF_INET ? '4' : (af==PJ_AF_INET6 ? '6' : '0'));
+    pj_memcpy(key+1, name->ptr, name->slen);
+    keylen = (unsigned)name->slen + 1;
+
+    pj_gettickcount(&now);
+
+    pj_mutex_lock(ai_res.mutex);
+
+    ent = ai_get_entry(key, keylen, hval, &found);
+    if (!ent) {
+	pj_mutex_unlock(ai_res.mutex);
+	return PJ_ETOOMANY;
+    }
+
+    if (found && !ent->pending && PJ_TIME_VAL_GT(ent->expiry, now)) {
+	/* Cache hit, report synchronously */
+	pj_addrinfo ai[PJ_GETADDRINFO_ASYNC_MAX_ADDR];
+	unsigned count = ent->count;
+	pj_status_t status = ent->status;
+
+	pj_memcpy(ai, ent->ai, count * sizeof(pj_addrinfo));
+	pj_list_erase(ent);
+	pj_list_push_front(&ai_res.lru, ent);
+	pj_mutex_unlock(ai_res.mutex);
+
+	(*cb)(user_data, status, count, ai);
+	return PJ_SUCCESS;
+    }
+
+    /* Register the waiter */
+    if (!pj_list_empty(&ai_res.free_wt)) {
+	w = ai_res.free_wt.next;
+	pj_list_erase(w);
+    } else {
+	w = PJ_POOL_ZALLOC_T(ai_res.pool, ai_waiter);
+    }
+    w->cb = cb;
+    w->user_data = user_data;
+    pj_list_push_back(&ent->waiters, w);
+
+    if (ent->pending) {
+	/* Coalesced with the query already in progress */
+	pj_mutex_unlock(ai_res.mutex);
+	return PJ_EPENDING;
+    }
+
+    /* Expired entry is refreshed */
+    if (found)
+	pj_list_erase(ent);
+
+    ent->af = af;
+    ent->pending = PJ_TRUE;
+
+#if PJ_GETADDRINFO_ASYNC_THREAD_CNT > 0
+    pj_list_push_back(&ai_res.jobs, ent);
+    pj_mutex_unlock(ai_res.mutex);
+    pj_sem_post(ai_res.sem);
+
+    return PJ_EPENDING;
+#else
+    pj_mutex_unlock(ai_res.mutex);
+    ai_run_query(ent);
+
+    return PJ_SUCCESS;
+#endif
+}
@@ -204,6 +204,39 @@ static void ssl_close_sockets(pj_ssl_sock_t *ssock)
         pj_sock_close(sock);
 }
 
+/* Handshake statistics of all secure sockets */
+static pj_ssl_sock_stat ssl_stat;
+
+/* Update handshake statistics */
+static void update_handshake_stat(pj_ssl_sock_t *ssock, pj_status_t status)
+{
+    pj_timestamp now;
+
+    /* Handshake not started, e.g: TCP connection failure */
+    if (ssock->handshake_start.u64 == 0)
+	return;
+
+    pj_get_timestamp(&now);
+    ssock->handshake_time = pj_elapsed_msec(&ssock->handshake_start, &now);
+    ssock->handshake_start.u64 = 0;
+
+    pj_enter_critical_section();
+    if (status != PJ_SUCCESS) {
+	ssl_stat.failed_cnt++;
+    } else {
+	if (ssock->session_reused) {
+	    ssl_stat.reused_cnt++;
+	    ssl_stat.reused_time += ssock->handshake_time;
+	} else {
+	    ssl_stat.full_cnt++;
+	    ssl_stat.full_time += ssock->handshake_time;
+	}
+	if (ssock->handshake_time > ssl_stat.max_time)
+	    ssl_stat.max_time = ssock->handshake_time;
+    }
+    pj_leave_critical_section();
+}
+
 /* When handshake completed:
  * - notify application
  * - if handshake failed, reset SSL state
@@ -218,6 +251,8 @@ static pj_bool_t on_handshake_complete(pj_ssl_sock_t *ssock,
 	ssock->timer.id = TIMER_NONE;
     }
 
+    update_handshake_stat(ssock, status);
+
     /* Update certificates info on successful handshake */
     if (status == PJ_SUCCESS)
 	ssl_update_certs_info(ssock);
@@ -1001,6 +1036,7 @@ static pj_bool_t asock_on_accept_complete (pj_activesock_t *asock,
 
     /* Start SSL handshake */
     ssock->ssl_state = SSL_STATE_HANDSHAKING;
+    pj_get_timestamp(&ssock->handshake_start);
     ssl_set_state(ssock, PJ_TRUE);
     status = ssl_do_handshake(ssock);
 
@@ -1100,6 +1136,7 @@ static pj_bool_t asock_on_connect_complete (pj_activesock_t *asock,
 
     /* Start SSL handshake */
     ssock->ssl_state = SSL_STATE_HANDSHAKING;
+    pj_get_timestamp(&ssock->handshake_start);
     ssl_set_state(ssock, PJ_FALSE);
 
     status = ssl_do_handshake(ssock);
@@ -1416,6 +1453,10 @@ PJ_DEF(pj_status_t) pj_ssl_sock_get_info (pj_ssl_sock_t *ssock,
 
 	/* Verification status */
 	info->verify_status = ssock->verify_status;
+
+	/* Handshake info */
+	info->session_reused = ssock->session_reused;
+	info->handshake_time = ssock->handshake_time;
     }
 
     /* Last known SSL error code */
@@ -1428,6 +1469,20 @@ PJ_DEF(pj_status_t) pj_ssl_sock_get_info (pj_ssl_sock_t *ssock,
 }
 
 
+/*
+ * Retrieve the handshake statistics of all secure sockets.
+ */
+PJ_DEF(void) pj_ssl_sock_get_stat(pj_ssl_sock_stat *stat, pj_bool_t reset)
+{
+    pj_enter_critical_section();
+    if (stat)
+	pj_memcpy(stat, &ssl_stat, sizeof(ssl_stat));
+    if (reset)
+	pj_bzero(&ssl_stat, sizeof(ssl_stat));
+    pj_leave_critical_section();
+}
+
+
 /*
  * Starts read operation on this secure socket.
  */
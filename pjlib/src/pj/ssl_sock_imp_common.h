@@ -114,6 +114,10 @@ struct pj_ssl_sock_t
     pj_timer_entry	  timer;
     pj_status_t		  verify_status;
 
+    pj_timestamp	  handshake_start;
+    unsigned		  handshake_time; /* handshake duration, in msec    */
+    pj_bool_t		  session_reused; /* set by backend on handshake    */
+
     unsigned long	  last_err;
 
     pj_sock_t		  sock;
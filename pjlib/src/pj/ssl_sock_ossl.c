@@ -53,6 +53,7 @@
 #   include <openssl/dh.h>
 #endif
 
+#include <openssl/evp.h>
 #include <openssl/rand.h>
 #include <openssl/opensslconf.h>
 #include <openssl/opensslv.h>
@@ -136,6 +137,18 @@ static unsigned get_nid_from_cid(unsigned cid)
 #endif
 
 
+/* Shared SSL contexts and client sessions need the reference counting
+ * and locking API of OpenSSL 1.1.0.
+ */
+#if PJ_SSL_SOCK_CTX_CACHE_SIZE > 0 && !USING_LIBRESSL && \
+    OPENSSL_VERSION_NUMBER >= 0x10100000L
+#  define HAS_CTX_CACHE		    1
+#  define CTX_KEY_LEN		    32	/* SHA-256 */
+#else
+#  define HAS_CTX_CACHE		    0
+#endif
+
+
 #ifdef _MSC_VER
 #  if OPENSSL_VERSION_NUMBER >= 0x10100000L
 #    pragma comment(lib, "libcrypto")
@@ -178,6 +191,13 @@ typedef struct ossl_sock_t
     SSL			 *ossl_ssl;
     BIO			 *ossl_rbio;
     BIO			 *ossl_wbio;
+
+#if HAS_CTX_CACHE
+    pj_uint8_t		  ctx_key[CTX_KEY_LEN];	/* key of shared context    */
+    pj_bool_t		  ctx_reused;		/* context is from cache    */
+    pj_bool_t		  ctx_shared;		/* counted as cache user    */
+    char		  sess_peer[PJ_MAX_HOSTNAME]; /* client session key */
+#endif
 } ossl_sock_t;
 
 /**
@@ -719,6 +739,350 @@ static pj_status_t set_sigalgs(pj_ssl_sock_t *ssock);
 static void set_entropy(pj_ssl_sock_t *ssock);
 
 
+#if HAS_CTX_CACHE
+
+/* Cache of shared SSL contexts and of client sessions for resumption */
+static struct ctx_cache_t
+{
+    CRYPTO_RWLOCK	*lock;
+    pj_uint32_t		 clock;		/* LRU clock			    */
+
+    struct {
+	pj_uint8_t	 key[CTX_KEY_LEN];
+	SSL_CTX		*ctx;
+	unsigned	 users;		/* Sockets using the context	    */
+	pj_uint32_t	 last_use;
+    } ctx[PJ_SSL_SOCK_CTX_CACHE_SIZE];
+
+#if PJ_SSL_SOCK_SESS_CACHE_SIZE > 0
+    struct {
+	pj_uint8_t	 key[CTX_KEY_LEN];
+	char		 peer[PJ_MAX_HOSTNAME];
+	SSL_SESSION	*sess;
+	pj_uint32_t	 last_use;
+    } sess[PJ_SSL_SOCK_SESS_CACHE_SIZE];
+#endif
+} ctx_cache;
+
+
+/* Release the cache on library shutdown. The sockets still hold their own
+ * references to the shared contexts.
+ */
+static void ctx_cache_destroy(void)
+{
+    unsigned i;
+
+    for (i = 0; i < PJ_ARRAY_SIZE(ctx_cache.ctx); ++i) {
+	if (ctx_cache.ctx[i].ctx)
+	    SSL_CTX_free(ctx_cache.ctx[i].ctx);
+    }
+#if PJ_SSL_SOCK_SESS_CACHE_SIZE > 0
+    for (i = 0; i < PJ_ARRAY_SIZE(ctx_cache.sess); ++i) {
+	if (ctx_cache.sess[i].sess)
+	    SSL_SESSION_free(ctx_cache.sess[i].sess);
+    }
+#endif
+    if (ctx_cache.lock)
+	CRYPTO_THREAD_lock_free(ctx_cache.lock);
+
+    pj_bzero(&ctx_cache, sizeof(ctx_cache));
+}
+
+static pj_status_t ctx_cache_init(void)
+{
+    pj_status_t status = PJ_SUCCESS;
+
+    pj_enter_critical_section();
+    if (ctx_cache.lock == NULL) {
+	ctx_cache.lock = CRYPTO_THREAD_lock_new();
+	if (ctx_cache.lock)
+	    pj_atexit(&ctx_cache_destroy);
+	else
+	    status = PJ_ENOMEM;
+    }
+    pj_leave_critical_section();
+
+    return status;
+}
+
+static void ctx_key_update(EVP_MD_CTX *md, const void *data, pj_size_t len)
+{
+    pj_uint32_t len32 = (pj_uint32_t)len;
+
+    /* Prefix the length to keep the fields apart */
+    EVP_DigestUpdate(md, &len32, sizeof(len32));
+    if (len)
+	EVP_DigestUpdate(md, data, len);
+}
+
+/* Hash the file or directory name with its size and times, so that
+ * a certificate renewed at the same path gets a new context.
+ */
+static void ctx_key_update_file(EVP_MD_CTX *md, const pj_str_t *path)
+{
+    char name[PJ_MAXPATH];
+    pj_file_stat st;
+
+    ctx_key_update(md, path->ptr, path->slen);
+    if (path->slen == 0)
+	return;
+
+    pj_bzero(&st, sizeof(st));
+    if (path->slen < (pj_ssize_t)sizeof(name)) {
+	pj_memcpy(name, path->ptr, path->slen);
+	name[path->slen] = '\0';
+	pj_file_getstat(name, &st);
+    }
+    ctx_key_update(md, &st.size, sizeof(st.size));
+    ctx_key_update(md, &st.mtime, sizeof(st.mtime));
+    ctx_key_update(md, &st.ctime, sizeof(st.ctime));
+}
+
+/* Calculate the key of the context from the settings applied to it. The
+ * certificate and private key are hashed, so the key doesn't keep them.
+ */
+static pj_status_t calc_ctx_key(pj_ssl_sock_t *ssock, pj_uint32_t ssl_opt,
+				pj_uint8_t key[CTX_KEY_LEN])
+{
+    pj_ssl_cert_t *cert = ssock->cert;
+    EVP_MD_CTX *md;
+    unsigned key_len = CTX_KEY_LEN;
+
+    md = EVP_MD_CTX_new();
+    if (!md || !EVP_DigestInit_ex(md, EVP_sha256(), NULL)) {
+	EVP_MD_CTX_free(md);
+	return PJ_ENOMEM;
+    }
+
+    ctx_key_update(md, &ssock->is_server, sizeof(ssock->is_server));
+    ctx_key_update(md, &ssock->param.proto, sizeof(ssock->param.proto));
+    ctx_key_update(md, &ssl_opt, sizeof(ssl_opt));
+
+    if (ssock->is_server) {
+	/* Don't let a session resume on a server with stricter client
+	 * certificate verification (the key is the session ID context).
+	 */
+	ctx_key_update(md, &ssock->param.verify_peer,
+		       sizeof(ssock->param.verify_peer));
+	ctx_key_update(md, &ssock->param.require_client_cert,
+		       sizeof(ssock->param.require_client_cert));
+    } else {
+	/* Client curves are set to the context */
+	ctx_key_update(md, ssock->param.curves,
+		       ssock->param.curves_num * sizeof(pj_ssl_curve));
+    }
+
+    if (cert) {
+	ctx_key_update_file(md, &cert->CA_file);
+	ctx_key_update_file(md, &cert->CA_path);
+	ctx_key_update_file(md, &cert->cert_file);
+	ctx_key_update_file(md, &cert->privkey_file);
+	ctx_key_update(md, cert->privkey_pass.ptr, cert->privkey_pass.slen);
+	ctx_key_update(md, cert->CA_buf.ptr, cert->CA_buf.slen);
+	ctx_key_update(md, cert->cert_buf.ptr, cert->cert_buf.slen);
+	ctx_key_update(md, cert->privkey_buf.ptr, cert->privkey_buf.slen);
+    }
+
+    EVP_DigestFinal_ex(md, key, &key_len);
+    EVP_MD_CTX_free(md);
+
+    return PJ_SUCCESS;
+}
+
+/* Get a new reference to the cached context, or NULL if not found */
+static SSL_CTX *ctx_cache_get(const pj_uint8_t key[CTX_KEY_LEN])
+{
+    SSL_CTX *ctx = NULL;
+    unsigned i;
+
+    CRYPTO_THREAD_write_lock(ctx_cache.lock);
+    for (i = 0; i < PJ_ARRAY_SIZE(ctx_cache.ctx); ++i) {
+	if (ctx_cache.ctx[i].ctx &&
+	    pj_memcmp(ctx_cache.ctx[i].key, key, CTX_KEY_LEN) == 0)
+	{
+	    ctx = ctx_cache.ctx[i].ctx;
+	    SSL_CTX_up_ref(ctx);
+	    ++ctx_cache.ctx[i].users;
+	    ctx_cache.ctx[i].last_use = ++ctx_cache.clock;
+	    break;
+	}
+    }
+    CRYPTO_THREAD_unlock(ctx_cache.lock);
+
+    return ctx;
+}
+
+/* Add the context used by a socket to the cache, replacing the least
+ * recently used one. Return PJ_FALSE if the cache already has a context
+ * with the key.
+ */
+static pj_bool_t ctx_cache_add(const pj_uint8_t key[CTX_KEY_LEN],
+			       SSL_CTX *ctx)
+{
+    unsigned i, lru = 0;
+
+    CRYPTO_THREAD_write_lock(ctx_cache.lock);
+    for (i = 0; i < PJ_ARRAY_SIZE(ctx_cache.ctx); ++i) {
+	if (ctx_cache.ctx[i].ctx == NULL) {
+	    lru = i;
+	    break;
+	}
+	/* Another socket has added the same context */
+	if (pj_memcmp(ctx_cache.ctx[i].key, key, CTX_KEY_LEN) == 0) {
+	    CRYPTO_THREAD_unlock(ctx_cache.lock);
+	    return PJ_FALSE;
+	}
+	if (ctx_cache.ctx[i].last_use < ctx_cache.ctx[lru].last_use)
+	    lru = i;
+    }
+
+    if (ctx_cache.ctx[lru].ctx)
+	SSL_CTX_free(ctx_cache.ctx[lru].ctx);
+
+    SSL_CTX_up_ref(ctx);
+    pj_memcpy(ctx_cache.ctx[lru].key, key, CTX_KEY_LEN);
+    ctx_cache.ctx[lru].ctx = ctx;
+    ctx_cache.ctx[lru].users = 1;
+    ctx_cache.ctx[lru].last_use = ++ctx_cache.clock;
+    CRYPTO_THREAD_unlock(ctx_cache.lock);
+
+    return PJ_TRUE;
+}
+
+/* The socket no longer uses the cached context. The context is removed
+ * from the cache when the last socket using it is closed, so that the
+ * loaded private key is not kept after the sockets are gone.
+ */
+static void ctx_cache_release(SSL_CTX *ctx)
+{
+    unsigned i;
+
+    /* The cache has been destroyed by pj_shutdown() */
+    if (ctx_cache.lock == NULL)
+	return;
+
+    CRYPTO_THREAD_write_lock(ctx_cache.lock);
+    for (i = 0; i < PJ_ARRAY_SIZE(ctx_cache.ctx); ++i) {
+	/* The socket holds a reference, so the pointer is not reused
+	 * even if the context has been evicted.
+	 */
+	if (ctx_cache.ctx[i].ctx == ctx) {
+	    if (--ctx_cache.ctx[i].users == 0) {
+		SSL_CTX_free(ctx);
+		ctx_cache.ctx[i].ctx = NULL;
+	    }
+	    break;
+	}
+    }
+    CRYPTO_THREAD_unlock(ctx_cache.lock);
+}
+
+#if PJ_SSL_SOCK_SESS_CACHE_SIZE > 0
+
+/* Find the client session of the peer, return its index or -1 */
+static int sess_cache_find(ossl_sock_t *ossock)
+{
+    unsigned i;
+
+    for (i = 0; i < PJ_ARRAY_SIZE(ctx_cache.sess); ++i) {
+	if (ctx_cache.sess[i].sess &&
+	    pj_memcmp(ctx_cache.sess[i].key, ossock->ctx_key,
+		      CTX_KEY_LEN) == 0 &&
+	    pj_ansi_strcmp(ctx_cache.sess[i].peer, ossock->sess_peer) == 0)
+	{
+	    return i;
+	}
+    }
+    return -1;
+}
+
+/* Called by OpenSSL when the client receives a new session or ticket
+ * (with TLS 1.3, this happens after the handshake).
+ */
+static int on_new_session(SSL *ssl, SSL_SESSION *sess)
+{
+    pj_ssl_sock_t *ssock;
+    ossl_sock_t *ossock;
+    int i;
+
+    ssock = SSL_get_ex_data(ssl, sslsock_idx);
+    if (!ssock)
+	return 0;
+
+    ossock = (ossl_sock_t *)ssock;
+
+    /* Only keep sessions of verified servers, as certificate verification
+     * is skipped when resuming.
+     */
+    if (ssock->verify_status != PJ_SSL_CERT_ESUCCESS)
+	return 0;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    if (!SSL_SESSION_is_resumable(sess))
+	return 0;
+#endif
+
+    CRYPTO_THREAD_write_lock(ctx_cache.lock);
+
+    i = sess_cache_find(ossock);
+    if (i < 0) {
+	unsigned j;
+
+	/* Use empty or least recently used entry */
+	for (i = 0, j = 0; j < PJ_ARRAY_SIZE(ctx_cache.sess); ++j) {
+	    if (ctx_cache.sess[j].sess == NULL) {
+		i = j;
+		break;
+	    }
+	    if (ctx_cache.sess[j].last_use < ctx_cache.sess[i].last_use)
+		i = j;
+	}
+	pj_memcpy(ctx_cache.sess[i].key, ossock->ctx_key, CTX_KEY_LEN);
+	pj_ansi_strcpy(ctx_cache.sess[i].peer, ossock->sess_peer);
+    }
+
+    if (ctx_cache.sess[i].sess)
+	SSL_SESSION_free(ctx_cache.sess[i].sess);
+
+    /* Keep the reference given by OpenSSL */
+    ctx_cache.sess[i].sess = sess;
+    ctx_cache.sess[i].last_use = ++ctx_cache.clock;
+
+    CRYPTO_THREAD_unlock(ctx_cache.lock);
+
+    return 1;
+}
+
+/* Offer the last session of the peer for resumption */
+static void sess_cache_apply(ossl_sock_t *ossock)
+{
+    pj_ssl_sock_t *ssock = &ossock->base;
+    int i;
+
+    /* Server name if specified, otherwise the remote address */
+    if (ssock->param.server_name.slen) {
+	pj_ansi_snprintf(ossock->sess_peer, sizeof(ossock->sess_peer),
+			 "%.*s", (int)ssock->param.server_name.slen,
+			 ssock->param.server_name.ptr);
+    } else {
+	pj_sockaddr_print(&ssock->rem_addr, ossock->sess_peer,
+			  sizeof(ossock->sess_peer), 3);
+    }
+
+    CRYPTO_THREAD_write_lock(ctx_cache.lock);
+    i = sess_cache_find(ossock);
+    if (i >= 0) {
+	SSL_set_session(ossock->ossl_ssl, ctx_cache.sess[i].sess);
+	ctx_cache.sess[i].last_use = ++ctx_cache.clock;
+    }
+    CRYPTO_THREAD_unlock(ctx_cache.lock);
+}
+
+#endif	/* PJ_SSL_SOCK_SESS_CACHE_SIZE > 0 */
+
+#endif	/* HAS_CTX_CACHE */
+
+
 static pj_ssl_sock_t *ssl_alloc(pj_pool_t *pool)
 {
     return (pj_ssl_sock_t *)PJ_POOL_ZALLOC_T(pool, ossl_sock_t);
@@ -823,6 +1187,22 @@ static pj_status_t ssl_create(pj_ssl_sock_t *ssock)
 
     }
 
+#if HAS_CTX_CACHE
+    /* Share the context of sockets with the same settings */
+    status = ctx_cache_init();
+    if (status == PJ_SUCCESS)
+	status = calc_ctx_key(ssock, ssl_opt, ossock->ctx_key);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    ctx = ctx_cache_get(ossock->ctx_key);
+    if (ctx) {
+	ossock->ctx_reused = PJ_TRUE;
+	ossock->ctx_shared = PJ_TRUE;
+	goto create_ssl;
+    }
+#endif
+
     /* Create SSL context */
     ctx = SSL_CTX_new(ssl_method);
     if (ctx == NULL) {
@@ -1139,6 +1519,30 @@ static pj_status_t ssl_create(pj_ssl_sock_t *ssock)
             SSL_CTX_set_client_CA_list(ctx, ca_dn);
     }
 
+    /* The password is only needed when loading the keys above, and the
+     * context may outlive this socket.
+     */
+    SSL_CTX_set_default_passwd_cb(ctx, NULL);
+    SSL_CTX_set_default_passwd_cb_userdata(ctx, NULL);
+
+#if HAS_CTX_CACHE
+    if (ssock->is_server) {
+	/* Needed for resuming sessions when client certificate is
+	 * requested.
+	 */
+	SSL_CTX_set_session_id_context(ctx, ossock->ctx_key, CTX_KEY_LEN);
+    } else {
+#  if PJ_SSL_SOCK_SESS_CACHE_SIZE > 0
+	/* Client sessions are kept in our cache, see on_new_session() */
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT |
+					    SSL_SESS_CACHE_NO_INTERNAL_STORE);
+	SSL_CTX_sess_set_new_cb(ctx, &on_new_session);
+#  endif
+    }
+
+create_ssl:
+#endif
+
     /* Early sensitive data cleanup after OpenSSL context setup. However,
      * this cannot be done for listener sockets, as the data will still
      * be needed by accepted sockets.
@@ -1186,6 +1590,16 @@ static pj_status_t ssl_create(pj_ssl_sock_t *ssock)
     (void)BIO_set_close(ossock->ossl_wbio, BIO_CLOSE);
     SSL_set_bio(ossock->ossl_ssl, ossock->ossl_rbio, ossock->ossl_wbio);
 
+#if HAS_CTX_CACHE
+    if (!ossock->ctx_reused)
+	ossock->ctx_shared = ctx_cache_add(ossock->ctx_key, ctx);
+
+#  if PJ_SSL_SOCK_SESS_CACHE_SIZE > 0
+    if (!ssock->is_server)
+	sess_cache_apply(ossock);
+#  endif
+#endif
+
     return PJ_SUCCESS;
 }
 
@@ -1203,6 +1617,12 @@ static void ssl_destroy(pj_ssl_sock_t *ssock)
 
     /* Destroy SSL context */
     if (ossock->ossl_ctx) {
+#if HAS_CTX_CACHE
+	if (ossock->ctx_shared) {
+	    ctx_cache_release(ossock->ossl_ctx);
+	    ossock->ctx_shared = PJ_FALSE;
+	}
+#endif
 	SSL_CTX_free(ossock->ossl_ctx);
 	ossock->ossl_ctx = NULL;
     }
@@ -1372,6 +1792,11 @@ static pj_status_t set_curves_list(pj_ssl_sock_t *ssock)
 	if (ret < 1)
 	    return GET_SSL_STATUS(ssock);
     } else {
+#if HAS_CTX_CACHE
+	/* Already set to the shared context */
+	if (ossock->ctx_reused)
+	    return PJ_SUCCESS;
+#endif
 	ret = SSL_CTX_set1_curves(ossock->ossl_ctx, curves,
 				  ssock->param.curves_num);
 	if (ret < 1)
@@ -1818,6 +2243,7 @@ static pj_status_t ssl_do_handshake(pj_ssl_sock_t *ssock)
     /* Check if handshake has been completed */
     if (SSL_is_init_finished(ossock->ossl_ssl)) {
 	ssock->ssl_state = SSL_STATE_ESTABLISHED;
+	ssock->session_reused = (SSL_session_reused(ossock->ossl_ssl) == 1);
 	return PJ_SUCCESS;
     }
 
@@ -990,6 +990,18 @@ PJ_DEF(pj_status_t) pj_ssl_sock_get_info (pj_ssl_sock_t *ssock,
 }
 
 
+/*
+ * Retrieve the handshake statistics, not supported by this backend.
+ */
+PJ_DEF(void) pj_ssl_sock_get_stat(pj_ssl_sock_stat *stat, pj_bool_t reset)
+{
+    PJ_UNUSED_ARG(reset);
+
+    if (stat)
+	pj_bzero(stat, sizeof(*stat));
+}
+
+
 /*
  * Starts read operation on this SSL socket.
  */
@@ -772,6 +772,75 @@ static int gethostbyname_test(void)
 	return 0;
 }
 
+/* Result of pj_getaddrinfo_async() */
+static struct gai_result
+{
+    unsigned	cb_cnt;
+    pj_status_t	status;
+    unsigned	count;
+    int		af;
+} gai_res;
+
+static void gai_cb(void *user_data, pj_status_t status,
+		   unsigned count, const pj_addrinfo ai[])
+{
+    PJ_UNUSED_ARG(user_data);
+
+    gai_res.status = status;
+    gai_res.count = count;
+    gai_res.af = count ? ai[0].ai_addr.addr.sa_family : 0;
+    ++gai_res.cb_cnt;
+}
+
+static int getaddrinfo_async_test(void)
+{
+    pj_str_t host;
+    pj_status_t status;
+    unsigned i;
+
+    PJ_LOG(3,("test", "...getaddrinfo_async_test()"));
+
+    /* Address literal is resolved synchronously */
+    pj_bzero(&gai_res, sizeof(gai_res));
+    host = pj_str("127.0.0.1");
+    status = pj_getaddrinfo_async(pj_AF_INET(), &host, &gai_cb, NULL);
+    if (status != PJ_SUCCESS || gai_res.cb_cnt != 1)
+	return -20200;
+    if (gai_res.status != PJ_SUCCESS || gai_res.count == 0 ||
+	gai_res.af != pj_AF_INET())
+    {
+	return -20210;
+    }
+
+    /* Concurrent queries for the same invalid host are merged */
+    pj_bzero(&gai_res, sizeof(gai_res));
+    host = pj_str("an-invalid-host-name");
+    for (i=0; i<2; ++i) {
+	status = pj_getaddrinfo_async(pj_AF_INET(), &host, &gai_cb, NULL);
+	if (status != PJ_SUCCESS && status != PJ_EPENDING)
+	    return -20220;
+    }
+
+    for (i=0; i<300 && gai_res.cb_cnt < 2; ++i)
+	pj_thread_sleep(100);
+
+    if (gai_res.cb_cnt != 2)
+	return -20230;
+
+    /* Must return failure! */
+    if (gai_res.status == PJ_SUCCESS)
+	return -20240;
+
+    /* The failure is cached, so the callback must be called immediately */
+    status = pj_getaddrinfo_async(pj_AF_INET(), &host, &gai_cb, NULL);
+    if (status != PJ_SUCCESS || gai_res.cb_cnt != 3)
+	return -20250;
+    if (gai_res.status == PJ_SUCCESS)
+	return -20260;
+
+    return 0;
+}
+
 #if 0
 #include "../pj/os_symbian.h"
 static int connect_test()
@@ -852,6 +921,10 @@ int sock_test()
     if (rc != 0)
 	return rc;
 
+    rc = getaddrinfo_async_test();
+    if (rc != 0)
+	return rc;
+
     rc = simple_sock_test();
     if (rc != 0)
 	return rc;
@@ -746,6 +746,176 @@ on_return:
 }
 
 
+/* Connect several times to the same server, the connections after the
+ * first one must resume the session instead of doing a full handshake.
+ */
+static int session_resume_test(pj_ssl_sock_proto proto)
+{
+    enum { CONN_CNT = 3 };
+    pj_pool_t *pool = NULL;
+    pj_ioqueue_t *ioqueue = NULL;
+    pj_ssl_sock_t *ssock_serv = NULL;
+    pj_ssl_sock_param param;
+    pj_ssl_sock_stat stat;
+    struct test_state state_serv = { 0 };
+    pj_sockaddr addr, listen_addr;
+    pj_ssl_cert_t *cert = NULL;
+    char send_str[64];
+    unsigned i;
+    pj_status_t status;
+
+    pool = pj_pool_create(mem, "ssl_resume", 256, 256, NULL);
+
+    status = pj_ioqueue_create(pool, CONN_CNT * 2 + 1, &ioqueue);
+    if (status != PJ_SUCCESS) {
+	goto on_return;
+    }
+
+    pj_ssl_sock_param_default(&param);
+    param.cb.on_accept_complete = &ssl_on_accept_complete;
+    param.cb.on_connect_complete = &ssl_on_connect_complete;
+    param.cb.on_data_read = &ssl_on_data_read;
+    param.cb.on_data_sent = &ssl_on_data_sent;
+    param.ioqueue = ioqueue;
+    param.proto = proto;
+
+    {
+	pj_str_t tmp_st;
+	pj_sockaddr_init(PJ_AF_INET, &addr, pj_strset2(&tmp_st, "127.0.0.1"), 0);
+    }
+
+    /* === SERVER === */
+    param.user_data = &state_serv;
+    state_serv.pool = pool;
+    state_serv.echo = PJ_TRUE;
+    state_serv.is_server = PJ_TRUE;
+
+    status = pj_ssl_sock_create(pool, &param, &ssock_serv);
+    if (status != PJ_SUCCESS) {
+	goto on_return;
+    }
+
+    {
+	pj_str_t ca_file = pj_str(CERT_CA_FILE);
+	pj_str_t cert_file = pj_str(CERT_FILE);
+	pj_str_t privkey_file = pj_str(CERT_PRIVKEY_FILE);
+	pj_str_t privkey_pass = pj_str(CERT_PRIVKEY_PASS);
+
+	status = pj_ssl_cert_load_from_files(pool, &ca_file, &cert_file, 
+					     &privkey_file, &privkey_pass,
+					     &cert);
+	if (status != PJ_SUCCESS) {
+	    goto on_return;
+	}
+
+	status = pj_ssl_sock_set_certificate(ssock_serv, pool, cert);
+	if (status != PJ_SUCCESS) {
+	    goto on_return;
+	}
+    }
+
+    status = pj_ssl_sock_start_accept(ssock_serv, pool, &addr, pj_sockaddr_get_len(&addr));
+    if (status != PJ_SUCCESS) {
+	goto on_return;
+    }
+
+    {
+	pj_ssl_sock_info info;
+
+	pj_ssl_sock_get_info(ssock_serv, &info);
+	pj_sockaddr_cp(&listen_addr, &info.local_addr);
+    }
+
+    /* Client certificate, CA only */
+    {
+	pj_str_t ca_file = pj_str(CERT_CA_FILE);
+	pj_str_t null_str = pj_str("");
+
+	status = pj_ssl_cert_load_from_files(pool, &ca_file, &null_str, 
+					     &null_str, &null_str, &cert);
+	if (status != PJ_SUCCESS) {
+	    goto on_return;
+	}
+    }
+
+    pj_ansi_strcpy(send_str, "Hello, resumed session!");
+    pj_ssl_sock_get_stat(NULL, PJ_TRUE);
+
+    /* === CLIENTS === */
+    for (i = 0; i < CONN_CNT; ++i) {
+	pj_ssl_sock_t *ssock_cli = NULL;
+	struct test_state state_cli = { 0 };
+
+	param.user_data = &state_cli;
+	state_cli.pool = pool;
+	state_cli.check_echo = PJ_TRUE;
+	state_cli.send_str = send_str;
+	state_cli.send_str_len = pj_ansi_strlen(send_str);
+
+	status = pj_ssl_sock_create(pool, &param, &ssock_cli);
+	if (status != PJ_SUCCESS) {
+	    goto on_return;
+	}
+
+	status = pj_ssl_sock_set_certificate(ssock_cli, pool, cert);
+	if (status != PJ_SUCCESS) {
+	    pj_ssl_sock_close(ssock_cli);
+	    goto on_return;
+	}
+
+	status = pj_ssl_sock_start_connect(ssock_cli, pool, &addr, &listen_addr, pj_sockaddr_get_len(&addr));
+	if (status == PJ_SUCCESS) {
+	    ssl_on_connect_complete(ssock_cli, PJ_SUCCESS);
+	} else if (status != PJ_EPENDING) {
+	    pj_ssl_sock_close(ssock_cli);
+	    goto on_return;
+	}
+
+	while (!state_serv.err && !state_cli.err && !state_cli.done) {
+	    pj_time_val delay = {0, 100};
+	    pj_ioqueue_poll(ioqueue, &delay);
+	}
+
+	if (!state_cli.err && !state_cli.done)
+	    pj_ssl_sock_close(ssock_cli);
+
+	status = state_serv.err ? state_serv.err : state_cli.err;
+	if (status != PJ_SUCCESS)
+	    goto on_return;
+    }
+
+    /* Clean up sockets */
+    {
+	pj_time_val delay = {0, 100};
+	while (pj_ioqueue_poll(ioqueue, &delay) > 0);
+    }
+
+    /* Both sides of the subsequent connections resume the session */
+    pj_ssl_sock_get_stat(&stat, PJ_FALSE);
+    PJ_LOG(3, ("", "...Full handshakes: %d (%d ms), resumed: %d (%d ms)",
+	       stat.full_cnt, stat.full_time, stat.reused_cnt,
+	       stat.reused_time));
+
+#if PJ_SSL_SOCK_IMP == PJ_SSL_SOCK_IMP_OPENSSL && \
+    PJ_SSL_SOCK_CTX_CACHE_SIZE > 0 && PJ_SSL_SOCK_SESS_CACHE_SIZE > 0
+    if (stat.reused_cnt < (CONN_CNT - 1) * 2) {
+	PJ_LOG(3, ("", "...ERROR session is not resumed"));
+	status = PJ_EBUG;
+    }
+#endif
+
+on_return:
+    if (ssock_serv)
+	pj_ssl_sock_close(ssock_serv);
+    if (ioqueue)
+	pj_ioqueue_destroy(ioqueue);
+    if (pool)
+	pj_pool_release(pool);
+
+    return status;
+}
+
+
 static pj_bool_t asock_on_data_read(pj_activesock_t *asock,
 				    void *data,
 				    pj_size_t size,
@@ -1559,6 +1729,16 @@ int ssl_sock_test(void)
     if (ret != 0)
 	return ret;
 
+    PJ_LOG(3,("", "..session resumption test w/ TLSv1.2"));
+    ret = session_resume_test(PJ_SSL_SOCK_PROTO_TLS1_2);
+    if (ret != 0)
+	return ret;
+
+    PJ_LOG(3,("", "..session resumption test w/ TLSv1.3"));
+    ret = session_resume_test(PJ_SSL_SOCK_PROTO_TLS1_3);
+    if (ret != 0)
+	return ret;
+
     PJ_LOG(3,("", "..performance test"));
     ret = perf_test(PJ_IOQUEUE_MAX_HANDLES/2 - 1, 0);
     if (ret != 0)
@@ -51,6 +51,7 @@
 #include <pjmedia/rtcp.h>
 #include <pjmedia/rtcp_xr.h>
 #include <pjmedia/rtp.h>
+#include <pjmedia/rtp_pkt_pool.h>
 #include <pjmedia/sdp.h>
 #include <pjmedia/sdp_neg.h>
 //#include <pjmedia/session.h>
@@ -139,8 +139,25 @@ PJ_DECL(unsigned char) pjmedia_ulaw2alaw(unsigned char uval);
 
 #endif
 
+#if defined(PJMEDIA_HAS_G711_SIMD) && PJMEDIA_HAS_G711_SIMD!=0
+/*
+ * SIMD implementation of the bulk conversion functions below. Application
+ * should call the bulk conversion functions instead.
+ */
+PJ_DECL(void) pjmedia_ulaw_encode_simd(pj_uint8_t *dst, const pj_int16_t *src,
+				       pj_size_t count);
+PJ_DECL(void) pjmedia_alaw_encode_simd(pj_uint8_t *dst, const pj_int16_t *src,
+				       pj_size_t count);
+PJ_DECL(void) pjmedia_ulaw_decode_simd(pj_int16_t *dst, const pj_uint8_t *src,
+				       pj_size_t len);
+PJ_DECL(void) pjmedia_alaw_decode_simd(pj_int16_t *dst, const pj_uint8_t *src,
+				       pj_size_t len);
+#endif
+
 /**
- * Encode 16-bit linear PCM data to 8-bit U-Law data.
+ * Encode 16-bit linear PCM data to 8-bit U-Law data. When
+ * #PJMEDIA_HAS_G711_SIMD is enabled, the samples are converted with SIMD
+ * instructions.
  *
  * @param dst	    Destination buffer for 8-bit U-Law data.
  * @param src	    Source, 16-bit linear PCM data.
@@ -149,15 +166,21 @@ PJ_DECL(unsigned char) pjmedia_ulaw2alaw(unsigned char uval);
 PJ_INLINE(void) pjmedia_ulaw_encode(pj_uint8_t *dst, const pj_int16_t *src, 
 				    pj_size_t count)
 {
+#if defined(PJMEDIA_HAS_G711_SIMD) && PJMEDIA_HAS_G711_SIMD!=0
+    pjmedia_ulaw_encode_simd(dst, src, count);
+#else
     const pj_int16_t *end = src + count;
     
     while (src < end) {
 	*dst++ = pjmedia_linear2ulaw(*src++);
     }
+#endif
 }
 
 /**
- * Encode 16-bit linear PCM data to 8-bit A-Law data.
+ * Encode 16-bit linear PCM data to 8-bit A-Law data. When
+ * #PJMEDIA_HAS_G711_SIMD is enabled, the samples are converted with SIMD
+ * instructions.
  *
  * @param dst	    Destination buffer for 8-bit A-Law data.
  * @param src	    Source, 16-bit linear PCM data.
@@ -166,15 +189,21 @@ PJ_INLINE(void) pjmedia_ulaw_encode(pj_uint8_t *dst, const pj_int16_t *src,
 PJ_INLINE(void) pjmedia_alaw_encode(pj_uint8_t *dst, const pj_int16_t *src, 
 				    pj_size_t count)
 {
+#if defined(PJMEDIA_HAS_G711_SIMD) && PJMEDIA_HAS_G711_SIMD!=0
+    pjmedia_alaw_encode_simd(dst, src, count);
+#else
     const pj_int16_t *end = src + count;
     
     while (src < end) {
 	*dst++ = pjmedia_linear2alaw(*src++);
     }
+#endif
 }
 
 /**
- * Decode 8-bit U-Law data to 16-bit linear PCM data.
+ * Decode 8-bit U-Law data to 16-bit linear PCM data. When
+ * #PJMEDIA_HAS_G711_SIMD is enabled, the samples are converted with SIMD
+ * instructions.
  *
  * @param dst	    Destination buffer for 16-bit PCM data.
  * @param src	    Source, 8-bit U-Law data.
@@ -183,15 +212,21 @@ PJ_INLINE(void) pjmedia_alaw_encode(pj_uint8_t *dst, const pj_int16_t *src,
 PJ_INLINE(void) pjmedia_ulaw_decode(pj_int16_t *dst, const pj_uint8_t *src, 
 				    pj_size_t len)
 {
+#if defined(PJMEDIA_HAS_G711_SIMD) && PJMEDIA_HAS_G711_SIMD!=0
+    pjmedia_ulaw_decode_simd(dst, src, len);
+#else
     const pj_uint8_t *end = src + len;
     
     while (src < end) {
 	*dst++ = pjmedia_ulaw2linear(*src++);
     }
+#endif
 }
 
 /**
- * Decode 8-bit A-Law data to 16-bit linear PCM data.
+ * Decode 8-bit A-Law data to 16-bit linear PCM data. When
+ * #PJMEDIA_HAS_G711_SIMD is enabled, the samples are converted with SIMD
+ * instructions.
  *
  * @param dst	    Destination buffer for 16-bit PCM data.
  * @param src	    Source, 8-bit A-Law data.
@@ -200,13 +235,49 @@ PJ_INLINE(void) pjmedia_ulaw_decode(pj_int16_t *dst, const pj_uint8_t *src,
 PJ_INLINE(void) pjmedia_alaw_decode(pj_int16_t *dst, const pj_uint8_t *src, 
 				    pj_size_t len)
 {
+#if defined(PJMEDIA_HAS_G711_SIMD) && PJMEDIA_HAS_G711_SIMD!=0
+    pjmedia_alaw_decode_simd(dst, src, len);
+#else
     const pj_uint8_t *end = src + len;
     
     while (src < end) {
 	*dst++ = pjmedia_alaw2linear(*src++);
     }
+#endif
 }
 
+/**
+ * Encode several frames of 16-bit linear PCM data to 8-bit U-Law data in
+ * one call. This is faster than encoding the frames one by one, as the
+ * conversion is set up only once.
+ *
+ * @param frame_cnt Number of frames.
+ * @param dst	    Destination buffers for 8-bit U-Law data, one for
+ *		    each frame.
+ * @param src	    Sources, 16-bit linear PCM data, one for each frame.
+ * @param count	    Number of samples in each frame.
+ */
+PJ_DECL(void) pjmedia_ulaw_encode_frames(unsigned frame_cnt,
+					 pj_uint8_t *const dst[],
+					 const pj_int16_t *const src[],
+					 pj_size_t count);
+
+/**
+ * Encode several frames of 16-bit linear PCM data to 8-bit A-Law data in
+ * one call. This is faster than encoding the frames one by one, as the
+ * conversion is set up only once.
+ *
+ * @param frame_cnt Number of frames.
+ * @param dst	    Destination buffers for 8-bit A-Law data, one for
+ *		    each frame.
+ * @param src	    Sources, 16-bit linear PCM data, one for each frame.
+ * @param count	    Number of samples in each frame.
+ */
+PJ_DECL(void) pjmedia_alaw_encode_frames(unsigned frame_cnt,
+					 pj_uint8_t *const dst[],
+					 const pj_int16_t *const src[],
+					 pj_size_t count);
+
 PJ_END_DECL
 
 #endif	/* __PJMEDIA_ALAW_ULAW_H__ */
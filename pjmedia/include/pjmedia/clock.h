@@ -323,6 +323,150 @@ PJ_DECL(pj_bool_t) pjmedia_clock_wait(pjmedia_clock *clock,
 PJ_DECL(pj_status_t) pjmedia_clock_destroy(pjmedia_clock *clock);
 
 
+/**
+ * Opaque declaration for media clock scheduler.
+ *
+ * By default every asynchronous media clock runs its own thread. When
+ * there are many independent media graphs, such as thousands of two-party
+ * calls each driven by a @ref PJMEDIA_MASTER_PORT, a clock scheduler can
+ * be used instead: it runs a fixed pool of worker threads and each worker
+ * ticks many clocks according to their own deadline. Clocks are assigned
+ * to the least loaded worker when they are started.
+ */
+typedef struct pjmedia_clock_sched pjmedia_clock_sched;
+
+
+/**
+ * Clock scheduler settings.
+ */
+typedef struct pjmedia_clock_sched_param
+{
+    /**
+     * Number of worker threads.
+     *
+     * Default: 1
+     */
+    unsigned	thread_cnt;
+
+    /**
+     * Bitmask of #pjmedia_clock_options to be applied to the worker
+     * threads. Only PJMEDIA_CLOCK_NO_HIGHEST_PRIO is applicable.
+     *
+     * Default: 0 (worker threads run with highest priority)
+     */
+    unsigned	options;
+
+} pjmedia_clock_sched_param;
+
+
+/**
+ * Clock scheduler statistics.
+ */
+typedef struct pjmedia_clock_sched_stat
+{
+    /**
+     * Number of worker threads.
+     */
+    unsigned	thread_cnt;
+
+    /**
+     * Number of clocks currently scheduled.
+     */
+    unsigned	clock_cnt;
+
+    /**
+     * Total number of clock ticks executed.
+     */
+    pj_uint32_t	tick_cnt;
+
+    /**
+     * Number of clock ticks executed more than one clock interval after
+     * their deadline.
+     */
+    pj_uint32_t	overrun_cnt;
+
+    /**
+     * Maximum delay between a tick deadline and its execution, in usec.
+     */
+    unsigned	max_late_usec;
+
+    /**
+     * Load of the busiest worker thread since the statistic was last
+     * reset, i.e: percentage of time spent in clock callbacks.
+     */
+    unsigned	max_load_pct;
+
+} pjmedia_clock_sched_stat;
+
+
+/**
+ * Initialize clock scheduler settings with default values.
+ *
+ * @param param		    The settings to be initialized.
+ */
+PJ_DECL(void) pjmedia_clock_sched_param_default(
+					    pjmedia_clock_sched_param *param);
+
+
+/**
+ * Create a clock scheduler and start its worker threads.
+ *
+ * @param pool		    Pool to allocate memory.
+ * @param param		    Optional settings, if NULL the default settings
+ *			    will be used.
+ * @param p_sched	    Pointer to receive the scheduler instance.
+ *
+ * @return		    PJ_SUCCESS on success, or the appropriate error
+ *			    code.
+ */
+PJ_DECL(pj_status_t) pjmedia_clock_sched_create(
+				    pj_pool_t *pool,
+				    const pjmedia_clock_sched_param *param,
+				    pjmedia_clock_sched **p_sched);
+
+
+/**
+ * Get the scheduler statistics.
+ *
+ * @param sched		    The clock scheduler.
+ * @param stat		    Structure to receive the statistics.
+ * @param reset		    If non-zero, reset the statistics after reading.
+ *
+ * @return		    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_clock_sched_get_stat(
+				    pjmedia_clock_sched *sched,
+				    pjmedia_clock_sched_stat *stat,
+				    pj_bool_t reset);
+
+
+/**
+ * Stop the worker threads and destroy the clock scheduler. Clocks which
+ * are still scheduled will be stopped, and all clocks using the scheduler
+ * will run their own thread when started again.
+ *
+ * @param sched		    The clock scheduler.
+ *
+ * @return		    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_clock_sched_destroy(pjmedia_clock_sched *sched);
+
+
+/**
+ * Let the clock be run by a clock scheduler instead of by its own thread.
+ * This must be called while the clock is stopped, and is only valid for
+ * clock created without PJMEDIA_CLOCK_NO_ASYNC flag.
+ *
+ * @param clock		    The media clock.
+ * @param sched		    The clock scheduler, or NULL to let the clock
+ *			    run its own thread again.
+ *
+ * @return		    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_clock_set_sched(pjmedia_clock *clock,
+					     pjmedia_clock_sched *sched);
+
+
 
 PJ_END_DECL
 
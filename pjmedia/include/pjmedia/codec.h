@@ -328,6 +328,30 @@ PJ_DECL(pjmedia_codec_param*) pjmedia_codec_param_clone(
 typedef struct pjmedia_codec pjmedia_codec;
 
 
+/**
+ * This structure describes one encoding job of
+ * #pjmedia_codec_encode_batch().
+ */
+typedef struct pjmedia_codec_encode_job
+{
+    /** The codec instance. */
+    pjmedia_codec		*codec;
+
+    /** The input frame. */
+    const struct pjmedia_frame	*input;
+
+    /** The length of buffer in the output frame. */
+    unsigned			 out_size;
+
+    /** The output frame. */
+    struct pjmedia_frame	*output;
+
+    /** On output, the encoding status of this job. */
+    pj_status_t			 status;
+
+} pjmedia_codec_encode_job;
+
+
 /**
  * This structure describes codec operations. Each codec MUST implement
  * all of these functions.
@@ -485,6 +509,38 @@ typedef struct pjmedia_codec_op
     pj_status_t (*recover)(pjmedia_codec *codec,
 			   unsigned out_size,
 			   struct pjmedia_frame *output);
+
+    /**
+     * Optional: encode frames of several instances of this codec in one
+     * call. All jobs use codec instances having this operation, and each
+     * job is equivalent to calling \a encode() for the job. The codec
+     * must set the status of every job.
+     *
+     * Application should call #pjmedia_codec_encode_batch() instead of
+     * calling this function directly.
+     *
+     * @param count	Number of jobs.
+     * @param jobs	The encoding jobs.
+     *
+     * @return		PJ_SUCCESS if all jobs succeeded.
+     */
+    pj_status_t (*encode_batch)(unsigned count,
+				pjmedia_codec_encode_job jobs[]);
+
+    /**
+     * Optional: reset a closed codec instance so that the codec manager
+     * can keep it in its instance pool and give it to the next user of
+     * the same codec (see #pjmedia_codec_mgr_set_pool_limit()). The codec
+     * must discard all state of the previous session, e.g: PLC history,
+     * but it may keep its resources, such as the encoder and decoder
+     * state memory, to be reinitialized by the next \a open(). Instances
+     * of codecs without this operation are never pooled.
+     *
+     * @param codec	The codec instance.
+     *
+     * @return		PJ_SUCCESS if the instance can be reused.
+     */
+    pj_status_t (*reset)(pjmedia_codec *codec);
 } pjmedia_codec_op;
 
 
@@ -693,9 +749,25 @@ struct pjmedia_codec_desc
     pjmedia_codec_factory  *factory;	/**< The factory.	    */
     pjmedia_codec_default_param *param; /**< Default codecs 
 					     parameters.	    */
+    struct pjmedia_codec_inst_pool *inst_pool; /**< Idle instances.  */
 };
 
 
+/**
+ * Statistic of the codec instance pool, see
+ * #pjmedia_codec_mgr_get_pool_stat().
+ */
+typedef struct pjmedia_codec_pool_stat
+{
+    unsigned	idle_cnt;	/**< Number of idle instances in the pool.  */
+    pj_uint32_t	hit_cnt;	/**< Allocations served from the pool.	    */
+    pj_uint32_t	miss_cnt;	/**< Allocations served by the factory
+				     while the pool is enabled.		    */
+    pj_uint32_t	discard_cnt;	/**< Deallocations returned to the factory
+				     because the pool was full.		    */
+} pjmedia_codec_pool_stat;
+
+
 /**
  * The declaration for codec manager. Application doesn't normally need
  * to see this declaration, but nevertheless this declaration is needed
@@ -936,8 +1008,11 @@ pjmedia_codec_mgr_alloc_codec( pjmedia_codec_mgr *mgr,
 			       pjmedia_codec **p_codec);
 
 /**
- * Deallocate the specified codec instance. The codec manager will return
- * the instance of the codec back to its factory.
+ * Deallocate the specified codec instance. The codec manager will reset
+ * the instance and keep it in its instance pool when the codec supports
+ * it and the pool of the codec is not full (see
+ * #pjmedia_codec_mgr_set_pool_limit()), or otherwise return the instance
+ * of the codec back to its factory. The codec must have been closed.
  *
  * @param mgr	    The codec manager instance. Application can get the
  *		    instance by calling #pjmedia_endpt_get_codec_mgr().
@@ -949,6 +1024,54 @@ PJ_DECL(pj_status_t) pjmedia_codec_mgr_dealloc_codec(pjmedia_codec_mgr *mgr,
 						     pjmedia_codec *codec);
 
 
+/**
+ * Set the maximum number of idle instances the codec manager keeps for
+ * the specified codecs. Deallocated instances are kept in a pool per
+ * codec (i.e: per codec ID, clock rate, and channel count) and are given
+ * back by #pjmedia_codec_mgr_alloc_codec(), to save the cost of creating
+ * the codec state, e.g: when calls are frequently set up and torn down.
+ * Only instances of codecs implementing the \a reset() operation in
+ * #pjmedia_codec_op are pooled, the instance is reset when it is put in
+ * the pool, and it will be initialized and opened again by the
+ * application. Lowering the limit returns the excess idle instances to
+ * their factory.
+ *
+ * The initial limit is PJMEDIA_CODEC_MGR_MAX_IDLE_CODECS.
+ *
+ * @param mgr	    The codec manager instance. Application can get the
+ *		    instance by calling #pjmedia_endpt_get_codec_mgr().
+ * @param codec_id  The full codec ID or codec ID prefix. If an empty
+ *		    string is given, it will match all codecs.
+ * @param max_idle  Maximum number of idle instances per codec, zero to
+ *		    disable the pool.
+ *
+ * @return	    PJ_SUCCESS if at least one codec is found.
+ */
+PJ_DECL(pj_status_t)
+pjmedia_codec_mgr_set_pool_limit(pjmedia_codec_mgr *mgr,
+				 const pj_str_t *codec_id,
+				 unsigned max_idle);
+
+
+/**
+ * Get the instance pool statistic of the specified codecs. If more than
+ * one codecs match the codec ID prefix, the sum of their statistic is
+ * returned.
+ *
+ * @param mgr	    The codec manager instance. Application can get the
+ *		    instance by calling #pjmedia_endpt_get_codec_mgr().
+ * @param codec_id  The full codec ID or codec ID prefix. If an empty
+ *		    string is given, it will match all codecs.
+ * @param stat	    On return, will be filled with the statistic.
+ *
+ * @return	    PJ_SUCCESS if at least one codec is found.
+ */
+PJ_DECL(pj_status_t)
+pjmedia_codec_mgr_get_pool_stat(pjmedia_codec_mgr *mgr,
+				const pj_str_t *codec_id,
+				pjmedia_codec_pool_stat *stat);
+
+
 
 /** 
  * Initialize codec using the specified attribute.
@@ -1070,6 +1193,25 @@ PJ_INLINE(pj_status_t) pjmedia_codec_encode(
 }
 
 
+/**
+ * Encode frames of several codec instances in one call, e.g: to encode
+ * the frames of all streams in one conference bridge tick. Consecutive
+ * jobs of the same codec type are handed to the codec in one call when the
+ * codec supports batch encoding, other jobs are encoded one at a time with
+ * #pjmedia_codec_encode().
+ *
+ * @param count		Number of jobs.
+ * @param jobs		The encoding jobs. On return, the status of each
+ *			job is set.
+ *
+ * @return		PJ_SUCCESS if all jobs succeeded, or otherwise the
+ *			status of the first failed job.
+ */
+PJ_DECL(pj_status_t) pjmedia_codec_encode_batch(
+					unsigned count,
+					pjmedia_codec_encode_job jobs[]);
+
+
 /** 
  * Instruct the codec to decode the specified input frame. The input
  * frame MUST have ptime that is exactly equal to base frame
@@ -101,8 +101,17 @@ enum pjmedia_conf_option
 				     microphone device.			    */
     PJMEDIA_CONF_NO_DEVICE = 2,	/**< Do not create sound device.	    */
     PJMEDIA_CONF_SMALL_FILTER=4,/**< Use small filter table when resampling */
-    PJMEDIA_CONF_USE_LINEAR=8	/**< Use linear resampling instead of filter
+    PJMEDIA_CONF_USE_LINEAR=8,	/**< Use linear resampling instead of filter
 				     based.				    */
+    PJMEDIA_CONF_USE_DTX=16	/**< Enable discontinuous transmission:
+				     signal from ports that are detected
+				     as silent by the voice activity
+				     detector is not mixed, and stream
+				     ports that receive no active signal
+				     are given NULL frames instead of
+				     mixed silence, letting the stream
+				     skip encoding. Other ports, such as
+				     recorders, still get silence.	    */
 };
 
 
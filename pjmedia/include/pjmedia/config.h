@@ -84,6 +84,20 @@
 #   define PJMEDIA_CONF_USE_AGC    	    1
 #endif
 
+/**
+ * Specify whether the delay buffer of conference passive ports uses
+ * the lock-free mode (see #PJMEDIA_DELAY_BUF_LOCK_FREE), so the thread
+ * putting frames to the passive port, e.g: the sound device thread,
+ * never contends with the conference bridge clock. Only disable this
+ * if the application puts frames to a passive port from more than
+ * one thread concurrently.
+ *
+ * Default: 1 (enabled)
+ */
+#ifndef PJMEDIA_CONF_PASSIVE_PORT_LOCK_FREE
+#   define PJMEDIA_CONF_PASSIVE_PORT_LOCK_FREE	1
+#endif
+
 
 /*
  * Types of sound stream backends.
@@ -183,6 +197,26 @@
 #endif
 
 
+/**
+ * Specify whether the WSOLA implementation (PJMEDIA_WSOLA_IMP_WSOLA with
+ * floating point) should use SSE2 or NEON instructions for the pitch
+ * search correlation and the overlap-add. The kernels keep the order of
+ * the floating point operations, so the output is identical to the
+ * scalar code.
+ *
+ * Default: 1 on SSE2 or 64-bit NEON capable targets, 0 otherwise
+ */
+#ifndef PJMEDIA_HAS_WSOLA_SIMD
+#   if defined(__SSE2__) || defined(_M_X64) || \
+       (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || \
+       (defined(__ARM_NEON) && defined(__aarch64__))
+#	define PJMEDIA_HAS_WSOLA_SIMD	    1
+#   else
+#	define PJMEDIA_HAS_WSOLA_SIMD	    0
+#   endif
+#endif
+
+
 /**
  * Specify the default maximum duration of synthetic audio that is generated
  * by WSOLA. This value should be long enough to cover burst of packet losses. 
@@ -286,6 +320,44 @@
 #endif
 
 
+/**
+ * Specify whether the bulk A-law/U-law conversion functions, such as
+ * #pjmedia_ulaw_encode(), should use SSE2 or NEON instructions to convert
+ * 16 samples at a time without table lookup. The result is identical to
+ * the A-law/U-law table conversion. This is enabled by default when the
+ * compiler targets SSE2 or NEON.
+ *
+ * Default: 1 on SSE2 or NEON capable targets, 0 otherwise
+ */
+#ifndef PJMEDIA_HAS_G711_SIMD
+#   if defined(__SSE2__) || defined(_M_X64) || \
+       (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || \
+       defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#	define PJMEDIA_HAS_G711_SIMD	    1
+#   else
+#	define PJMEDIA_HAS_G711_SIMD	    0
+#   endif
+#endif
+
+
+/**
+ * Specify whether the simple echo suppressor (PJMEDIA_ECHO_SIMPLE) should
+ * use SSE2 or NEON instructions for its per frame signal level analysis
+ * and gain scaling. The analysis result is identical to the scalar code.
+ *
+ * Default: 1 on SSE2 or NEON capable targets, 0 otherwise
+ */
+#ifndef PJMEDIA_HAS_ECHO_SUPP_SIMD
+#   if defined(__SSE2__) || defined(_M_X64) || \
+       (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || \
+       defined(__ARM_NEON) || defined(__ARM_NEON__)
+#	define PJMEDIA_HAS_ECHO_SUPP_SIMD   1
+#   else
+#	define PJMEDIA_HAS_ECHO_SUPP_SIMD   0
+#   endif
+#endif
+
+
 /**
  * Unless specified otherwise, G711 codec is included by default.
  */
@@ -351,6 +423,9 @@
 						     using libsamplerate 
 						     (a.k.a Secret Rabbit Code)
 						 */
+#define PJMEDIA_RESAMPLE_POLYPHASE	    5	/**< Sample rate conversion
+						     using built-in polyphase
+						     filter.  */
 
 /**
  * Select which resample implementation to use. Currently pjmedia supports:
@@ -359,6 +434,10 @@
  *  - #PJMEDIA_RESAMPLE_LIBSAMPLERATE, to use libsamplerate implementation
  *    (a.k.a. Secret Rabbit Code).
  *  - #PJMEDIA_RESAMPLE_SPEEX, to use sample rate conversion in Speex library.
+ *  - #PJMEDIA_RESAMPLE_POLYPHASE, to use the built-in polyphase filter
+ *    resampler, vectorized with SSE, AVX or NEON when the compiler targets
+ *    those instruction sets. The quality preset is selected by the
+ *    high_quality and large_filter parameters of #pjmedia_resample_create().
  *  - #PJMEDIA_RESAMPLE_NONE, to disable sample rate conversion. Any calls to
  *    resample function will return error.
  *
@@ -369,6 +448,19 @@
 #endif
 
 
+/**
+ * Maximum number of filter phases of the polyphase resampler, i.e: the
+ * output rate divided by the greatest common divisor of the input and
+ * output rates (e.g: 160 for 44100 to 48000). Each phase takes up to
+ * 48 coefficients. Resampling which needs more phases will fail.
+ *
+ * Default: 256
+ */
+#ifndef PJMEDIA_RESAMPLE_POLYPHASE_MAX_PHASES
+#   define PJMEDIA_RESAMPLE_POLYPHASE_MAX_PHASES    256
+#endif
+
+
 /**
  * Specify whether libsamplerate, when used, should be linked statically
  * into the application. This option is only useful for Visual Studio
@@ -623,6 +715,18 @@
 #endif
 
 
+/**
+ * Alignment of the buffers in the RTP packet pool, in bytes. This should
+ * be the CPU cache line size, so buffers used by different threads never
+ * share a cache line. Must be a power of two.
+ *
+ * Default: 64
+ */
+#ifndef PJMEDIA_RTP_PKT_POOL_ALIGN
+#   define PJMEDIA_RTP_PKT_POOL_ALIGN		64
+#endif
+
+
 /**
  * Specify the maximum duration of silence period in the codec, in msec. 
  * This is useful for example to keep NAT binding open in the firewall
@@ -715,6 +819,21 @@
 #endif
 
 
+/**
+ * Maximum number of idle instances the codec manager keeps per codec
+ * (i.e: per codec ID, clock rate, and channel count) to be reused by
+ * the next allocation of the same codec. Only codecs implementing the
+ * reset() operation are pooled. Application may change the limit per
+ * codec with #pjmedia_codec_mgr_set_pool_limit(), or set this to zero
+ * to disable the pool.
+ *
+ * Default: 4
+ */
+#ifndef PJMEDIA_CODEC_MGR_MAX_IDLE_CODECS
+#   define PJMEDIA_CODEC_MGR_MAX_IDLE_CODECS	4
+#endif
+
+
 /**
  * Maximum number of parameters in SDP fmtp attribute.
  *
@@ -1559,6 +1678,17 @@
 #endif
 
 
+/**
+ * Default number of rendering worker threads of the video conference
+ * bridge, see pjmedia_vid_conf_setting.worker_cnt.
+ *
+ * Default : 0 (rendering is done by the clock thread)
+ */
+#ifndef PJMEDIA_VID_CONF_WORKER_CNT
+#   define PJMEDIA_VID_CONF_WORKER_CNT			    0
+#endif
+
+
 
 /**
  * @}
@@ -72,7 +72,25 @@ typedef enum pjmedia_delay_buf_flag
      * Use simple FIFO mechanism for the delay buffer, i.e.
      * without WSOLA for expanding and shrinking audio samples.
      */
-    PJMEDIA_DELAY_BUF_SIMPLE_FIFO = 1
+    PJMEDIA_DELAY_BUF_SIMPLE_FIFO = 1,
+
+    /**
+     * Use lock-free single-producer/single-consumer mode. In this mode,
+     * pjmedia_delay_buf_put() only copies the frame into a ring without
+     * taking any lock, and all processing, including the drift correction
+     * with WSOLA, is done by pjmedia_delay_buf_get(). This avoids priority
+     * inversion between e.g: the sound device thread and the conference
+     * bridge clock thread.
+     *
+     * The application must guarantee that pjmedia_delay_buf_put() is only
+     * called from one thread at a time, and likewise for
+     * pjmedia_delay_buf_get(). When the ring is full, the new frame will
+     * be dropped instead of the eldest one, and pjmedia_delay_buf_reset()
+     * will only take effect on the next pjmedia_delay_buf_get().
+     *
+     * If the platform has no lock-free support, the mutex will be used.
+     */
+    PJMEDIA_DELAY_BUF_LOCK_FREE = 2
 
 } pjmedia_delay_buf_flag;
 
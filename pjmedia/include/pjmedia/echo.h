@@ -237,6 +237,37 @@ typedef struct pjmedia_echo_stat
 PJ_DECL(void) pjmedia_echo_stat_default(pjmedia_echo_stat *stat);
 
 
+/**
+ * This structure describes one echo cancellation job to be processed by
+ * #pjmedia_echo_cancel_batch().
+ */
+typedef struct pjmedia_echo_job
+{
+    /**
+     * The Echo Canceller.
+     */
+    pjmedia_echo_state	*echo;
+
+    /**
+     * On input, the signal captured from the microphone. On output, the
+     * signal with the echo removed.
+     */
+    pj_int16_t		*rec_frm;
+
+    /**
+     * The reference (played) frame, or NULL to use the frames supplied
+     * with #pjmedia_echo_playback() as in #pjmedia_echo_capture().
+     */
+    const pj_int16_t	*play_frm;
+
+    /**
+     * On output, the status of the job.
+     */
+    pj_status_t		 status;
+
+} pjmedia_echo_job;
+
+
 /**
  * Create the echo canceller. 
  *
@@ -390,6 +421,25 @@ PJ_DECL(pj_status_t) pjmedia_echo_cancel( pjmedia_echo_state *echo,
 					  void *reserved );
 
 
+/**
+ * Perform echo cancellation of several Echo Cancellers in one call, e.g:
+ * to process the captured frames of all call legs of a gateway in one
+ * clock tick.
+ *
+ * @param count		Number of jobs.
+ * @param jobs		The echo cancellation jobs. On return, the status
+ *			of each job is set.
+ * @param options	Echo cancellation options, reserved for future use.
+ *			Put zero for now.
+ *
+ * @return		PJ_SUCCESS if all jobs succeeded, or otherwise the
+ *			status of the first failed job.
+ */
+PJ_DECL(pj_status_t) pjmedia_echo_cancel_batch(unsigned count,
+					       pjmedia_echo_job jobs[],
+					       unsigned options);
+
+
 PJ_END_DECL
 
 /**
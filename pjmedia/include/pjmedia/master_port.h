@@ -105,6 +105,22 @@ PJ_DECL(pj_status_t) pjmedia_master_port_start(pjmedia_master_port *m);
 PJ_DECL(pj_status_t) pjmedia_master_port_stop(pjmedia_master_port *m);
 
 
+/**
+ * Let the master port clock be run by a shared clock scheduler instead of
+ * by its own thread, see #pjmedia_clock_set_sched(). This must be called
+ * while the master port is stopped.
+ *
+ * @param m		The master port.
+ * @param sched		The clock scheduler, or NULL to run the clock in
+ *			its own thread.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_master_port_set_clock_sched(
+					    pjmedia_master_port *m,
+					    pjmedia_clock_sched *sched);
+
+
 /**
  * Poll the master port clock and execute the callback when the clock tick has
  * elapsed. This operation is only valid if the master port is created with
@@ -0,0 +1,226 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJMEDIA_RTP_PKT_POOL_H__
+#define __PJMEDIA_RTP_PKT_POOL_H__
+
+/**
+ * @file rtp_pkt_pool.h
+ * @brief RTP packet buffer pool.
+ */
+#include <pjmedia/types.h>
+
+
+PJ_BEGIN_DECL
+
+
+/**
+ * @defgroup PJMED_RTP_PKT_POOL RTP Packet Buffer Pool
+ * @ingroup PJMEDIA_TRANSPORT
+ * @brief Shared pool of reference counted RTP packet buffers.
+ * @{
+ *
+ * The RTP packet pool manages fixed size packet buffers which can be
+ * shared by many streams. Each buffer is aligned to
+ * #PJMEDIA_RTP_PKT_POOL_ALIGN bytes, so buffers used by different threads
+ * never share a cache line, and is reference counted, so a packet can be
+ * handed over to other components without copying. The buffer is returned
+ * to the pool once the last reference is released.
+ *
+ * The pool can also wrap a buffer owned by the caller, e.g: the receive
+ * buffer of a media transport, with pjmedia_rtp_pkt_pool_wrap(). This
+ * lets the packet be passed on with the same reference counting without
+ * copying it into a pool buffer.
+ */
+
+/**
+ * Opaque declaration of RTP packet pool.
+ */
+typedef struct pjmedia_rtp_pkt_pool pjmedia_rtp_pkt_pool;
+
+
+/**
+ * RTP packet buffer acquired from the pool.
+ */
+typedef struct pjmedia_rtp_pkt
+{
+    /** The packet buffer, aligned to #PJMEDIA_RTP_PKT_POOL_ALIGN. */
+    void		    *buf;
+
+    /** Capacity of the buffer, in bytes. */
+    unsigned		     size;
+
+    /** Length of the packet currently stored in the buffer, in bytes. */
+    unsigned		     len;
+
+    /** Internal: the pool owning this packet. */
+    pjmedia_rtp_pkt_pool    *pool;
+
+    /** Internal: reference counter. */
+    unsigned		     ref_cnt;
+
+    /** Internal: non-zero if the buffer is not owned by the pool. */
+    pj_bool_t		     wrapped;
+
+    /** Internal: next packet in the free list. */
+    struct pjmedia_rtp_pkt  *next;
+
+} pjmedia_rtp_pkt;
+
+
+/**
+ * RTP packet pool statistic.
+ */
+typedef struct pjmedia_rtp_pkt_pool_stat
+{
+    /** Number of buffers allocated by the pool. */
+    unsigned	capacity;
+
+    /** Number of buffers currently in use. */
+    unsigned	in_use;
+
+    /** Highest number of buffers in use at the same time. */
+    unsigned	max_in_use;
+
+    /** Number of successful acquire operations. */
+    unsigned	acquire_cnt;
+
+    /** Number of acquire operations failed because the pool is exhausted. */
+    unsigned	fail_cnt;
+
+} pjmedia_rtp_pkt_pool_stat;
+
+
+/**
+ * Create RTP packet pool.
+ *
+ * @param pool		Pool, its factory will be used to create the memory
+ *			pool for the packet buffers.
+ * @param name		Optional name for logging identification.
+ * @param buf_size	Size of each packet buffer, in bytes. This should
+ *			take into account the space needed by the transport,
+ *			e.g: #PJMEDIA_STREAM_RESV_PAYLOAD_LEN for the SRTP
+ *			trailer.
+ * @param init_cnt	Number of buffers to be allocated initially.
+ * @param max_cnt	Maximum number of buffers, the pool will grow on
+ *			demand up to this number. Zero means the same as
+ *			\a init_cnt.
+ * @param p_pkt_pool	Pointer to receive the packet pool.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_rtp_pkt_pool_create(pj_pool_t *pool,
+						 const char *name,
+						 unsigned buf_size,
+						 unsigned init_cnt,
+						 unsigned max_cnt,
+						 pjmedia_rtp_pkt_pool **p_pkt_pool);
+
+
+/**
+ * Acquire a packet buffer from the pool. The returned packet has its
+ * reference counter set to one and zero length.
+ *
+ * @param pkt_pool	The packet pool.
+ * @param p_pkt		Pointer to receive the packet.
+ *
+ * @return		PJ_SUCCESS on success, or PJ_ETOOMANY if all
+ *			buffers are in use.
+ */
+PJ_DECL(pj_status_t) pjmedia_rtp_pkt_pool_acquire(pjmedia_rtp_pkt_pool *pkt_pool,
+						  pjmedia_rtp_pkt **p_pkt);
+
+
+/**
+ * Wrap a buffer owned by the caller in a packet from the pool, without
+ * copying it. The returned packet has its reference counter set to one.
+ * The caller must keep the buffer valid until the last reference to the
+ * packet is released. Wrapped packets do not use the pool buffers, but
+ * are counted as in use and are limited by the maximum number of buffers
+ * of the pool as well.
+ *
+ * @param pkt_pool	The packet pool.
+ * @param buf		The buffer.
+ * @param size		Capacity of the buffer, in bytes.
+ * @param len		Length of the packet in the buffer, in bytes.
+ * @param p_pkt		Pointer to receive the packet.
+ *
+ * @return		PJ_SUCCESS on success, or PJ_ETOOMANY if the
+ *			pool is exhausted.
+ */
+PJ_DECL(pj_status_t) pjmedia_rtp_pkt_pool_wrap(pjmedia_rtp_pkt_pool *pkt_pool,
+					       void *buf,
+					       unsigned size,
+					       unsigned len,
+					       pjmedia_rtp_pkt **p_pkt);
+
+
+/**
+ * Add reference to the packet.
+ *
+ * @param pkt		The packet.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_rtp_pkt_add_ref(pjmedia_rtp_pkt *pkt);
+
+
+/**
+ * Release a reference to the packet. When the reference counter reaches
+ * zero, the packet is returned to the pool and must not be used anymore.
+ *
+ * @param pkt		The packet.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_rtp_pkt_dec_ref(pjmedia_rtp_pkt *pkt);
+
+
+/**
+ * Get the packet pool statistic.
+ *
+ * @param pkt_pool	The packet pool.
+ * @param stat		Pointer to receive the statistic.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_rtp_pkt_pool_get_stat(
+					pjmedia_rtp_pkt_pool *pkt_pool,
+					pjmedia_rtp_pkt_pool_stat *stat);
+
+
+/**
+ * Destroy the packet pool. All packets must have been released.
+ *
+ * @param pkt_pool	The packet pool.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_rtp_pkt_pool_destroy(
+					pjmedia_rtp_pkt_pool *pkt_pool);
+
+
+/**
+ * @}
+ */
+
+
+PJ_END_DECL
+
+
+#endif	/* __PJMEDIA_RTP_PKT_POOL_H__ */
@@ -32,6 +32,7 @@
 #include <pjmedia/port.h>
 #include <pjmedia/rtcp.h>
 #include <pjmedia/rtcp_fb.h>
+#include <pjmedia/rtp_pkt_pool.h>
 #include <pjmedia/transport.h>
 #include <pjmedia/vid_codec.h>
 #include <pjmedia/stream_common.h>
@@ -458,6 +459,39 @@ pjmedia_stream_get_rtp_session_info(pjmedia_stream *stream,
 			           pjmedia_stream_rtp_sess_info *session_info);
 
 
+/**
+ * Relay incoming RTP packets of the stream to another stream's transport,
+ * e.g: for pass-through or media relay use. Valid incoming RTP packets
+ * (including RFC 2833 DTMF) are sent unmodified to the transport of
+ * \a dst, without going through the jitter buffer, the decoder, or the
+ * encoder, so the decoding direction of this stream will only produce
+ * silence/PLC frames. Only packets from the verified remote address are
+ * relayed. The received buffer is passed on as is, wrapped in a packet
+ * from \a pkt_pool, which may be shared among many streams. When the
+ * transport of \a dst is SRTP, which protects the packet in place, the
+ * packet is copied to a buffer from the pool instead, so each buffer
+ * must be at least #PJMEDIA_MAX_MTU + #PJMEDIA_STREAM_RESV_PAYLOAD_LEN
+ * bytes.
+ *
+ * The application should pause the encoding direction of \a dst (or not
+ * connect it to any source), and must cancel the relay before
+ * destroying \a dst or \a pkt_pool. Cancelling the relay waits until
+ * the packets being relayed have been sent.
+ *
+ * @param stream	The media stream receiving the packets.
+ * @param dst		The stream whose transport the packets will be
+ *			sent to, or NULL to stop relaying.
+ * @param pkt_pool	The RTP packet pool. Must be specified when \a dst
+ *			is not NULL.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t)
+pjmedia_stream_set_rtp_relay(pjmedia_stream *stream,
+			     pjmedia_stream *dst,
+			     pjmedia_rtp_pkt_pool *pkt_pool);
+
+
 /**
  * @}
  */
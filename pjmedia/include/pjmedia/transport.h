@@ -661,6 +661,18 @@ struct pjmedia_transport_attach_param
      */
     void (*rtp_cb2)(pjmedia_tp_cb_param *param);
 
+    /**
+     * Number of writable bytes which are guaranteed to be available after
+     * the end of every RTP packet given to #pjmedia_transport_send_rtp().
+     * When this is non-zero, the stream also allows the transport to
+     * modify the outgoing RTP packet in place, for example SRTP transport
+     * may protect the packet directly in the stream buffer instead of
+     * copying it to its own buffer first.
+     *
+     * Default: 0 (the outgoing packet must not be modified).
+     */
+    unsigned rtp_tx_tailroom;
+
 };
 
 /**
@@ -71,6 +71,14 @@
 PJ_BEGIN_DECL
 
 
+/**
+ * Maximum number of bytes appended by SRTP protection to an RTP or RTCP
+ * packet with the supported crypto suites, i.e: the largest authentication
+ * tag plus the SRTCP index.
+ */
+#define PJMEDIA_SRTP_MAX_TRAILER_LEN	(16 + 4)
+
+
 /**
  * Crypto option.
  */
@@ -484,6 +492,85 @@ PJ_DECL(pj_status_t) pjmedia_transport_srtp_decrypt_pkt(pjmedia_transport *tp,
 							int *pkt_len);
 
 
+/**
+ * This is a utility function to encrypt RTP/RTCP packet in place using
+ * SRTP transport, without sending it to the member transport. The buffer
+ * must have room for the SRTP trailer after the packet, i.e: at least
+ * PJMEDIA_SRTP_MAX_TRAILER_LEN bytes.
+ *
+ * @param tp		The SRTP transport.
+ * @param is_rtp	Set to non-zero if the packet is RTP, otherwise set
+ *			to zero if the packet is RTCP.
+ * @param pkt		On input, it contains RTP or RTCP packet. On
+ *			output, it contains the SRTP/SRTCP packet.
+ * @param pkt_len	On input, specify the length of the packet. On
+ *			output, it will be filled with the actual length
+ *			of encrypted packet.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_transport_srtp_encrypt_pkt(pjmedia_transport *tp,
+							pj_bool_t is_rtp,
+							void *pkt,
+							int *pkt_len);
+
+
+/**
+ * This structure describes a packet to be encrypted by
+ * #pjmedia_transport_srtp_encrypt_pkts().
+ */
+typedef struct pjmedia_srtp_pkt
+{
+    /**
+     * The SRTP transport to encrypt the packet with.
+     */
+    pjmedia_transport	*tp;
+
+    /**
+     * Set to non-zero if the packet is RTP, or zero if it is RTCP.
+     */
+    pj_bool_t		 is_rtp;
+
+    /**
+     * The packet buffer, which must have room for the SRTP trailer
+     * (PJMEDIA_SRTP_MAX_TRAILER_LEN bytes) after the packet. The packet
+     * is encrypted in place.
+     */
+    void		*pkt;
+
+    /**
+     * On input, the length of the packet. On output, the length of
+     * the encrypted packet.
+     */
+    int			 len;
+
+    /**
+     * On output, the result of encrypting this packet.
+     */
+    pj_status_t		 status;
+
+} pjmedia_srtp_pkt;
+
+
+/**
+ * Encrypt a batch of RTP/RTCP packets in place, for example the packets
+ * of all streams in one conference tick, before sending them with
+ * the member transports. Consecutive packets which belong to the same
+ * SRTP transport are encrypted under a single lock acquisition, so
+ * callers should group the packets by transport.
+ *
+ * @param count		Number of packets.
+ * @param pkts		Array of packets. The individual encryption result
+ *			is returned in the \a status field of each entry.
+ *
+ * @return		PJ_SUCCESS if all packets are encrypted, or
+ *			the first error status otherwise.
+ */
+PJ_DECL(pj_status_t) pjmedia_transport_srtp_encrypt_pkts(
+						unsigned count,
+						pjmedia_srtp_pkt pkts[]);
+
+
 /**
  * Query member transport of SRTP.
  *
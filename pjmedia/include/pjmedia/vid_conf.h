@@ -118,6 +118,18 @@ typedef struct pjmedia_vid_conf_setting
      */
     unsigned		 layout;
 
+    /**
+     * Number of worker threads for rendering. When set, the frames of
+     * different sink ports will be rendered (i.e: scaled, converted, and
+     * composed) in parallel by the worker threads and the clock thread.
+     * Note that get_frame() and put_frame() of the ports are still invoked
+     * from the clock thread. Zero means all rendering is done by the
+     * clock thread.
+     *
+     * Default: PJMEDIA_VID_CONF_WORKER_CNT
+     */
+    unsigned		 worker_cnt;
+
 } pjmedia_vid_conf_setting;
 
 
@@ -76,6 +76,7 @@ static pj_status_t  g722_codec_init(pjmedia_codec *codec,
 static pj_status_t  g722_codec_open(pjmedia_codec *codec, 
 				    pjmedia_codec_param *attr );
 static pj_status_t  g722_codec_close(pjmedia_codec *codec );
+static pj_status_t  g722_codec_reset(pjmedia_codec *codec );
 static pj_status_t  g722_codec_modify(pjmedia_codec *codec, 
 				      const pjmedia_codec_param *attr );
 static pj_status_t  g722_codec_parse(pjmedia_codec *codec,
@@ -109,10 +110,12 @@ static pjmedia_codec_op g722_op =
     &g722_codec_encode,
     &g722_codec_decode,
 #if !PLC_DISABLED
-    &g722_codec_recover
+    &g722_codec_recover,
 #else
-    NULL
+    NULL,
 #endif
+    NULL,
+    &g722_codec_reset
 };
 
 /* Definition for G722 codec factory operations. */
@@ -384,26 +387,15 @@ static pj_status_t g722_alloc_codec(pjmedia_codec_factory *factory,
 }
 
 /*
- * Free codec.
+ * Clear the state of the previous session, since codec+plc will be reused
+ * next time.
  */
-static pj_status_t g722_dealloc_codec(pjmedia_codec_factory *factory, 
-				      pjmedia_codec *codec )
+static void g722_clear_state(struct g722_data *g722_data)
 {
-    struct g722_data *g722_data;
     int i;
 
-    PJ_ASSERT_RETURN(factory && codec, PJ_EINVAL);
-    PJ_ASSERT_RETURN(factory == &g722_codec_factory.base, PJ_EINVAL);
-
-    g722_data = (struct g722_data*) codec->codec_data;
-
-    /* Close codec, if it's not closed. */
-    g722_codec_close(codec);
-
 #if !PLC_DISABLED
-    /* Clear left samples in the PLC, since codec+plc will be reused
-     * next time.
-     */
+    /* Clear left samples in the PLC */
     for (i=0; i<2; ++i) {
 	pj_int16_t frame[SAMPLES_PER_FRAME];
 	pjmedia_zero_samples(frame, PJ_ARRAY_SIZE(frame));
@@ -415,6 +407,21 @@ static pj_status_t g722_dealloc_codec(pjmedia_codec_factory *factory,
 
     /* Re-init silence_period */
     pj_set_timestamp32(&g722_data->last_tx, 0, 0);
+}
+
+/*
+ * Free codec.
+ */
+static pj_status_t g722_dealloc_codec(pjmedia_codec_factory *factory, 
+				      pjmedia_codec *codec )
+{
+    PJ_ASSERT_RETURN(factory && codec, PJ_EINVAL);
+    PJ_ASSERT_RETURN(factory == &g722_codec_factory.base, PJ_EINVAL);
+
+    /* Close codec, if it's not closed. */
+    g722_codec_close(codec);
+
+    g722_clear_state((struct g722_data*) codec->codec_data);
 
     /* Put in the free list. */
     pj_mutex_lock(g722_codec_factory.mutex);
@@ -488,6 +495,17 @@ static pj_status_t g722_codec_close( pjmedia_codec *codec )
 }
 
 
+/*
+ * Reset codec to be kept in the codec manager's instance pool. The
+ * encoder and decoder are reinitialized in open().
+ */
+static pj_status_t g722_codec_reset( pjmedia_codec *codec )
+{
+    g722_clear_state((struct g722_data*) codec->codec_data);
+    return PJ_SUCCESS;
+}
+
+
 /*
  * Modify codec settings.
  */
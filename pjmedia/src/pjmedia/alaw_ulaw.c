@@ -298,3 +298,445 @@ PJ_DEF(unsigned char) pjmedia_ulaw2alaw(
 
 #endif	/* PJMEDIA_HAS_ALAW_ULAW_TABLE */
 
+
+
+/*
+ * Bulk conversion.
+ *
+ * The SIMD kernels compute the conversion without table, producing exactly
+ * the same result as the A-law/U-law tables (i.e: the lowest two bits of
+ * the linear samples are ignored when encoding). SSE2 is used on x86 and
+ * NEON on ARM.
+ */
+#if defined(PJMEDIA_HAS_G711_SIMD) && PJMEDIA_HAS_G711_SIMD!=0
+#   if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#	include <arm_neon.h>
+#	define G711_NEON	1
+#   else
+#	include <emmintrin.h>
+#	define G711_SSE2	1
+#   endif
+#endif
+
+#if defined(G711_SSE2)
+
+/*
+ * Get the segment and the four bits following the leading one bit of
+ * each 16-bit magnitude, as (exponent << 4) | mantissa of the magnitude
+ * converted to float, where exponent is the biased floating point exponent.
+ * The magnitude must be non-zero.
+ */
+static __m128i float_exp_mant(__m128i mag)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo, hi;
+
+    lo = _mm_castps_si128(_mm_cvtepi32_ps(_mm_unpacklo_epi16(mag, zero)));
+    hi = _mm_castps_si128(_mm_cvtepi32_ps(_mm_unpackhi_epi16(mag, zero)));
+    return _mm_packs_epi32(_mm_srli_epi32(lo, 19), _mm_srli_epi32(hi, 19));
+}
+
+/* Encode 8 samples to U-law, the result is in the low byte of each lane */
+static __m128i ulaw_encode8(__m128i x)
+{
+    __m128i neg, mag, val, mask;
+
+    /* 14-bit magnitude, clipped and biased, i.e: 33..8192 */
+    x = _mm_srai_epi16(x, 2);
+    neg = _mm_cmplt_epi16(x, _mm_setzero_si128());
+    mag = _mm_sub_epi16(_mm_xor_si128(x, neg), neg);
+    mag = _mm_min_epi16(mag, _mm_set1_epi16(8159));
+    mag = _mm_add_epi16(mag, _mm_set1_epi16(0x21));
+
+    /* Segment zero starts at 2^5, the segment and quantization bits are
+     * the float exponent and mantissa, saturated to 0x7F.
+     */
+    val = _mm_sub_epi16(float_exp_mant(mag), _mm_set1_epi16((127+5) << 4));
+    val = _mm_min_epi16(val, _mm_set1_epi16(0x7F));
+
+    /* Complement, and clear the sign bit for negative samples */
+    mask = _mm_xor_si128(_mm_set1_epi16(0xFF),
+			 _mm_and_si128(neg, _mm_set1_epi16(0x80)));
+    return _mm_xor_si128(val, mask);
+}
+
+/* Encode 8 samples to A-law, the result is in the low byte of each lane */
+static __m128i alaw_encode8(__m128i x)
+{
+    __m128i neg, mag, seg0, val, mask;
+
+    /* Magnitude of the sample with the lowest two bits cleared */
+    x = _mm_and_si128(x, _mm_set1_epi16(~3));
+    neg = _mm_cmplt_epi16(x, _mm_setzero_si128());
+    mag = _mm_subs_epi16(_mm_xor_si128(x, neg), neg);
+
+    /* Segment one starts at 2^8. Segment zero is linear like segment one,
+     * so put its magnitude in segment one and decrement the segment.
+     */
+    seg0 = _mm_cmplt_epi16(mag, _mm_set1_epi16(0x100));
+    mag = _mm_add_epi16(mag, _mm_and_si128(seg0, _mm_set1_epi16(0x100)));
+    val = _mm_sub_epi16(float_exp_mant(mag), _mm_set1_epi16((127+7) << 4));
+    val = _mm_add_epi16(val, _mm_slli_epi16(seg0, 4));
+
+    mask = _mm_xor_si128(_mm_set1_epi16(0xD5),
+			 _mm_and_si128(neg, _mm_set1_epi16(0x80)));
+    return _mm_xor_si128(val, mask);
+}
+
+/* 2^n for each lane, n is 0..7 */
+static __m128i pow2_epi16(__m128i n)
+{
+    __m128i one = _mm_set1_epi16(1);
+    __m128i p;
+
+    p = _mm_add_epi16(one, _mm_and_si128(
+		_mm_cmpeq_epi16(_mm_and_si128(n, one), one), one));
+    p = _mm_mullo_epi16(p, _mm_add_epi16(one, _mm_and_si128(
+		_mm_cmpeq_epi16(_mm_and_si128(n, _mm_set1_epi16(2)),
+				_mm_set1_epi16(2)),
+		_mm_set1_epi16(3))));
+    p = _mm_mullo_epi16(p, _mm_add_epi16(one, _mm_and_si128(
+		_mm_cmpeq_epi16(_mm_and_si128(n, _mm_set1_epi16(4)),
+				_mm_set1_epi16(4)),
+		_mm_set1_epi16(15))));
+    return p;
+}
+
+/* Decode 8 U-law codes, one in each 16-bit lane */
+static __m128i ulaw_decode8(__m128i u)
+{
+    __m128i t, sign;
+
+    u = _mm_xor_si128(u, _mm_set1_epi16(0xFF));
+    t = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(u, _mm_set1_epi16(0xF)),
+				     3),
+		      _mm_set1_epi16(0x84));
+    t = _mm_mullo_epi16(t, pow2_epi16(_mm_srli_epi16(
+			      _mm_and_si128(u, _mm_set1_epi16(0x70)), 4)));
+    t = _mm_sub_epi16(t, _mm_set1_epi16(0x84));
+
+    /* Negate when the sign bit is set */
+    sign = _mm_cmpeq_epi16(_mm_and_si128(u, _mm_set1_epi16(0x80)),
+			   _mm_set1_epi16(0x80));
+    return _mm_sub_epi16(_mm_xor_si128(t, sign), sign);
+}
+
+/* Decode 8 A-law codes, one in each 16-bit lane */
+static __m128i alaw_decode8(__m128i a)
+{
+    __m128i t, seg, seg0, sign;
+
+    a = _mm_xor_si128(a, _mm_set1_epi16(0x55));
+    seg = _mm_srli_epi16(_mm_and_si128(a, _mm_set1_epi16(0x70)), 4);
+    seg0 = _mm_cmpeq_epi16(seg, _mm_setzero_si128());
+
+    /* t = ((a & 0xF) << 4) + (seg==0? 8 : 0x108), shifted by seg-1 */
+    t = _mm_slli_epi16(_mm_and_si128(a, _mm_set1_epi16(0xF)), 4);
+    t = _mm_add_epi16(t, _mm_or_si128(
+		_mm_and_si128(seg0, _mm_set1_epi16(8)),
+		_mm_andnot_si128(seg0, _mm_set1_epi16(0x108))));
+    seg = _mm_sub_epi16(seg, _mm_andnot_si128(seg0, _mm_set1_epi16(1)));
+    t = _mm_mullo_epi16(t, pow2_epi16(seg));
+
+    /* Negate when the sign bit is clear */
+    sign = _mm_cmpeq_epi16(_mm_and_si128(a, _mm_set1_epi16(0x80)),
+			   _mm_setzero_si128());
+    return _mm_sub_epi16(_mm_xor_si128(t, sign), sign);
+}
+
+/* Encode 16 samples to U-law */
+static void ulaw_encode16(pj_uint8_t *dst, const pj_int16_t *src)
+{
+    __m128i lo = ulaw_encode8(_mm_loadu_si128((const __m128i*)src));
+    __m128i hi = ulaw_encode8(_mm_loadu_si128((const __m128i*)(src + 8)));
+    _mm_storeu_si128((__m128i*)dst, _mm_packus_epi16(lo, hi));
+}
+
+/* Encode 16 samples to A-law */
+static void alaw_encode16(pj_uint8_t *dst, const pj_int16_t *src)
+{
+    __m128i lo = alaw_encode8(_mm_loadu_si128((const __m128i*)src));
+    __m128i hi = alaw_encode8(_mm_loadu_si128((const __m128i*)(src + 8)));
+    _mm_storeu_si128((__m128i*)dst, _mm_packus_epi16(lo, hi));
+}
+
+/* Decode 16 U-law codes */
+static void ulaw_decode16(pj_int16_t *dst, const pj_uint8_t *src)
+{
+    __m128i v = _mm_loadu_si128((const __m128i*)src);
+    __m128i zero = _mm_setzero_si128();
+
+    _mm_storeu_si128((__m128i*)dst, ulaw_decode8(_mm_unpacklo_epi8(v, zero)));
+    _mm_storeu_si128((__m128i*)(dst + 8),
+		     ulaw_decode8(_mm_unpackhi_epi8(v, zero)));
+}
+
+/* Decode 16 A-law codes */
+static void alaw_decode16(pj_int16_t *dst, const pj_uint8_t *src)
+{
+    __m128i v = _mm_loadu_si128((const __m128i*)src);
+    __m128i zero = _mm_setzero_si128();
+
+    _mm_storeu_si128((__m128i*)dst, alaw_decode8(_mm_unpacklo_epi8(v, zero)));
+    _mm_storeu_si128((__m128i*)(dst + 8),
+		     alaw_decode8(_mm_unpackhi_epi8(v, zero)));
+}
+
+#elif defined(G711_NEON)
+
+/*
+ * (segment << 4) | quantization bits of each 16-bit magnitude, where the
+ * segment is the position of the leading one bit minus seg_base, and the
+ * quantization bits are the four bits following the leading one bit. The
+ * magnitude must be at least 2^4.
+ */
+static uint16x8_t seg_quant(uint16x8_t mag, unsigned seg_base)
+{
+    uint16x8_t pos, quant;
+
+    pos = vsubq_u16(vdupq_n_u16(15), vclzq_u16(mag));
+    quant = vshlq_u16(mag, vreinterpretq_s16_u16(
+				vsubq_u16(vdupq_n_u16(4), pos)));
+    quant = vandq_u16(quant, vdupq_n_u16(0xF));
+    return vorrq_u16(vshlq_n_u16(vsubq_u16(pos, vdupq_n_u16(seg_base)), 4),
+		     quant);
+}
+
+/* Encode 8 samples to U-law, the result is in the low byte of each lane */
+static uint16x8_t ulaw_encode8(int16x8_t x)
+{
+    uint16x8_t neg, mag, val, mask;
+
+    /* 14-bit magnitude, clipped and biased, i.e: 33..8192 */
+    x = vshrq_n_s16(x, 2);
+    neg = vcltq_s16(x, vdupq_n_s16(0));
+    mag = vreinterpretq_u16_s16(vabsq_s16(x));
+    mag = vminq_u16(mag, vdupq_n_u16(8159));
+    mag = vaddq_u16(mag, vdupq_n_u16(0x21));
+
+    /* Segment zero starts at 2^5, saturate to 0x7F */
+    val = vminq_u16(seg_quant(mag, 5), vdupq_n_u16(0x7F));
+
+    /* Complement, and clear the sign bit for negative samples */
+    mask = veorq_u16(vdupq_n_u16(0xFF), vandq_u16(neg, vdupq_n_u16(0x80)));
+    return veorq_u16(val, mask);
+}
+
+/* Encode 8 samples to A-law, the result is in the low byte of each lane */
+static uint16x8_t alaw_encode8(int16x8_t x)
+{
+    uint16x8_t neg, mag, seg0, val, mask;
+
+    /* Magnitude of the sample with the lowest two bits cleared */
+    x = vandq_s16(x, vdupq_n_s16(~3));
+    neg = vcltq_s16(x, vdupq_n_s16(0));
+    mag = vreinterpretq_u16_s16(vqabsq_s16(x));
+
+    /* Segment one starts at 2^8. Segment zero is linear like segment one,
+     * so put its magnitude in segment one and decrement the segment.
+     */
+    seg0 = vcltq_u16(mag, vdupq_n_u16(0x100));
+    mag = vaddq_u16(mag, vandq_u16(seg0, vdupq_n_u16(0x100)));
+    val = vaddq_u16(seg_quant(mag, 7), vshlq_n_u16(seg0, 4));
+
+    mask = veorq_u16(vdupq_n_u16(0xD5), vandq_u16(neg, vdupq_n_u16(0x80)));
+    return veorq_u16(val, mask);
+}
+
+/* Decode 8 U-law codes, one in each 16-bit lane */
+static int16x8_t ulaw_decode8(uint16x8_t u)
+{
+    uint16x8_t t;
+    int16x8_t v;
+
+    u = veorq_u16(u, vdupq_n_u16(0xFF));
+    t = vaddq_u16(vshlq_n_u16(vandq_u16(u, vdupq_n_u16(0xF)), 3),
+		  vdupq_n_u16(0x84));
+    t = vshlq_u16(t, vreinterpretq_s16_u16(
+			vshrq_n_u16(vandq_u16(u, vdupq_n_u16(0x70)), 4)));
+    v = vreinterpretq_s16_u16(vsubq_u16(t, vdupq_n_u16(0x84)));
+
+    /* Negate when the sign bit is set */
+    return vbslq_s16(vtstq_u16(u, vdupq_n_u16(0x80)), vnegq_s16(v), v);
+}
+
+/* Decode 8 A-law codes, one in each 16-bit lane */
+static int16x8_t alaw_decode8(uint16x8_t a)
+{
+    uint16x8_t t, seg, seg0;
+    int16x8_t v;
+
+    a = veorq_u16(a, vdupq_n_u16(0x55));
+    seg = vshrq_n_u16(vandq_u16(a, vdupq_n_u16(0x70)), 4);
+    seg0 = vceqq_u16(seg, vdupq_n_u16(0));
+
+    /* t = ((a & 0xF) << 4) + (seg==0? 8 : 0x108), shifted by seg-1 */
+    t = vshlq_n_u16(vandq_u16(a, vdupq_n_u16(0xF)), 4);
+    t = vaddq_u16(t, vbslq_u16(seg0, vdupq_n_u16(8), vdupq_n_u16(0x108)));
+    seg = vsubq_u16(seg, vbicq_u16(vdupq_n_u16(1), seg0));
+    v = vreinterpretq_s16_u16(vshlq_u16(t, vreinterpretq_s16_u16(seg)));
+
+    /* Negate when the sign bit is clear */
+    return vbslq_s16(vtstq_u16(a, vdupq_n_u16(0x80)), v, vnegq_s16(v));
+}
+
+/* Encode 16 samples to U-law */
+static void ulaw_encode16(pj_uint8_t *dst, const pj_int16_t *src)
+{
+    vst1q_u8(dst, vcombine_u8(vmovn_u16(ulaw_encode8(vld1q_s16(src))),
+			      vmovn_u16(ulaw_encode8(vld1q_s16(src + 8)))));
+}
+
+/* Encode 16 samples to A-law */
+static void alaw_encode16(pj_uint8_t *dst, const pj_int16_t *src)
+{
+    vst1q_u8(dst, vcombine_u8(vmovn_u16(alaw_encode8(vld1q_s16(src))),
+			      vmovn_u16(alaw_encode8(vld1q_s16(src + 8)))));
+}
+
+/* Decode 16 U-law codes */
+static void ulaw_decode16(pj_int16_t *dst, const pj_uint8_t *src)
+{
+    uint8x16_t v = vld1q_u8(src);
+
+    vst1q_s16(dst, ulaw_decode8(vmovl_u8(vget_low_u8(v))));
+    vst1q_s16(dst + 8, ulaw_decode8(vmovl_u8(vget_high_u8(v))));
+}
+
+/* Decode 16 A-law codes */
+static void alaw_decode16(pj_int16_t *dst, const pj_uint8_t *src)
+{
+    uint8x16_t v = vld1q_u8(src);
+
+    vst1q_s16(dst, alaw_decode8(vmovl_u8(vget_low_u8(v))));
+    vst1q_s16(dst + 8, alaw_decode8(vmovl_u8(vget_high_u8(v))));
+}
+
+#endif	/* G711_NEON */
+
+
+#if defined(PJMEDIA_HAS_G711_SIMD) && PJMEDIA_HAS_G711_SIMD!=0
+
+/* Number of samples processed by each SIMD kernel iteration */
+#define SIMD_CNT	16
+
+PJ_DEF(void) pjmedia_ulaw_encode_simd(pj_uint8_t *dst, const pj_int16_t *src,
+				      pj_size_t count)
+{
+    pj_size_t i;
+
+    for (i = 0; i + SIMD_CNT <= count; i += SIMD_CNT)
+	ulaw_encode16(dst + i, src + i);
+    for (; i < count; ++i)
+	dst[i] = (pj_uint8_t) pjmedia_linear2ulaw(src[i]);
+}
+
+
+PJ_DEF(void) pjmedia_alaw_encode_simd(pj_uint8_t *dst, const pj_int16_t *src,
+				      pj_size_t count)
+{
+    pj_size_t i;
+
+    for (i = 0; i + SIMD_CNT <= count; i += SIMD_CNT)
+	alaw_encode16(dst + i, src + i);
+    for (; i < count; ++i)
+	dst[i] = (pj_uint8_t) pjmedia_linear2alaw(src[i]);
+}
+
+
+PJ_DEF(void) pjmedia_ulaw_decode_simd(pj_int16_t *dst, const pj_uint8_t *src,
+				      pj_size_t len)
+{
+    pj_size_t i;
+
+    for (i = 0; i + SIMD_CNT <= len; i += SIMD_CNT)
+	ulaw_decode16(dst + i, src + i);
+    for (; i < len; ++i)
+	dst[i] = (pj_int16_t) pjmedia_ulaw2linear(src[i]);
+}
+
+
+PJ_DEF(void) pjmedia_alaw_decode_simd(pj_int16_t *dst, const pj_uint8_t *src,
+				      pj_size_t len)
+{
+    pj_size_t i;
+
+    for (i = 0; i + SIMD_CNT <= len; i += SIMD_CNT)
+	alaw_decode16(dst + i, src + i);
+    for (; i < len; ++i)
+	dst[i] = (pj_int16_t) pjmedia_alaw2linear(src[i]);
+}
+
+
+/*
+ * The frames are converted block by block across all frames, so the
+ * constants stay in registers for the whole batch. The remaining samples
+ * of each frame are converted with the table.
+ */
+PJ_DEF(void) pjmedia_ulaw_encode_frames(unsigned frame_cnt,
+					pj_uint8_t *const dst[],
+					const pj_int16_t *const src[],
+					pj_size_t count)
+{
+    pj_size_t i;
+    unsigned f;
+
+    for (i = 0; i + SIMD_CNT <= count; i += SIMD_CNT) {
+	for (f = 0; f < frame_cnt; ++f)
+	    ulaw_encode16(dst[f] + i, src[f] + i);
+    }
+    for (f = 0; f < frame_cnt; ++f) {
+	pj_size_t j;
+
+	for (j = i; j < count; ++j)
+	    dst[f][j] = (pj_uint8_t) pjmedia_linear2ulaw(src[f][j]);
+    }
+}
+
+
+PJ_DEF(void) pjmedia_alaw_encode_frames(unsigned frame_cnt,
+					pj_uint8_t *const dst[],
+					const pj_int16_t *const src[],
+					pj_size_t count)
+{
+    pj_size_t i;
+    unsigned f;
+
+    for (i = 0; i + SIMD_CNT <= count; i += SIMD_CNT) {
+	for (f = 0; f < frame_cnt; ++f)
+	    alaw_encode16(dst[f] + i, src[f] + i);
+    }
+    for (f = 0; f < frame_cnt; ++f) {
+	pj_size_t j;
+
+	for (j = i; j < count; ++j)
+	    dst[f][j] = (pj_uint8_t) pjmedia_linear2alaw(src[f][j]);
+    }
+}
+
+#else	/* PJMEDIA_HAS_G711_SIMD */
+
+PJ_DEF(void) pjmedia_ulaw_encode_frames(unsigned frame_cnt,
+					pj_uint8_t *const dst[],
+					const pj_int16_t *const src[],
+					pj_size_t count)
+{
+    unsigned f;
+
+    for (f = 0; f < frame_cnt; ++f)
+	pjmedia_ulaw_encode(dst[f], src[f], count);
+}
+
+
+PJ_DEF(void) pjmedia_alaw_encode_frames(unsigned frame_cnt,
+					pj_uint8_t *const dst[],
+					const pj_int16_t *const src[],
+					pj_size_t count)
+{
+    unsigned f;
+
+    for (f = 0; f < frame_cnt; ++f)
+	pjmedia_alaw_encode(dst[f], src[f], count);
+}
+
+#endif	/* PJMEDIA_HAS_G711_SIMD */
@@ -20,6 +20,7 @@
 #include <pjmedia/clock.h>
 #include <pjmedia/errno.h>
 #include <pj/assert.h>
+#include <pj/list.h>
 #include <pj/lock.h>
 #include <pj/os.h>
 #include <pj/pool.h>
@@ -107,8 +108,18 @@ pjmedia_clock_src_get_time_msec( const pjmedia_clock_src *clocksrc )
  * Implementation of media clock with OS thread.
  */
 
+typedef struct sched_worker sched_worker;
+
+/* Entry in the list of clocks attached to a scheduler */
+typedef struct sched_node
+{
+    PJ_DECL_LIST_MEMBER(struct sched_node);
+    pjmedia_clock	    *clock;
+} sched_node;
+
 struct pjmedia_clock
 {
+    PJ_DECL_LIST_MEMBER(struct pjmedia_clock);
     pj_pool_t		    *pool;
     pj_timestamp	     freq;
     pj_timestamp	     interval;
@@ -123,14 +134,65 @@ struct pjmedia_clock
     pj_bool_t		     running;
     pj_bool_t		     quitting;
     pj_lock_t		    *lock;
+
+    /* Scheduler running this clock, and the worker it is assigned to
+     * while the clock is started.
+     */
+    pjmedia_clock_sched	    *sched;
+    sched_worker	    *worker;
+    sched_node		     sched_node;
+};
+
+
+/*
+ * Worker thread of media clock scheduler.
+ */
+struct sched_worker
+{
+    pjmedia_clock_sched	    *sched;
+    pj_thread_t		    *thread;
+    pj_lock_t		    *lock;
+    pj_list		     clocks;	    /**< List of scheduled clocks.  */
+    pjmedia_clock	    *iter_next;	    /**< Next clock to iterate.	    */
+    pjmedia_clock	    *cb_clock;	    /**< Clock in callback, if any. */
+    unsigned		     clock_cnt;
+
+    /* Statistics */
+    pj_timestamp	     stat_start;
+    pj_timestamp	     busy;
+    pj_uint32_t		     tick_cnt;
+    pj_uint32_t		     overrun_cnt;
+    pj_uint64_t		     max_late;
+};
+
+struct pjmedia_clock_sched
+{
+    pj_pool_t		    *pool;
+    pj_timestamp	     freq;
+    unsigned		     options;
+    pj_bool_t		     quitting;
+    unsigned		     worker_cnt;
+    sched_worker	    *workers;
+    pj_lock_t		    *lock;	    /**< Protects attached list.    */
+    sched_node		     attached;	    /**< Clocks using the scheduler.*/
 };
 
 
 static int clock_thread(void *arg);
+static int sched_worker_thread(void *arg);
+static pj_status_t sched_add_clock(pjmedia_clock_sched *sched,
+				   pjmedia_clock *clock);
+static void sched_remove_clock(pjmedia_clock *clock);
+static void sched_detach_clock(pjmedia_clock *clock);
 
 #define MAX_JUMP_MSEC	500
 #define USEC_IN_SEC	(pj_uint64_t)1000000
 
+/* Maximum time a scheduler worker sleeps, so that newly added clocks with
+ * an earlier deadline are picked up in time.
+ */
+#define SCHED_MAX_SLEEP_MSEC	5
+
 /*
  * Create media clock.
  */
@@ -186,6 +248,9 @@ PJ_DEF(pj_status_t) pjmedia_clock_create2(pj_pool_t *pool,
     clock->thread = NULL;
     clock->running = PJ_FALSE;
     clock->quitting = PJ_FALSE;
+    clock->sched = NULL;
+    clock->worker = NULL;
+    clock->sched_node.clock = clock;
     
     /* I don't think we need a mutex, so we'll use null. */
     status = pj_lock_create_null_mutex(pool, "clock", &clock->lock);
@@ -219,6 +284,13 @@ PJ_DEF(pj_status_t) pjmedia_clock_start(pjmedia_clock *clock)
     clock->running = PJ_TRUE;
     clock->quitting = PJ_FALSE;
 
+    if (clock->sched) {
+	status = sched_add_clock(clock->sched, clock);
+	if (status != PJ_SUCCESS)
+	    clock->running = PJ_FALSE;
+	return status;
+    }
+
     if ((clock->options & PJMEDIA_CLOCK_NO_ASYNC) == 0 && !clock->thread) {
 	status = pj_thread_create(clock->pool, "clock", &clock_thread, clock,
 				  0, 0, &clock->thread);
@@ -242,6 +314,9 @@ PJ_DEF(pj_status_t) pjmedia_clock_stop(pjmedia_clock *clock)
     clock->running = PJ_FALSE;
     clock->quitting = PJ_TRUE;
 
+    if (clock->worker)
+	sched_remove_clock(clock);
+
     if (clock->thread) {
 	if (pj_thread_join(clock->thread) == PJ_SUCCESS) {
 	    pj_thread_destroy(clock->thread);
@@ -404,6 +479,12 @@ PJ_DEF(pj_status_t) pjmedia_clock_destroy(pjmedia_clock *clock)
     clock->running = PJ_FALSE;
     clock->quitting = PJ_TRUE;
 
+    if (clock->worker)
+	sched_remove_clock(clock);
+
+    if (clock->sched)
+	sched_detach_clock(clock);
+
     if (clock->thread) {
 	pj_thread_join(clock->thread);
 	pj_thread_destroy(clock->thread);
@@ -421,3 +502,368 @@ PJ_DEF(pj_status_t) pjmedia_clock_destroy(pjmedia_clock *clock)
 }
 
 
+
+
+/*
+ * Media clock scheduler.
+ */
+
+PJ_DEF(void) pjmedia_clock_sched_param_default(
+					    pjmedia_clock_sched_param *param)
+{
+    pj_bzero(param, sizeof(*param));
+    param->thread_cnt = 1;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_clock_sched_create(
+				    pj_pool_t *pool,
+				    const pjmedia_clock_sched_param *param,
+				    pjmedia_clock_sched **p_sched)
+{
+    pjmedia_clock_sched_param def_param;
+    pjmedia_clock_sched *sched;
+    pj_pool_t *sched_pool;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && p_sched, PJ_EINVAL);
+
+    if (!param) {
+	pjmedia_clock_sched_param_default(&def_param);
+	param = &def_param;
+    }
+    PJ_ASSERT_RETURN(param->thread_cnt > 0, PJ_EINVAL);
+
+    sched_pool = pj_pool_create(pool->factory, "clksched%p", 512, 512, NULL);
+    PJ_ASSERT_RETURN(sched_pool, PJ_ENOMEM);
+    sched = PJ_POOL_ZALLOC_T(sched_pool, pjmedia_clock_sched);
+    sched->pool = sched_pool;
+    sched->options = param->options;
+    pj_list_init(&sched->attached);
+
+    status = pj_get_timestamp_freq(&sched->freq);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(sched_pool);
+	return status;
+    }
+
+    status = pj_lock_create_simple_mutex(sched_pool, "clksched",
+					 &sched->lock);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(sched_pool);
+	return status;
+    }
+
+    sched->workers = (sched_worker*)
+		     pj_pool_calloc(sched_pool, param->thread_cnt,
+				    sizeof(sched_worker));
+
+    for (i = 0; i < param->thread_cnt; ++i) {
+	sched_worker *w = &sched->workers[i];
+
+	w->sched = sched;
+	pj_list_init(&w->clocks);
+	pj_get_timestamp(&w->stat_start);
+
+	/* Recursive, as clock may be stopped from its own callback */
+	status = pj_lock_create_recursive_mutex(sched_pool, "clksched",
+						&w->lock);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+	status = pj_thread_create(sched_pool, "clksched%p",
+				  &sched_worker_thread, w, 0, 0, &w->thread);
+	if (status != PJ_SUCCESS) {
+	    pj_lock_destroy(w->lock);
+	    goto on_error;
+	}
+
+	++sched->worker_cnt;
+    }
+
+    *p_sched = sched;
+    return PJ_SUCCESS;
+
+on_error:
+    pjmedia_clock_sched_destroy(sched);
+    return status;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_clock_sched_get_stat(
+				    pjmedia_clock_sched *sched,
+				    pjmedia_clock_sched_stat *stat,
+				    pj_bool_t reset)
+{
+    pj_uint64_t max_late = 0;
+    unsigned i;
+
+    PJ_ASSERT_RETURN(sched && stat, PJ_EINVAL);
+
+    pj_bzero(stat, sizeof(*stat));
+    stat->thread_cnt = sched->worker_cnt;
+
+    for (i = 0; i < sched->worker_cnt; ++i) {
+	sched_worker *w = &sched->workers[i];
+	pj_timestamp now;
+	unsigned load = 0;
+
+	pj_lock_acquire(w->lock);
+
+	pj_get_timestamp(&now);
+	if (now.u64 > w->stat_start.u64)
+	    load = (unsigned)(w->busy.u64 * 100 /
+			      (now.u64 - w->stat_start.u64));
+
+	stat->clock_cnt += w->clock_cnt;
+	stat->tick_cnt += w->tick_cnt;
+	stat->overrun_cnt += w->overrun_cnt;
+	if (w->max_late > max_late)
+	    max_late = w->max_late;
+	if (load > stat->max_load_pct)
+	    stat->max_load_pct = load;
+
+	if (reset) {
+	    w->stat_start = now;
+	    w->busy.u64 = 0;
+	    w->tick_cnt = w->overrun_cnt = 0;
+	    w->max_late = 0;
+	}
+
+	pj_lock_release(w->lock);
+    }
+
+    stat->max_late_usec = (unsigned)(max_late * USEC_IN_SEC /
+				     sched->freq.u64);
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_clock_sched_destroy(pjmedia_clock_sched *sched)
+{
+    unsigned i;
+
+    PJ_ASSERT_RETURN(sched, PJ_EINVAL);
+
+    sched->quitting = PJ_TRUE;
+
+    for (i = 0; i < sched->worker_cnt; ++i) {
+	sched_worker *w = &sched->workers[i];
+
+	pj_thread_join(w->thread);
+	pj_thread_destroy(w->thread);
+
+	/* Stop clocks which are still scheduled */
+	while (!pj_list_empty(&w->clocks)) {
+	    pjmedia_clock *clock = (pjmedia_clock*)w->clocks.next;
+	    clock->running = PJ_FALSE;
+	    sched_remove_clock(clock);
+	}
+
+	pj_lock_destroy(w->lock);
+    }
+
+    /* Detach all clocks, including the stopped ones, so that they will
+     * run their own thread when started again.
+     */
+    while (!pj_list_empty(&sched->attached))
+	sched_detach_clock(sched->attached.next->clock);
+
+    pj_lock_destroy(sched->lock);
+    pj_pool_release(sched->pool);
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_clock_set_sched(pjmedia_clock *clock,
+					    pjmedia_clock_sched *sched)
+{
+    PJ_ASSERT_RETURN(clock, PJ_EINVAL);
+    PJ_ASSERT_RETURN((clock->options & PJMEDIA_CLOCK_NO_ASYNC) == 0,
+		     PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(!clock->running && !clock->worker && !clock->thread,
+		     PJ_EINVALIDOP);
+
+    if (clock->sched == sched)
+	return PJ_SUCCESS;
+
+    if (clock->sched)
+	sched_detach_clock(clock);
+
+    if (sched) {
+	pj_lock_acquire(sched->lock);
+	pj_list_push_back(&sched->attached, &clock->sched_node);
+	clock->sched = sched;
+	pj_lock_release(sched->lock);
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+/* Remove the clock from the list of clocks attached to its scheduler */
+static void sched_detach_clock(pjmedia_clock *clock)
+{
+    pjmedia_clock_sched *sched = clock->sched;
+
+    pj_lock_acquire(sched->lock);
+    pj_list_erase(&clock->sched_node);
+    clock->sched = NULL;
+    pj_lock_release(sched->lock);
+}
+
+
+/* Assign the clock to the worker with the least number of clocks */
+static pj_status_t sched_add_clock(pjmedia_clock_sched *sched,
+				   pjmedia_clock *clock)
+{
+    sched_worker *w = NULL;
+    unsigned i, min_cnt = 0;
+
+    PJ_ASSERT_RETURN(!sched->quitting, PJ_EINVALIDOP);
+
+    if (clock->worker)
+	return PJ_SUCCESS;
+
+    for (i = 0; i < sched->worker_cnt; ++i) {
+	unsigned cnt;
+
+	pj_lock_acquire(sched->workers[i].lock);
+	cnt = sched->workers[i].clock_cnt;
+	pj_lock_release(sched->workers[i].lock);
+
+	if (!w || cnt < min_cnt) {
+	    w = &sched->workers[i];
+	    min_cnt = cnt;
+	}
+    }
+
+    pj_lock_acquire(w->lock);
+    pj_list_push_back(&w->clocks, clock);
+    ++w->clock_cnt;
+    clock->worker = w;
+    pj_lock_release(w->lock);
+
+    return PJ_SUCCESS;
+}
+
+
+/* Remove the clock from its worker. When this returns, the clock callback
+ * is not running (unless this is called from the callback itself).
+ */
+static void sched_remove_clock(pjmedia_clock *clock)
+{
+    sched_worker *w = clock->worker;
+
+    pj_lock_acquire(w->lock);
+    if (w->iter_next == clock)
+	w->iter_next = clock->next;
+    pj_list_erase(clock);
+    --w->clock_cnt;
+    clock->worker = NULL;
+
+    /* Wait until the callback of this clock returns. Callbacks are invoked
+     * without holding the worker lock, so release it while waiting.
+     */
+    while (w->cb_clock == clock && pj_thread_this() != w->thread) {
+	pj_lock_release(w->lock);
+	pj_thread_sleep(1);
+	pj_lock_acquire(w->lock);
+    }
+    pj_lock_release(w->lock);
+}
+
+
+/*
+ * Scheduler worker thread
+ */
+static int sched_worker_thread(void *arg)
+{
+    sched_worker *w = (sched_worker*) arg;
+    pjmedia_clock_sched *sched = w->sched;
+    pj_uint64_t max_sleep = SCHED_MAX_SLEEP_MSEC * sched->freq.u64 / 1000;
+
+    /* Set thread priority to maximum unless not wanted. */
+    if ((sched->options & PJMEDIA_CLOCK_NO_HIGHEST_PRIO) == 0) {
+	int max = pj_thread_get_prio_max(pj_thread_this());
+	if (max > 0)
+	    pj_thread_set_prio(pj_thread_this(), max);
+    }
+
+    while (!sched->quitting) {
+	pj_timestamp now, next_wake;
+	pjmedia_clock *clock;
+	pjmedia_clock_callback *cb;
+	void *user_data;
+
+	pj_get_timestamp(&now);
+	next_wake.u64 = now.u64 + max_sleep;
+
+	pj_lock_acquire(w->lock);
+
+	clock = (pjmedia_clock*)w->clocks.next;
+	while (clock != (pjmedia_clock*)&w->clocks) {
+	    w->iter_next = clock->next;
+
+	    if (clock->running && clock->next_tick.u64 <= now.u64) {
+		pj_timestamp ts, start, end;
+		pj_uint64_t late = now.u64 - clock->next_tick.u64;
+
+		if (late > clock->interval.u64)
+		    ++w->overrun_cnt;
+		if (late > w->max_late)
+		    w->max_late = late;
+		++w->tick_cnt;
+
+		/* Advance the clock before calling the callback, as the
+		 * clock may be stopped or destroyed by the callback.
+		 */
+		ts = clock->timestamp;
+		clock->timestamp.u64 += clock->timestamp_inc;
+		clock_calc_next_tick(clock, &now);
+		if (clock->next_tick.u64 < next_wake.u64)
+		    next_wake = clock->next_tick;
+
+		/* Call the callback without holding the worker lock, so
+		 * that starting, stopping or querying clocks does not wait
+		 * for a whole tick, and so that the callback may take its
+		 * own locks. The clock is pinned with cb_clock, so removing
+		 * it waits for the callback to return, and iter_next is
+		 * kept valid by sched_remove_clock().
+		 */
+		cb = clock->cb;
+		user_data = clock->user_data;
+		w->cb_clock = clock;
+		pj_lock_release(w->lock);
+
+		start = now;
+		if (cb)
+		    (*cb)(&ts, user_data);
+		pj_get_timestamp(&end);
+
+		pj_lock_acquire(w->lock);
+		w->cb_clock = NULL;
+		w->busy.u64 += (end.u64 - start.u64);
+		now = end;
+
+	    } else if (clock->next_tick.u64 < next_wake.u64) {
+		next_wake = clock->next_tick;
+	    }
+
+	    clock = w->iter_next;
+	}
+	w->iter_next = NULL;
+
+	pj_lock_release(w->lock);
+
+	/* Sleep until the earliest deadline */
+	pj_get_timestamp(&now);
+	if (now.u64 < next_wake.u64)
+	    pj_thread_sleep(pj_elapsed_msec(&now, &next_wake));
+    }
+
+    return 0;
+}
@@ -21,6 +21,7 @@
 #include <pjmedia/errno.h>
 #include <pj/array.h>
 #include <pj/assert.h>
+#include <pj/hash.h>
 #include <pj/log.h>
 #include <pj/string.h>
 
@@ -36,10 +37,87 @@ struct pjmedia_codec_default_param
 };
 
 
+/* Allocated instance of a codec that may be kept in the instance pool */
+struct inst_entry
+{
+    PJ_DECL_LIST_MEMBER(struct inst_entry);
+    pjmedia_codec	    *codec;
+    pj_hash_entry_buf	     hbuf;
+};
+
+
+/* Idle instances of a codec, kept by the codec manager to be reused */
+struct pjmedia_codec_inst_pool
+{
+    pjmedia_codec_factory   *factory;
+    unsigned		     max_idle;
+    pjmedia_codec	     idle_list;
+    pj_hash_table_t	    *active;	/* Allocated poolable instances    */
+    struct inst_entry	     free_entry;/* Unused entries		    */
+    pjmedia_codec_pool_stat  stat;
+};
+
+
 /* Sort codecs in codec manager based on priorities */
 static void sort_codecs(pjmedia_codec_mgr *mgr);
 
 
+/* Return idle instances exceeding the limit to the factory. Codec manager
+ * mutex must be held.
+ */
+static void trim_inst_pool(struct pjmedia_codec_inst_pool *ip,
+			   unsigned max_idle)
+{
+    while (ip->stat.idle_cnt > max_idle) {
+	pjmedia_codec *codec = ip->idle_list.next;
+
+	pj_list_erase(codec);
+	codec->prev = codec->next = NULL;
+	--ip->stat.idle_cnt;
+	(*ip->factory->op->dealloc_codec)(ip->factory, codec);
+    }
+}
+
+
+/* Remember an allocated instance, so it can be kept in the pool when it
+ * is deallocated. Codec manager mutex must be held.
+ */
+static void track_inst(pj_pool_t *pool, struct pjmedia_codec_inst_pool *ip,
+		       pjmedia_codec *codec)
+{
+    struct inst_entry *e;
+
+    if (!pj_list_empty(&ip->free_entry)) {
+	e = ip->free_entry.next;
+	pj_list_erase(e);
+    } else {
+	e = PJ_POOL_ZALLOC_T(pool, struct inst_entry);
+    }
+
+    e->codec = codec;
+    pj_hash_set_np(ip->active, &e->codec, sizeof(e->codec), 0, e->hbuf, e);
+}
+
+
+/* Forget an allocated instance. Returns PJ_FALSE if the instance is not
+ * from this pool. Codec manager mutex must be held.
+ */
+static pj_bool_t untrack_inst(struct pjmedia_codec_inst_pool *ip,
+			      pjmedia_codec *codec)
+{
+    struct inst_entry *e;
+
+    e = (struct inst_entry*) pj_hash_get(ip->active, &codec, sizeof(codec),
+					 NULL);
+    if (!e)
+	return PJ_FALSE;
+
+    pj_hash_set_np(ip->active, &codec, sizeof(codec), 0, NULL, NULL);
+    pj_list_push_back(&ip->free_entry, e);
+    return PJ_TRUE;
+}
+
+
 /*
  * Duplicate codec parameter.
  */
@@ -110,6 +188,10 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_destroy (pjmedia_codec_mgr *mgr)
 
     PJ_ASSERT_RETURN(mgr, PJ_EINVAL);
 
+    /* Return idle codec instances to their factories */
+    for (i=0; i<mgr->codec_cnt; ++i)
+	trim_inst_pool(mgr->codec_desc[i].inst_pool, 0);
+
     /* Destroy all factories in the list */
     factory = mgr->factory_list.next;
     while (factory != &mgr->factory_list) {
@@ -177,13 +259,22 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_register_factory( pjmedia_codec_mgr *mgr,
 
     /* Save the codecs */
     for (i=0; i<count; ++i) {
-	pj_memcpy( &mgr->codec_desc[mgr->codec_cnt+i],
-		   &info[i], sizeof(pjmedia_codec_info));
-	mgr->codec_desc[mgr->codec_cnt+i].prio = PJMEDIA_CODEC_PRIO_NORMAL;
-	mgr->codec_desc[mgr->codec_cnt+i].factory = factory;
-	pjmedia_codec_info_to_id( &info[i],
-				  mgr->codec_desc[mgr->codec_cnt+i].id,
+	struct pjmedia_codec_desc *desc = &mgr->codec_desc[mgr->codec_cnt+i];
+
+	pj_memcpy( desc, &info[i], sizeof(pjmedia_codec_info));
+	desc->prio = PJMEDIA_CODEC_PRIO_NORMAL;
+	desc->factory = factory;
+	desc->param = NULL;
+	pjmedia_codec_info_to_id( &info[i], desc->id,
 				  sizeof(pjmedia_codec_id));
+
+	desc->inst_pool = PJ_POOL_ZALLOC_T(mgr->pool,
+					   struct pjmedia_codec_inst_pool);
+	desc->inst_pool->factory = factory;
+	desc->inst_pool->max_idle = PJMEDIA_CODEC_MGR_MAX_IDLE_CODECS;
+	desc->inst_pool->active = pj_hash_create(mgr->pool, 31);
+	pj_list_init(&desc->inst_pool->idle_list);
+	pj_list_init(&desc->inst_pool->free_entry);
     }
 
     /* Update count */
@@ -229,6 +320,11 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_unregister_factory(
     for (i=0; i<mgr->codec_cnt; ) {
 
 	if (mgr->codec_desc[i].factory == factory) {
+	    /* Return idle instances. Instances deallocated later are not
+	     * found in any pool, and go straight to the factory.
+	     */
+	    trim_inst_pool(mgr->codec_desc[i].inst_pool, 0);
+
 	    /* Release pool of codec default param */
 	    if (mgr->codec_desc[i].param) {
 		pj_assert(mgr->codec_desc[i].param->pool);
@@ -478,14 +574,41 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_alloc_codec(pjmedia_codec_mgr *mgr,
 						  pjmedia_codec **p_codec)
 {
     pjmedia_codec_factory *factory;
+    pjmedia_codec_id codec_id;
+    struct pjmedia_codec_desc *desc = NULL;
+    unsigned i;
     pj_status_t status;
 
     PJ_ASSERT_RETURN(mgr && info && p_codec, PJ_EINVAL);
 
     *p_codec = NULL;
 
+    if (!pjmedia_codec_info_to_id(info, codec_id, sizeof(codec_id)))
+	return PJ_EINVAL;
+
     pj_mutex_lock(mgr->mutex);
 
+    /* Reuse an idle instance of the codec if there is one */
+    for (i=0; i<mgr->codec_cnt; ++i) {
+	if (pj_ansi_stricmp(codec_id, mgr->codec_desc[i].id) == 0) {
+	    struct pjmedia_codec_inst_pool *ip = mgr->codec_desc[i].inst_pool;
+
+	    if (!pj_list_empty(&ip->idle_list)) {
+		*p_codec = ip->idle_list.next;
+		pj_list_erase(*p_codec);
+		(*p_codec)->prev = (*p_codec)->next = NULL;
+		--ip->stat.idle_cnt;
+		++ip->stat.hit_cnt;
+		track_inst(mgr->pool, ip, *p_codec);
+		pj_mutex_unlock(mgr->mutex);
+		return PJ_SUCCESS;
+	    }
+
+	    desc = &mgr->codec_desc[i];
+	    break;
+	}
+    }
+
     factory = mgr->factory_list.next;
     while (factory != &mgr->factory_list) {
 
@@ -493,6 +616,16 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_alloc_codec(pjmedia_codec_mgr *mgr,
 
 	    status = (*factory->op->alloc_codec)(factory, info, p_codec);
 	    if (status == PJ_SUCCESS) {
+		/* Remember the instance if it can be pooled when it's
+		 * released.
+		 */
+		if (desc && desc->factory == factory &&
+		    desc->inst_pool->max_idle && (*p_codec)->op->reset)
+		{
+		    track_inst(mgr->pool, desc->inst_pool, *p_codec);
+		    ++desc->inst_pool->stat.miss_cnt;
+		}
+
 		pj_mutex_unlock(mgr->mutex);
 		return PJ_SUCCESS;
 	    }
@@ -656,8 +789,141 @@ PJ_DEF(pj_status_t) pjmedia_codec_mgr_set_default_param(
 PJ_DEF(pj_status_t) pjmedia_codec_mgr_dealloc_codec(pjmedia_codec_mgr *mgr, 
 						    pjmedia_codec *codec)
 {
+    unsigned i;
+
     PJ_ASSERT_RETURN(mgr && codec, PJ_EINVAL);
 
+    pj_mutex_lock(mgr->mutex);
+
+    /* Reset and keep the instance if the pool of the codec is not full */
+    for (i=0; i<mgr->codec_cnt; ++i) {
+	struct pjmedia_codec_inst_pool *ip = mgr->codec_desc[i].inst_pool;
+
+	if (mgr->codec_desc[i].factory != codec->factory ||
+	    !untrack_inst(ip, codec))
+	{
+	    continue;
+	}
+
+	if (ip->stat.idle_cnt < ip->max_idle &&
+	    (*codec->op->reset)(codec) == PJ_SUCCESS)
+	{
+	    pj_list_push_back(&ip->idle_list, codec);
+	    ++ip->stat.idle_cnt;
+	    pj_mutex_unlock(mgr->mutex);
+	    return PJ_SUCCESS;
+	}
+	++ip->stat.discard_cnt;
+	break;
+    }
+
+    pj_mutex_unlock(mgr->mutex);
+
     return (*codec->factory->op->dealloc_codec)(codec->factory, codec);
 }
 
+
+/*
+ * Set the maximum number of idle instances of codecs.
+ */
+PJ_DEF(pj_status_t) pjmedia_codec_mgr_set_pool_limit(
+				pjmedia_codec_mgr *mgr,
+				const pj_str_t *codec_id,
+				unsigned max_idle)
+{
+    unsigned i, found = 0;
+
+    PJ_ASSERT_RETURN(mgr && codec_id, PJ_EINVAL);
+
+    pj_mutex_lock(mgr->mutex);
+
+    for (i=0; i<mgr->codec_cnt; ++i) {
+	if (codec_id->slen == 0 ||
+	    pj_strnicmp2(codec_id, mgr->codec_desc[i].id, 
+			 codec_id->slen) == 0) 
+	{
+	    mgr->codec_desc[i].inst_pool->max_idle = max_idle;
+	    trim_inst_pool(mgr->codec_desc[i].inst_pool, max_idle);
+	    ++found;
+	}
+    }
+
+    pj_mutex_unlock(mgr->mutex);
+
+    return found ? PJ_SUCCESS : PJ_ENOTFOUND;
+}
+
+
+/*
+ * Get the instance pool statistic of codecs.
+ */
+PJ_DEF(pj_status_t) pjmedia_codec_mgr_get_pool_stat(
+				pjmedia_codec_mgr *mgr,
+				const pj_str_t *codec_id,
+				pjmedia_codec_pool_stat *stat)
+{
+    unsigned i, found = 0;
+
+    PJ_ASSERT_RETURN(mgr && codec_id && stat, PJ_EINVAL);
+
+    pj_bzero(stat, sizeof(*stat));
+
+    pj_mutex_lock(mgr->mutex);
+
+    for (i=0; i<mgr->codec_cnt; ++i) {
+	if (codec_id->slen == 0 ||
+	    pj_strnicmp2(codec_id, mgr->codec_desc[i].id, 
+			 codec_id->slen) == 0) 
+	{
+	    const pjmedia_codec_pool_stat *s = 
+				&mgr->codec_desc[i].inst_pool->stat;
+
+	    stat->idle_cnt += s->idle_cnt;
+	    stat->hit_cnt += s->hit_cnt;
+	    stat->miss_cnt += s->miss_cnt;
+	    stat->discard_cnt += s->discard_cnt;
+	    ++found;
+	}
+    }
+
+    pj_mutex_unlock(mgr->mutex);
+
+    return found ? PJ_SUCCESS : PJ_ENOTFOUND;
+}
+
+
+/*
+ * Encode frames of several codec instances.
+ */
+PJ_DEF(pj_status_t) pjmedia_codec_encode_batch(
+					unsigned count,
+					pjmedia_codec_encode_job jobs[])
+{
+    pj_status_t status = PJ_SUCCESS;
+    unsigned i = 0;
+
+    PJ_ASSERT_RETURN(count == 0 || jobs, PJ_EINVAL);
+
+    while (i < count) {
+	pjmedia_codec_op *op = jobs[i].codec->op;
+	unsigned j;
+
+	if (op->encode_batch) {
+	    /* Hand over all consecutive jobs of the same codec type */
+	    for (j = i + 1; j < count && jobs[j].codec->op == op; ++j)
+		;
+	    (*op->encode_batch)(j - i, &jobs[i]);
+	} else {
+	    jobs[i].status = (*op->encode)(jobs[i].codec, jobs[i].input,
+					   jobs[i].out_size, jobs[i].output);
+	    j = i + 1;
+	}
+
+	for (; i < j; ++i) {
+	    if (jobs[i].status != PJ_SUCCESS && status == PJ_SUCCESS)
+		status = jobs[i].status;
+	}
+    }
+
+    return status;
+}
@@ -131,6 +131,17 @@ struct conf_port
     unsigned		 tx_level;	/**< Last tx level to this port.    */
     unsigned		 rx_level;	/**< Last rx level from this port.  */
 
+    /* Voice activity detector for the RX signal, only created when the
+     * bridge is created with PJMEDIA_CONF_USE_DTX option.
+     */
+    pjmedia_silence_det	*vad;		/**< RX VAD, may be NULL.	    */
+
+    /* With DTX, whether the port is given NULL frame instead of silence
+     * when none of its transmitters is active. Only set for streams, other
+     * ports such as recorders expect a continuous signal.
+     */
+    pj_bool_t		 tx_dtx;	/**< Send NULL frame on silence.    */
+
     /* The normalized signal level adjustment.
      * A value of 128 (NORMAL_LEVEL) means there's no adjustment.
      */
@@ -171,6 +182,8 @@ struct conf_port
     int			 mix_adj;	/**< Adjustment level for mix_buf.  */
     int			 last_mix_adj;	/**< Last adjustment level.	    */
     pj_int32_t		*mix_buf;	/**< Total sum of signal.	    */
+    unsigned		 mix_cnt;	/**< # of sources mixed in mix_buf
+					     in current tick.		    */
 
     /* Tx buffer is a temporary buffer to be used when there's mismatch 
      * between port's clock rate or ptime with conference's sample rate
@@ -423,6 +436,20 @@ static pj_status_t create_conf_port( pj_pool_t *pool,
     PJ_ASSERT_RETURN(conf_port->mix_buf, PJ_ENOMEM);
     conf_port->last_mix_adj = NORMAL_LEVEL;
 
+    /* Create VAD for DTX. The VAD runs on the signal level calculated by
+     * the bridge, so it doesn't add another pass over the samples.
+     */
+    if (conf->options & PJMEDIA_CONF_USE_DTX) {
+	status = pjmedia_silence_det_create(pool, conf->clock_rate,
+					    conf->samples_per_frame,
+					    &conf_port->vad);
+	if (status != PJ_SUCCESS)
+	    return status;
+
+	conf_port->tx_dtx = (port &&
+			     port->info.signature == PJMEDIA_SIG_PORT_STREAM);
+    }
+
 
     /* Done */
     *p_conf_port = conf_port;
@@ -456,7 +483,11 @@ static pj_status_t create_pasv_port( pjmedia_conf *conf,
 				      conf->samples_per_frame,
 				      conf->channel_count,
 				      RX_BUF_COUNT * ptime, /* max delay */
+#if PJMEDIA_CONF_PASSIVE_PORT_LOCK_FREE
+				      PJMEDIA_DELAY_BUF_LOCK_FREE,
+#else
 				      0, /* options */
+#endif
 				      &conf_port->delay_buf);
     if (status != PJ_SUCCESS)
 	return status;
@@ -1654,9 +1685,13 @@ static pj_status_t write_port(pjmedia_conf *conf, struct conf_port *cport,
     *frm_type = PJMEDIA_FRAME_TYPE_AUDIO;
 
     /* If port is muted or nobody is transmitting to this port, 
-     * transmit NULL frame. 
+     * transmit NULL frame. With DTX, also transmit NULL frame to streams
+     * when none of the transmitters is active.
      */
-    if (cport->tx_setting == PJMEDIA_PORT_MUTE || cport->transmitter_cnt==0) {
+    if (cport->tx_setting == PJMEDIA_PORT_MUTE || cport->transmitter_cnt==0 ||
+	(cport->tx_setting == PJMEDIA_PORT_ENABLE && cport->mix_cnt == 0 &&
+	 cport->tx_dtx))
+    {
 
 	pjmedia_frame frame;
 
@@ -1703,6 +1738,12 @@ static pj_status_t write_port(pjmedia_conf *conf, struct conf_port *cport,
     /* Reset heart-beat sample count */
     cport->tx_heart_beat = 0;
 
+    /* Nothing was mixed to this port in this tick, transmit silence */
+    if (cport->mix_cnt == 0) {
+	pj_bzero(cport->mix_buf,
+		 conf->samples_per_frame * sizeof(cport->mix_buf[0]));
+    }
+
     buf = (pj_int16_t*) cport->mix_buf;
 
     /* If there are sources in the mix buffer, convert the mixed samples
@@ -1910,14 +1951,12 @@ static pj_status_t get_frame(pjmedia_port *this_port,
 	/* Var "ci" is to count how many ports have been visited so far. */
 	++ci;
 
-	/* Reset buffer (only necessary if the port has transmitter) and
-	 * reset auto adjustment level for mixed signal.
+	/* Reset mixed source count and auto adjustment level for mixed
+	 * signal. The mix buffer is initialized by the first source mixed
+	 * to it, or cleared by write_port() if there is none.
 	 */
 	conf_port->mix_adj = NORMAL_LEVEL;
-	if (conf_port->transmitter_cnt) {
-	    pj_bzero(conf_port->mix_buf,
-		     conf->samples_per_frame*sizeof(conf_port->mix_buf[0]));
-	}
+	conf_port->mix_cnt = 0;
     }
 
     /* Get frames from all ports, and "mix" the signal 
@@ -1926,6 +1965,7 @@ static pj_status_t get_frame(pjmedia_port *this_port,
     for (i=0, ci=0; i < conf->max_ports && ci < conf->port_cnt; ++i) {
 	struct conf_port *conf_port = conf->ports[i];
 	pj_int32_t level = 0;
+	pj_bool_t is_silence;
 
 	/* Skip empty port. */
 	if (!conf_port)
@@ -2032,6 +2072,10 @@ static pj_status_t get_frame(pjmedia_port *this_port,
 
 	level /= conf->samples_per_frame;
 
+	/* Feed the VAD with the linear level before it's converted */
+	is_silence = conf_port->vad &&
+		     pjmedia_silence_det_apply(conf_port->vad, level);
+
 	/* Convert level to 8bit complement ulaw */
 	level = pjmedia_linear2ulaw(level) ^ 0xff;
 
@@ -2044,6 +2088,14 @@ static pj_status_t get_frame(pjmedia_port *this_port,
 	//if (level == 0)
 	//    continue;
 
+	/* With DTX, skip mixing silent frame. Unlike the zero level check
+	 * above, the VAD has hangover so the tail of a talkspurt is not cut,
+	 * and listeners with no active source get NULL frame which lets the
+	 * stream/codec decide what to transmit.
+	 */
+	if (is_silence)
+	    continue;
+
 	/* Add the signal to all listeners. */
 	for (cj=0; cj < conf_port->listener_cnt; ++cj) 
 	{
@@ -2091,7 +2143,7 @@ static pj_status_t get_frame(pjmedia_port *this_port,
 		p_in_conn_leveled = p_in;
 	    }
 
-	    if (listener->transmitter_cnt > 1) {
+	    if (listener->mix_cnt++ > 0) {
 		/* Mixing signals,
 		 * and calculate appropriate level adjustment if there is
 		 * any overflowed level in the mixed signal.
@@ -2121,7 +2173,7 @@ static pj_status_t get_frame(pjmedia_port *this_port,
 			listener->mix_adj = tmp_adj;
 		}
 	    } else {
-		/* Only 1 transmitter:
+		/* First source mixed to this listener in this tick:
 		 * just copy the samples to the mix buffer
 		 * no mixing and level adjustment needed
 		 */
@@ -56,6 +56,39 @@ enum OP
  */
 #define SAFE_MARGIN	    0
 
+/* Memory ordering primitives used by the lock-free (SPSC) mode. The
+ * producer publishes a frame with a release store to the write index and
+ * the consumer observes it with an acquire load, and vice versa for the
+ * read index.
+ */
+#if defined(__clang__) || (defined(__GNUC__) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)))
+#   define HAS_LOCK_FREE	1
+#   define LOAD_ACQUIRE(p)	__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#   define STORE_RELEASE(p,v)	__atomic_store_n(p, v, __ATOMIC_RELEASE)
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+    /* Aligned loads and stores on x86/x64 already have acquire/release
+     * semantic, only compiler reordering needs to be prevented.
+     */
+#   include <intrin.h>
+#   define HAS_LOCK_FREE	1
+#   define LOAD_ACQUIRE(p)	load_acquire(p)
+#   define STORE_RELEASE(p,v)	store_release(p, v)
+    static unsigned load_acquire(volatile unsigned *p)
+    {
+	unsigned v = *p;
+	_ReadWriteBarrier();
+	return v;
+    }
+    static void store_release(volatile unsigned *p, unsigned v)
+    {
+	_ReadWriteBarrier();
+	*p = v;
+    }
+#else
+#   define HAS_LOCK_FREE	0
+#endif
+
 /* This structure describes internal delaybuf settings and states.
  */
 struct pjmedia_delay_buf
@@ -83,6 +116,19 @@ struct pjmedia_delay_buf
 
     /* Drift handler */
     pjmedia_wsola   *wsola;		/**< Drift handler		     */
+
+    /* Lock-free mode. The frame ring is the only state shared between
+     * the producer and the consumer, everything else (circular buffer,
+     * learning vars, WSOLA) is owned by the consumer.
+     */
+    pj_bool_t	     lock_free;		/**< Lock-free SPSC mode is used.    */
+    pj_int16_t	    *ring;		/**< Frame slots of the ring.	     */
+    unsigned	     ring_cnt;		/**< Number of frame slots.	     */
+    volatile unsigned ring_write;	/**< Frames written, by producer.    */
+    volatile unsigned ring_read;	/**< Frames read, by consumer.	     */
+    volatile unsigned reset_req;	/**< Reset requested.		     */
+    volatile unsigned ring_drop;	/**< Frames dropped on ring full.    */
+    unsigned	     ring_drop_logged;	/**< Last reported drop count.	     */
 };
 
 
@@ -135,6 +181,24 @@ PJ_DEF(pj_status_t) pjmedia_delay_buf_create( pj_pool_t *pool,
         PJ_LOG(5, (b->obj_name, "Using simple FIFO delay buffer."));
     }
 
+    if (options & PJMEDIA_DELAY_BUF_LOCK_FREE) {
+#if HAS_LOCK_FREE
+	/* The ring must be able to hold as many frames as the circular
+	 * buffer, plus one frame being drained by the consumer.
+	 */
+	b->lock_free = PJ_TRUE;
+	b->ring_cnt = b->max_cnt / samples_per_frame + 1;
+	b->ring = (pj_int16_t*)
+		  pj_pool_alloc(pool, b->ring_cnt * samples_per_frame *
+				      sizeof(pj_int16_t));
+	PJ_LOG(5, (b->obj_name, "Using lock-free delay buffer, %d frames",
+		   b->ring_cnt));
+#else
+	PJ_LOG(4, (b->obj_name, "Lock-free delay buffer is not supported "
+		   "on this platform, using mutex"));
+#endif
+    }
+
     /* Finally, create mutex */
     status = pj_lock_create_recursive_mutex(pool, b->obj_name, 
 					    &b->lock);
@@ -260,23 +324,17 @@ static void update(pjmedia_delay_buf *b, enum OP op)
     }
 }
 
-PJ_DEF(pj_status_t) pjmedia_delay_buf_put(pjmedia_delay_buf *b,
-					   pj_int16_t frame[])
+/* Store one frame into the circular buffer, dropping eldest samples
+ * on overflow.
+ */
+static pj_status_t store_frame(pjmedia_delay_buf *b, pj_int16_t frame[])
 {
-    pj_status_t status;
-
-    PJ_ASSERT_RETURN(b && frame, PJ_EINVAL);
-
-    pj_lock_acquire(b->lock);
-
     if (b->wsola) {
-        update(b, OP_PUT);
-    
+        pj_status_t status;
+
         status = pjmedia_wsola_save(b->wsola, frame, PJ_FALSE);
-        if (status != PJ_SUCCESS) {
-	    pj_lock_release(b->lock);
+        if (status != PJ_SUCCESS)
 	    return status;
-        }
     }
 
     /* Overflow checking */
@@ -314,22 +372,16 @@ PJ_DEF(pj_status_t) pjmedia_delay_buf_put(pjmedia_delay_buf *b,
 
     pjmedia_circ_buf_write(b->circ_buf, frame, b->samples_per_frame);
 
-    pj_lock_release(b->lock);
     return PJ_SUCCESS;
 }
 
-PJ_DEF(pj_status_t) pjmedia_delay_buf_get( pjmedia_delay_buf *b,
-					   pj_int16_t frame[])
+/* Read one frame from the circular buffer, generating a frame on
+ * underflow.
+ */
+static void read_frame(pjmedia_delay_buf *b, pj_int16_t frame[])
 {
     pj_status_t status = PJ_SUCCESS;
 
-    PJ_ASSERT_RETURN(b && frame, PJ_EINVAL);
-
-    pj_lock_acquire(b->lock);
-
-    if (b->wsola)
-        update(b, OP_GET);
-
     /* Starvation checking */
     if (pjmedia_circ_buf_get_len(b->circ_buf) < b->samples_per_frame) {
 
@@ -341,10 +393,8 @@ PJ_DEF(pj_status_t) pjmedia_delay_buf_get( pjmedia_delay_buf *b,
 
 	    if (status == PJ_SUCCESS) {
 	        TRACE__((b->obj_name,"Successfully generate 1 frame"));
-	        if (pjmedia_circ_buf_get_len(b->circ_buf) == 0) {
-		    pj_lock_release(b->lock);
-		    return PJ_SUCCESS;
-	        }
+	        if (pjmedia_circ_buf_get_len(b->circ_buf) == 0)
+		    return;
 
 	        /* Put generated frame into buffer */
 	        pjmedia_circ_buf_write(b->circ_buf, frame,
@@ -366,13 +416,131 @@ PJ_DEF(pj_status_t) pjmedia_delay_buf_get( pjmedia_delay_buf *b,
 	    /* The buffer is empty now, reset it */
 	    pjmedia_circ_buf_reset(b->circ_buf);
 
-	    pj_lock_release(b->lock);
-
-	    return PJ_SUCCESS;
+	    return;
 	}
     }
 
     pjmedia_circ_buf_read(b->circ_buf, frame, b->samples_per_frame);
+}
+
+#if HAS_LOCK_FREE
+/* Lock-free put, called by the producer. The frame is only copied to
+ * the ring, all processing is deferred to the consumer.
+ */
+static pj_status_t ring_put(pjmedia_delay_buf *b, const pj_int16_t frame[])
+{
+    unsigned w = b->ring_write;
+    unsigned r = LOAD_ACQUIRE(&b->ring_read);
+
+    if (w - r >= b->ring_cnt) {
+	/* Ring is full, the consumer is not keeping up. Only the consumer
+	 * may drop the eldest frame, so drop the new one instead.
+	 */
+	STORE_RELEASE(&b->ring_drop, b->ring_drop + 1);
+	TRACE__((b->obj_name,"Ring full, dropping new frame"));
+	return PJ_SUCCESS;
+    }
+
+    pjmedia_copy_samples(b->ring + (w % b->ring_cnt) * b->samples_per_frame,
+			 frame, b->samples_per_frame);
+    STORE_RELEASE(&b->ring_write, w + 1);
+
+    return PJ_SUCCESS;
+}
+
+/* Lock-free get, called by the consumer. Frames from the ring are moved
+ * into the circular buffer, then drift correction and learning are
+ * done as in the locked mode, without blocking the producer.
+ */
+static pj_status_t ring_get(pjmedia_delay_buf *b, pj_int16_t frame[])
+{
+    unsigned w = LOAD_ACQUIRE(&b->ring_write);
+    unsigned r = b->ring_read;
+
+    if (LOAD_ACQUIRE(&b->reset_req)) {
+	/* Discard everything queued so far */
+	STORE_RELEASE(&b->ring_read, w);
+	r = w;
+	b->recalc_timer = RECALC_TIME;
+	pjmedia_circ_buf_reset(b->circ_buf);
+	if (b->wsola)
+	    pjmedia_wsola_reset(b->wsola, 0);
+	STORE_RELEASE(&b->reset_req, 0);
+	PJ_LOG(5,(b->obj_name,"Delay buffer is reset"));
+    }
+
+    for (; r != w; ++r) {
+	pj_int16_t *slot;
+	pj_status_t status;
+
+	if (b->wsola)
+	    update(b, OP_PUT);
+
+	/* WSOLA may modify the frame, which is fine since the slot is
+	 * owned by the consumer until the read index is advanced.
+	 */
+	slot = b->ring + (r % b->ring_cnt) * b->samples_per_frame;
+	status = store_frame(b, slot);
+	STORE_RELEASE(&b->ring_read, r + 1);
+
+	if (status != PJ_SUCCESS)
+	    PJ_PERROR(4,(b->obj_name, status, "Error storing frame"));
+    }
+
+    if (LOAD_ACQUIRE(&b->ring_drop) != b->ring_drop_logged) {
+	b->ring_drop_logged = b->ring_drop;
+	PJ_LOG(4,(b->obj_name,"Ring was full, %d frame(s) dropped so far",
+		  b->ring_drop_logged));
+    }
+
+    if (b->wsola)
+        update(b, OP_GET);
+
+    read_frame(b, frame);
+
+    return PJ_SUCCESS;
+}
+#endif
+
+PJ_DEF(pj_status_t) pjmedia_delay_buf_put(pjmedia_delay_buf *b,
+					   pj_int16_t frame[])
+{
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(b && frame, PJ_EINVAL);
+
+#if HAS_LOCK_FREE
+    if (b->lock_free)
+	return ring_put(b, frame);
+#endif
+
+    pj_lock_acquire(b->lock);
+
+    if (b->wsola)
+        update(b, OP_PUT);
+    
+    status = store_frame(b, frame);
+
+    pj_lock_release(b->lock);
+    return status;
+}
+
+PJ_DEF(pj_status_t) pjmedia_delay_buf_get( pjmedia_delay_buf *b,
+					   pj_int16_t frame[])
+{
+    PJ_ASSERT_RETURN(b && frame, PJ_EINVAL);
+
+#if HAS_LOCK_FREE
+    if (b->lock_free)
+	return ring_get(b, frame);
+#endif
+
+    pj_lock_acquire(b->lock);
+
+    if (b->wsola)
+        update(b, OP_GET);
+
+    read_frame(b, frame);
 
     pj_lock_release(b->lock);
 
@@ -384,6 +552,14 @@ PJ_DEF(pj_status_t) pjmedia_delay_buf_reset(pjmedia_delay_buf *b)
 {
     PJ_ASSERT_RETURN(b, PJ_EINVAL);
 
+#if HAS_LOCK_FREE
+    if (b->lock_free) {
+	/* The buffer is owned by the consumer, let it do the reset */
+	STORE_RELEASE(&b->reset_req, 1);
+	return PJ_SUCCESS;
+    }
+#endif
+
     pj_lock_acquire(b->lock);
 
     b->recalc_timer = RECALC_TIME;
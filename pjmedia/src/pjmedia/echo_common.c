@@ -445,6 +445,39 @@ PJ_DEF(pj_status_t) pjmedia_echo_cancel( pjmedia_echo_state *echo,
 }
 
 
+/*
+ * Perform echo cancellation of several Echo Cancellers.
+ */
+PJ_DEF(pj_status_t) pjmedia_echo_cancel_batch( unsigned count,
+					       pjmedia_echo_job jobs[],
+					       unsigned options )
+{
+    pj_status_t status = PJ_SUCCESS;
+    unsigned i;
+
+    PJ_ASSERT_RETURN(count == 0 || jobs, PJ_EINVAL);
+
+    for (i = 0; i < count; ++i) {
+	pjmedia_echo_job *job = &jobs[i];
+
+	if (job->play_frm) {
+	    job->status = (*job->echo->op->ec_cancel)(job->echo->state,
+						      job->rec_frm,
+						      job->play_frm,
+						      options, NULL);
+	} else {
+	    job->status = pjmedia_echo_capture(job->echo, job->rec_frm,
+					       options);
+	}
+
+	if (job->status != PJ_SUCCESS && status == PJ_SUCCESS)
+	    status = job->status;
+    }
+
+    return status;
+}
+
+
 /*
  * Get the Echo Canceller stats. 
  */
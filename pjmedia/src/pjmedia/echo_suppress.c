@@ -31,6 +31,16 @@
 
 #include "echo_internal.h"
 
+#if defined(PJMEDIA_HAS_ECHO_SUPP_SIMD) && PJMEDIA_HAS_ECHO_SUPP_SIMD!=0
+#   if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#	include <arm_neon.h>
+#	define USE_NEON	1
+#   else
+#	include <emmintrin.h>
+#	define USE_SSE2	1
+#   endif
+#endif
+
 #define THIS_FILE			    "echo_suppress.c"
 
 /* Maximum float constant */
@@ -240,6 +250,7 @@ typedef struct echo_supp
     unsigned	 tail_cnt;	    /* Tail length, in # of segments	    */
     unsigned	 play_hist_cnt;	    /* # of segments in play_hist	    */
     pj_uint16_t *play_hist;	    /* Array of playback levels		    */
+    float	*play_ratio;	    /* play_hist[i+1] / play_hist[i]	    */
     pj_uint16_t *rec_hist;	    /* Array of rec levels		    */
 
     float	*corr_sum;	    /* Array of corr for each tail pos.	    */
@@ -304,6 +315,9 @@ PJ_DEF(pj_status_t) echo_supp_create( pj_pool_t *pool,
     ec->play_hist = (pj_uint16_t*)
 		     pj_pool_alloc(pool, ec->play_hist_cnt *
 					 sizeof(ec->play_hist[0]));
+    ec->play_ratio = (float*)
+		     pj_pool_alloc(pool, ec->play_hist_cnt *
+					 sizeof(ec->play_ratio[0]));
 
     ec->corr_sum = (float*)
 		   pj_pool_alloc(pool, ec->tail_cnt *
@@ -347,6 +361,7 @@ PJ_DEF(void) echo_supp_reset(void *state)
 
     pj_bzero(ec->rec_hist, ec->templ_cnt * sizeof(ec->rec_hist[0]));
     pj_bzero(ec->play_hist, ec->play_hist_cnt * sizeof(ec->play_hist[0]));
+    pj_bzero(ec->play_ratio, ec->play_hist_cnt * sizeof(ec->play_ratio[0]));
 
     for (i=0; i<ec->tail_cnt; ++i) {
 	ec->corr_sum[i] = ec->avg_factor[i] = 0;
@@ -393,6 +408,53 @@ PJ_DEF(void) echo_supp_soft_reset(void *state)
 }
 
 
+/* Calculate the average absolute level of a segment, same as
+ * pjmedia_calc_avg_signal().
+ */
+static unsigned calc_level(const pj_int16_t *samples, unsigned count)
+{
+    pj_uint32_t sum = 0;
+    unsigned i = 0;
+
+#if defined(USE_SSE2)
+    __m128i acc = _mm_setzero_si128();
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 8 <= count; i += 8) {
+	__m128i x = _mm_loadu_si128((const __m128i*)(samples + i));
+	__m128i sign = _mm_srai_epi16(x, 15);
+
+	/* |x| fits in unsigned 16-bit, including for -32768 */
+	x = _mm_sub_epi16(_mm_xor_si128(x, sign), sign);
+	acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(x, zero));
+	acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(x, zero));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1,0,3,2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2,3,0,1)));
+    sum = (pj_uint32_t)_mm_cvtsi128_si32(acc);
+#elif defined(USE_NEON)
+    uint32x4_t acc = vdupq_n_u32(0);
+
+    for (; i + 8 <= count; i += 8) {
+	/* vabsq_s16() wraps -32768 to 0x8000, i.e: 32768 unsigned */
+	int16x8_t x = vabsq_s16(vld1q_s16(samples + i));
+	acc = vpadalq_u16(acc, vreinterpretq_u16_s16(x));
+    }
+    sum = vgetq_lane_u32(acc, 0) + vgetq_lane_u32(acc, 1) +
+	  vgetq_lane_u32(acc, 2) + vgetq_lane_u32(acc, 3);
+#endif
+
+    for (; i < count; ++i) {
+	if (samples[i] < 0)
+	    sum -= samples[i];
+	else
+	    sum += samples[i];
+    }
+
+    return count ? sum / count : 0;
+}
+
+
 /* Set state */
 static void echo_supp_set_state(echo_supp *ec, talk_state_t state,
 				unsigned level)
@@ -409,6 +471,70 @@ static void echo_supp_set_state(echo_supp *ec, talk_state_t state,
     }
 }
 
+/*
+ * Accummulate the correlation value and update the min and avg gain factor
+ * of tail positions 1 to tail_cnt-2. The previous correlation sums are
+ * saved in tmp_corr.
+ */
+static void update_tail_stat(echo_supp *ec)
+{
+    const unsigned end = ec->tail_cnt - 1;
+    unsigned i = 1;
+
+#if defined(USE_SSE2)
+    const __m128 n = _mm_set1_ps((float)ec->tail_cnt);
+    const __m128 n1 = _mm_set1_ps((float)(ec->tail_cnt + 1));
+
+    for (; i + 4 <= end; i += 4) {
+	__m128 corr = _mm_loadu_ps(ec->corr_sum + i);
+	__m128 tmp_factor = _mm_loadu_ps(ec->tmp_factor + i);
+	__m128 avg = _mm_loadu_ps(ec->avg_factor + i);
+
+	_mm_storeu_ps(ec->corr_sum + i,
+		      _mm_add_ps(corr, _mm_loadu_ps(ec->tmp_corr + i)));
+	_mm_storeu_ps(ec->tmp_corr + i, corr);
+	_mm_storeu_ps(ec->min_factor + i,
+		      _mm_min_ps(tmp_factor, _mm_loadu_ps(ec->min_factor + i)));
+	avg = _mm_div_ps(_mm_add_ps(_mm_mul_ps(avg, n), tmp_factor), n1);
+	_mm_storeu_ps(ec->avg_factor + i, avg);
+    }
+#elif defined(USE_NEON) && defined(__aarch64__)
+    const float32x4_t n = vdupq_n_f32((float)ec->tail_cnt);
+    const float32x4_t n1 = vdupq_n_f32((float)(ec->tail_cnt + 1));
+
+    for (; i + 4 <= end; i += 4) {
+	float32x4_t corr = vld1q_f32(ec->corr_sum + i);
+	float32x4_t tmp_factor = vld1q_f32(ec->tmp_factor + i);
+	float32x4_t min = vld1q_f32(ec->min_factor + i);
+	float32x4_t avg = vld1q_f32(ec->avg_factor + i);
+
+	vst1q_f32(ec->corr_sum + i,
+		  vaddq_f32(corr, vld1q_f32(ec->tmp_corr + i)));
+	vst1q_f32(ec->tmp_corr + i, corr);
+	vst1q_f32(ec->min_factor + i,
+		  vbslq_f32(vcltq_f32(tmp_factor, min), tmp_factor, min));
+	avg = vdivq_f32(vaddq_f32(vmulq_f32(avg, n), tmp_factor), n1);
+	vst1q_f32(ec->avg_factor + i, avg);
+    }
+#endif
+
+    for (; i < end; ++i) {
+	float corr = ec->corr_sum[i];
+
+	/* Accummulate correlation value  for this tail position */
+	ec->corr_sum[i] = corr + ec->tmp_corr[i];
+	ec->tmp_corr[i] = corr;
+
+	/* Update the min and avg gain factor for this tail position */
+	if (ec->tmp_factor[i] < ec->min_factor[i])
+	    ec->min_factor[i] = ec->tmp_factor[i];
+	ec->avg_factor[i] = ((ec->avg_factor[i] * ec->tail_cnt) +
+				    ec->tmp_factor[i]) /
+			    (ec->tail_cnt + 1);
+    }
+}
+
+
 /*
  * Update EC state
  */
@@ -425,7 +551,7 @@ static void echo_supp_update(echo_supp *ec, pj_int16_t *rec_frm,
 	ec->update_cnt = 0x7FFFFFFF; /* Detect overflow */
 
     /* Calculate current play frame level */
-    frm_level = pjmedia_calc_avg_signal(play_frm, ec->samples_per_segment);
+    frm_level = calc_level(play_frm, ec->samples_per_segment);
     ++frm_level; /* to avoid division by zero */
 
     /* Save the oldest frame level for later */
@@ -435,8 +561,20 @@ static void echo_supp_update(echo_supp *ec, pj_int16_t *rec_frm,
     pj_array_erase(ec->play_hist, sizeof(pj_uint16_t), ec->play_hist_cnt, 0);
     ec->play_hist[ec->play_hist_cnt-1] = (pj_uint16_t) frm_level;
 
+    /* Keep the ratio of consecutive play levels along with the history,
+     * so the correlation of every tail position below is calculated
+     * without division.
+     */
+    pj_array_erase(ec->play_ratio, sizeof(float), ec->play_hist_cnt, 0);
+    ec->play_ratio[ec->play_hist_cnt-1] = 0;
+    if (ec->play_hist[ec->play_hist_cnt-2]) {
+	ec->play_ratio[ec->play_hist_cnt-2] = 
+		(float)ec->play_hist[ec->play_hist_cnt-1] / 
+		ec->play_hist[ec->play_hist_cnt-2];
+    }
+
     /* Calculate level of current mic frame */
-    frm_level = pjmedia_calc_avg_signal(rec_frm, ec->samples_per_segment);
+    frm_level = calc_level(rec_frm, ec->samples_per_segment);
     ++frm_level; /* to avoid division by zero */
 
     /* Save the oldest frame level for later */
@@ -491,9 +629,7 @@ static void echo_supp_update(echo_supp *ec, pj_int16_t *rec_frm,
 	sum_play_level = 0;
 	play_corr = 0;
 	for (j=0; j<ec->templ_cnt-1; ++j) {
-	    float corr;
-	    corr = (float)ec->play_hist[j+1] / ec->play_hist[j];
-	    play_corr += corr;
+	    play_corr += ec->play_ratio[j];
 	    sum_play_level += ec->play_hist[j];
 	}
 	sum_play_level += ec->play_hist[j];
@@ -505,8 +641,7 @@ static void echo_supp_update(echo_supp *ec, pj_int16_t *rec_frm,
 			      ec->play_hist[ec->templ_cnt-1];
 	ec->play_corr0 = ec->play_corr0 - ((float)ec->play_hist[0] /
 					          old_play_frm_level) +
-		         ((float)ec->play_hist[ec->templ_cnt-1] /
-			         ec->play_hist[ec->templ_cnt-2]);
+		         ec->play_ratio[ec->templ_cnt-2];
 	sum_play_level = ec->sum_play_level0;
 	play_corr = ec->play_corr0;
     }
@@ -535,8 +670,7 @@ static void echo_supp_update(echo_supp *ec, pj_int16_t *rec_frm,
 
 	sum_play_level = sum_play_level - ec->play_hist[i-1] +
 			 ec->play_hist[end-1];
-	play_corr = play_corr - ((float)ec->play_hist[i]/ec->play_hist[i-1]) +
-		    ((float)ec->play_hist[end-1]/ec->play_hist[end-2]);
+	play_corr = play_corr - ec->play_ratio[i-1] + ec->play_ratio[end-2];
 
 	/* Bail out if remote isn't talking */
 	ulaw = pjmedia_linear2ulaw(sum_play_level/ec->templ_cnt) ^ 0xFF;
@@ -576,23 +710,16 @@ static void echo_supp_update(echo_supp *ec, pj_int16_t *rec_frm,
      * time find the tail index of the best correlation.
      */
     prev_index = ec->tail_index;
+    update_tail_stat(ec);
     for (i=1; i<ec->tail_cnt-1; ++i) {
-	float *p = &ec->corr_sum[i], sum;
-
-	/* Accummulate correlation value  for this tail position */
-	ec->corr_sum[i] += ec->tmp_corr[i];
-
-	/* Update the min and avg gain factor for this tail position */
-	if (ec->tmp_factor[i] < ec->min_factor[i])
-	    ec->min_factor[i] = ec->tmp_factor[i];
-	ec->avg_factor[i] = ((ec->avg_factor[i] * ec->tail_cnt) +
-				    ec->tmp_factor[i]) /
-			    (ec->tail_cnt + 1);
+	float *p = &ec->corr_sum[i], sum, next;
 
 	/* To get the best correlation, also include the correlation
-	 * value of the neighbouring tail locations.
+	 * value of the neighbouring tail locations. The next location
+	 * is taken before this round of accummulation.
 	 */
-	sum = *(p-1) + (*p)*2 + *(p+1);
+	next = (i+1 < ec->tail_cnt-1) ? ec->tmp_corr[i+1] : *(p+1);
+	sum = *(p-1) + (*p)*2 + next;
 	//sum = *p;
 
 	/* See if we have better correlation value */
@@ -650,9 +777,36 @@ static void echo_supp_update(echo_supp *ec, pj_int16_t *rec_frm,
 static void amplify_frame(pj_int16_t *frm, unsigned length,
 			  pj_ufloat_t factor)
 {
-    unsigned i;
+    unsigned i = 0;
+
+#if defined(PJ_HAS_FLOATING_POINT) && PJ_HAS_FLOATING_POINT!=0
+#   if defined(USE_SSE2)
+    const __m128 f = _mm_set1_ps(factor);
+
+    for (; i + 8 <= length; i += 8) {
+	__m128i x = _mm_loadu_si128((const __m128i*)(frm + i));
+	__m128i sign = _mm_srai_epi16(x, 15);
+	__m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(x, sign));
+	__m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(x, sign));
+
+	x = _mm_packs_epi32(_mm_cvttps_epi32(_mm_mul_ps(lo, f)),
+			    _mm_cvttps_epi32(_mm_mul_ps(hi, f)));
+	_mm_storeu_si128((__m128i*)(frm + i), x);
+    }
+#   elif defined(USE_NEON)
+    for (; i + 8 <= length; i += 8) {
+	int16x8_t x = vld1q_s16(frm + i);
+	float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(x)));
+	float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(x)));
+
+	x = vcombine_s16(vqmovn_s32(vcvtq_s32_f32(vmulq_n_f32(lo, factor))),
+			 vqmovn_s32(vcvtq_s32_f32(vmulq_n_f32(hi, factor))));
+	vst1q_s16(frm + i, x);
+    }
+#   endif
+#endif
 
-    for (i=0; i<length; ++i) {
+    for (; i<length; ++i) {
 	frm[i] = (pj_int16_t)pj_ufloat_mul_i(frm[i], factor);
     }
 }
@@ -771,7 +925,7 @@ PJ_DEF(pj_status_t) echo_supp_cancel_echo( void *state,
 	    unsigned level, recalc_cnt;
 
 	    /* Get the adjusted frame signal level */
-	    level = pjmedia_calc_avg_signal(rec_frm, ec->samples_per_frame);
+	    level = calc_level(rec_frm, ec->samples_per_frame);
 	    level = pjmedia_linear2ulaw(level) ^ 0xFF;
 
 	    /* Accumulate average echo residue to see the ES effectiveness */
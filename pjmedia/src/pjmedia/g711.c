@@ -43,6 +43,7 @@
 #define PTIME		    10	/* basic frame size is 10 msec	    */
 #define FRAME_SIZE	    (8000 * PTIME / 1000)   /* 80 bytes	    */
 #define SAMPLES_PER_FRAME   (8000 * PTIME / 1000)   /* 80 samples   */
+#define BATCH_FRAMES	    32	/* frames per bulk conversion in batch */
 
 /* Prototypes for G711 factory */
 static pj_status_t g711_test_alloc( pjmedia_codec_factory *factory, 
@@ -86,6 +87,9 @@ static pj_status_t  g711_recover( pjmedia_codec *codec,
 				  unsigned output_buf_len,
 				  struct pjmedia_frame *output);
 #endif
+static pj_status_t  g711_encode_batch( unsigned count,
+				       pjmedia_codec_encode_job jobs[]);
+static pj_status_t  g711_reset( pjmedia_codec *codec );
 
 /* Definition for G711 codec operations. */
 static pjmedia_codec_op g711_op = 
@@ -98,10 +102,12 @@ static pjmedia_codec_op g711_op =
     &g711_encode,
     &g711_decode,
 #if !PLC_DISABLED
-    &g711_recover
+    &g711_recover,
 #else
-    NULL
+    NULL,
 #endif
+    &g711_encode_batch,
+    &g711_reset
 };
 
 /* Definition for G711 codec factory operations. */
@@ -369,11 +375,32 @@ static pj_status_t g711_alloc_codec( pjmedia_codec_factory *factory,
     return PJ_SUCCESS;
 }
 
+/* Clear the state of the previous session, since codec+plc will be
+ * reused next time.
+ */
+static void g711_clear_state(struct g711_private *priv)
+{
+    int i = 0;
+
+#if !PLC_DISABLED
+    /* Clear left samples in the PLC */
+    for (i=0; i<2; ++i) {
+	pj_int16_t frame[SAMPLES_PER_FRAME];
+	pjmedia_zero_samples(frame, PJ_ARRAY_SIZE(frame));
+	pjmedia_plc_save(priv->plc, frame);
+    }
+#else
+    PJ_UNUSED_ARG(i);
+#endif
+
+    /* Re-init silence_period */
+    pj_set_timestamp32(&priv->last_tx, 0, 0);
+}
+
 static pj_status_t g711_dealloc_codec(pjmedia_codec_factory *factory, 
 				      pjmedia_codec *codec )
 {
     struct g711_private *priv = (struct g711_private*) codec->codec_data;
-    int i = 0;
 
     PJ_ASSERT_RETURN(factory==&g711_factory.base, PJ_EINVAL);
 
@@ -383,19 +410,7 @@ static pj_status_t g711_dealloc_codec(pjmedia_codec_factory *factory,
 	return PJ_EINVALIDOP;
     }
 
-#if !PLC_DISABLED
-    /* Clear left samples in the PLC, since codec+plc will be reused
-     * next time.
-     */
-    for (i=0; i<2; ++i) {
-	pj_int16_t frame[SAMPLES_PER_FRAME];
-	pjmedia_zero_samples(frame, PJ_ARRAY_SIZE(frame));
-	pjmedia_plc_save(priv->plc, frame);
-    }
-#else
-    PJ_UNUSED_ARG(i);
-    PJ_UNUSED_ARG(priv);
-#endif
+    g711_clear_state(priv);
 
     /* Lock mutex. */
     pj_mutex_lock(g711_factory.mutex);
@@ -437,6 +452,13 @@ static pj_status_t g711_close( pjmedia_codec *codec )
     return PJ_SUCCESS;
 }
 
+static pj_status_t  g711_reset( pjmedia_codec *codec )
+{
+    /* The instance goes to the codec manager's pool instead of our list */
+    g711_clear_state((struct g711_private*) codec->codec_data);
+    return PJ_SUCCESS;
+}
+
 static pj_status_t  g711_modify(pjmedia_codec *codec, 
 			        const pjmedia_codec_param *attr )
 {
@@ -482,30 +504,36 @@ static pj_status_t  g711_parse( pjmedia_codec *codec,
     return PJ_SUCCESS;
 }
 
-static pj_status_t  g711_encode(pjmedia_codec *codec, 
-				const struct pjmedia_frame *input,
-				unsigned output_buf_len, 
-				struct pjmedia_frame *output)
+/*
+ * Check the output buffer and run VAD before encoding a frame. On silence,
+ * the output frame is set to NONE frame and \a is_silence is set. Otherwise
+ * the output frame is set up for the encoded samples.
+ */
+static pj_status_t  g711_encode_prepare(pjmedia_codec *codec,
+					const struct pjmedia_frame *input,
+					unsigned output_buf_len,
+					struct pjmedia_frame *output,
+					pj_bool_t *is_silence)
 {
-    pj_int16_t *samples = (pj_int16_t*) input->buf;
     struct g711_private *priv = (struct g711_private*) codec->codec_data;
 
+    *is_silence = PJ_FALSE;
+
     /* Check output buffer length */
     if (output_buf_len < (input->size >> 1))
 	return PJMEDIA_CODEC_EFRMTOOSHORT;
 
     /* Detect silence if VAD is enabled */
     if (priv->vad_enabled) {
-	pj_bool_t is_silence;
 	pj_int32_t silence_period;
 
 	silence_period = pj_timestamp_diff32(&priv->last_tx,
 					     &input->timestamp);
 
-	is_silence = pjmedia_silence_det_detect(priv->vad, 
-						(const pj_int16_t*) input->buf, 
-						(input->size >> 1), NULL);
-	if (is_silence && 
+	*is_silence = pjmedia_silence_det_detect(priv->vad,
+						 (const pj_int16_t*) input->buf,
+						 (input->size >> 1), NULL);
+	if (*is_silence && 
 	    (PJMEDIA_CODEC_MAX_SILENCE_PERIOD == -1 ||
 	     silence_period < PJMEDIA_CODEC_MAX_SILENCE_PERIOD*8000/1000))
 	{
@@ -515,31 +543,13 @@ static pj_status_t  g711_encode(pjmedia_codec *codec,
 	    output->timestamp = input->timestamp;
 	    return PJ_SUCCESS;
 	} else {
+	    *is_silence = PJ_FALSE;
 	    priv->last_tx = input->timestamp;
 	}
     }
 
-    /* Encode */
-    if (priv->pt == PJMEDIA_RTP_PT_PCMA) {
-	unsigned i, n;
-	pj_uint8_t *dst = (pj_uint8_t*) output->buf;
-
-	n = ((unsigned)input->size >> 1);
-	for (i=0; i!=n; ++i, ++dst) {
-	    *dst = pjmedia_linear2alaw(samples[i]);
-	}
-    } else if (priv->pt == PJMEDIA_RTP_PT_PCMU) {
-	unsigned i, n;
-	pj_uint8_t *dst = (pj_uint8_t*) output->buf;
-
-	n = ((unsigned)input->size >> 1);
-	for (i=0; i!=n; ++i, ++dst) {
-	    *dst = pjmedia_linear2ulaw(samples[i]);
-	}
-
-    } else {
+    if (priv->pt != PJMEDIA_RTP_PT_PCMA && priv->pt != PJMEDIA_RTP_PT_PCMU)
 	return PJMEDIA_EINVALIDPT;
-    }
 
     output->type = PJMEDIA_FRAME_TYPE_AUDIO;
     output->size = (input->size >> 1);
@@ -548,6 +558,33 @@ static pj_status_t  g711_encode(pjmedia_codec *codec,
     return PJ_SUCCESS;
 }
 
+static pj_status_t  g711_encode(pjmedia_codec *codec, 
+				const struct pjmedia_frame *input,
+				unsigned output_buf_len, 
+				struct pjmedia_frame *output)
+{
+    pj_int16_t *samples = (pj_int16_t*) input->buf;
+    struct g711_private *priv = (struct g711_private*) codec->codec_data;
+    pj_bool_t is_silence;
+    pj_status_t status;
+
+    status = g711_encode_prepare(codec, input, output_buf_len, output,
+				 &is_silence);
+    if (status != PJ_SUCCESS || is_silence)
+	return status;
+
+    /* Encode */
+    if (priv->pt == PJMEDIA_RTP_PT_PCMA) {
+	pjmedia_alaw_encode((pj_uint8_t*)output->buf, samples,
+			    input->size >> 1);
+    } else {
+	pjmedia_ulaw_encode((pj_uint8_t*)output->buf, samples,
+			    input->size >> 1);
+    }
+
+    return PJ_SUCCESS;
+}
+
 static pj_status_t  g711_decode(pjmedia_codec *codec, 
 				const struct pjmedia_frame *input,
 				unsigned output_buf_len, 
@@ -565,22 +602,11 @@ static pj_status_t  g711_decode(pjmedia_codec *codec,
 
     /* Decode */
     if (priv->pt == PJMEDIA_RTP_PT_PCMA) {
-	unsigned i;
-	pj_uint8_t *src = (pj_uint8_t*) input->buf;
-	pj_uint16_t *dst = (pj_uint16_t*) output->buf;
-
-	for (i=0; i!=input->size; ++i) {
-	    *dst++ = (pj_uint16_t) pjmedia_alaw2linear(*src++);
-	}
+	pjmedia_alaw_decode((pj_int16_t*)output->buf,
+			    (const pj_uint8_t*)input->buf, input->size);
     } else if (priv->pt == PJMEDIA_RTP_PT_PCMU) {
-	unsigned i;
-	pj_uint8_t *src = (pj_uint8_t*) input->buf;
-	pj_uint16_t *dst = (pj_uint16_t*) output->buf;
-
-	for (i=0; i!=input->size; ++i) {
-	    *dst++ = (pj_uint16_t) pjmedia_ulaw2linear(*src++);
-	}
-
+	pjmedia_ulaw_decode((pj_int16_t*)output->buf,
+			    (const pj_uint8_t*)input->buf, input->size);
     } else {
 	return PJMEDIA_EINVALIDPT;
     }
@@ -597,6 +623,77 @@ static pj_status_t  g711_decode(pjmedia_codec *codec,
     return PJ_SUCCESS;
 }
 
+/* Encode the collected frames of one law with one bulk conversion call */
+static void g711_encode_frames(pj_bool_t alaw, unsigned frame_cnt,
+			       pj_uint8_t *const dst[],
+			       const pj_int16_t *const src[],
+			       pj_size_t count)
+{
+    if (alaw)
+	pjmedia_alaw_encode_frames(frame_cnt, dst, src, count);
+    else
+	pjmedia_ulaw_encode_frames(frame_cnt, dst, src, count);
+}
+
+/*
+ * Check and run VAD on every job first, then convert the frames that need
+ * encoding with one bulk conversion call for each law and frame size.
+ */
+static pj_status_t  g711_encode_batch( unsigned count,
+				       pjmedia_codec_encode_job jobs[])
+{
+    pj_uint8_t *dst[2][BATCH_FRAMES];
+    const pj_int16_t *src[2][BATCH_FRAMES];
+    pj_size_t samples_cnt[2] = { 0, 0 };
+    unsigned frame_cnt[2] = { 0, 0 };
+    pj_status_t status = PJ_SUCCESS;
+    unsigned i;
+
+    for (i = 0; i < count; ++i) {
+	pjmedia_codec_encode_job *job = &jobs[i];
+	struct g711_private *priv;
+	pj_bool_t is_silence;
+	pj_size_t samples;
+	unsigned law;
+
+	job->status = g711_encode_prepare(job->codec, job->input,
+					  job->out_size, job->output,
+					  &is_silence);
+	if (job->status != PJ_SUCCESS) {
+	    if (status == PJ_SUCCESS)
+		status = job->status;
+	    continue;
+	}
+	if (is_silence)
+	    continue;
+
+	priv = (struct g711_private*) job->codec->codec_data;
+	law = (priv->pt == PJMEDIA_RTP_PT_PCMA);
+	samples = job->input->size >> 1;
+
+	if (frame_cnt[law] == BATCH_FRAMES ||
+	    (frame_cnt[law] && samples_cnt[law] != samples))
+	{
+	    g711_encode_frames(law, frame_cnt[law], dst[law], src[law],
+			       samples_cnt[law]);
+	    frame_cnt[law] = 0;
+	}
+
+	dst[law][frame_cnt[law]] = (pj_uint8_t*) job->output->buf;
+	src[law][frame_cnt[law]] = (const pj_int16_t*) job->input->buf;
+	samples_cnt[law] = samples;
+	++frame_cnt[law];
+    }
+
+    for (i = 0; i < 2; ++i) {
+	if (frame_cnt[i])
+	    g711_encode_frames(i, frame_cnt[i], dst[i], src[i],
+			       samples_cnt[i]);
+    }
+
+    return status;
+}
+
 #if !PLC_DISABLED
 static pj_status_t  g711_recover( pjmedia_codec *codec,
 				  unsigned output_buf_len,
@@ -150,6 +150,19 @@ PJ_DEF(pj_status_t) pjmedia_master_port_stop(pjmedia_master_port *m)
 }
 
 
+/*
+ * Let the master port clock be run by a clock scheduler.
+ */
+PJ_DEF(pj_status_t) pjmedia_master_port_set_clock_sched(
+					    pjmedia_master_port *m,
+					    pjmedia_clock_sched *sched)
+{
+    PJ_ASSERT_RETURN(m && m->clock, PJ_EINVAL);
+
+    return pjmedia_clock_set_sched(m->clock, sched);
+}
+
+
 /* Poll the master port clock */
 PJ_DEF(pj_bool_t) pjmedia_master_port_wait( pjmedia_master_port *m,
 					    pj_bool_t wait,
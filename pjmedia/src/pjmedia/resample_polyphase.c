@@ -0,0 +1,360 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pjmedia/resample.h>
+#include <pjmedia/errno.h>
+#include <pj/assert.h>
+#include <pj/log.h>
+#include <pj/pool.h>
+
+#if PJMEDIA_RESAMPLE_IMP==PJMEDIA_RESAMPLE_POLYPHASE
+
+#include <math.h>
+
+#if defined(__AVX__)
+#   include <immintrin.h>
+#   define SIMD_NAME	    "AVX"
+#elif defined(__SSE__) || defined(_M_X64) || \
+      (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#   include <xmmintrin.h>
+#   define SIMD_NAME	    "SSE"
+#   define USE_SSE	    1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#   include <arm_neon.h>
+#   define SIMD_NAME	    "NEON"
+#   define USE_NEON	    1
+#else
+#   define SIMD_NAME	    "scalar"
+#endif
+
+#define THIS_FILE   "resample_polyphase.c"
+
+/* Number of filter taps is always a multiple of this, so the dot product
+ * loop doesn't need remainder handling. It is also the alignment, in
+ * number of floats, of each filter phase.
+ */
+#define TAP_ALIGN	8
+
+#ifndef M_PI
+#   define M_PI		3.14159265358979323846
+#endif
+
+
+/* Filter presets */
+static const struct preset
+{
+    const char	*name;
+    unsigned	 taps;		/* Number of taps per phase.		    */
+    double	 cutoff;	/* Cutoff, relative to the Nyquist rate.    */
+    double	 beta;		/* Kaiser window beta.			    */
+} presets[] =
+{
+    { "fast",	 8, 0.80, 4.0 },    /* !high_quality			    */
+    { "medium", 24, 0.90, 6.5 },    /* high_quality, small filter	    */
+    { "high",	48, 0.94, 8.5 },    /* high_quality, large filter	    */
+};
+
+
+struct pjmedia_resample
+{
+    unsigned	 channel_cnt;	/* Channel count.			    */
+    unsigned	 in_frame;	/* Input samples per channel per frame.	    */
+    unsigned	 out_frame;	/* Output samples per channel per frame.    */
+    unsigned	 up;		/* Interpolation factor (L).		    */
+    unsigned	 down;		/* Decimation factor (M).		    */
+    unsigned	 taps;		/* Taps per phase, multiple of TAP_ALIGN.   */
+
+    float	*coef;		/* Filter bank, up * taps coefficients.	    */
+    float	**hist;		/* Per channel buffer: taps-1 samples of
+				   history followed by the input frame.	    */
+};
+
+
+/* Zeroth order modified Bessel function of the first kind */
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0, y = x * x / 4.0;
+    unsigned k;
+
+    for (k = 1; k < 50; ++k) {
+	term *= y / ((double)k * k);
+	sum += term;
+	if (term < sum * 1e-12)
+	    break;
+    }
+    return sum;
+}
+
+/* Allocate float array aligned to TAP_ALIGN floats */
+static float *alloc_aligned(pj_pool_t *pool, unsigned cnt)
+{
+    pj_size_t align = TAP_ALIGN * sizeof(float);
+    char *p = (char*) pj_pool_zalloc(pool, cnt * sizeof(float) + align);
+
+    if (!p)
+	return NULL;
+    return (float*)(((pj_size_t)p + align - 1) & ~(align - 1));
+}
+
+static unsigned gcd(unsigned a, unsigned b)
+{
+    while (b) {
+	unsigned t = a % b;
+	a = b;
+	b = t;
+    }
+    return a;
+}
+
+/*
+ * Build the polyphase filter bank. Phase p of the bank interpolates the
+ * input at p/up sample after the input sample, with a delay of taps/2
+ * input samples. Each phase is normalized to unity DC gain.
+ */
+static void design_filter(pjmedia_resample *rs, const struct preset *ps)
+{
+    double fc, i0_beta, half = rs->taps / 2.0;
+    unsigned p, k;
+
+    /* Cutoff at the lower Nyquist rate of the input and output */
+    fc = ps->cutoff;
+    if (rs->down > rs->up)
+	fc = fc * rs->up / rs->down;
+
+    i0_beta = bessel_i0(ps->beta);
+
+    for (p = 0; p < rs->up; ++p) {
+	float *h = rs->coef + p * rs->taps;
+	double sum = 0;
+
+	for (k = 0; k < rs->taps; ++k) {
+	    double t = half - 1 - k + (double)p / rs->up;
+	    double x = fc * t, r = t / half, v;
+
+	    v = (x == 0) ? fc : fc * sin(M_PI * x) / (M_PI * x);
+	    if (r <= -1.0 || r >= 1.0)
+		v = 0;
+	    else
+		v *= bessel_i0(ps->beta * sqrt(1.0 - r * r)) / i0_beta;
+
+	    h[k] = (float)v;
+	    sum += v;
+	}
+
+	for (k = 0; k < rs->taps; ++k)
+	    h[k] = (float)(h[k] / sum);
+    }
+}
+
+
+/* Dot product of taps (multiple of TAP_ALIGN) samples, h is aligned */
+static float dot_product(const float *x, const float *h, unsigned taps)
+{
+#if defined(__AVX__)
+    __m256 acc = _mm256_setzero_ps();
+    __m128 lo;
+    unsigned k;
+
+    for (k = 0; k < taps; k += 8) {
+	acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(x + k),
+					       _mm256_load_ps(h + k)));
+    }
+    lo = _mm_add_ps(_mm256_castps256_ps128(acc),
+		    _mm256_extractf128_ps(acc, 1));
+    lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+    lo = _mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 1));
+    return _mm_cvtss_f32(lo);
+
+#elif defined(USE_SSE)
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    unsigned k;
+
+    for (k = 0; k < taps; k += 8) {
+	acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + k),
+					   _mm_load_ps(h + k)));
+	acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x + k + 4),
+					   _mm_load_ps(h + k + 4)));
+    }
+    acc0 = _mm_add_ps(acc0, acc1);
+    acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+    acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+    return _mm_cvtss_f32(acc0);
+
+#elif defined(USE_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0), acc1 = vdupq_n_f32(0);
+    float32x2_t sum;
+    unsigned k;
+
+    for (k = 0; k < taps; k += 8) {
+	acc0 = vmlaq_f32(acc0, vld1q_f32(x + k), vld1q_f32(h + k));
+	acc1 = vmlaq_f32(acc1, vld1q_f32(x + k + 4), vld1q_f32(h + k + 4));
+    }
+    acc0 = vaddq_f32(acc0, acc1);
+    sum = vadd_f32(vget_low_f32(acc0), vget_high_f32(acc0));
+    return vget_lane_f32(vpadd_f32(sum, sum), 0);
+
+#else
+    float acc[TAP_ALIGN] = { 0 };
+    unsigned k, j;
+
+    for (k = 0; k < taps; k += TAP_ALIGN) {
+	for (j = 0; j < TAP_ALIGN; ++j)
+	    acc[j] += x[k + j] * h[k + j];
+    }
+    for (j = 1; j < TAP_ALIGN; ++j)
+	acc[0] += acc[j];
+    return acc[0];
+#endif
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_resample_create( pj_pool_t *pool,
+					     pj_bool_t high_quality,
+					     pj_bool_t large_filter,
+					     unsigned channel_count,
+					     unsigned rate_in,
+					     unsigned rate_out,
+					     unsigned samples_per_frame,
+					     pjmedia_resample **p_resample)
+{
+    pjmedia_resample *rs;
+    const struct preset *ps;
+    unsigned i, g;
+
+    PJ_ASSERT_RETURN(pool && p_resample && rate_in &&
+		     rate_out && samples_per_frame, PJ_EINVAL);
+    PJ_ASSERT_RETURN(channel_count && samples_per_frame % channel_count == 0,
+		     PJ_EINVAL);
+
+    rs = PJ_POOL_ZALLOC_T(pool, pjmedia_resample);
+    PJ_ASSERT_RETURN(rs, PJ_ENOMEM);
+
+    g = gcd(rate_in, rate_out);
+    rs->up = rate_out / g;
+    rs->down = rate_in / g;
+    rs->channel_cnt = channel_count;
+    rs->in_frame = samples_per_frame / channel_count;
+
+    /* Input frame must produce whole number of output samples */
+    if ((rs->in_frame * rs->up) % rs->down != 0 ||
+	rs->up > PJMEDIA_RESAMPLE_POLYPHASE_MAX_PHASES)
+    {
+	PJ_LOG(4,(THIS_FILE, "Unsupported resampling %d->%d with %d samples "
+		  "per frame", rate_in, rate_out, samples_per_frame));
+	return PJ_ENOTSUP;
+    }
+    rs->out_frame = rs->in_frame * rs->up / rs->down;
+
+    if (!high_quality)
+	ps = &presets[0];
+    else if (!large_filter)
+	ps = &presets[1];
+    else
+	ps = &presets[2];
+
+    rs->taps = ps->taps;
+    pj_assert(rs->taps % TAP_ALIGN == 0);
+
+    rs->coef = alloc_aligned(pool, rs->up * rs->taps);
+    rs->hist = (float**) pj_pool_calloc(pool, channel_count, sizeof(float*));
+    PJ_ASSERT_RETURN(rs->coef && rs->hist, PJ_ENOMEM);
+
+    for (i = 0; i < channel_count; ++i) {
+	rs->hist[i] = alloc_aligned(pool, rs->taps - 1 + rs->in_frame);
+	PJ_ASSERT_RETURN(rs->hist[i], PJ_ENOMEM);
+    }
+
+    design_filter(rs, ps);
+
+    *p_resample = rs;
+
+    PJ_LOG(5,(THIS_FILE, "resample created: %s filter (%d taps, %d phases, "
+	      SIMD_NAME "), ch=%d, in/out rate=%d/%d", ps->name, rs->taps,
+	      rs->up, channel_count, rate_in, rate_out));
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(void) pjmedia_resample_run( pjmedia_resample *rs,
+				   const pj_int16_t *input,
+				   pj_int16_t *output )
+{
+    unsigned hist_len, ch;
+
+    PJ_ASSERT_ON_FAIL(rs, return);
+
+    hist_len = rs->taps - 1;
+
+    for (ch = 0; ch < rs->channel_cnt; ++ch) {
+	float *x = rs->hist[ch];
+	const pj_int16_t *in = input + ch;
+	pj_int16_t *out = output + ch;
+	unsigned i, n, in_idx = 0, phase = 0;
+
+	/* Append the frame after the history */
+	for (i = 0; i < rs->in_frame; ++i, in += rs->channel_cnt)
+	    x[hist_len + i] = (float)*in;
+
+	for (n = 0; n < rs->out_frame; ++n, out += rs->channel_cnt) {
+	    float v = dot_product(x + in_idx, rs->coef + phase * rs->taps,
+				  rs->taps);
+
+	    if (v >= 32767.0f)
+		*out = 32767;
+	    else if (v <= -32768.0f)
+		*out = -32768;
+	    else
+		*out = (pj_int16_t)(v < 0 ? v - 0.5f : v + 0.5f);
+
+	    phase += rs->down;
+	    while (phase >= rs->up) {
+		phase -= rs->up;
+		++in_idx;
+	    }
+	}
+
+	/* The frame always ends at phase zero, see pjmedia_resample_create()
+	 * for the frame size requirement.
+	 */
+	pj_assert(in_idx == rs->in_frame && phase == 0);
+
+	/* Keep the last samples as history for the next frame */
+	pj_memmove(x, x + rs->in_frame, hist_len * sizeof(float));
+    }
+}
+
+
+PJ_DEF(unsigned) pjmedia_resample_get_input_size(pjmedia_resample *resample)
+{
+    PJ_ASSERT_RETURN(resample != NULL, 0);
+    return resample->in_frame * resample->channel_cnt;
+}
+
+
+PJ_DEF(void) pjmedia_resample_destroy(pjmedia_resample *resample)
+{
+    PJ_UNUSED_ARG(resample);
+}
+
+
+#else /* PJMEDIA_RESAMPLE_IMP==PJMEDIA_RESAMPLE_POLYPHASE */
+
+int pjmedia_resample_polyphase_excluded;
+
+#endif	/* PJMEDIA_RESAMPLE_IMP==PJMEDIA_RESAMPLE_POLYPHASE */
+
@@ -0,0 +1,284 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pjmedia/rtp_pkt_pool.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/lock.h>
+#include <pj/log.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+
+
+/* Round up x to multiple of a, a must be power of two */
+#define ALIGN_UP(x, a)	(((x) + (a) - 1) & ~((pj_size_t)(a) - 1))
+
+struct pjmedia_rtp_pkt_pool
+{
+    char		 obj_name[PJ_MAX_OBJ_NAME];
+    pj_pool_t		*pool;		/**< Pool for the buffers.	    */
+    pj_lock_t		*lock;		/**< Protects the members below.    */
+    unsigned		 buf_size;	/**< Requested buffer size.	    */
+    unsigned		 max_cnt;	/**< Maximum number of buffers.	    */
+    pjmedia_rtp_pkt	*free_list;	/**< Unused packets.		    */
+    unsigned		 wrap_cnt;	/**< Wrapped packets allocated.	    */
+    pjmedia_rtp_pkt	*wrap_free_list;/**< Unused wrapped packets.	    */
+    pjmedia_rtp_pkt_pool_stat stat;	/**< Statistic.			    */
+};
+
+
+/* Allocate a new packet, pool lock must be held */
+static pjmedia_rtp_pkt *alloc_pkt(pjmedia_rtp_pkt_pool *pp)
+{
+    pjmedia_rtp_pkt *pkt;
+    pj_size_t size;
+    char *buf;
+
+    /* Pad the buffer size as well, so the buffer doesn't share cache
+     * line with the next allocation.
+     */
+    size = ALIGN_UP(pp->buf_size, PJMEDIA_RTP_PKT_POOL_ALIGN);
+    buf = (char*) pj_pool_alloc(pp->pool, size + PJMEDIA_RTP_PKT_POOL_ALIGN);
+    if (!buf)
+	return NULL;
+
+    pkt = PJ_POOL_ZALLOC_T(pp->pool, pjmedia_rtp_pkt);
+    pkt->buf = (void*) ALIGN_UP((pj_size_t)buf, PJMEDIA_RTP_PKT_POOL_ALIGN);
+    pkt->size = pp->buf_size;
+    pkt->pool = pp;
+
+    ++pp->stat.capacity;
+    return pkt;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_rtp_pkt_pool_create(pj_pool_t *pool,
+						const char *name,
+						unsigned buf_size,
+						unsigned init_cnt,
+						unsigned max_cnt,
+						pjmedia_rtp_pkt_pool **p_pkt_pool)
+{
+    pjmedia_rtp_pkt_pool *pp;
+    pj_pool_t *pp_pool;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && buf_size && init_cnt && p_pkt_pool, PJ_EINVAL);
+    PJ_ASSERT_RETURN(max_cnt == 0 || max_cnt >= init_cnt, PJ_EINVAL);
+
+    if (!name)
+	name = "rtppkt%p";
+
+    pp_pool = pj_pool_create(pool->factory, name,
+			     init_cnt * (buf_size + 2 *
+					 PJMEDIA_RTP_PKT_POOL_ALIGN) + 512,
+			     16 * (buf_size + 2 * PJMEDIA_RTP_PKT_POOL_ALIGN),
+			     NULL);
+    PJ_ASSERT_RETURN(pp_pool, PJ_ENOMEM);
+
+    pp = PJ_POOL_ZALLOC_T(pp_pool, pjmedia_rtp_pkt_pool);
+    pp->pool = pp_pool;
+    pp->buf_size = buf_size;
+    pp->max_cnt = max_cnt? max_cnt : init_cnt;
+    pj_ansi_strncpy(pp->obj_name, pp_pool->obj_name, PJ_MAX_OBJ_NAME-1);
+
+    status = pj_lock_create_simple_mutex(pp_pool, pp->obj_name, &pp->lock);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(pp_pool);
+	return status;
+    }
+
+    for (i = 0; i < init_cnt; ++i) {
+	pjmedia_rtp_pkt *pkt = alloc_pkt(pp);
+
+	if (!pkt) {
+	    pjmedia_rtp_pkt_pool_destroy(pp);
+	    return PJ_ENOMEM;
+	}
+	pkt->next = pp->free_list;
+	pp->free_list = pkt;
+    }
+
+    PJ_LOG(5,(pp->obj_name, "RTP packet pool created, %d buffers of %d "
+	      "bytes (max %d)", init_cnt, buf_size, pp->max_cnt));
+
+    *p_pkt_pool = pp;
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_rtp_pkt_pool_acquire(pjmedia_rtp_pkt_pool *pp,
+						 pjmedia_rtp_pkt **p_pkt)
+{
+    pjmedia_rtp_pkt *pkt;
+
+    PJ_ASSERT_RETURN(pp && p_pkt, PJ_EINVAL);
+
+    pj_lock_acquire(pp->lock);
+
+    pkt = pp->free_list;
+    if (pkt) {
+	pp->free_list = pkt->next;
+    } else if (pp->stat.capacity < pp->max_cnt) {
+	pkt = alloc_pkt(pp);
+    }
+
+    if (!pkt) {
+	++pp->stat.fail_cnt;
+	pj_lock_release(pp->lock);
+	return PJ_ETOOMANY;
+    }
+
+    pkt->next = NULL;
+    pkt->len = 0;
+    pkt->ref_cnt = 1;
+
+    ++pp->stat.acquire_cnt;
+    if (++pp->stat.in_use > pp->stat.max_in_use)
+	pp->stat.max_in_use = pp->stat.in_use;
+
+    pj_lock_release(pp->lock);
+
+    *p_pkt = pkt;
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_rtp_pkt_pool_wrap(pjmedia_rtp_pkt_pool *pp,
+					      void *buf,
+					      unsigned size,
+					      unsigned len,
+					      pjmedia_rtp_pkt **p_pkt)
+{
+    pjmedia_rtp_pkt *pkt;
+
+    PJ_ASSERT_RETURN(pp && buf && len <= size && p_pkt, PJ_EINVAL);
+
+    pj_lock_acquire(pp->lock);
+
+    pkt = pp->wrap_free_list;
+    if (pkt) {
+	pp->wrap_free_list = pkt->next;
+    } else if (pp->wrap_cnt < pp->max_cnt) {
+	pkt = PJ_POOL_ZALLOC_T(pp->pool, pjmedia_rtp_pkt);
+	pkt->pool = pp;
+	pkt->wrapped = PJ_TRUE;
+	++pp->wrap_cnt;
+    }
+
+    if (!pkt) {
+	++pp->stat.fail_cnt;
+	pj_lock_release(pp->lock);
+	return PJ_ETOOMANY;
+    }
+
+    pkt->next = NULL;
+    pkt->buf = buf;
+    pkt->size = size;
+    pkt->len = len;
+    pkt->ref_cnt = 1;
+
+    ++pp->stat.acquire_cnt;
+    if (++pp->stat.in_use > pp->stat.max_in_use)
+	pp->stat.max_in_use = pp->stat.in_use;
+
+    pj_lock_release(pp->lock);
+
+    *p_pkt = pkt;
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_rtp_pkt_add_ref(pjmedia_rtp_pkt *pkt)
+{
+    PJ_ASSERT_RETURN(pkt && pkt->pool, PJ_EINVAL);
+
+    pj_lock_acquire(pkt->pool->lock);
+    pj_assert(pkt->ref_cnt > 0);
+    ++pkt->ref_cnt;
+    pj_lock_release(pkt->pool->lock);
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_rtp_pkt_dec_ref(pjmedia_rtp_pkt *pkt)
+{
+    pjmedia_rtp_pkt_pool *pp;
+
+    PJ_ASSERT_RETURN(pkt && pkt->pool, PJ_EINVAL);
+
+    pp = pkt->pool;
+    pj_lock_acquire(pp->lock);
+
+    PJ_ASSERT_ON_FAIL(pkt->ref_cnt > 0,
+		      { pj_lock_release(pp->lock); return PJ_EINVALIDOP; });
+
+    if (--pkt->ref_cnt == 0) {
+	if (pkt->wrapped) {
+	    /* Don't keep pointer to the caller's buffer */
+	    pkt->buf = NULL;
+	    pkt->size = pkt->len = 0;
+	    pkt->next = pp->wrap_free_list;
+	    pp->wrap_free_list = pkt;
+	} else {
+	    pkt->next = pp->free_list;
+	    pp->free_list = pkt;
+	}
+	--pp->stat.in_use;
+    }
+
+    pj_lock_release(pp->lock);
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_rtp_pkt_pool_get_stat(
+					pjmedia_rtp_pkt_pool *pp,
+					pjmedia_rtp_pkt_pool_stat *stat)
+{
+    PJ_ASSERT_RETURN(pp && stat, PJ_EINVAL);
+
+    pj_lock_acquire(pp->lock);
+    pj_memcpy(stat, &pp->stat, sizeof(*stat));
+    pj_lock_release(pp->lock);
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_rtp_pkt_pool_destroy(pjmedia_rtp_pkt_pool *pp)
+{
+    PJ_ASSERT_RETURN(pp, PJ_EINVAL);
+
+    if (pp->stat.in_use) {
+	PJ_LOG(4,(pp->obj_name, "Destroying RTP packet pool with %d "
+		  "buffers still in use", pp->stat.in_use));
+    }
+
+    if (pp->lock) {
+	pj_lock_destroy(pp->lock);
+	pp->lock = NULL;
+    }
+
+    pj_pool_safe_release(&pp->pool);
+
+    return PJ_SUCCESS;
+}
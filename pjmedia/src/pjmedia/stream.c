@@ -159,6 +159,9 @@ struct pjmedia_stream
 						 bit.			    */
     pj_uint32_t		     ts_vad_disabled;/**< TS when VAD was disabled. */
     pj_uint32_t		     tx_duration;   /**< TX duration in timestamp.  */
+    pj_uint32_t		     tx_dtx_duration;/**< Duration of NULL frames not
+						 encoded during silence, in
+						 timestamp.		    */
 
     pj_mutex_t		    *jb_mutex;
     pjmedia_jbuf	    *jb;	    /**< Jitter buffer.		    */
@@ -259,6 +262,12 @@ struct pjmedia_stream
     pjmedia_rtcp_fb_nack     rtcp_fb_nack;	    /**< TX NACK state.	    */
     int			     rtcp_fb_nack_cap_idx;  /**< RX NACK cap idx.   */
 
+    /* RTP relay, protected by jb_mutex */
+    pjmedia_stream	    *relay_dst;		    /**< Relay destination. */
+    pjmedia_rtp_pkt_pool    *relay_pkt_pool;	    /**< Relay packet pool. */
+    pj_bool_t		     relay_copy;	    /**< Copy to pool buf?  */
+    unsigned		     relay_busy;	    /**< Relays in progress.*/
+
 
 };
 
@@ -485,9 +494,10 @@ static void send_keep_alive_packet(pjmedia_stream *stream)
     pjmedia_transport_send_rtp(stream->transport, stream->enc->out_pkt,
 			       pkt_len);
 
-    /* Send to RTCP port */
-    pjmedia_transport_send_rtcp(stream->transport, stream->enc->out_pkt,
-			        pkt_len);
+    /* Send to RTCP port. The transport may have protected the RTP packet
+     * in place, so send the original keep-alive packet instead.
+     */
+    pjmedia_transport_send_rtcp(stream->transport, str_ka.ptr, pkt_len);
 
 #else
 
@@ -1384,6 +1394,31 @@ static pj_status_t put_frame_imp( pjmedia_port *port,
 	}
 
 
+    /*
+     * NULL frame (e.g. from conference bridge with DTX enabled) while the
+     * codec VAD has already stopped transmitting: skip encoding, the codec
+     * would not transmit anything for zero PCM frame anyway. The zero
+     * frame is still encoded once every PJMEDIA_CODEC_MAX_SILENCE_PERIOD,
+     * so the codec can transmit its periodic silence frame.
+     */
+    } else if (frame->type == PJMEDIA_FRAME_TYPE_AUDIO &&
+	       frame->buf == NULL &&
+	       stream->codec_param.setting.vad &&
+	       !stream->is_streaming &&
+	       (PJMEDIA_CODEC_MAX_SILENCE_PERIOD == -1 ||
+		stream->tx_dtx_duration + ts_len <
+		    (unsigned)PJMEDIA_CODEC_MAX_SILENCE_PERIOD *
+		    PJMEDIA_PIA_SRATE(&stream->port.info) / 1000))
+    {
+	stream->tx_dtx_duration += ts_len;
+
+	/* Just update RTP session's timestamp. */
+	status = pjmedia_rtp_encode_rtp( &channel->rtp,
+					 0, 0,
+					 0, rtp_ts_len,
+					 (const void**)&rtphdr,
+					 &rtphdrlen);
+
     /*
      * Special treatment for FRAME_TYPE_AUDIO but with frame->buf==NULL.
      * This happens when stream input is disconnected from the bridge.
@@ -1407,6 +1442,7 @@ static pj_status_t put_frame_imp( pjmedia_port *port,
 	silence_frame.size = stream->enc_samples_per_pkt * 2;
 	silence_frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
 	silence_frame.timestamp.u32.lo = pj_ntohl(stream->enc->rtp.out_hdr.ts);
+	stream->tx_dtx_duration = 0;
 
 	/* Encode! */
 	status = pjmedia_codec_encode( stream->codec, &silence_frame,
@@ -1507,6 +1543,7 @@ static pj_status_t put_frame_imp( pjmedia_port *port,
     }
 
     stream->is_streaming = PJ_TRUE;
+    stream->tx_dtx_duration = 0;
 
     /* Send the RTP packet to the transport. */
     status = pjmedia_transport_send_rtp(stream->transport, channel->out_pkt,
@@ -1746,6 +1783,78 @@ static void handle_incoming_dtmf( pjmedia_stream *stream,
 }
 
 
+/*
+ * Relay incoming RTP packet to the relay destination, if any.
+ * Return PJ_TRUE if the packet has been handled by the relay.
+ */
+static pj_bool_t relay_rtp(pjmedia_stream *stream, void *pkt,
+			   pj_ssize_t size)
+{
+    pjmedia_stream *dst;
+    pjmedia_rtp_pkt_pool *pkt_pool;
+    pjmedia_rtp_pkt *rpkt;
+    pj_bool_t copy;
+    pj_status_t status;
+
+    if (!stream->relay_dst)
+	return PJ_FALSE;
+
+    /* Pin the relay destination, so it stays valid while the packet is
+     * being sent without holding our lock.
+     */
+    pj_mutex_lock(stream->jb_mutex);
+    dst = stream->relay_dst;
+    pkt_pool = stream->relay_pkt_pool;
+    copy = stream->relay_copy;
+    if (dst)
+	++stream->relay_busy;
+    pj_mutex_unlock(stream->jb_mutex);
+
+    if (!dst)
+	return PJ_FALSE;
+
+    if (copy) {
+	/* The destination transport protects the packet in place and
+	 * appends the SRTP trailer, so it needs a buffer with room after
+	 * the packet, as promised by the destination stream when attaching
+	 * to its transport. We can't tell how much room the receive buffer
+	 * has.
+	 */
+	status = pjmedia_rtp_pkt_pool_acquire(pkt_pool, &rpkt);
+	if (status == PJ_SUCCESS) {
+	    if (size + PJMEDIA_STREAM_RESV_PAYLOAD_LEN <= rpkt->size) {
+		pj_memcpy(rpkt->buf, pkt, size);
+		rpkt->len = (unsigned)size;
+	    } else {
+		status = PJ_ETOOBIG;
+	    }
+	}
+    } else {
+	/* Pass the received buffer on as is */
+	status = pjmedia_rtp_pkt_pool_wrap(pkt_pool, pkt, (unsigned)size,
+					   (unsigned)size, &rpkt);
+    }
+
+    if (status == PJ_SUCCESS) {
+	status = pjmedia_transport_send_rtp(dst->transport, rpkt->buf,
+					    rpkt->len);
+	pjmedia_rtp_pkt_dec_ref(rpkt);
+    } else if (status == PJ_ETOOMANY) {
+	TRC_((stream->port.info.name.ptr, "Relay packet pool exhausted"));
+    }
+
+    if (status != PJ_SUCCESS) {
+	TRC_((stream->port.info.name.ptr, "Error relaying RTP packet"));
+    }
+
+    pj_mutex_lock(stream->jb_mutex);
+    --stream->relay_busy;
+    pj_mutex_unlock(stream->jb_mutex);
+
+    return PJ_TRUE;
+}
+
+
 /*
  * This callback is called by stream transport on receipt of packets
  * in the RTP socket.
@@ -1763,6 +1872,7 @@ static void on_rx_rtp( pjmedia_tp_cb_param *param)
     pj_bool_t check_pt;
     pj_status_t status;
     pj_bool_t pkt_discarded = PJ_FALSE;
+    pj_bool_t is_event = PJ_FALSE;
 
     /* Check for errors */
     if (bytes_read < 0) {
@@ -1862,12 +1972,15 @@ static void on_rx_rtp( pjmedia_tp_cb_param *param)
 	/* Ignore out-of-order packet as it will be detected as new
 	 * digit. Also ignore duplicate packet as it serves no use.
 	 */
-	if (seq_st.status.flag.outorder || seq_st.status.flag.dup) {
-	    goto on_return;
-	}
+	if (!seq_st.status.flag.outorder && !seq_st.status.flag.dup)
+	    handle_incoming_dtmf(stream, payload, payloadlen);
 
-	handle_incoming_dtmf(stream, payload, payloadlen);
-	goto on_return;
+	/* When relaying, the event is relayed as is (the remote will
+	 * handle retransmissions), after the source address check below.
+	 */
+	if (!stream->relay_dst)
+	    goto on_return;
+	is_event = PJ_TRUE;
     }
 
     /* See if source address of RTP packet is different than the
@@ -1926,6 +2039,10 @@ static void on_rx_rtp( pjmedia_tp_cb_param *param)
 	}
     }
 
+    /* Relay the packet as is, it doesn't need to be decoded */
+    if (relay_rtp(stream, pkt, bytes_read) || is_event)
+	goto on_return;
+
     /* Put "good" packet to jitter buffer, or reset the jitter buffer
      * when RTP session is restarted.
      */
@@ -2219,7 +2336,11 @@ static pj_status_t create_channel( pj_pool_t *pool,
         return PJ_ENOTSUP;
     }
 
-    channel->out_pkt = pj_pool_alloc(pool, channel->out_pkt_size);
+    /* Reserve tailroom after the packet so media transport may append
+     * its trailer (e.g: SRTP auth tag) in place.
+     */
+    channel->out_pkt = pj_pool_alloc(pool, channel->out_pkt_size +
+					   PJMEDIA_STREAM_RESV_PAYLOAD_LEN);
     PJ_ASSERT_RETURN(channel->out_pkt != NULL, PJ_ENOMEM);
 
 
@@ -2688,6 +2809,7 @@ PJ_DEF(pj_status_t) pjmedia_stream_create( pjmedia_endpt *endpt,
     att_param.addr_len = pj_sockaddr_get_len(&info->rem_addr);
     att_param.rtp_cb2 = &on_rx_rtp;
     att_param.rtcp_cb = &on_rx_rtcp;
+    att_param.rtp_tx_tailroom = PJMEDIA_STREAM_RESV_PAYLOAD_LEN;
 
     /* Only attach transport when stream is ready. */
     status = pjmedia_transport_attach2(tp, &att_param);
@@ -3305,3 +3427,53 @@ pjmedia_stream_get_rtp_session_info(pjmedia_stream *stream,
     session_info->rtcp = &stream->rtcp;
     return PJ_SUCCESS;
 }
+
+
+/*
+ * Relay incoming RTP packets to another stream's transport.
+ */
+PJ_DEF(pj_status_t)
+pjmedia_stream_set_rtp_relay(pjmedia_stream *stream,
+			     pjmedia_stream *dst,
+			     pjmedia_rtp_pkt_pool *pkt_pool)
+{
+    pj_bool_t copy = PJ_FALSE;
+
+    PJ_ASSERT_RETURN(stream && stream != dst, PJ_EINVAL);
+    PJ_ASSERT_RETURN(!dst || (pkt_pool && dst->transport), PJ_EINVAL);
+
+    /* Received packets can be passed on as is, unless the destination
+     * transport protects them in place (SRTP), which needs room after
+     * the packet.
+     */
+    if (dst) {
+	pjmedia_transport_info tp_info;
+
+	pjmedia_transport_info_init(&tp_info);
+	pjmedia_transport_get_info(dst->transport, &tp_info);
+	copy = (pjmedia_transport_info_get_spc_info(
+				    &tp_info, PJMEDIA_TRANSPORT_TYPE_SRTP)
+		!= NULL);
+    }
+
+    pj_mutex_lock(stream->jb_mutex);
+    stream->relay_dst = dst;
+    stream->relay_pkt_pool = dst? pkt_pool : NULL;
+    stream->relay_copy = copy;
+
+    /* Wait until packets being relayed to the previous destination have
+     * been sent, so the application may destroy it once we return.
+     */
+    while (stream->relay_busy) {
+	pj_mutex_unlock(stream->jb_mutex);
+	pj_thread_sleep(1);
+	pj_mutex_lock(stream->jb_mutex);
+    }
+    pj_mutex_unlock(stream->jb_mutex);
+
+    PJ_LOG(4,(stream->port.info.name.ptr, "RTP relay %s%s",
+	      (dst? "to " : "disabled"),
+	      (dst? dst->port.info.name.ptr : "")));
+
+    return PJ_SUCCESS;
+}
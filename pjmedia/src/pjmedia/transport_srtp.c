@@ -230,8 +230,10 @@ typedef struct transport_srtp
     pjmedia_transport	 base;		    /**< Base transport interface.  */
     pj_pool_t		*pool;		    /**< Pool for transport SRTP.   */
     pj_lock_t		*mutex;		    /**< Mutex for libsrtp contexts.*/
-    char		 rtp_tx_buffer[MAX_RTP_BUFFER_LEN];
-    char		 rtcp_tx_buffer[MAX_RTCP_BUFFER_LEN];
+    pj_lock_t		*rtp_tx_mutex;	    /**< Mutex for RTP protect.	    */
+    pj_lock_t		*rtcp_tx_mutex;	    /**< Mutex for RTCP protect.    */
+    unsigned		 rtp_tx_tailroom;   /**< Tailroom of stream buffer. */
+    unsigned		 rtp_tx_trailer_len;/**< SRTP trailer length.	    */
     pjmedia_srtp_setting setting;
     unsigned		 media_option;
     pj_bool_t		 use_rtcp_mux;	    /**< Use RTP& RTCP multiplexing?*/
@@ -249,8 +251,12 @@ typedef struct transport_srtp
     pjmedia_srtp_crypto  tx_policy_neg;
     pjmedia_srtp_crypto  rx_policy_neg;
 
-    /* libSRTP contexts */
+    /* libSRTP contexts. Outgoing RTP and RTCP use separate contexts
+     * (created with the same policy), so they can be protected by
+     * different threads without contending for the same lock.
+     */
     srtp_t		 srtp_tx_ctx;
+    srtp_t		 srtp_tx_rtcp_ctx;
     srtp_t		 srtp_rx_ctx;
 
     /* Stream information */
@@ -756,6 +762,23 @@ PJ_DEF(pj_status_t) pjmedia_transport_srtp_create(
 	return status;
     }
 
+    status = pj_lock_create_recursive_mutex(pool, pool->obj_name,
+					    &srtp->rtp_tx_mutex);
+    if (status != PJ_SUCCESS) {
+	pj_lock_destroy(srtp->mutex);
+	pj_pool_release(pool);
+	return status;
+    }
+
+    status = pj_lock_create_recursive_mutex(pool, pool->obj_name,
+					    &srtp->rtcp_tx_mutex);
+    if (status != PJ_SUCCESS) {
+	pj_lock_destroy(srtp->rtp_tx_mutex);
+	pj_lock_destroy(srtp->mutex);
+	pj_pool_release(pool);
+	return status;
+    }
+
     /* Initialize base pjmedia_transport */
     pj_memcpy(srtp->base.name, pool->obj_name, PJ_MAX_OBJ_NAME);
     if (tp)
@@ -826,7 +849,10 @@ PJ_DEF(pj_status_t) pjmedia_transport_srtp_start(
 
     PJ_ASSERT_RETURN(tp && tx && rx, PJ_EINVAL);
 
+    /* Lock order: mutex, rtp_tx_mutex, then rtcp_tx_mutex */
     pj_lock_acquire(srtp->mutex);
+    pj_lock_acquire(srtp->rtp_tx_mutex);
+    pj_lock_acquire(srtp->rtcp_tx_mutex);
 
     if (srtp->session_inited) {
 	pjmedia_transport_srtp_stop(tp);
@@ -894,6 +920,13 @@ PJ_DEF(pj_status_t) pjmedia_transport_srtp_start(
 	status = PJMEDIA_ERRNO_FROM_LIBSRTP(err);
 	goto on_return;
     }
+    err = srtp_create(&srtp->srtp_tx_rtcp_ctx, &tx_);
+    if (err != srtp_err_status_ok) {
+	srtp_dealloc(srtp->srtp_tx_ctx);
+	status = PJMEDIA_ERRNO_FROM_LIBSRTP(err);
+	goto on_return;
+    }
+    srtp->rtp_tx_trailer_len = tx_.rtp.auth_tag_len;
     srtp->tx_policy = *tx;
     pj_strset(&srtp->tx_policy.key,  srtp->tx_key, tx->key.slen);
     srtp->tx_policy.name=pj_str(crypto_suites[get_crypto_idx(&tx->name)].name);
@@ -925,6 +958,7 @@ PJ_DEF(pj_status_t) pjmedia_transport_srtp_start(
     err = srtp_create(&srtp->srtp_rx_ctx, &rx_);
     if (err != srtp_err_status_ok) {
 	srtp_dealloc(srtp->srtp_tx_ctx);
+	srtp_dealloc(srtp->srtp_tx_rtcp_ctx);
 	status = PJMEDIA_ERRNO_FROM_LIBSRTP(err);
 	goto on_return;
     }
@@ -978,6 +1012,8 @@ PJ_DEF(pj_status_t) pjmedia_transport_srtp_start(
 #endif
 
 on_return:
+    pj_lock_release(srtp->rtcp_tx_mutex);
+    pj_lock_release(srtp->rtp_tx_mutex);
     pj_lock_release(srtp->mutex);
     return status;
 }
@@ -999,6 +1035,9 @@ PJ_DEF(pj_status_t) pjmedia_transport_srtp_stop(pjmedia_transport *srtp)
 	return PJ_SUCCESS;
     }
 
+    pj_lock_acquire(p_srtp->rtp_tx_mutex);
+    pj_lock_acquire(p_srtp->rtcp_tx_mutex);
+
     err = srtp_dealloc(p_srtp->srtp_rx_ctx);
     if (err != srtp_err_status_ok) {
 	PJ_LOG(4, (p_srtp->pool->obj_name,
@@ -1011,11 +1050,19 @@ PJ_DEF(pj_status_t) pjmedia_transport_srtp_stop(pjmedia_transport *srtp)
 		   "Failed to dealloc TX SRTP context: %s",
 		   get_libsrtp_errstr(err)));
     }
+    err = srtp_dealloc(p_srtp->srtp_tx_rtcp_ctx);
+    if (err != srtp_err_status_ok) {
+	PJ_LOG(4, (p_srtp->pool->obj_name,
+		   "Failed to dealloc TX SRTCP context: %s",
+		   get_libsrtp_errstr(err)));
+    }
 
     p_srtp->session_inited = PJ_FALSE;
     pj_bzero(&p_srtp->rx_policy, sizeof(p_srtp->rx_policy));
     pj_bzero(&p_srtp->tx_policy, sizeof(p_srtp->tx_policy));
 
+    pj_lock_release(p_srtp->rtcp_tx_mutex);
+    pj_lock_release(p_srtp->rtp_tx_mutex);
     pj_lock_release(p_srtp->mutex);
 
     return PJ_SUCCESS;
@@ -1133,6 +1180,7 @@ static pj_status_t transport_attach2(pjmedia_transport *tp,
 	srtp->rtp_cb2 = param->rtp_cb2;
 	srtp->rtcp_cb = param->rtcp_cb;
 	srtp->user_data = param->user_data;
+	srtp->rtp_tx_tailroom = param->rtp_tx_tailroom;
     }
     pj_lock_release(srtp->mutex);
 
@@ -1177,6 +1225,7 @@ static void transport_detach(pjmedia_transport *tp, void *strm)
     srtp->rtp_cb2 = NULL;
     srtp->rtcp_cb = NULL;
     srtp->user_data = NULL;
+    srtp->rtp_tx_tailroom = 0;
     pj_lock_release(srtp->mutex);
     srtp->member_tp_attached = PJ_FALSE;
 }
@@ -1188,27 +1237,41 @@ static pj_status_t transport_send_rtp( pjmedia_transport *tp,
     pj_status_t status;
     transport_srtp *srtp = (transport_srtp*) tp;
     int len = (int)size;
+    /* Per call, so the packet can be sent after the lock is released */
+    pj_uint32_t tx_buf[(MAX_RTP_BUFFER_LEN+3)/4];
+    void *buf;
     srtp_err_status_t err;
 
     if (srtp->bypass_srtp)
 	return pjmedia_transport_send_rtp(srtp->member_tp, pkt, size);
 
-    if (size > sizeof(srtp->rtp_tx_buffer) - MAX_TRAILER_LEN)
-	return PJ_ETOOBIG;
-
-    pj_memcpy(srtp->rtp_tx_buffer, pkt, size);
-
-    pj_lock_acquire(srtp->mutex);
+    pj_lock_acquire(srtp->rtp_tx_mutex);
     if (!srtp->session_inited) {
-	pj_lock_release(srtp->mutex);
+	pj_lock_release(srtp->rtp_tx_mutex);
 	return PJMEDIA_SRTP_EKEYNOTREADY;
     }
-    err = srtp_protect(srtp->srtp_tx_ctx, srtp->rtp_tx_buffer, &len);
-    pj_lock_release(srtp->mutex);
+
+    /* If the stream has reserved enough room for the SRTP trailer after
+     * the packet, protect the packet in place, otherwise protect a copy.
+     */
+    if (srtp->rtp_tx_tailroom >= srtp->rtp_tx_trailer_len &&
+	(((pj_ssize_t)pkt) & 0x03) == 0)
+    {
+	buf = (void*)pkt;
+    } else {
+	if (size > sizeof(tx_buf) - MAX_TRAILER_LEN) {
+	    pj_lock_release(srtp->rtp_tx_mutex);
+	    return PJ_ETOOBIG;
+	}
+	pj_memcpy(tx_buf, pkt, size);
+	buf = tx_buf;
+    }
+
+    err = srtp_protect(srtp->srtp_tx_ctx, buf, &len);
+    pj_lock_release(srtp->rtp_tx_mutex);
 
     if (err == srtp_err_status_ok) {
-	status = pjmedia_transport_send_rtp(srtp->member_tp,
-					    srtp->rtp_tx_buffer, len);
+	status = pjmedia_transport_send_rtp(srtp->member_tp, buf, len);
     } else {
 	status = PJMEDIA_ERRNO_FROM_LIBSRTP(err);
     }
@@ -1232,6 +1295,8 @@ static pj_status_t transport_send_rtcp2(pjmedia_transport *tp,
     pj_status_t status;
     transport_srtp *srtp = (transport_srtp*) tp;
     int len = (int)size;
+    /* Per call, so the packet can be sent after the lock is released */
+    pj_uint32_t tx_buf[(MAX_RTCP_BUFFER_LEN+3)/4];
     srtp_err_status_t err;
 
     if (srtp->bypass_srtp) {
@@ -1239,22 +1304,21 @@ static pj_status_t transport_send_rtcp2(pjmedia_transport *tp,
 	                                    pkt, size);
     }
 
-    if (size > sizeof(srtp->rtcp_tx_buffer) - (MAX_TRAILER_LEN+4))
+    if (size > sizeof(tx_buf) - (MAX_TRAILER_LEN+4))
 	return PJ_ETOOBIG;
 
-    pj_memcpy(srtp->rtcp_tx_buffer, pkt, size);
-
-    pj_lock_acquire(srtp->mutex);
+    pj_lock_acquire(srtp->rtcp_tx_mutex);
     if (!srtp->session_inited) {
-	pj_lock_release(srtp->mutex);
+	pj_lock_release(srtp->rtcp_tx_mutex);
 	return PJMEDIA_SRTP_EKEYNOTREADY;
     }
-    err = srtp_protect_rtcp(srtp->srtp_tx_ctx, srtp->rtcp_tx_buffer, &len);
-    pj_lock_release(srtp->mutex);
+    pj_memcpy(tx_buf, pkt, size);
+    err = srtp_protect_rtcp(srtp->srtp_tx_rtcp_ctx, tx_buf, &len);
+    pj_lock_release(srtp->rtcp_tx_mutex);
 
     if (err == srtp_err_status_ok) {
 	status = pjmedia_transport_send_rtcp2(srtp->member_tp, addr, addr_len,
-					      srtp->rtcp_tx_buffer, len);
+					      tx_buf, len);
     } else {
 	status = PJMEDIA_ERRNO_FROM_LIBSRTP(err);
     }
@@ -1300,6 +1364,8 @@ static pj_status_t transport_destroy  (pjmedia_transport *tp)
     pj_lock_acquire(srtp->mutex);
     pj_lock_release(srtp->mutex);
 
+    pj_lock_destroy(srtp->rtcp_tx_mutex);
+    pj_lock_destroy(srtp->rtp_tx_mutex);
     pj_lock_destroy(srtp->mutex);
     pj_pool_release(srtp->pool);
 
@@ -1815,4 +1881,96 @@ PJ_DEF(pj_status_t) pjmedia_transport_srtp_decrypt_pkt(pjmedia_transport *tp,
 				       PJMEDIA_ERRNO_FROM_LIBSRTP(err);
 }
 
+/* Encrypt one packet in place. The TX lock of the packet type must be
+ * held by the caller.
+ */
+static pj_status_t encrypt_pkt(transport_srtp *srtp, pj_bool_t is_rtp,
+			       void *pkt, int *pkt_len)
+{
+    srtp_err_status_t err;
+
+    if (!srtp->session_inited)
+	return PJMEDIA_SRTP_EKEYNOTREADY;
+
+    /* Make sure buffer is 32bit aligned */
+    PJ_ASSERT_RETURN((((pj_ssize_t)pkt) & 0x03)==0, PJ_EINVAL);
+
+    if (is_rtp)
+	err = srtp_protect(srtp->srtp_tx_ctx, pkt, pkt_len);
+    else
+	err = srtp_protect_rtcp(srtp->srtp_tx_rtcp_ctx, pkt, pkt_len);
+
+    if (err != srtp_err_status_ok) {
+	PJ_LOG(5,(srtp->pool->obj_name,
+		  "Failed to protect SRTP, pkt size=%d, err=%s",
+		  *pkt_len, get_libsrtp_errstr(err)));
+	return PJMEDIA_ERRNO_FROM_LIBSRTP(err);
+    }
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pjmedia_transport_srtp_encrypt_pkt(pjmedia_transport *tp,
+						       pj_bool_t is_rtp,
+						       void *pkt,
+						       int *pkt_len)
+{
+    transport_srtp *srtp = (transport_srtp *)tp;
+    pj_lock_t *lock;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(tp && pkt && pkt_len && (*pkt_len>0), PJ_EINVAL);
+
+    if (srtp->bypass_srtp)
+	return PJ_SUCCESS;
+
+    lock = is_rtp? srtp->rtp_tx_mutex : srtp->rtcp_tx_mutex;
+    pj_lock_acquire(lock);
+    status = encrypt_pkt(srtp, is_rtp, pkt, pkt_len);
+    pj_lock_release(lock);
+
+    return status;
+}
+
+PJ_DEF(pj_status_t) pjmedia_transport_srtp_encrypt_pkts(
+						unsigned count,
+						pjmedia_srtp_pkt pkts[])
+{
+    pj_lock_t *lock = NULL;
+    pj_status_t status = PJ_SUCCESS;
+    unsigned i;
+
+    PJ_ASSERT_RETURN(count==0 || pkts, PJ_EINVAL);
+
+    for (i = 0; i < count; ++i) {
+	pjmedia_srtp_pkt *p = &pkts[i];
+	transport_srtp *p_srtp = (transport_srtp *)p->tp;
+	pj_lock_t *p_lock;
+
+	if (!p_srtp || !p->pkt || p->len <= 0) {
+	    p->status = PJ_EINVAL;
+	} else if (p_srtp->bypass_srtp) {
+	    p->status = PJ_SUCCESS;
+	} else {
+	    /* Only switch lock when the transport or packet type changes */
+	    p_lock = p->is_rtp? p_srtp->rtp_tx_mutex : p_srtp->rtcp_tx_mutex;
+	    if (p_lock != lock) {
+		if (lock)
+		    pj_lock_release(lock);
+		lock = p_lock;
+		pj_lock_acquire(lock);
+	    }
+	    p->status = encrypt_pkt(p_srtp, p->is_rtp, p->pkt, &p->len);
+	}
+
+	if (p->status != PJ_SUCCESS && status == PJ_SUCCESS)
+	    status = p->status;
+    }
+
+    if (lock)
+	pj_lock_release(lock);
+
+    return status;
+}
+
 #endif
@@ -21,6 +21,8 @@
 #include <pjmedia/converter.h>
 #include <pjmedia/errno.h>
 #include <pj/array.h>
+#include <pj/list.h>
+#include <pj/lock.h>
 #include <pj/log.h>
 #include <pj/os.h>
 
@@ -46,6 +48,49 @@
 #define TRACE_(x)	PJ_LOG(5,x)
 
 
+/*
+ * Rendering job, i.e: a sink port to be rendered in the current tick.
+ */
+typedef struct render_job
+{
+    struct vconf_port	*sink;		/**< The sink port.		    */
+    pj_bool_t		 ts_incremented;/**< Sink ts_next already updated,
+					     as it transmits to itself.	    */
+} render_job;
+
+
+/*
+ * Scaled source frame, shared by all render states that need the same
+ * source region converted into the same format and size, so the
+ * conversion is done only once per tick regardless of the number of
+ * sinks rendering it.
+ */
+typedef struct scaled_frame
+{
+    PJ_DECL_LIST_MEMBER(struct scaled_frame);
+    pj_pool_t		*pool;		/**< Pool.			    */
+    struct pjmedia_vid_conf *vid_conf;	/**< The bridge.		    */
+    unsigned		 ref_cnt;	/**< Number of render states.	    */
+
+    /* Key */
+    unsigned		 src_slot;	/**< Source port slot.		    */
+    pjmedia_format_id	 src_fmt_id;	/**< Source format ID.		    */
+    pjmedia_rect_size	 src_frame_size;/**< Source frame size.		    */
+    pjmedia_rect	 src_rect;	/**< Source region.		    */
+    pjmedia_format_id	 dst_fmt_id;	/**< Target format ID.		    */
+    pjmedia_rect_size	 dst_size;	/**< Target size.		    */
+
+    pjmedia_converter	*converter;	/**< Converter.			    */
+    const pjmedia_video_format_info *vfi;/**< Target format info, NULL if
+					     the frame can't be shared.	    */
+    void		*buf;		/**< Converted frame, allocated
+					     when shared.		    */
+    pj_size_t		 buf_size;	/**< Converted frame size.	    */
+    pj_lock_t		*lock;		/**< Converting lock.		    */
+    pj_uint32_t		 tick;		/**< Tick of the converted frame.   */
+} scaled_frame;
+
+
 /*
  * Conference bridge.
  */
@@ -57,6 +102,19 @@ struct pjmedia_vid_conf
     pj_mutex_t		 *mutex;	/**< Conference mutex.		    */
     struct vconf_port	**ports;	/**< Array of ports.		    */
     pjmedia_clock	 *clock;	/**< Clock.			    */
+
+    render_job		 *jobs;		/**< Rendering jobs of this tick.   */
+    unsigned		  job_cnt;	/**< Number of rendering jobs.	    */
+    pj_atomic_t		 *job_idx;	/**< Next job to be taken.	    */
+
+    unsigned		  worker_cnt;	/**< Number of worker threads.	    */
+    pj_thread_t		**workers;	/**< Rendering worker threads.	    */
+    pj_sem_t		 *job_sem;	/**< Signal workers to start.	    */
+    pj_sem_t		 *done_sem;	/**< Signal workers are done.	    */
+    pj_bool_t		  quitting;	/**< Workers should quit.	    */
+
+    scaled_frame	  scaled_frames;/**< List of scaled frames.	    */
+    pj_uint32_t		  tick;		/**< Current tick number.	    */
 };
 
 
@@ -73,7 +131,7 @@ typedef struct render_state
     pjmedia_rect_size	dst_frame_size;	/**< Destination frame size.	    */
     pjmedia_rect	dst_rect;	/**< Destination region.	    */
 
-    pjmedia_converter	*converter;	/**< Converter.			    */
+    scaled_frame	*sf;		/**< Scaled source frame.	    */
 
 } render_state;
 
@@ -115,6 +173,8 @@ static pj_status_t render_src_frame(vconf_port *src, vconf_port *sink,
 static void update_render_state(pjmedia_vid_conf *vid_conf, vconf_port *cp);
 static void cleanup_render_state(vconf_port *cp,
 				 unsigned transmitter_idx);
+static void release_scaled_frame(scaled_frame *sf);
+static int render_worker_thread(void *arg);
 
 
 /*
@@ -125,6 +185,7 @@ PJ_DEF(void) pjmedia_vid_conf_setting_default(pjmedia_vid_conf_setting *opt)
     pj_bzero(opt, sizeof(*opt));
     opt->max_slot_cnt = 32;
     opt->frame_rate = 60;
+    opt->worker_cnt = PJMEDIA_VID_CONF_WORKER_CNT;
 }
 
 
@@ -145,6 +206,7 @@ PJ_DEF(pj_status_t) pjmedia_vid_conf_create(
     /* Allocate conf structure */
     vid_conf = PJ_POOL_ZALLOC_T(pool, pjmedia_vid_conf);
     PJ_ASSERT_RETURN(vid_conf, PJ_ENOMEM);
+    pj_list_init(&vid_conf->scaled_frames);
 
     /* Init settings */
     if (opt) {
@@ -159,6 +221,12 @@ PJ_DEF(pj_status_t) pjmedia_vid_conf_create(
 					   sizeof(vconf_port*));
     PJ_ASSERT_RETURN(vid_conf->ports, PJ_ENOMEM);
 
+    /* Allocate rendering jobs */
+    vid_conf->jobs = (render_job*)
+		     pj_pool_calloc(pool, vid_conf->opt.max_slot_cnt,
+				    sizeof(render_job));
+    PJ_ASSERT_RETURN(vid_conf->jobs, PJ_ENOMEM);
+
     /* Create mutex */
     status = pj_mutex_create_recursive(pool, CONF_NAME, &vid_conf->mutex);
     if (status != PJ_SUCCESS) {
@@ -166,6 +234,39 @@ PJ_DEF(pj_status_t) pjmedia_vid_conf_create(
 	return status;
     }
 
+    /* Create rendering workers */
+    if (vid_conf->opt.worker_cnt) {
+	unsigned i;
+
+	status = pj_atomic_create(pool, 0, &vid_conf->job_idx);
+	if (status == PJ_SUCCESS)
+	    status = pj_sem_create(pool, "vconfjob", 0,
+				   vid_conf->opt.worker_cnt,
+				   &vid_conf->job_sem);
+	if (status == PJ_SUCCESS)
+	    status = pj_sem_create(pool, "vconfdone", 0,
+				   vid_conf->opt.worker_cnt,
+				   &vid_conf->done_sem);
+	if (status != PJ_SUCCESS) {
+	    pjmedia_vid_conf_destroy(vid_conf);
+	    return status;
+	}
+
+	vid_conf->workers = (pj_thread_t**)
+			    pj_pool_calloc(pool, vid_conf->opt.worker_cnt,
+					   sizeof(pj_thread_t*));
+	for (i = 0; i < vid_conf->opt.worker_cnt; ++i) {
+	    status = pj_thread_create(pool, "vconfwrk%p",
+				      &render_worker_thread, vid_conf,
+				      0, 0, &vid_conf->workers[i]);
+	    if (status != PJ_SUCCESS) {
+		pjmedia_vid_conf_destroy(vid_conf);
+		return status;
+	    }
+	    ++vid_conf->worker_cnt;
+	}
+    }
+
     /* Create clock */
     pj_bzero(&clock_param, sizeof(clock_param));
     clock_param.clock_rate = TS_CLOCK_RATE;
@@ -202,6 +303,30 @@ PJ_DEF(pj_status_t) pjmedia_vid_conf_destroy(pjmedia_vid_conf *vid_conf)
 	vid_conf->clock = NULL;
     }
 
+    /* Stop rendering workers */
+    if (vid_conf->worker_cnt) {
+	vid_conf->quitting = PJ_TRUE;
+	for (i=0; i < vid_conf->worker_cnt; ++i)
+	    pj_sem_post(vid_conf->job_sem);
+	for (i=0; i < vid_conf->worker_cnt; ++i) {
+	    pj_thread_join(vid_conf->workers[i]);
+	    pj_thread_destroy(vid_conf->workers[i]);
+	}
+	vid_conf->worker_cnt = 0;
+    }
+    if (vid_conf->job_sem) {
+	pj_sem_destroy(vid_conf->job_sem);
+	vid_conf->job_sem = NULL;
+    }
+    if (vid_conf->done_sem) {
+	pj_sem_destroy(vid_conf->done_sem);
+	vid_conf->done_sem = NULL;
+    }
+    if (vid_conf->job_idx) {
+	pj_atomic_destroy(vid_conf->job_idx);
+	vid_conf->job_idx = NULL;
+    }
+
     /* Remove any registered ports (at least to cleanup their pool) */
     for (i=0; i < vid_conf->opt.max_slot_cnt; ++i) {
 	pjmedia_vid_conf_remove_port(vid_conf, i);
@@ -671,6 +796,63 @@ PJ_DEF(pj_status_t) pjmedia_vid_conf_disconnect_port(
  * Internal functions.
  */
 
+/* Render all transmitters of a sink port to the sink put buffer */
+static void render_sink(pjmedia_vid_conf *vid_conf, vconf_port *sink)
+{
+    unsigned j;
+    pj_status_t status;
+
+    for (j=0; j < sink->transmitter_cnt; ++j) {
+	vconf_port *src = vid_conf->ports[sink->transmitter_slots[j]];
+
+	/* Render src get buffer to sink put buffer (based on sink layout
+	 * settings, if any)
+	 */
+	status = render_src_frame(src, sink, j);
+	if (status != PJ_SUCCESS) {
+	    PJ_PERROR(5, (THIS_FILE, status,
+			  "Failed to render frame from port %d [%s] to "
+			  "%d [%s]",
+			  src->idx, src->port->info.name.ptr,
+			  sink->idx, sink->port->info.name.ptr));
+	}
+    }
+}
+
+/* Take and run rendering jobs until there is none left. Each sink port
+ * has its own put buffer and render states, and source get buffers are
+ * only read here, so sinks can be rendered in parallel.
+ */
+static void run_render_jobs(pjmedia_vid_conf *vid_conf)
+{
+    for (;;) {
+	unsigned idx;
+
+	idx = (unsigned)pj_atomic_inc_and_get(vid_conf->job_idx) - 1;
+	if (idx >= vid_conf->job_cnt)
+	    break;
+
+	render_sink(vid_conf, vid_conf->jobs[idx].sink);
+    }
+}
+
+/* Rendering worker thread */
+static int render_worker_thread(void *arg)
+{
+    pjmedia_vid_conf *vid_conf = (pjmedia_vid_conf*)arg;
+
+    for (;;) {
+	pj_sem_wait(vid_conf->job_sem);
+	if (vid_conf->quitting)
+	    break;
+
+	run_render_jobs(vid_conf);
+	pj_sem_post(vid_conf->done_sem);
+    }
+
+    return 0;
+}
+
 static void on_clock_tick(const pj_timestamp *now, void *user_data)
 {
     pjmedia_vid_conf *vid_conf = (pjmedia_vid_conf*)user_data;
@@ -681,14 +863,21 @@ static void on_clock_tick(const pj_timestamp *now, void *user_data)
 
     pj_mutex_lock(vid_conf->mutex);
 
-    /* Iterate all (sink) ports */
+    /* New tick, invalidate all scaled frames (zero is never used) */
+    if (++vid_conf->tick == 0)
+	vid_conf->tick = 1;
+
+    /* Iterate all (sink) ports, get frames from the transmitters of the
+     * sinks that need rendering in this tick.
+     */
+    vid_conf->job_cnt = 0;
     for (i=0, ci=0; i<vid_conf->opt.max_slot_cnt &&
 		    ci<vid_conf->port_cnt; ++i)
     {
 	unsigned j;
-	pj_bool_t got_frame = PJ_FALSE;
 	pj_bool_t ts_incremented = PJ_FALSE;
 	vconf_port *sink = vid_conf->ports[i];
+	render_job *job;
 
 	/* Skip empty port */
 	if (!sink)
@@ -748,21 +937,32 @@ static void on_clock_tick(const pj_timestamp *now, void *user_data)
 		pj_add_timestamp32(&src->ts_next, src->ts_interval);
 		ts_incremented = src==sink;
 	    }
+	}
 
-	    /* Render src get buffer to sink put buffer (based on sink layout
-	     * settings, if any)
-	     */
-	    status = render_src_frame(src, sink, j);
-	    if (status != PJ_SUCCESS) {
-		PJ_PERROR(5, (THIS_FILE, status,
-			      "Failed to render frame from port %d [%s] to "
-			      "%d [%s]",
-			      src->idx, src->port->info.name.ptr,
-			      sink->idx, sink->port->info.name.ptr));
-	    }
+	job = &vid_conf->jobs[vid_conf->job_cnt++];
+	job->sink = sink;
+	job->ts_incremented = ts_incremented;
+    }
 
-	    got_frame = PJ_TRUE;
-	}
+    /* Render the sinks, using the workers if there are more than one */
+    if (vid_conf->worker_cnt && vid_conf->job_cnt > 1) {
+	pj_atomic_set(vid_conf->job_idx, 0);
+	for (i=0; i < vid_conf->worker_cnt; ++i)
+	    pj_sem_post(vid_conf->job_sem);
+
+	run_render_jobs(vid_conf);
+
+	for (i=0; i < vid_conf->worker_cnt; ++i)
+	    pj_sem_wait(vid_conf->done_sem);
+    } else {
+	for (i=0; i < vid_conf->job_cnt; ++i)
+	    render_sink(vid_conf, vid_conf->jobs[i].sink);
+    }
+
+    /* Deliver the rendered frames to the sinks */
+    for (i=0; i < vid_conf->job_cnt; ++i) {
+	vconf_port *sink = vid_conf->jobs[i].sink;
+	pj_bool_t got_frame = (sink->transmitter_cnt > 0);
 
 	/* Call sink->put_frame()
 	 * Note that if transmitter_cnt==0, we should still call put_frame()
@@ -798,7 +998,7 @@ static void on_clock_tick(const pj_timestamp *now, void *user_data)
 	/* Update next put/get, careful that it may have been updated
 	 * if this port transmits to itself!
 	 */
-	if (!ts_incremented) {
+	if (!vid_conf->jobs[i].ts_incremented) {
 	    pj_add_timestamp32(&sink->ts_next, sink->ts_interval);
 	}
     }
@@ -833,6 +1033,163 @@ static void match_ratio_crop(pjmedia_rect_size *size,
     return;
 }
 
+/* Release a scaled frame, destroy it when it is no longer used */
+static void release_scaled_frame(scaled_frame *sf)
+{
+    pj_assert(sf->ref_cnt > 0);
+    if (--sf->ref_cnt > 0)
+	return;
+
+    pj_list_erase(sf);
+    if (sf->converter)
+	pjmedia_converter_destroy(sf->converter);
+    if (sf->lock)
+	pj_lock_destroy(sf->lock);
+    pj_pool_safe_release(&sf->pool);
+}
+
+/* Find a scaled frame matching the render state, or create a new one */
+static pj_status_t acquire_scaled_frame(pjmedia_vid_conf *vid_conf,
+					vconf_port *cp,
+					unsigned src_slot,
+					render_state *rs)
+{
+    scaled_frame *sf;
+    pjmedia_conversion_param cparam;
+    pj_pool_t *pool;
+    char tmp_buf[32];
+    pj_status_t status;
+
+    /* Look for existing shareable frame with the same key */
+    for (sf = vid_conf->scaled_frames.next; sf != &vid_conf->scaled_frames;
+	 sf = sf->next)
+    {
+	if (sf->vfi && sf->src_slot == src_slot &&
+	    sf->src_fmt_id == rs->src_fmt_id &&
+	    sf->dst_fmt_id == rs->dst_fmt_id &&
+	    pj_memcmp(&sf->src_frame_size, &rs->src_frame_size,
+		      sizeof(sf->src_frame_size)) == 0 &&
+	    pj_memcmp(&sf->src_rect, &rs->src_rect,
+		      sizeof(sf->src_rect)) == 0 &&
+	    pj_memcmp(&sf->dst_size, &rs->dst_rect.size,
+		      sizeof(sf->dst_size)) == 0)
+	{
+	    break;
+	}
+    }
+
+    if (sf != &vid_conf->scaled_frames) {
+	/* Now shared, allocate the frame buffer */
+	if (!sf->buf) {
+	    sf->buf = pj_pool_alloc(sf->pool, sf->buf_size);
+	    if (!sf->buf)
+		return PJ_ENOMEM;
+	}
+
+	++sf->ref_cnt;
+	rs->sf = sf;
+
+	TRACE_((THIS_FILE, "Port %d shares scaled frame of source %d "
+			   "(%d users)", cp->idx, src_slot, sf->ref_cnt));
+	return PJ_SUCCESS;
+    }
+
+    /* Create new scaled frame */
+    pj_ansi_snprintf(tmp_buf, sizeof(tmp_buf), "vcsf_%d_%dx%d",
+		     src_slot, rs->dst_rect.size.w, rs->dst_rect.size.h);
+    pool = pj_pool_create(cp->pool->factory, tmp_buf, 256, 256, NULL);
+    if (!pool)
+	return PJ_ENOMEM;
+
+    sf = PJ_POOL_ZALLOC_T(pool, scaled_frame);
+    sf->pool = pool;
+    sf->vid_conf = vid_conf;
+    sf->src_slot = src_slot;
+    sf->src_fmt_id = rs->src_fmt_id;
+    sf->src_frame_size = rs->src_frame_size;
+    sf->src_rect = rs->src_rect;
+    sf->dst_fmt_id = rs->dst_fmt_id;
+    sf->dst_size = rs->dst_rect.size;
+
+    pjmedia_format_init_video(&cparam.src, rs->src_fmt_id,
+			      rs->src_rect.size.w,
+			      rs->src_rect.size.h,
+			      0, 1);
+    pjmedia_format_init_video(&cparam.dst, rs->dst_fmt_id,
+			      rs->dst_rect.size.w,
+			      rs->dst_rect.size.h,
+			      0, 1);
+    status = pjmedia_converter_create(NULL, pool, &cparam, &sf->converter);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(pool);
+	return status;
+    }
+
+    /* Only frames whose format layout is known can be blitted to sinks */
+    sf->vfi = pjmedia_get_video_format_info(NULL, rs->dst_fmt_id);
+    if (sf->vfi && sf->vfi->apply_fmt) {
+	pjmedia_video_apply_fmt_param vafp;
+
+	pj_bzero(&vafp, sizeof(vafp));
+	vafp.size = sf->dst_size;
+	if (sf->vfi->apply_fmt(sf->vfi, &vafp) == PJ_SUCCESS)
+	    sf->buf_size = vafp.framebytes;
+    }
+    if (sf->buf_size == 0 ||
+	pj_lock_create_simple_mutex(pool, tmp_buf, &sf->lock) != PJ_SUCCESS)
+    {
+	sf->vfi = NULL;
+    }
+
+    sf->ref_cnt = 1;
+    pj_list_push_back(&vid_conf->scaled_frames, sf);
+    rs->sf = sf;
+
+    return PJ_SUCCESS;
+}
+
+/* Copy a frame into a region of a bigger frame of the same format */
+static void blit_frame(const pjmedia_video_format_info *vfi,
+		       void *src_buf, const pjmedia_rect_size *src_size,
+		       void *dst_buf, const pjmedia_rect_size *dst_size,
+		       const pjmedia_coord *dst_pos)
+{
+    pjmedia_video_apply_fmt_param src, dst;
+    unsigned i;
+
+    pj_bzero(&src, sizeof(src));
+    src.size = *src_size;
+    src.buffer = (pj_uint8_t*)src_buf;
+    vfi->apply_fmt(vfi, &src);
+
+    pj_bzero(&dst, sizeof(dst));
+    dst.size = *dst_size;
+    dst.buffer = (pj_uint8_t*)dst_buf;
+    vfi->apply_fmt(vfi, &dst);
+
+    for (i = 0; i < vfi->plane_cnt; ++i) {
+	const pj_uint8_t *s = src.planes[i];
+	pj_uint8_t *d;
+	unsigned src_h, dst_h, y;
+
+	if (!src.strides[i] || !dst.strides[i])
+	    continue;
+
+	/* Plane position is scaled according to the plane subsampling */
+	src_h = (unsigned)(src.plane_bytes[i] / src.strides[i]);
+	dst_h = (unsigned)(dst.plane_bytes[i] / dst.strides[i]);
+	d = dst.planes[i] +
+	    (dst_pos->y * dst_h / dst_size->h) * dst.strides[i] +
+	    (dst_pos->x * dst.strides[i] / dst_size->w);
+
+	for (y = 0; y < src_h; ++y) {
+	    pj_memcpy(d, s, src.strides[i]);
+	    s += src.strides[i];
+	    d += dst.strides[i];
+	}
+    }
+}
+
 /* Cleanup rendering states, called when a transmitter is disconnected
  * from a listener, or before reinit-ing rendering state of a listener
  * when new connection has just been made.
@@ -841,10 +1198,10 @@ static void cleanup_render_state(vconf_port *cp,
 				 unsigned transmitter_idx)
 {
     render_state *rs = cp->render_states[transmitter_idx];
-    if (rs && rs->converter)
+    if (rs && rs->sf)
     {
-	pjmedia_converter_destroy(rs->converter);
-	rs->converter = NULL;
+	release_scaled_frame(rs->sf);
+	rs->sf = NULL;
     }
     cp->render_states[transmitter_idx] = NULL;
 
@@ -905,7 +1262,6 @@ static void update_render_state(pjmedia_vid_conf *vid_conf, vconf_port *cp)
     for (i = 0; i < cp->transmitter_cnt && i < 4; ++i) {
 	pj_pool_t *pool;
 	render_state *rs;
-	pjmedia_conversion_param cparam;
 	char tmp_buf[32];
 
 	/* Create pool & render state */
@@ -1023,17 +1379,11 @@ static void update_render_state(pjmedia_vid_conf *vid_conf, vconf_port *cp)
 			   rs->dst_rect.size.w, rs->dst_rect.size.h,
 			   rs->dst_rect.coord.x, rs->dst_rect.coord.y));
 
-	/* Create converter */
-	pjmedia_format_init_video(&cparam.src, rs->src_fmt_id,
-				  rs->src_rect.size.w,
-				  rs->src_rect.size.h,
-				  0, 1);
-	pjmedia_format_init_video(&cparam.dst, rs->dst_fmt_id,
-				  rs->dst_rect.size.w,
-				  rs->dst_rect.size.h,
-				  0, 1);
-	status = pjmedia_converter_create(NULL, pool, &cparam,
-					  &rs->converter);
+	/* Get converter and scaled frame, shared with other sinks
+	 * rendering the same source region at the same size.
+	 */
+	status = acquire_scaled_frame(vid_conf, cp, cp->transmitter_slots[i],
+				      rs);
 	if (status != PJ_SUCCESS) {
 	    PJ_PERROR(4,(THIS_FILE, status,
 			 "Port %d failed creating converter "
@@ -1048,30 +1398,66 @@ static pj_status_t render_src_frame(vconf_port *src, vconf_port *sink,
 {
     pj_status_t status;
     render_state *rs = sink->render_states[transmitter_idx];
+    scaled_frame *sf = rs? rs->sf : NULL;
 
-    if (sink->transmitter_cnt == 1 && (!rs || !rs->converter)) {
+    if (sink->transmitter_cnt == 1 && !sf) {
 	/* The only transmitter and no conversion needed */
 	pj_assert(src->get_buf_size <= sink->put_buf_size);
 	pj_memcpy(sink->put_buf, src->get_buf, src->get_buf_size);
-    } else if (rs && rs->converter) {
+    } else if (sf) {
 	pjmedia_frame src_frame, dst_frame;
-	
+	pj_bool_t shared = (sf->ref_cnt > 1 && sf->vfi);
+
 	pj_bzero(&src_frame, sizeof(src_frame));
 	src_frame.buf = src->get_buf;
 	src_frame.size = src->get_buf_size;
 
-	pj_bzero(&dst_frame, sizeof(dst_frame));
-	dst_frame.buf = sink->put_buf;
-	dst_frame.size = sink->put_buf_size;
-
-	status = pjmedia_converter_convert2(rs->converter,
-					    &src_frame,
-					    &rs->src_frame_size,
-					    &rs->src_rect.coord,
-					    &dst_frame,
-					    &rs->dst_frame_size,
-					    &rs->dst_rect.coord,
-					    NULL);
+	if (!shared) {
+	    /* Only used by this sink, convert directly to sink buffer */
+	    pj_bzero(&dst_frame, sizeof(dst_frame));
+	    dst_frame.buf = sink->put_buf;
+	    dst_frame.size = sink->put_buf_size;
+
+	    status = pjmedia_converter_convert2(sf->converter,
+						&src_frame,
+						&rs->src_frame_size,
+						&rs->src_rect.coord,
+						&dst_frame,
+						&rs->dst_frame_size,
+						&rs->dst_rect.coord,
+						NULL);
+	} else {
+	    /* Convert once per tick, sinks may be rendered in parallel */
+	    pj_lock_acquire(sf->lock);
+	    if (sf->tick != sf->vid_conf->tick) {
+		pjmedia_coord zero_pos = { 0, 0 };
+
+		pj_bzero(&dst_frame, sizeof(dst_frame));
+		dst_frame.buf = sf->buf;
+		dst_frame.size = sf->buf_size;
+
+		status = pjmedia_converter_convert2(sf->converter,
+						    &src_frame,
+						    &rs->src_frame_size,
+						    &rs->src_rect.coord,
+						    &dst_frame,
+						    &sf->dst_size,
+						    &zero_pos,
+						    NULL);
+		if (status == PJ_SUCCESS)
+		    sf->tick = sf->vid_conf->tick;
+	    } else {
+		status = PJ_SUCCESS;
+	    }
+	    pj_lock_release(sf->lock);
+
+	    if (status == PJ_SUCCESS) {
+		blit_frame(sf->vfi, sf->buf, &sf->dst_size,
+			   sink->put_buf, &rs->dst_frame_size,
+			   &rs->dst_rect.coord);
+	    }
+	}
+
 	if (status != PJ_SUCCESS) {
 	    PJ_PERROR(4,(THIS_FILE, status,
 			 "Port id %d: converter failed in "
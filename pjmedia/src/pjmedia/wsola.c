@@ -25,6 +25,17 @@
 #include <pj/math.h>
 #include <pj/pool.h>
 
+#if defined(PJ_HAS_FLOATING_POINT) && PJ_HAS_FLOATING_POINT!=0 && \
+    defined(PJMEDIA_HAS_WSOLA_SIMD) && PJMEDIA_HAS_WSOLA_SIMD!=0
+#   if defined(__ARM_NEON) && defined(__aarch64__)
+#	include <arm_neon.h>
+#	define USE_NEON	1
+#   else
+#	include <emmintrin.h>
+#	define USE_SSE2	1
+#   endif
+#endif
+
 /*
  * This file contains implementation of WSOLA using PJMEDIA_WSOLA_IMP_WSOLA
  * or PJMEDIA_WSOLA_IMP_NULL
@@ -222,44 +233,141 @@ static pj_int16_t *find_pitch(pj_int16_t *frm, pj_int16_t *beg, pj_int16_t *end,
  * Floating point version.
  */
 
+#if defined(USE_SSE2)
+/* Load four samples as float */
+PJ_INLINE(__m128) load4(const pj_int16_t *p)
+{
+    __m128i x = _mm_loadl_epi64((const __m128i*)p);
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+}
+#endif
+
 #if (PJMEDIA_WSOLA_IMP==PJMEDIA_WSOLA_IMP_WSOLA)
 
+/* Correlation of the template with one position */
+static double calc_corr(const pj_int16_t *frm, const pj_int16_t *sr,
+			unsigned template_cnt)
+{
+    double corr = 0;
+    unsigned i;
+
+    /* Do calculation on 8 samples at once */
+    for (i=0; i<template_cnt-8; i += 8) {
+	corr += ((float)frm[i+0]) * ((float)sr[i+0]) + 
+		((float)frm[i+1]) * ((float)sr[i+1]) + 
+		((float)frm[i+2]) * ((float)sr[i+2]) + 
+		((float)frm[i+3]) * ((float)sr[i+3]) + 
+		((float)frm[i+4]) * ((float)sr[i+4]) + 
+		((float)frm[i+5]) * ((float)sr[i+5]) + 
+		((float)frm[i+6]) * ((float)sr[i+6]) + 
+		((float)frm[i+7]) * ((float)sr[i+7]);
+    }
+
+    /* Process remaining samples. */
+    for (; i<template_cnt; ++i) {
+	corr += ((float)frm[i]) * ((float)sr[i]);
+    }
+
+    return corr;
+}
+
+#if defined(USE_SSE2) || defined(USE_NEON)
+/* Number of positions calculated at once */
+#   define CORR_CNT	4
+
+/* Correlation of the template with CORR_CNT consecutive positions. Each
+ * lane performs exactly the same operations as calc_corr(), so the result
+ * is identical.
+ */
+static void calc_corr_n(const pj_int16_t *frm, const pj_int16_t *sr,
+			unsigned template_cnt, double corr[CORR_CNT])
+{
+    unsigned i, k;
+#   if defined(USE_SSE2)
+    __m128d c01 = _mm_setzero_pd(), c23 = _mm_setzero_pd();
+
+    for (i=0; i<template_cnt-8; i += 8) {
+	__m128 sum = _mm_mul_ps(_mm_set1_ps((float)frm[i]), load4(sr+i));
+
+	for (k=1; k<8; ++k) {
+	    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps((float)frm[i+k]),
+					     load4(sr+i+k)));
+	}
+	c01 = _mm_add_pd(c01, _mm_cvtps_pd(sum));
+	c23 = _mm_add_pd(c23, _mm_cvtps_pd(_mm_movehl_ps(sum, sum)));
+    }
+
+    for (; i<template_cnt; ++i) {
+	__m128 prod = _mm_mul_ps(_mm_set1_ps((float)frm[i]), load4(sr+i));
+
+	c01 = _mm_add_pd(c01, _mm_cvtps_pd(prod));
+	c23 = _mm_add_pd(c23, _mm_cvtps_pd(_mm_movehl_ps(prod, prod)));
+    }
+
+    _mm_storeu_pd(corr, c01);
+    _mm_storeu_pd(corr+2, c23);
+#   else
+    float64x2_t c01 = vdupq_n_f64(0), c23 = vdupq_n_f64(0);
+
+    for (i=0; i<template_cnt-8; i += 8) {
+	float32x4_t sum = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vld1_s16(sr+i))),
+				      (float)frm[i]);
+
+	for (k=1; k<8; ++k) {
+	    float32x4_t x = vcvtq_f32_s32(vmovl_s16(vld1_s16(sr+i+k)));
+	    sum = vaddq_f32(sum, vmulq_n_f32(x, (float)frm[i+k]));
+	}
+	c01 = vaddq_f64(c01, vcvt_f64_f32(vget_low_f32(sum)));
+	c23 = vaddq_f64(c23, vcvt_high_f64_f32(sum));
+    }
+
+    for (; i<template_cnt; ++i) {
+	float32x4_t prod = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vld1_s16(sr+i))),
+				       (float)frm[i]);
+
+	c01 = vaddq_f64(c01, vcvt_f64_f32(vget_low_f32(prod)));
+	c23 = vaddq_f64(c23, vcvt_high_f64_f32(prod));
+    }
+
+    vst1q_f64(corr, c01);
+    vst1q_f64(corr+2, c23);
+#   endif
+}
+#else
+#   define CORR_CNT	1
+#endif
+
 static pj_int16_t *find_pitch(pj_int16_t *frm, pj_int16_t *beg, pj_int16_t *end, 
 			 unsigned template_cnt, int first)
 {
     pj_int16_t *sr, *best=beg;
     double best_corr = 0;
 
-    for (sr=beg; sr!=end; ++sr) {
-	double corr = 0;
-	unsigned i;
-
-	/* Do calculation on 8 samples at once */
-	for (i=0; i<template_cnt-8; i += 8) {
-	    corr += ((float)frm[i+0]) * ((float)sr[i+0]) + 
-		    ((float)frm[i+1]) * ((float)sr[i+1]) + 
-		    ((float)frm[i+2]) * ((float)sr[i+2]) + 
-		    ((float)frm[i+3]) * ((float)sr[i+3]) + 
-		    ((float)frm[i+4]) * ((float)sr[i+4]) + 
-		    ((float)frm[i+5]) * ((float)sr[i+5]) + 
-		    ((float)frm[i+6]) * ((float)sr[i+6]) + 
-		    ((float)frm[i+7]) * ((float)sr[i+7]);
-	}
+    for (sr=beg; sr!=end; ) {
+	double corr[CORR_CNT];
+	unsigned i, n = 1;
 
-	/* Process remaining samples. */
-	for (; i<template_cnt; ++i) {
-	    corr += ((float)frm[i]) * ((float)sr[i]);
+#if CORR_CNT > 1
+	if (end - sr >= CORR_CNT) {
+	    calc_corr_n(frm, sr, template_cnt, corr);
+	    n = CORR_CNT;
+	} else
+#endif
+	{
+	    corr[0] = calc_corr(frm, sr, template_cnt);
 	}
 
-	if (first) {
-	    if (corr > best_corr) {
-		best_corr = corr;
-		best = sr;
-	    }
-	} else {
-	    if (corr >= best_corr) {
-		best_corr = corr;
-		best = sr;
+	for (i=0; i<n; ++i, ++sr) {
+	    if (first) {
+		if (corr[i] > best_corr) {
+		    best_corr = corr[i];
+		    best = sr;
+		}
+	    } else {
+		if (corr[i] >= best_corr) {
+		    best_corr = corr[i];
+		    best = sr;
+		}
 	    }
 	}
     }
@@ -274,9 +382,35 @@ static void overlapp_add(pj_int16_t dst[], unsigned count,
 			 pj_int16_t l[], pj_int16_t r[],
 			 float w[])
 {
-    unsigned i;
+    unsigned i = 0;
+
+    /* Note that dst may be the same buffer as l */
+#if defined(USE_SSE2)
+    for (; i+4<=count; i += 4) {
+	__m128 wl = _mm_loadu_ps(w + count - 4 - i);
+	__m128 v;
+
+	wl = _mm_shuffle_ps(wl, wl, _MM_SHUFFLE(0,1,2,3));
+	v = _mm_add_ps(_mm_mul_ps(load4(l+i), wl),
+		       _mm_mul_ps(load4(r+i), _mm_loadu_ps(w + i)));
+	_mm_storel_epi64((__m128i*)(dst+i),
+			 _mm_packs_epi32(_mm_cvttps_epi32(v),
+					 _mm_setzero_si128()));
+    }
+#elif defined(USE_NEON)
+    for (; i+4<=count; i += 4) {
+	float32x4_t wl = vld1q_f32(w + count - 4 - i);
+	float32x4_t v;
+
+	wl = vrev64q_f32(vcombine_f32(vget_high_f32(wl), vget_low_f32(wl)));
+	v = vaddq_f32(vmulq_f32(vcvtq_f32_s32(vmovl_s16(vld1_s16(l+i))), wl),
+		      vmulq_f32(vcvtq_f32_s32(vmovl_s16(vld1_s16(r+i))),
+				vld1q_f32(w + i)));
+	vst1_s16(dst+i, vqmovn_s32(vcvtq_s32_f32(v)));
+    }
+#endif
 
-    for (i=0; i<count; ++i) {
+    for (; i<count; ++i) {
 	dst[i] = (pj_int16_t)(l[i] * w[count-1-i] + r[i] * w[i]);
     }
 }
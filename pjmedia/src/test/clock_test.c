@@ -0,0 +1,333 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE	"clock_test.c"
+
+/* Clock interval, in msec */
+#define PTIME		10
+
+/* Number of clocks in the tick test */
+#define CLOCK_CNT	8
+
+/* Duration of the tick test, in msec */
+#define DURATION	500
+
+/* Duration of the callback of the slow clock, in msec */
+#define SLOW_CB_MSEC	100
+
+/* Ticks after which the self stopping clock stops itself */
+#define SELF_STOP_TICKS	5
+
+struct clock_data
+{
+    pjmedia_clock	*clock;
+    unsigned		 tick_cnt;
+    pj_uint32_t		 last_ts;
+    pj_bool_t		 ts_error;
+    pj_bool_t		 in_cb;
+    unsigned		 cb_msec;
+    unsigned		 stop_after;
+};
+
+static void clock_cb(const pj_timestamp *ts, void *user_data)
+{
+    struct clock_data *cd = (struct clock_data*) user_data;
+
+    cd->in_cb = PJ_TRUE;
+
+    /* Timestamp must advance by one frame per tick */
+    if (cd->tick_cnt && ts->u32.lo != cd->last_ts + 8000 * PTIME / 1000)
+	cd->ts_error = PJ_TRUE;
+    cd->last_ts = ts->u32.lo;
+    ++cd->tick_cnt;
+
+    if (cd->cb_msec)
+	pj_thread_sleep(cd->cb_msec);
+
+    if (cd->stop_after && cd->tick_cnt == cd->stop_after)
+	pjmedia_clock_stop(cd->clock);
+
+    cd->in_cb = PJ_FALSE;
+}
+
+static pj_status_t create_clock(pj_pool_t *pool,
+				pjmedia_clock_sched *sched,
+				struct clock_data *cd)
+{
+    pj_status_t status;
+
+    status = pjmedia_clock_create(pool, 8000, 1, 8000 * PTIME / 1000, 0,
+				  &clock_cb, cd, &cd->clock);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    return pjmedia_clock_set_sched(cd->clock, sched);
+}
+
+/* Many clocks on a small worker pool must all tick at their own rate */
+static int tick_test(pj_pool_t *pool)
+{
+    pjmedia_clock_sched_param param;
+    pjmedia_clock_sched_stat stat;
+    pjmedia_clock_sched *sched;
+    struct clock_data cd[CLOCK_CNT];
+    const unsigned expected = DURATION / PTIME;
+    unsigned i;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  tick test"));
+
+    pjmedia_clock_sched_param_default(&param);
+    param.thread_cnt = 2;
+    param.options = PJMEDIA_CLOCK_NO_HIGHEST_PRIO;
+    status = pjmedia_clock_sched_create(pool, &param, &sched);
+    if (status != PJ_SUCCESS)
+	return -10;
+
+    pj_bzero(cd, sizeof(cd));
+    for (i = 0; i < CLOCK_CNT; ++i) {
+	if (create_clock(pool, sched, &cd[i]) != PJ_SUCCESS ||
+	    pjmedia_clock_start(cd[i].clock) != PJ_SUCCESS)
+	{
+	    rc = -20;
+	    goto on_return;
+	}
+    }
+
+    pjmedia_clock_sched_get_stat(sched, &stat, PJ_FALSE);
+    if (stat.thread_cnt != 2 || stat.clock_cnt != CLOCK_CNT) {
+	rc = -30;
+	goto on_return;
+    }
+
+    pj_thread_sleep(DURATION);
+
+    for (i = 0; i < CLOCK_CNT; ++i)
+	pjmedia_clock_stop(cd[i].clock);
+
+    pjmedia_clock_sched_get_stat(sched, &stat, PJ_FALSE);
+    PJ_LOG(3,(THIS_FILE, "    ticks=%u overruns=%u max_late=%uus load=%u%%",
+	      stat.tick_cnt, stat.overrun_cnt, stat.max_late_usec,
+	      stat.max_load_pct));
+
+    if (stat.clock_cnt != 0) {
+	rc = -40;
+	goto on_return;
+    }
+
+    for (i = 0; i < CLOCK_CNT; ++i) {
+	/* Be lenient, the machine may be loaded */
+	if (cd[i].tick_cnt < expected / 2 || cd[i].tick_cnt > expected + 5) {
+	    PJ_LOG(3,(THIS_FILE, "    clock %u: %u ticks, expecting %u",
+		      i, cd[i].tick_cnt, expected));
+	    rc = -50;
+	    goto on_return;
+	}
+	if (cd[i].ts_error) {
+	    rc = -60;
+	    goto on_return;
+	}
+    }
+
+on_return:
+    for (i = 0; i < CLOCK_CNT; ++i) {
+	if (cd[i].clock)
+	    pjmedia_clock_destroy(cd[i].clock);
+    }
+    pjmedia_clock_sched_destroy(sched);
+    return rc;
+}
+
+/* The scheduler must not be blocked while a clock callback is running,
+ * stopping a clock must wait for its callback, and a clock must be able
+ * to stop itself from its callback.
+ */
+static int callback_test(pj_pool_t *pool)
+{
+    pjmedia_clock_sched_param param;
+    pjmedia_clock_sched_stat stat;
+    pjmedia_clock_sched *sched;
+    struct clock_data slow, self_stop;
+    pj_timestamp t1, t2;
+    unsigned i, tick_cnt;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  callback test"));
+
+    /* Single worker, so both clocks share the same thread */
+    pjmedia_clock_sched_param_default(&param);
+    param.options = PJMEDIA_CLOCK_NO_HIGHEST_PRIO;
+    status = pjmedia_clock_sched_create(pool, &param, &sched);
+    if (status != PJ_SUCCESS)
+	return -100;
+
+    pj_bzero(&slow, sizeof(slow));
+    pj_bzero(&self_stop, sizeof(self_stop));
+    slow.cb_msec = SLOW_CB_MSEC;
+    self_stop.stop_after = SELF_STOP_TICKS;
+
+    if (create_clock(pool, sched, &slow) != PJ_SUCCESS ||
+	create_clock(pool, sched, &self_stop) != PJ_SUCCESS)
+    {
+	rc = -110;
+	goto on_return;
+    }
+
+    if (pjmedia_clock_start(slow.clock) != PJ_SUCCESS) {
+	rc = -120;
+	goto on_return;
+    }
+
+    /* Wait until the slow callback is running */
+    for (i = 0; i < 100 && !slow.in_cb; ++i)
+	pj_thread_sleep(5);
+    if (!slow.in_cb) {
+	rc = -130;
+	goto on_return;
+    }
+
+    /* Starting another clock and querying the statistics must not wait
+     * for the slow callback to complete.
+     */
+    pj_get_timestamp(&t1);
+    status = pjmedia_clock_start(self_stop.clock);
+    pjmedia_clock_sched_get_stat(sched, &stat, PJ_FALSE);
+    pj_get_timestamp(&t2);
+    if (status != PJ_SUCCESS) {
+	rc = -140;
+	goto on_return;
+    }
+    if (pj_elapsed_msec(&t1, &t2) >= SLOW_CB_MSEC / 2) {
+	PJ_LOG(3,(THIS_FILE, "    scheduler blocked for %u ms",
+		  pj_elapsed_msec(&t1, &t2)));
+	rc = -150;
+	goto on_return;
+    }
+
+    /* Stopping the slow clock must wait for its callback to return */
+    while (!slow.in_cb)
+	pj_thread_sleep(1);
+    pjmedia_clock_stop(slow.clock);
+    if (slow.in_cb) {
+	rc = -160;
+	goto on_return;
+    }
+    tick_cnt = slow.tick_cnt;
+
+    /* Let the self stopping clock run */
+    pj_thread_sleep(SELF_STOP_TICKS * PTIME * 4 + SLOW_CB_MSEC);
+
+    if (self_stop.tick_cnt != SELF_STOP_TICKS) {
+	PJ_LOG(3,(THIS_FILE, "    self stopping clock: %u ticks",
+		  self_stop.tick_cnt));
+	rc = -170;
+	goto on_return;
+    }
+    if (slow.tick_cnt != tick_cnt) {
+	rc = -180;
+	goto on_return;
+    }
+
+    pjmedia_clock_sched_get_stat(sched, &stat, PJ_FALSE);
+    if (stat.clock_cnt != 0) {
+	rc = -190;
+	goto on_return;
+    }
+
+on_return:
+    if (slow.clock)
+	pjmedia_clock_destroy(slow.clock);
+    if (self_stop.clock)
+	pjmedia_clock_destroy(self_stop.clock);
+    pjmedia_clock_sched_destroy(sched);
+    return rc;
+}
+
+/* Destroying the scheduler must detach the stopped clocks too, so that
+ * they run their own thread when started again.
+ */
+static int detach_test(pj_pool_t *pool)
+{
+    pjmedia_clock_sched *sched;
+    struct clock_data cd;
+    unsigned tick_cnt;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  detach test"));
+
+    status = pjmedia_clock_sched_create(pool, NULL, &sched);
+    if (status != PJ_SUCCESS)
+	return -200;
+
+    pj_bzero(&cd, sizeof(cd));
+    if (create_clock(pool, sched, &cd) != PJ_SUCCESS ||
+	pjmedia_clock_start(cd.clock) != PJ_SUCCESS)
+    {
+	pjmedia_clock_sched_destroy(sched);
+	rc = -210;
+	goto on_return;
+    }
+
+    pj_thread_sleep(5 * PTIME);
+    pjmedia_clock_stop(cd.clock);
+    pjmedia_clock_sched_destroy(sched);
+
+    tick_cnt = cd.tick_cnt;
+    if (pjmedia_clock_start(cd.clock) != PJ_SUCCESS) {
+	rc = -220;
+	goto on_return;
+    }
+
+    pj_thread_sleep(10 * PTIME);
+    pjmedia_clock_stop(cd.clock);
+
+    if (cd.tick_cnt == tick_cnt) {
+	PJ_LOG(3,(THIS_FILE, "    clock didn't tick after detached"));
+	rc = -230;
+	goto on_return;
+    }
+
+on_return:
+    if (cd.clock)
+	pjmedia_clock_destroy(cd.clock);
+    return rc;
+}
+
+int clock_test(void)
+{
+    pj_pool_t *pool;
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "Testing media clock scheduler"));
+
+    pool = pj_pool_create(mem, "clocktest", 1000, 1000, NULL);
+
+    rc = tick_test(pool);
+    if (rc == 0)
+	rc = callback_test(pool);
+    if (rc == 0)
+	rc = detach_test(pool);
+
+    pj_pool_release(pool);
+    return rc;
+}
@@ -0,0 +1,352 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+#include <pjmedia-codec.h>
+
+#define THIS_FILE	"codec_pool_test.c"
+
+/* Number of frames encoded and decoded in each session */
+#define FRAME_CNT	10
+
+/* Maximum samples per frame and encoded frame size */
+#define MAX_SPF		640
+#define MAX_ENC		640
+
+/* Number of alloc/dealloc rounds in the benchmark */
+#define BENCH_ROUNDS	1000
+
+struct session_out
+{
+    pj_uint8_t	enc[FRAME_CNT][MAX_ENC];
+    unsigned	enc_len[FRAME_CNT];
+    pj_int16_t	plc[MAX_SPF];
+};
+
+/* Input signal of a session, different for each seed */
+static void gen_frame(pj_int16_t *buf, unsigned spf, unsigned seed,
+		      unsigned frm)
+{
+    unsigned i;
+
+    for (i = 0; i < spf; ++i) {
+	unsigned t = frm * spf + i;
+	buf[i] = (pj_int16_t)((((t * (seed + 3)) % 200) - 100) * 80 +
+			      ((t * 7919 + seed * 104729) % 1000) - 500);
+    }
+}
+
+/* Open the codec, encode and decode some frames, then generate a lost
+ * frame, which depends on the decoder and PLC history.
+ */
+static pj_status_t run_session(pjmedia_codec *codec, pj_pool_t *pool,
+			       pjmedia_codec_param *param, unsigned seed,
+			       struct session_out *out)
+{
+    unsigned spf = param->info.clock_rate * param->info.frm_ptime / 1000 *
+		   param->info.channel_cnt;
+    pj_int16_t pcm[MAX_SPF];
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(spf <= MAX_SPF, PJ_ETOOBIG);
+
+    status = pjmedia_codec_init(codec, pool);
+    if (status == PJ_SUCCESS)
+	status = pjmedia_codec_open(codec, param);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    pj_bzero(out, sizeof(*out));
+
+    for (i = 0; i < FRAME_CNT; ++i) {
+	pjmedia_frame in_frm, enc_frm, dec_frm;
+
+	gen_frame(pcm, spf, seed, i);
+
+	pj_bzero(&in_frm, sizeof(in_frm));
+	in_frm.type = PJMEDIA_FRAME_TYPE_AUDIO;
+	in_frm.buf = pcm;
+	in_frm.size = spf * 2;
+	in_frm.timestamp.u64 = i * spf;
+
+	pj_bzero(&enc_frm, sizeof(enc_frm));
+	enc_frm.buf = out->enc[i];
+	status = pjmedia_codec_encode(codec, &in_frm, MAX_ENC, &enc_frm);
+	if (status != PJ_SUCCESS)
+	    break;
+	out->enc_len[i] = (unsigned)enc_frm.size;
+
+	dec_frm.buf = pcm;
+	status = pjmedia_codec_decode(codec, &enc_frm, sizeof(pcm), &dec_frm);
+	if (status != PJ_SUCCESS)
+	    break;
+    }
+
+    if (status == PJ_SUCCESS && codec->op->recover) {
+	pjmedia_frame plc_frm;
+
+	pj_bzero(&plc_frm, sizeof(plc_frm));
+	plc_frm.buf = out->plc;
+	status = pjmedia_codec_recover(codec, sizeof(out->plc), &plc_frm);
+    }
+
+    pjmedia_codec_close(codec);
+    return status;
+}
+
+/*
+ * A deallocated instance must be kept in the pool and reused by the next
+ * allocation, and the session on the reused instance must be identical
+ * to a session on a new instance.
+ */
+static int test_reuse(pjmedia_codec_mgr *mgr, pj_pool_t *pool,
+		      const char *codec_id)
+{
+    pj_str_t id = pj_str((char*)codec_id);
+    const pjmedia_codec_info *ci;
+    pjmedia_codec_param param;
+    pjmedia_codec_pool_stat stat;
+    pjmedia_codec *codec, *codec2;
+    static struct session_out reused, fresh;
+    unsigned ci_cnt = 1, i;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  %s", codec_id));
+
+    status = pjmedia_codec_mgr_find_codecs_by_id(mgr, &id, &ci_cnt, &ci,
+						 NULL);
+    if (status != PJ_SUCCESS) {
+	PJ_LOG(3,(THIS_FILE, "    codec not found, skipped"));
+	return 0;
+    }
+
+    status = pjmedia_codec_mgr_get_default_param(mgr, ci, &param);
+    if (status != PJ_SUCCESS)
+	return -10;
+    param.setting.plc = 1;
+
+    pjmedia_codec_mgr_set_pool_limit(mgr, &id, 1);
+
+    /* First session on a new instance, which is then kept */
+    status = pjmedia_codec_mgr_alloc_codec(mgr, ci, &codec);
+    if (status != PJ_SUCCESS)
+	return -20;
+    status = run_session(codec, pool, &param, 1, &reused);
+    pjmedia_codec_mgr_dealloc_codec(mgr, codec);
+    if (status != PJ_SUCCESS) {
+	app_perror(status, "    error: session failed");
+	return -30;
+    }
+
+    pjmedia_codec_mgr_get_pool_stat(mgr, &id, &stat);
+    if (stat.idle_cnt != 1 || stat.miss_cnt != 1 || stat.hit_cnt != 0) {
+	PJ_LOG(3,(THIS_FILE, "    error: instance is not pooled, idle=%d "
+		  "miss=%d hit=%d", stat.idle_cnt, stat.miss_cnt,
+		  stat.hit_cnt));
+	return -40;
+    }
+
+    /* Second session on the reused instance */
+    status = pjmedia_codec_mgr_alloc_codec(mgr, ci, &codec2);
+    if (status != PJ_SUCCESS)
+	return -50;
+    if (codec2 != codec) {
+	pjmedia_codec_mgr_dealloc_codec(mgr, codec2);
+	return -60;
+    }
+    status = run_session(codec2, pool, &param, 2, &reused);
+    pjmedia_codec_mgr_dealloc_codec(mgr, codec2);
+    if (status != PJ_SUCCESS)
+	return -70;
+
+    /* Same session on a new instance. Disabling the pool returns the idle
+     * instance to the factory.
+     */
+    pjmedia_codec_mgr_set_pool_limit(mgr, &id, 0);
+    pjmedia_codec_mgr_get_pool_stat(mgr, &id, &stat);
+    if (stat.idle_cnt != 0 || stat.hit_cnt != 1) {
+	PJ_LOG(3,(THIS_FILE, "    error: unexpected pool stat, idle=%d "
+		  "hit=%d", stat.idle_cnt, stat.hit_cnt));
+	return -80;
+    }
+
+    status = pjmedia_codec_mgr_alloc_codec(mgr, ci, &codec);
+    if (status != PJ_SUCCESS)
+	return -90;
+    status = run_session(codec, pool, &param, 2, &fresh);
+    pjmedia_codec_mgr_dealloc_codec(mgr, codec);
+    if (status != PJ_SUCCESS)
+	return -100;
+
+    /* Nothing from the first session may be left in the reused instance */
+    for (i = 0; i < FRAME_CNT; ++i) {
+	if (reused.enc_len[i] != fresh.enc_len[i] ||
+	    pj_memcmp(reused.enc[i], fresh.enc[i], fresh.enc_len[i]) != 0)
+	{
+	    PJ_LOG(3,(THIS_FILE, "    error: frame %d differs from new "
+		      "instance", i));
+	    return -110;
+	}
+    }
+    if (pj_memcmp(reused.plc, fresh.plc, sizeof(fresh.plc)) != 0) {
+	PJ_LOG(3,(THIS_FILE, "    error: PLC differs from new instance"));
+	return -120;
+    }
+
+    return 0;
+}
+
+/* Instances of codecs without reset() must go back to the factory */
+static int test_no_reset(pjmedia_codec_mgr *mgr, const char *codec_id)
+{
+    pj_str_t id = pj_str((char*)codec_id);
+    const pjmedia_codec_info *ci;
+    pjmedia_codec_pool_stat stat;
+    pjmedia_codec *codec;
+    unsigned ci_cnt = 1;
+
+    if (pjmedia_codec_mgr_find_codecs_by_id(mgr, &id, &ci_cnt, &ci,
+					    NULL) != PJ_SUCCESS)
+    {
+	return 0;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "  %s (no reset)", codec_id));
+
+    pjmedia_codec_mgr_set_pool_limit(mgr, &id, 4);
+    if (pjmedia_codec_mgr_alloc_codec(mgr, ci, &codec) != PJ_SUCCESS)
+	return -200;
+    pjmedia_codec_mgr_dealloc_codec(mgr, codec);
+
+    pjmedia_codec_mgr_get_pool_stat(mgr, &id, &stat);
+    if (stat.idle_cnt || stat.miss_cnt || stat.hit_cnt || stat.discard_cnt)
+	return -210;
+
+    return 0;
+}
+
+/* Pool limit, discard count, and the cost of alloc/dealloc */
+static int test_limit(pjmedia_codec_mgr *mgr)
+{
+    enum { POOLED = 4 };
+    pj_str_t id = pj_str("PCMU");
+    const pjmedia_codec_info *ci;
+    pjmedia_codec_pool_stat stat;
+    pjmedia_codec *codecs[POOLED + 1];
+    pj_timestamp t0, t1, t2;
+    unsigned ci_cnt = 1, i;
+
+    PJ_LOG(3,(THIS_FILE, "  pool limit"));
+
+    if (pjmedia_codec_mgr_find_codecs_by_id(mgr, &id, &ci_cnt, &ci,
+					    NULL) != PJ_SUCCESS)
+    {
+	return -300;
+    }
+
+    pjmedia_codec_mgr_set_pool_limit(mgr, &id, 0);
+    pj_get_timestamp(&t0);
+    for (i = 0; i < BENCH_ROUNDS; ++i) {
+	if (pjmedia_codec_mgr_alloc_codec(mgr, ci, &codecs[0]) != PJ_SUCCESS)
+	    return -310;
+	pjmedia_codec_mgr_dealloc_codec(mgr, codecs[0]);
+    }
+    pj_get_timestamp(&t1);
+    pjmedia_codec_mgr_set_pool_limit(mgr, &id, POOLED);
+    for (i = 0; i < BENCH_ROUNDS; ++i) {
+	if (pjmedia_codec_mgr_alloc_codec(mgr, ci, &codecs[0]) != PJ_SUCCESS)
+	    return -320;
+	pjmedia_codec_mgr_dealloc_codec(mgr, codecs[0]);
+    }
+    pj_get_timestamp(&t2);
+
+    PJ_LOG(3,(THIS_FILE, "    %d alloc/dealloc: %6u usec, pooled %6u usec",
+	      BENCH_ROUNDS, pj_elapsed_usec(&t0, &t1),
+	      pj_elapsed_usec(&t1, &t2)));
+
+    /* Releasing more instances than the limit discards the excess */
+    for (i = 0; i <= POOLED; ++i) {
+	if (pjmedia_codec_mgr_alloc_codec(mgr, ci, &codecs[i]) != PJ_SUCCESS) {
+	    while (i--)
+		pjmedia_codec_mgr_dealloc_codec(mgr, codecs[i]);
+	    return -330;
+	}
+    }
+    for (i = 0; i <= POOLED; ++i)
+	pjmedia_codec_mgr_dealloc_codec(mgr, codecs[i]);
+
+    pjmedia_codec_mgr_get_pool_stat(mgr, &id, &stat);
+    if (stat.idle_cnt != POOLED || stat.discard_cnt != 1) {
+	PJ_LOG(3,(THIS_FILE, "    error: unexpected pool stat, idle=%d "
+		  "discard=%d", stat.idle_cnt, stat.discard_cnt));
+	return -340;
+    }
+
+    /* Lowering the limit trims the pool */
+    pjmedia_codec_mgr_set_pool_limit(mgr, &id, 1);
+    pjmedia_codec_mgr_get_pool_stat(mgr, &id, &stat);
+    if (stat.idle_cnt != 1)
+	return -350;
+
+    return 0;
+}
+
+/*
+ * Test the codec instance pool of the codec manager, with the codecs
+ * implementing reset().
+ */
+int codec_pool_test(void)
+{
+    pjmedia_endpt *endpt;
+    pjmedia_codec_mgr *mgr;
+    pj_pool_t *pool;
+    int rc;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "Testing codec instance pool"));
+
+    status = pjmedia_endpt_create(mem, NULL, 0, &endpt);
+    if (status != PJ_SUCCESS)
+	return -1;
+
+    pool = pjmedia_endpt_create_pool(endpt, "codecpool", 1000, 1000);
+    mgr = pjmedia_endpt_get_codec_mgr(endpt);
+
+    status = pjmedia_codec_register_audio_codecs(endpt, NULL);
+    if (status != PJ_SUCCESS) {
+	rc = -2;
+	goto on_return;
+    }
+
+    rc = test_reuse(mgr, pool, "PCMU/8000");
+    if (rc == 0)
+	rc = test_reuse(mgr, pool, "G722/16000");
+    if (rc == 0)
+	rc = test_no_reset(mgr, "speex/8000");
+    if (rc == 0)
+	rc = test_no_reset(mgr, "GSM/8000");
+    if (rc == 0)
+	rc = test_limit(mgr);
+
+on_return:
+    /* Idle instances are released along with the endpoint */
+    pj_pool_release(pool);
+    pjmedia_endpt_destroy(endpt);
+    return rc;
+}
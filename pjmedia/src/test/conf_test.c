@@ -0,0 +1,278 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE	"conf_test.c"
+
+#define CLOCK_RATE	8000
+#define SPF		160
+
+/* Number of ticks with active and silent sources. The silent period must
+ * be longer than the silence detector hangover.
+ */
+#define ACTIVE_TICKS	20
+#define SILENT_TICKS	200
+
+/* Sample value of the active sources, above the initial VAD threshold */
+#define SRC1_LEVEL	4000
+#define SRC2_LEVEL	2000
+
+/* Source port, generating constant signal when active */
+struct src_port
+{
+    pjmedia_port	 base;
+    pj_int16_t		 level;
+    pj_bool_t		 active;
+};
+
+/* Sink port, recording what the bridge gives it */
+struct sink_port
+{
+    pjmedia_port	 base;
+    unsigned		 null_cnt;	/* NULL frames received		    */
+    unsigned		 audio_cnt;	/* Audio frames received	    */
+    unsigned		 zero_cnt;	/* Audio frames with zero samples   */
+    pj_int16_t		 last;		/* First sample of last audio frame */
+};
+
+static pj_status_t src_get_frame(pjmedia_port *this_port,
+				 pjmedia_frame *frame)
+{
+    struct src_port *src = (struct src_port*) this_port;
+    pj_int16_t *samples = (pj_int16_t*) frame->buf;
+    unsigned i;
+
+    for (i = 0; i < SPF; ++i)
+	samples[i] = (pj_int16_t)(src->active? src->level : 0);
+    frame->size = SPF * 2;
+    frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
+    return PJ_SUCCESS;
+}
+
+static pj_status_t sink_put_frame(pjmedia_port *this_port,
+				  pjmedia_frame *frame)
+{
+    struct sink_port *sink = (struct sink_port*) this_port;
+    const pj_int16_t *samples = (const pj_int16_t*) frame->buf;
+    unsigned i;
+
+    if (frame->type != PJMEDIA_FRAME_TYPE_AUDIO) {
+	++sink->null_cnt;
+	return PJ_SUCCESS;
+    }
+
+    ++sink->audio_cnt;
+    for (i = 0; i < frame->size / 2 && samples[i] == 0; ++i)
+	;
+    if (i == frame->size / 2)
+	++sink->zero_cnt;
+    sink->last = samples[0];
+    return PJ_SUCCESS;
+}
+
+static void init_port(pjmedia_port *port, const char *name, pj_uint32_t sig)
+{
+    pj_str_t port_name = pj_str((char*)name);
+
+    pjmedia_port_info_init(&port->info, &port_name, sig, CLOCK_RATE, 1, 16,
+			   SPF);
+}
+
+/* Run the bridge for the specified number of ticks */
+static int run_ticks(pjmedia_conf *conf, unsigned cnt)
+{
+    pjmedia_port *master = pjmedia_conf_get_master_port(conf);
+    pj_int16_t buf[SPF];
+    pjmedia_frame frame;
+    unsigned i;
+
+    for (i = 0; i < cnt; ++i) {
+	frame.buf = buf;
+	frame.size = sizeof(buf);
+	frame.timestamp.u64 = (pj_uint64_t)i * SPF;
+	if (pjmedia_port_get_frame(master, &frame) != PJ_SUCCESS)
+	    return -1;
+    }
+    return 0;
+}
+
+static void reset_sink(struct sink_port *sink)
+{
+    sink->null_cnt = sink->audio_cnt = sink->zero_cnt = 0;
+    sink->last = 0;
+}
+
+/*
+ * Two sources are transmitting to a stream and a recorder. Check the
+ * mixed signal as sources become silent, and which ports are given NULL
+ * frames when nothing is active.
+ */
+static int dtx_test(pj_pool_t *pool, unsigned options)
+{
+    pj_bool_t dtx = (options & PJMEDIA_CONF_USE_DTX) != 0;
+    pjmedia_conf *conf;
+    struct src_port src1, src2;
+    struct sink_port stream, rec;
+    unsigned src1_slot, src2_slot, stream_slot, rec_slot;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  %s", dtx? "with DTX" : "without DTX"));
+
+    status = pjmedia_conf_create(pool, 8, CLOCK_RATE, 1, SPF, 16,
+				 PJMEDIA_CONF_NO_DEVICE | options, &conf);
+    if (status != PJ_SUCCESS)
+	return -10;
+
+    pj_bzero(&src1, sizeof(src1));
+    pj_bzero(&src2, sizeof(src2));
+    pj_bzero(&stream, sizeof(stream));
+    pj_bzero(&rec, sizeof(rec));
+
+    init_port(&src1.base, "src1", PJMEDIA_SIG_PORT_MEM_PLAYER);
+    src1.base.get_frame = &src_get_frame;
+    src1.level = SRC1_LEVEL;
+    init_port(&src2.base, "src2", PJMEDIA_SIG_PORT_MEM_PLAYER);
+    src2.base.get_frame = &src_get_frame;
+    src2.level = SRC2_LEVEL;
+
+    /* The stream is only recognized by its signature */
+    init_port(&stream.base, "stream", PJMEDIA_SIG_PORT_STREAM);
+    stream.base.put_frame = &sink_put_frame;
+    init_port(&rec.base, "rec", PJMEDIA_SIG_PORT_MEM_CAPTURE);
+    rec.base.put_frame = &sink_put_frame;
+
+    if (pjmedia_conf_add_port(conf, pool, &src1.base, NULL,
+			      &src1_slot) != PJ_SUCCESS ||
+	pjmedia_conf_add_port(conf, pool, &src2.base, NULL,
+			      &src2_slot) != PJ_SUCCESS ||
+	pjmedia_conf_add_port(conf, pool, &stream.base, NULL,
+			      &stream_slot) != PJ_SUCCESS ||
+	pjmedia_conf_add_port(conf, pool, &rec.base, NULL,
+			      &rec_slot) != PJ_SUCCESS)
+    {
+	rc = -20;
+	goto on_return;
+    }
+
+    if (pjmedia_conf_connect_port(conf, src1_slot, stream_slot, 0) ||
+	pjmedia_conf_connect_port(conf, src2_slot, stream_slot, 0) ||
+	pjmedia_conf_connect_port(conf, src1_slot, rec_slot, 0) ||
+	pjmedia_conf_connect_port(conf, src2_slot, rec_slot, 0))
+    {
+	rc = -30;
+	goto on_return;
+    }
+
+    /* Both sources active, both sinks get the sum */
+    src1.active = src2.active = PJ_TRUE;
+    if (run_ticks(conf, ACTIVE_TICKS)) {
+	rc = -40;
+	goto on_return;
+    }
+    if (stream.null_cnt || rec.null_cnt ||
+	stream.last != SRC1_LEVEL + SRC2_LEVEL ||
+	rec.last != SRC1_LEVEL + SRC2_LEVEL)
+    {
+	PJ_LOG(3,(THIS_FILE, "    error: mixed %d/%d, expecting %d",
+		  stream.last, rec.last, SRC1_LEVEL + SRC2_LEVEL));
+	rc = -50;
+	goto on_return;
+    }
+
+    /* One source silent. With DTX it is not mixed, and the other source
+     * is passed as is.
+     */
+    src2.active = PJ_FALSE;
+    if (run_ticks(conf, SILENT_TICKS)) {
+	rc = -60;
+	goto on_return;
+    }
+    if (stream.null_cnt || rec.null_cnt ||
+	stream.last != SRC1_LEVEL || rec.last != SRC1_LEVEL)
+    {
+	PJ_LOG(3,(THIS_FILE, "    error: mixed %d/%d, expecting %d",
+		  stream.last, rec.last, SRC1_LEVEL));
+	rc = -70;
+	goto on_return;
+    }
+
+    /* All sources silent. With DTX, once the VAD hangover has passed the
+     * stream is given NULL frames, while the recorder still gets silence.
+     */
+    src1.active = PJ_FALSE;
+    reset_sink(&stream);
+    reset_sink(&rec);
+    if (run_ticks(conf, SILENT_TICKS)) {
+	rc = -80;
+	goto on_return;
+    }
+    if (rec.null_cnt || rec.zero_cnt != SILENT_TICKS) {
+	rc = -90;
+	goto on_return;
+    }
+    if (dtx) {
+	if (stream.null_cnt == 0 || stream.null_cnt + stream.audio_cnt !=
+				    SILENT_TICKS)
+	{
+	    rc = -100;
+	    goto on_return;
+	}
+    } else if (stream.null_cnt || stream.zero_cnt != SILENT_TICKS) {
+	rc = -110;
+	goto on_return;
+    }
+    PJ_LOG(3,(THIS_FILE, "    silence: stream %u null/%u audio, recorder "
+	      "%u audio", stream.null_cnt, stream.audio_cnt, rec.audio_cnt));
+
+    /* Talkspurt again, the stream gets audio right away */
+    src1.active = PJ_TRUE;
+    reset_sink(&stream);
+    if (run_ticks(conf, 1)) {
+	rc = -120;
+	goto on_return;
+    }
+    if (stream.null_cnt || stream.audio_cnt != 1 ||
+	stream.last != SRC1_LEVEL)
+    {
+	rc = -130;
+	goto on_return;
+    }
+
+on_return:
+    pjmedia_conf_destroy(conf);
+    return rc;
+}
+
+int conf_test(void)
+{
+    pj_pool_t *pool;
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "Testing audio conference bridge"));
+
+    pool = pj_pool_create(mem, "conftest", 1000, 1000, NULL);
+
+    rc = dtx_test(pool, 0);
+    if (rc == 0)
+	rc = dtx_test(pool, PJMEDIA_CONF_USE_DTX);
+
+    pj_pool_release(pool);
+    return rc;
+}
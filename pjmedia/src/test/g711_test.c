@@ -0,0 +1,309 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE	"g711_test.c"
+
+/* Number of samples converted in the benchmark */
+#define BENCH_SAMPLES	(8000 * 60)
+
+/* Number of codec instances encoded in one batch */
+#define BATCH_CNT	32
+
+/* Samples per frame, 20ms */
+#define SPF		160
+
+
+static pj_int16_t pcm[65536];
+static pj_int16_t pcm2[65536];
+static pj_uint8_t enc[65536];
+
+
+/* Compare the bulk conversion with the per sample conversion of every
+ * possible value.
+ */
+static int verify_bulk(void)
+{
+    unsigned i;
+
+    for (i = 0; i < 65536; ++i)
+	pcm[i] = (pj_int16_t)(i - 32768);
+
+    pjmedia_ulaw_encode(enc, pcm, 65536);
+    for (i = 0; i < 65536; ++i) {
+	if (enc[i] != (pj_uint8_t)pjmedia_linear2ulaw(pcm[i])) {
+	    PJ_LOG(3,(THIS_FILE, "  error: ulaw encode mismatch for %d",
+		      pcm[i]));
+	    return -10;
+	}
+    }
+
+    pjmedia_alaw_encode(enc, pcm, 65536);
+    for (i = 0; i < 65536; ++i) {
+	if (enc[i] != (pj_uint8_t)pjmedia_linear2alaw(pcm[i])) {
+	    PJ_LOG(3,(THIS_FILE, "  error: alaw encode mismatch for %d",
+		      pcm[i]));
+	    return -20;
+	}
+    }
+
+    /* Every code, repeated so the SIMD path is exercised */
+    for (i = 0; i < 65536; ++i)
+	enc[i] = (pj_uint8_t)i;
+
+    pjmedia_ulaw_decode(pcm, enc, 65536);
+    for (i = 0; i < 65536; ++i) {
+	if (pcm[i] != (pj_int16_t)pjmedia_ulaw2linear(enc[i])) {
+	    PJ_LOG(3,(THIS_FILE, "  error: ulaw decode mismatch for 0x%02x",
+		      enc[i]));
+	    return -30;
+	}
+    }
+
+    pjmedia_alaw_decode(pcm, enc, 65536);
+    for (i = 0; i < 65536; ++i) {
+	if (pcm[i] != (pj_int16_t)pjmedia_alaw2linear(enc[i])) {
+	    PJ_LOG(3,(THIS_FILE, "  error: alaw decode mismatch for 0x%02x",
+		      enc[i]));
+	    return -40;
+	}
+    }
+
+    return 0;
+}
+
+/* Multiple frames encoding must match encoding the frames one by one */
+static int verify_frames(void)
+{
+    enum { FRAME_CNT = 5, SAMPLES = SPF + 7 };
+    pj_uint8_t *dst[FRAME_CNT];
+    const pj_int16_t *src[FRAME_CNT];
+    pj_uint8_t expected[SAMPLES];
+    unsigned i, law;
+
+    for (i = 0; i < FRAME_CNT * SAMPLES; ++i)
+	pcm[i] = (pj_int16_t)((pj_rand() & 0xFFFF) - 32768);
+
+    for (law = 0; law < 2; ++law) {
+	for (i = 0; i < FRAME_CNT; ++i) {
+	    /* Odd offsets, so the frames are not aligned */
+	    src[i] = pcm + i * SAMPLES;
+	    dst[i] = enc + i * (SAMPLES + 1) + 1;
+	}
+
+	if (law)
+	    pjmedia_alaw_encode_frames(FRAME_CNT, dst, src, SAMPLES);
+	else
+	    pjmedia_ulaw_encode_frames(FRAME_CNT, dst, src, SAMPLES);
+
+	for (i = 0; i < FRAME_CNT; ++i) {
+	    unsigned j;
+
+	    for (j = 0; j < SAMPLES; ++j) {
+		expected[j] = (pj_uint8_t)(law ? pjmedia_linear2alaw(src[i][j]) :
+					   pjmedia_linear2ulaw(src[i][j]));
+	    }
+	    if (pj_memcmp(dst[i], expected, SAMPLES) != 0) {
+		PJ_LOG(3,(THIS_FILE, "  error: %s frames encode mismatch in "
+			  "frame %d", (law ? "alaw" : "ulaw"), i));
+		return -50;
+	    }
+	}
+    }
+
+    return 0;
+}
+
+/* Compare the time of per sample and bulk conversion */
+static void bench_bulk(void)
+{
+    pj_timestamp t0, t1, t2;
+    unsigned i, j;
+
+    for (i = 0; i < 65536; ++i)
+	pcm[i] = (pj_int16_t)((pj_rand() & 0xFFFF) - 32768);
+
+    /* Encode */
+    pj_get_timestamp(&t0);
+    for (i = 0; i < BENCH_SAMPLES; i += SPF) {
+	pj_uint8_t *dst = enc + (i & 0x7FFF);
+	const pj_int16_t *src = pcm + (i & 0x7FFF);
+
+	for (j = 0; j < SPF; ++j)
+	    dst[j] = (pj_uint8_t)pjmedia_linear2ulaw(src[j]);
+    }
+    pj_get_timestamp(&t1);
+    for (i = 0; i < BENCH_SAMPLES; i += SPF)
+	pjmedia_ulaw_encode(enc + (i & 0x7FFF), pcm + (i & 0x7FFF), SPF);
+    pj_get_timestamp(&t2);
+
+    PJ_LOG(3,(THIS_FILE, "  ulaw encode: per sample %6u usec, bulk %6u usec",
+	      pj_elapsed_usec(&t0, &t1), pj_elapsed_usec(&t1, &t2)));
+
+    /* Decode */
+    pj_get_timestamp(&t0);
+    for (i = 0; i < BENCH_SAMPLES; i += SPF) {
+	pj_int16_t *dst = pcm2 + (i & 0x7FFF);
+	const pj_uint8_t *src = enc + (i & 0x7FFF);
+
+	for (j = 0; j < SPF; ++j)
+	    dst[j] = (pj_int16_t)pjmedia_ulaw2linear(src[j]);
+    }
+    pj_get_timestamp(&t1);
+    for (i = 0; i < BENCH_SAMPLES; i += SPF)
+	pjmedia_ulaw_decode(pcm2 + (i & 0x7FFF), enc + (i & 0x7FFF), SPF);
+    pj_get_timestamp(&t2);
+
+    PJ_LOG(3,(THIS_FILE, "  ulaw decode: per sample %6u usec, bulk %6u usec",
+	      pj_elapsed_usec(&t0, &t1), pj_elapsed_usec(&t1, &t2)));
+}
+
+#if PJMEDIA_HAS_G711_CODEC
+/* Encode frames of several G.711 instances with one batch call */
+static int test_batch(void)
+{
+    pjmedia_endpt *endpt;
+    pjmedia_codec_mgr *mgr;
+    pjmedia_codec *codecs[BATCH_CNT];
+    pjmedia_codec_encode_job jobs[BATCH_CNT];
+    pjmedia_frame in_frm[BATCH_CNT], out_frm[BATCH_CNT];
+    static pj_uint8_t out_buf[BATCH_CNT][SPF];
+    pj_uint8_t expected[SPF];
+    pj_pool_t *pool;
+    unsigned i, cnt = 0;
+    pj_status_t status;
+    int rc = 0;
+
+    status = pjmedia_endpt_create(mem, NULL, 0, &endpt);
+    if (status != PJ_SUCCESS)
+	return -100;
+
+    pool = pjmedia_endpt_create_pool(endpt, "g711batch", 1000, 1000);
+    mgr = pjmedia_endpt_get_codec_mgr(endpt);
+
+    status = pjmedia_codec_g711_init(endpt);
+    if (status != PJ_SUCCESS) {
+	rc = -110;
+	goto on_return;
+    }
+
+    for (cnt = 0; cnt < BATCH_CNT; ++cnt) {
+	const pjmedia_codec_info *ci;
+	pjmedia_codec_param param;
+	unsigned ci_cnt = 1;
+	pj_str_t id = pj_str((cnt & 1) ? "PCMA" : "PCMU");
+
+	status = pjmedia_codec_mgr_find_codecs_by_id(mgr, &id, &ci_cnt, &ci,
+						     NULL);
+	if (status == PJ_SUCCESS)
+	    status = pjmedia_codec_mgr_get_default_param(mgr, ci, &param);
+	if (status == PJ_SUCCESS)
+	    status = pjmedia_codec_mgr_alloc_codec(mgr, ci, &codecs[cnt]);
+	if (status != PJ_SUCCESS) {
+	    rc = -120;
+	    goto on_return;
+	}
+
+	param.setting.vad = 0;
+	status = pjmedia_codec_init(codecs[cnt], pool);
+	if (status == PJ_SUCCESS)
+	    status = pjmedia_codec_open(codecs[cnt], &param);
+	if (status != PJ_SUCCESS) {
+	    pjmedia_codec_mgr_dealloc_codec(mgr, codecs[cnt]);
+	    rc = -130;
+	    goto on_return;
+	}
+
+	pj_bzero(&in_frm[cnt], sizeof(in_frm[cnt]));
+	in_frm[cnt].type = PJMEDIA_FRAME_TYPE_AUDIO;
+	in_frm[cnt].buf = pcm + cnt * SPF;
+	in_frm[cnt].size = SPF * 2;
+
+	pj_bzero(&out_frm[cnt], sizeof(out_frm[cnt]));
+	out_frm[cnt].buf = out_buf[cnt];
+
+	jobs[cnt].codec = codecs[cnt];
+	jobs[cnt].input = &in_frm[cnt];
+	jobs[cnt].out_size = SPF;
+	jobs[cnt].output = &out_frm[cnt];
+	jobs[cnt].status = PJ_EUNKNOWN;
+    }
+
+    status = pjmedia_codec_encode_batch(cnt, jobs);
+    if (status != PJ_SUCCESS) {
+	app_perror(status, "  error: batch encode failed");
+	rc = -140;
+	goto on_return;
+    }
+
+    for (i = 0; i < cnt; ++i) {
+	if (i & 1)
+	    pjmedia_alaw_encode(expected, pcm + i * SPF, SPF);
+	else
+	    pjmedia_ulaw_encode(expected, pcm + i * SPF, SPF);
+
+	if (jobs[i].status != PJ_SUCCESS || out_frm[i].size != SPF ||
+	    pj_memcmp(out_buf[i], expected, SPF) != 0)
+	{
+	    PJ_LOG(3,(THIS_FILE, "  error: batch encode mismatch in job %d",
+		      i));
+	    rc = -150;
+	    break;
+	}
+    }
+
+on_return:
+    for (i = 0; i < cnt; ++i) {
+	pjmedia_codec_close(codecs[i]);
+	pjmedia_codec_mgr_dealloc_codec(mgr, codecs[i]);
+    }
+    pj_pool_release(pool);
+    pjmedia_endpt_destroy(endpt);
+    return rc;
+}
+
+#endif	/* PJMEDIA_HAS_G711_CODEC */
+
+/*
+ * Verify the bulk A-law/U-law conversion and the G.711 batch encoding,
+ * and compare the speed of bulk and per sample conversion.
+ */
+int g711_test(void)
+{
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "  G.711 bulk conversion (SIMD %s)",
+	      PJMEDIA_HAS_G711_SIMD ? "enabled" : "disabled"));
+
+    rc = verify_bulk();
+    if (rc != 0)
+	return rc;
+
+    rc = verify_frames();
+    if (rc != 0)
+	return rc;
+
+    bench_bulk();
+
+#if PJMEDIA_HAS_G711_CODEC
+    rc = test_batch();
+#endif
+
+    return rc;
+}
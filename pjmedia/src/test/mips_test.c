@@ -2143,6 +2143,7 @@ static pj_status_t delaybuf_on_destroy(struct pjmedia_port *this_port)
 }
 
 static pjmedia_port* create_delaybuf(int drift_pct,
+				     unsigned opt,
 				     pj_pool_t *pool,
 				     unsigned clock_rate,
 				     unsigned channel_count,
@@ -2152,7 +2153,6 @@ static pjmedia_port* create_delaybuf(int drift_pct,
 {
     struct delaybuf_port *dp;
     pj_str_t name = pj_str("delaybuf");
-    unsigned opt = 0;
     pj_status_t status;
 
     PJ_UNUSED_ARG(flags);
@@ -2190,7 +2190,7 @@ static pjmedia_port* delaybuf_0( pj_pool_t *pool,
 				  unsigned flags,
 				  struct test_entry *te)
 {
-    return create_delaybuf(0, pool, clock_rate, channel_count, 
+    return create_delaybuf(0, 0, pool, clock_rate, channel_count, 
 			   samples_per_frame, flags, te);
 }
 
@@ -2203,7 +2203,7 @@ static pjmedia_port* delaybuf_p2( pj_pool_t *pool,
 				  unsigned flags,
 				  struct test_entry *te)
 {
-    return create_delaybuf(2, pool, clock_rate, channel_count, 
+    return create_delaybuf(2, 0, pool, clock_rate, channel_count, 
 			   samples_per_frame, flags, te);
 }
 
@@ -2215,7 +2215,7 @@ static pjmedia_port* delaybuf_p5( pj_pool_t *pool,
 				  unsigned flags,
 				  struct test_entry *te)
 {
-    return create_delaybuf(5, pool, clock_rate, channel_count, 
+    return create_delaybuf(5, 0, pool, clock_rate, channel_count, 
 			   samples_per_frame, flags, te);
 }
 
@@ -2227,7 +2227,7 @@ static pjmedia_port* delaybuf_p10(pj_pool_t *pool,
 				  unsigned flags,
 				  struct test_entry *te)
 {
-    return create_delaybuf(10, pool, clock_rate, channel_count, 
+    return create_delaybuf(10, 0, pool, clock_rate, channel_count, 
 			   samples_per_frame, flags, te);
 }
 
@@ -2239,7 +2239,7 @@ static pjmedia_port* delaybuf_p20(pj_pool_t *pool,
 				  unsigned flags,
 				  struct test_entry *te)
 {
-    return create_delaybuf(20, pool, clock_rate, channel_count, 
+    return create_delaybuf(20, 0, pool, clock_rate, channel_count, 
 			   samples_per_frame, flags, te);
 }
 
@@ -2251,7 +2251,7 @@ static pjmedia_port* delaybuf_n2( pj_pool_t *pool,
 				  unsigned flags,
 				  struct test_entry *te)
 {
-    return create_delaybuf(-2, pool, clock_rate, channel_count, 
+    return create_delaybuf(-2, 0, pool, clock_rate, channel_count, 
 			   samples_per_frame, flags, te);
 }
 
@@ -2263,7 +2263,7 @@ static pjmedia_port* delaybuf_n5( pj_pool_t *pool,
 				  unsigned flags,
 				  struct test_entry *te)
 {
-    return create_delaybuf(-5, pool, clock_rate, channel_count, 
+    return create_delaybuf(-5, 0, pool, clock_rate, channel_count, 
 			   samples_per_frame, flags, te);
 }
 
@@ -2275,7 +2275,7 @@ static pjmedia_port* delaybuf_n10(pj_pool_t *pool,
 				  unsigned flags,
 				  struct test_entry *te)
 {
-    return create_delaybuf(-10, pool, clock_rate, channel_count, 
+    return create_delaybuf(-10, 0, pool, clock_rate, channel_count, 
 			   samples_per_frame, flags, te);
 }
 
@@ -2287,11 +2287,48 @@ static pjmedia_port* delaybuf_n20(pj_pool_t *pool,
 				  unsigned flags,
 				  struct test_entry *te)
 {
-    return create_delaybuf(-20, pool, clock_rate, channel_count, 
+    return create_delaybuf(-20, 0, pool, clock_rate, channel_count, 
 			   samples_per_frame, flags, te);
 }
 
 
+/* Lock-free delay buffer without drift */
+static pjmedia_port* delaybuf_lf_0(pj_pool_t *pool,
+				   unsigned clock_rate,
+				   unsigned channel_count,
+				   unsigned samples_per_frame,
+				   unsigned flags,
+				   struct test_entry *te)
+{
+    return create_delaybuf(0, PJMEDIA_DELAY_BUF_LOCK_FREE, pool, clock_rate,
+			   channel_count, samples_per_frame, flags, te);
+}
+
+/* Lock-free delay buffer with 5% drift */
+static pjmedia_port* delaybuf_lf_p5(pj_pool_t *pool,
+				    unsigned clock_rate,
+				    unsigned channel_count,
+				    unsigned samples_per_frame,
+				    unsigned flags,
+				    struct test_entry *te)
+{
+    return create_delaybuf(5, PJMEDIA_DELAY_BUF_LOCK_FREE, pool, clock_rate,
+			   channel_count, samples_per_frame, flags, te);
+}
+
+/* Lock-free delay buffer with -5% drift */
+static pjmedia_port* delaybuf_lf_n5(pj_pool_t *pool,
+				    unsigned clock_rate,
+				    unsigned channel_count,
+				    unsigned samples_per_frame,
+				    unsigned flags,
+				    struct test_entry *te)
+{
+    return create_delaybuf(-5, PJMEDIA_DELAY_BUF_LOCK_FREE, pool, clock_rate,
+			   channel_count, samples_per_frame, flags, te);
+}
+
+
 /***************************************************************************/
 /* Run test entry, return elapsed time */
 static pj_timestamp run_entry(unsigned clock_rate, struct test_entry *e)
@@ -2422,6 +2459,9 @@ int mips_test(void)
 	{ "Delay buffer - drift +5%", OP_GET_PUT, K8|K16, &delaybuf_p5},
 	{ "Delay buffer - drift +10%", OP_GET_PUT, K8|K16, &delaybuf_p10},
 	{ "Delay buffer - drift +20%", OP_GET_PUT, K8|K16, &delaybuf_p20},
+	{ "Lock-free delay buffer", OP_GET_PUT, K8|K16, &delaybuf_lf_0},
+	{ "Lock-free delay buffer - drift -5%", OP_GET_PUT, K8|K16, &delaybuf_lf_n5},
+	{ "Lock-free delay buffer - drift +5%", OP_GET_PUT, K8|K16, &delaybuf_lf_p5},
 	{ "echo canceller 100ms tail len", OP_GET_PUT, K8|K16, &ec_create_100},
 	{ "echo canceller 128ms tail len", OP_GET_PUT, K8|K16, &ec_create_128},
 	{ "echo canceller 200ms tail len", OP_GET_PUT, K8|K16, &ec_create_200},
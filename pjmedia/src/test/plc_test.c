@@ -0,0 +1,244 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE	"plc_test.c"
+
+#if PJMEDIA_WSOLA_IMP != PJMEDIA_WSOLA_IMP_NULL
+
+#include <math.h>
+
+/* Frame length, in msec */
+#define PTIME		20
+
+/* Duration of each run, in msec */
+#define DURATION	60000
+
+/* Extra lost packets allowed before the average loss is enforced, as in
+ * jbsim.c
+ */
+#define LOSS_EXTRA	2
+
+#define MAX_CLOCK_RATE	48000
+
+#ifndef M_PI
+#   define M_PI		3.14159265358979323846
+#endif
+
+/* Packet loss patterns, see the --loss, --loss-corr, --min-lost-burst,
+ * and --max-lost-burst options of jbsim.c.
+ */
+static const struct loss_pattern
+{
+    const char	*name;
+    unsigned	 pct_avg_lost;	    /* Average loss in percent	    */
+    unsigned	 min_lost_burst;    /* Min lost burst in #pkt	    */
+    unsigned	 max_lost_burst;    /* Max lost burst in #pkt	    */
+    unsigned	 pct_loss_corr;	    /* Loss correlation in pct	    */
+} patterns[] =
+{
+    { "random",  5, 0,  1,  0 },
+    { "bursty",  5, 1,  4, 50 },
+    { "heavy",  20, 2, 10, 70 },
+};
+
+static const unsigned clock_rates[] = { 8000, 16000, 48000 };
+
+
+/* Packet loss generator, the same algorithm as jbsim.c */
+static struct loss_state
+{
+    const struct loss_pattern *pat;
+    unsigned	total_tx;
+    unsigned	total_lost;
+    unsigned	cur_lost_burst;
+    unsigned	drop_prob;
+} loss;
+
+static pj_bool_t below_avg_loss(void)
+{
+    unsigned lost = loss.total_lost > LOSS_EXTRA ?
+		    loss.total_lost - LOSS_EXTRA : 0;
+
+    return lost * 100 / PJ_MAX(loss.total_tx, 1) < loss.pat->pct_avg_lost;
+}
+
+static pj_bool_t is_lost(void)
+{
+    pj_bool_t drop = PJ_FALSE;
+
+    if (loss.cur_lost_burst) {
+	/* Make it comply to minimum lost burst */
+	if (loss.cur_lost_burst < loss.pat->min_lost_burst)
+	    drop = PJ_TRUE;
+
+	/* Correlate the next packet loss */
+	if (!drop && loss.cur_lost_burst < loss.pat->max_lost_burst &&
+	    below_avg_loss())
+	{
+	    loss.drop_prob = ((loss.pat->pct_loss_corr * loss.drop_prob) +
+			      ((100 - loss.pat->pct_loss_corr) *
+			       (pj_rand() % 100))) / 100;
+	    if (loss.drop_prob >= 100)
+		loss.drop_prob = 99;
+
+	    if (loss.drop_prob >= 100 - loss.pat->pct_avg_lost)
+		drop = PJ_TRUE;
+	}
+    }
+
+    /* If we're not dropping packet then use randomly distributed loss */
+    if (!drop && below_avg_loss()) {
+	loss.drop_prob = pj_rand() % 100;
+	if (loss.drop_prob >= 100 - loss.pat->pct_avg_lost)
+	    drop = PJ_TRUE;
+    }
+
+    if (drop) {
+	++loss.total_lost;
+	++loss.cur_lost_burst;
+    } else {
+	loss.cur_lost_burst = 0;
+    }
+    ++loss.total_tx;
+
+    return drop;
+}
+
+/* Voiced speech like signal: harmonics of a slowly gliding pitch */
+static void gen_frame(pj_int16_t *frame, unsigned count, unsigned clock_rate,
+		      unsigned frame_no, double *phase)
+{
+    unsigned i, h;
+
+    for (i = 0; i < count; ++i) {
+	double t = (double)(frame_no * count + i) / clock_rate;
+	double pitch = 150 + 50 * sin(2 * M_PI * 0.5 * t);
+	double v = 0;
+
+	*phase += 2 * M_PI * pitch / clock_rate;
+	for (h = 1; h <= 5; ++h)
+	    v += sin(*phase * h) / h;
+
+	frame[i] = (pj_int16_t)(v * 6000);
+    }
+}
+
+static int run_plc(unsigned pi, unsigned clock_rate)
+{
+    enum { FRAME_CNT = DURATION / PTIME };
+    unsigned spf = clock_rate * PTIME / 1000;
+    pj_int16_t frame[MAX_CLOCK_RATE * PTIME / 1000];
+    pj_pool_t *pool;
+    pjmedia_plc *plc;
+    pj_timestamp t0, t1, elapsed, gen_elapsed;
+    double phase = 0;
+    unsigned i, usec, lost_cnt = 0, silent_cnt = 0;
+    pj_status_t status;
+
+    pool = pj_pool_create(mem, "plctest", 4000, 4000, NULL);
+
+    status = pjmedia_plc_create(pool, clock_rate, spf, 0, &plc);
+    if (status != PJ_SUCCESS) {
+	app_perror(status, "  error creating PLC");
+	pj_pool_release(pool);
+	return -10;
+    }
+
+    pj_bzero(&loss, sizeof(loss));
+    loss.pat = &patterns[pi];
+    pj_srand(0);
+
+    elapsed.u64 = gen_elapsed.u64 = 0;
+    for (i = 0; i < FRAME_CNT; ++i) {
+	gen_frame(frame, spf, clock_rate, i, &phase);
+
+	/* Never lose the first frames, PLC needs some history */
+	if (i > 10 && is_lost()) {
+	    pj_get_timestamp(&t0);
+	    pjmedia_plc_generate(plc, frame);
+	    pj_get_timestamp(&t1);
+	    gen_elapsed.u64 += (t1.u64 - t0.u64);
+
+	    ++lost_cnt;
+	    if (loss.cur_lost_burst == 1 &&
+		pjmedia_calc_avg_signal(frame, spf) == 0)
+	    {
+		++silent_cnt;
+	    }
+	} else {
+	    pj_get_timestamp(&t0);
+	    pjmedia_plc_save(plc, frame);
+	    pj_get_timestamp(&t1);
+	}
+	elapsed.u64 += (t1.u64 - t0.u64);
+    }
+
+    pj_pool_release(pool);
+
+    /* Processing time of one second of audio */
+    t0.u64 = 0;
+    usec = pj_elapsed_usec(&t0, &elapsed) * 1000 / DURATION;
+
+    PJ_LOG(3,(THIS_FILE, "  %-7s %5d %5d.%d%% %11d %8d", patterns[pi].name,
+	      clock_rate, lost_cnt * 100 / FRAME_CNT,
+	      lost_cnt * 1000 / FRAME_CNT % 10, usec,
+	      lost_cnt ? pj_elapsed_usec(&t0, &gen_elapsed) / lost_cnt : 0));
+
+    /* The first concealed frame of a burst must not be silent */
+    if (silent_cnt) {
+	PJ_LOG(3,(THIS_FILE, "  error: %d concealed frames are silent",
+		  silent_cnt));
+	return -20;
+    }
+
+    return 0;
+}
+
+/*
+ * Measure the PLC (WSOLA) processing time with the packet loss patterns
+ * of the jitter buffer simulator (jbsim).
+ */
+int plc_test(void)
+{
+    unsigned i, j;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  PLC processing time (SIMD %s), %d ms frames",
+	      PJMEDIA_HAS_WSOLA_SIMD ? "enabled" : "disabled", PTIME));
+    PJ_LOG(3,(THIS_FILE, "  Pattern  Rate   Lost  usec/second usec/lost"));
+    PJ_LOG(3,(THIS_FILE, "  --------------------------------------------"));
+
+    for (i = 0; i < PJ_ARRAY_SIZE(patterns) && rc == 0; ++i) {
+	for (j = 0; j < PJ_ARRAY_SIZE(clock_rates) && rc == 0; ++j) {
+	    rc = run_plc(i, clock_rates[j]);
+	}
+    }
+
+    return rc;
+}
+
+#else
+
+int plc_test(void)
+{
+    return 0;
+}
+
+#endif	/* PJMEDIA_WSOLA_IMP != PJMEDIA_WSOLA_IMP_NULL */
@@ -0,0 +1,208 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE	"resample_test.c"
+
+#if PJMEDIA_RESAMPLE_IMP != PJMEDIA_RESAMPLE_NONE
+
+#include <math.h>
+
+/* Frame length, in msec */
+#define PTIME		10
+
+/* Duration of each run, in msec */
+#define DURATION	2000
+
+/* Frames skipped before measuring the SNR, to let the filter settle */
+#define SKIP_FRAMES	10
+
+/* Test tone frequency and amplitude */
+#define TONE_FREQ	1000
+#define TONE_AMP	10000
+
+#define MAX_CLOCK_RATE	48000
+
+#ifndef M_PI
+#   define M_PI		3.14159265358979323846
+#endif
+
+static const struct
+{
+    const char	*name;
+    pj_bool_t	 high_quality;
+    pj_bool_t	 large_filter;
+    double	 min_snr;	/* Minimum SNR, in dB, to pass */
+} qualities[] =
+{
+    { "fast",	PJ_FALSE, PJ_FALSE, 25 },
+    { "small",	PJ_TRUE,  PJ_FALSE, 40 },
+    { "large",	PJ_TRUE,  PJ_TRUE,  40 },
+};
+
+static const struct
+{
+    unsigned	rate_in;
+    unsigned	rate_out;
+} rates[] =
+{
+    {  8000, 16000 },
+    { 16000,  8000 },
+    { 16000, 48000 },
+    { 48000, 16000 },
+    {  8000, 48000 },
+    { 44100, 48000 },
+};
+
+
+/*
+ * Compute the SNR of a tone against the ideal tone at the same frequency.
+ * The phase and amplitude are estimated with least squares fit, so the
+ * filter delay doesn't matter.
+ */
+static double tone_snr(const pj_int16_t *samples, unsigned count,
+		       unsigned clock_rate)
+{
+    double ss = 0, cc = 0, sc = 0, xs = 0, xc = 0, a, b, det;
+    double sig = 0, noise = 0;
+    unsigned i;
+
+    for (i = 0; i < count; ++i) {
+	double w = 2 * M_PI * TONE_FREQ * i / clock_rate;
+	double s = sin(w), c = cos(w);
+
+	ss += s * s;
+	cc += c * c;
+	sc += s * c;
+	xs += samples[i] * s;
+	xc += samples[i] * c;
+    }
+
+    det = ss * cc - sc * sc;
+    a = (xs * cc - xc * sc) / det;
+    b = (xc * ss - xs * sc) / det;
+
+    for (i = 0; i < count; ++i) {
+	double w = 2 * M_PI * TONE_FREQ * i / clock_rate;
+	double ref = a * sin(w) + b * cos(w);
+	double err = samples[i] - ref;
+
+	sig += ref * ref;
+	noise += err * err;
+    }
+
+    if (noise < 1)
+	noise = 1;
+    return 10 * log10(sig / noise);
+}
+
+static int test_rate(unsigned qi, unsigned rate_in, unsigned rate_out)
+{
+    enum { FRAME_CNT = DURATION / PTIME };
+    pj_pool_t *pool;
+    pjmedia_resample *resample;
+    unsigned in_cnt = rate_in * PTIME / 1000;
+    unsigned out_cnt = rate_out * PTIME / 1000;
+    pj_int16_t in[MAX_CLOCK_RATE * PTIME / 1000];
+    pj_int16_t *out;
+    pj_timestamp t0, t1, elapsed;
+    unsigned i, j, usec;
+    double snr;
+    int rc = 0;
+    pj_status_t status;
+
+    pool = pj_pool_create(mem, "resampletest", 4000, 4000, NULL);
+
+    status = pjmedia_resample_create(pool, qualities[qi].high_quality,
+				     qualities[qi].large_filter, 1,
+				     rate_in, rate_out, in_cnt, &resample);
+    if (status != PJ_SUCCESS) {
+	app_perror(status, "  error creating resample");
+	pj_pool_release(pool);
+	return -10;
+    }
+
+    out = (pj_int16_t*)pj_pool_alloc(pool, FRAME_CNT * out_cnt *
+					   sizeof(pj_int16_t));
+
+    elapsed.u64 = 0;
+    for (i = 0; i < FRAME_CNT; ++i) {
+	for (j = 0; j < in_cnt; ++j) {
+	    double w = 2 * M_PI * TONE_FREQ * (i * in_cnt + j) / rate_in;
+	    in[j] = (pj_int16_t)(TONE_AMP * sin(w));
+	}
+
+	pj_get_timestamp(&t0);
+	pjmedia_resample_run(resample, in, out + i * out_cnt);
+	pj_get_timestamp(&t1);
+	elapsed.u64 += (t1.u64 - t0.u64);
+    }
+
+    pjmedia_resample_destroy(resample);
+
+    snr = tone_snr(out + SKIP_FRAMES * out_cnt,
+		   (FRAME_CNT - SKIP_FRAMES) * out_cnt, rate_out);
+
+    /* Processing time of one second of audio */
+    t0.u64 = 0;
+    usec = pj_elapsed_usec(&t0, &elapsed) * 1000 / DURATION;
+
+    PJ_LOG(3,(THIS_FILE, "  %-5s %5d -> %5d %9d %8.1f", qualities[qi].name,
+	      rate_in, rate_out, usec, snr));
+
+    if (snr < qualities[qi].min_snr) {
+	PJ_LOG(3,(THIS_FILE, "  error: SNR is too low"));
+	rc = -20;
+    }
+
+    pj_pool_release(pool);
+    return rc;
+}
+
+/*
+ * Measure the resampling speed and quality of the selected resample
+ * backend for common clock rate conversions.
+ */
+int resample_test(void)
+{
+    unsigned i, j;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  Resampling %dHz tone, usec per second of audio",
+	      TONE_FREQ));
+    PJ_LOG(3,(THIS_FILE, "  Filter  In    ->  Out       usec  SNR(dB)"));
+    PJ_LOG(3,(THIS_FILE, "  ---------------------------------------"));
+
+    for (i = 0; i < PJ_ARRAY_SIZE(qualities) && rc == 0; ++i) {
+	for (j = 0; j < PJ_ARRAY_SIZE(rates) && rc == 0; ++j) {
+	    rc = test_rate(i, rates[j].rate_in, rates[j].rate_out);
+	}
+    }
+
+    return rc;
+}
+
+#else
+
+int resample_test(void)
+{
+    return 0;
+}
+
+#endif	/* PJMEDIA_RESAMPLE_IMP != PJMEDIA_RESAMPLE_NONE */
@@ -0,0 +1,206 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE	"rtp_pkt_pool_test.c"
+
+#define BUF_SIZE	(PJMEDIA_MAX_MTU + PJMEDIA_STREAM_RESV_PAYLOAD_LEN)
+#define INIT_CNT	2
+#define MAX_CNT		4
+
+static int check_stat(pjmedia_rtp_pkt_pool *pp, unsigned capacity,
+		      unsigned in_use, unsigned max_in_use,
+		      unsigned acquire_cnt, unsigned fail_cnt)
+{
+    pjmedia_rtp_pkt_pool_stat stat;
+
+    pjmedia_rtp_pkt_pool_get_stat(pp, &stat);
+    if (stat.capacity != capacity || stat.in_use != in_use ||
+	stat.max_in_use != max_in_use || stat.acquire_cnt != acquire_cnt ||
+	stat.fail_cnt != fail_cnt)
+    {
+	PJ_LOG(3,(THIS_FILE, "    unexpected stat: capacity=%u in_use=%u "
+		  "max_in_use=%u acquire_cnt=%u fail_cnt=%u",
+		  stat.capacity, stat.in_use, stat.max_in_use,
+		  stat.acquire_cnt, stat.fail_cnt));
+	return -1;
+    }
+    return 0;
+}
+
+int rtp_pkt_pool_test(void)
+{
+    pj_pool_t *pool;
+    pjmedia_rtp_pkt_pool *pp;
+    pjmedia_rtp_pkt *pkt[MAX_CNT+1], *wpkt[MAX_CNT+1], *p;
+    char ext_buf[160];
+    unsigned i;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "Testing RTP packet pool"));
+
+    pool = pj_pool_create(mem, "pktpooltest", 1000, 1000, NULL);
+
+    status = pjmedia_rtp_pkt_pool_create(pool, NULL, BUF_SIZE, INIT_CNT,
+					 MAX_CNT, &pp);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(pool);
+	return -10;
+    }
+
+    if (check_stat(pp, INIT_CNT, 0, 0, 0, 0)) {
+	rc = -20;
+	goto on_return;
+    }
+
+    /* Acquire up to the maximum, the pool grows on demand */
+    for (i = 0; i < MAX_CNT; ++i) {
+	status = pjmedia_rtp_pkt_pool_acquire(pp, &pkt[i]);
+	if (status != PJ_SUCCESS) {
+	    rc = -30;
+	    goto on_return;
+	}
+	if (((pj_size_t)pkt[i]->buf & (PJMEDIA_RTP_PKT_POOL_ALIGN-1)) != 0 ||
+	    pkt[i]->size != BUF_SIZE || pkt[i]->len != 0 ||
+	    pkt[i]->ref_cnt != 1)
+	{
+	    rc = -40;
+	    goto on_return;
+	}
+	/* Buffers must be distinct and fully writable */
+	pj_memset(pkt[i]->buf, i, BUF_SIZE);
+    }
+    for (i = 0; i < MAX_CNT; ++i) {
+	if (((pj_uint8_t*)pkt[i]->buf)[0] != i ||
+	    ((pj_uint8_t*)pkt[i]->buf)[BUF_SIZE-1] != i)
+	{
+	    rc = -50;
+	    goto on_return;
+	}
+    }
+
+    /* The pool is exhausted now */
+    status = pjmedia_rtp_pkt_pool_acquire(pp, &pkt[MAX_CNT]);
+    if (status != PJ_ETOOMANY) {
+	rc = -60;
+	goto on_return;
+    }
+    if (check_stat(pp, MAX_CNT, MAX_CNT, MAX_CNT, MAX_CNT, 1)) {
+	rc = -70;
+	goto on_return;
+    }
+
+    /* A packet with another reference is not returned to the pool by
+     * the first release.
+     */
+    pjmedia_rtp_pkt_add_ref(pkt[0]);
+    pjmedia_rtp_pkt_dec_ref(pkt[0]);
+    if (pkt[0]->ref_cnt != 1 ||
+	check_stat(pp, MAX_CNT, MAX_CNT, MAX_CNT, MAX_CNT, 1))
+    {
+	rc = -80;
+	goto on_return;
+    }
+    pjmedia_rtp_pkt_dec_ref(pkt[0]);
+    if (check_stat(pp, MAX_CNT, MAX_CNT-1, MAX_CNT, MAX_CNT, 1)) {
+	rc = -90;
+	goto on_return;
+    }
+
+    /* The released buffer is reused */
+    p = pkt[0];
+    pkt[0] = NULL;
+    status = pjmedia_rtp_pkt_pool_acquire(pp, &pkt[0]);
+    if (status != PJ_SUCCESS || pkt[0] != p) {
+	rc = -100;
+	goto on_return;
+    }
+
+    for (i = 0; i < MAX_CNT; ++i) {
+	pjmedia_rtp_pkt_dec_ref(pkt[i]);
+	pkt[i] = NULL;
+    }
+    if (check_stat(pp, MAX_CNT, 0, MAX_CNT, MAX_CNT+1, 1)) {
+	rc = -110;
+	goto on_return;
+    }
+
+    /* Wrapping external buffers doesn't copy nor use the pool buffers */
+    pj_bzero(wpkt, sizeof(wpkt));
+    for (i = 0; i < MAX_CNT; ++i) {
+	status = pjmedia_rtp_pkt_pool_wrap(pp, ext_buf, sizeof(ext_buf),
+					   100, &wpkt[i]);
+	if (status != PJ_SUCCESS || wpkt[i]->buf != ext_buf ||
+	    wpkt[i]->size != sizeof(ext_buf) || wpkt[i]->len != 100 ||
+	    wpkt[i]->ref_cnt != 1)
+	{
+	    rc = -120;
+	    goto on_return;
+	}
+    }
+    status = pjmedia_rtp_pkt_pool_wrap(pp, ext_buf, sizeof(ext_buf), 100,
+				       &wpkt[MAX_CNT]);
+    if (status != PJ_ETOOMANY) {
+	rc = -130;
+	goto on_return;
+    }
+
+    /* Pool buffers are still available */
+    status = pjmedia_rtp_pkt_pool_acquire(pp, &pkt[0]);
+    if (status != PJ_SUCCESS || pkt[0]->buf == ext_buf) {
+	rc = -140;
+	goto on_return;
+    }
+    pjmedia_rtp_pkt_dec_ref(pkt[0]);
+    pkt[0] = NULL;
+
+    pjmedia_rtp_pkt_add_ref(wpkt[0]);
+    for (i = 0; i < MAX_CNT; ++i) {
+	pjmedia_rtp_pkt_dec_ref(wpkt[i]);
+    }
+    if (wpkt[0]->buf != ext_buf ||
+	check_stat(pp, MAX_CNT, 1, MAX_CNT+1, 2*MAX_CNT+2, 2))
+    {
+	rc = -150;
+	goto on_return;
+    }
+    pjmedia_rtp_pkt_dec_ref(wpkt[0]);
+    pj_bzero(wpkt, sizeof(wpkt));
+
+    /* Wrapped packets are reused, and don't keep the caller's buffer */
+    status = pjmedia_rtp_pkt_pool_wrap(pp, ext_buf, sizeof(ext_buf), 0, &p);
+    if (status != PJ_SUCCESS) {
+	rc = -160;
+	goto on_return;
+    }
+    pjmedia_rtp_pkt_dec_ref(p);
+    if (p->buf != NULL ||
+	check_stat(pp, MAX_CNT, 0, MAX_CNT+1, 2*MAX_CNT+3, 2))
+    {
+	rc = -170;
+	goto on_return;
+    }
+
+on_return:
+    /* Destroying the pool also frees packets left by failed tests */
+    pjmedia_rtp_pkt_pool_destroy(pp);
+    pj_pool_release(pool);
+    return rc;
+}
@@ -0,0 +1,220 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE   "srtp_test.c"
+
+#if PJMEDIA_HAS_SRTP
+
+/* Number of packets to protect for each crypto suite */
+#define PKT_CNT		20000
+
+/* Number of packets given to pjmedia_transport_srtp_encrypt_pkts() */
+#define BATCH_CNT	16
+
+/* RTP payload length, i.e: 20ms of G.711 */
+#define PAYLOAD_LEN	160
+
+/* Packet buffer size, with room for the SRTP trailer */
+#define PKT_BUF_LEN	(sizeof(pjmedia_rtp_hdr) + PAYLOAD_LEN + \
+			 PJMEDIA_SRTP_MAX_TRAILER_LEN)
+
+static struct crypto_test
+{
+    const char	*name;
+    unsigned	 key_len;
+} cryptos[] =
+{
+    { "AEAD_AES_256_GCM",	    44 },
+    { "AEAD_AES_256_GCM_8",	    44 },
+    { "AES_256_CM_HMAC_SHA1_80",    46 },
+    { "AES_256_CM_HMAC_SHA1_32",    46 },
+    { "AES_192_CM_HMAC_SHA1_80",    38 },
+    { "AES_192_CM_HMAC_SHA1_32",    38 },
+    { "AEAD_AES_128_GCM",	    28 },
+    { "AEAD_AES_128_GCM_8",	    28 },
+    { "AES_CM_128_HMAC_SHA1_80",    30 },
+    { "AES_CM_128_HMAC_SHA1_32",    30 },
+};
+
+/* Packet buffers, 32bit aligned */
+static pj_uint32_t pkt_buf[BATCH_CNT][(PKT_BUF_LEN + 3) / 4];
+static pj_uint8_t  orig_pkt[BATCH_CNT][PKT_BUF_LEN];
+
+
+static int test_crypto(pjmedia_endpt *endpt, const struct crypto_test *ct)
+{
+    pjmedia_transport *loop, *srtp;
+    pjmedia_srtp_setting opt;
+    pjmedia_srtp_crypto crypto;
+    pjmedia_rtp_session rtp;
+    pjmedia_srtp_pkt pkts[BATCH_CNT];
+    char key[64];
+    pj_timestamp t_enc, t_dec, t0, t1;
+    unsigned i, j, enc_rate, dec_rate;
+    pj_status_t status;
+    int rc = 0;
+
+    status = pjmedia_transport_loop_create(endpt, &loop);
+    if (status != PJ_SUCCESS)
+	return -10;
+
+    pjmedia_srtp_setting_default(&opt);
+    opt.close_member_tp = PJ_TRUE;
+    opt.use = PJMEDIA_SRTP_MANDATORY;
+
+    status = pjmedia_transport_srtp_create(endpt, loop, &opt, &srtp);
+    if (status != PJ_SUCCESS) {
+	pjmedia_transport_close(loop);
+	return -20;
+    }
+
+    for (i = 0; i < ct->key_len; ++i)
+	key[i] = (char)(pj_rand() & 0xFF);
+
+    pj_bzero(&crypto, sizeof(crypto));
+    crypto.name = pj_str((char*)ct->name);
+    pj_strset(&crypto.key, key, ct->key_len);
+
+    /* Use the same key for both directions, so the packets encrypted
+     * with the transport can be decrypted back with the same transport.
+     */
+    status = pjmedia_transport_srtp_start(srtp, &crypto, &crypto);
+    if (status == PJMEDIA_SRTP_ENOTSUPCRYPTO) {
+	/* Crypto suite is not enabled in this build */
+	pjmedia_transport_close(srtp);
+	return 0;
+    } else if (status != PJ_SUCCESS) {
+	app_perror(status, "  error starting SRTP");
+	pjmedia_transport_close(srtp);
+	return -30;
+    }
+
+    pjmedia_rtp_session_init(&rtp, 0, pj_rand());
+
+    t_enc.u64 = t_dec.u64 = 0;
+    for (i = 0; i < PKT_CNT; i += BATCH_CNT) {
+	/* Build a batch of RTP packets */
+	for (j = 0; j < BATCH_CNT; ++j) {
+	    const void *hdr;
+	    int hdr_len;
+
+	    pjmedia_rtp_encode_rtp(&rtp, 0, 0, PAYLOAD_LEN, PAYLOAD_LEN,
+				   &hdr, &hdr_len);
+	    pj_memcpy(orig_pkt[j], hdr, hdr_len);
+	    pj_memset(orig_pkt[j] + hdr_len, (i + j) & 0xFF, PAYLOAD_LEN);
+	    pj_memcpy(pkt_buf[j], orig_pkt[j], hdr_len + PAYLOAD_LEN);
+
+	    pkts[j].tp = srtp;
+	    pkts[j].is_rtp = PJ_TRUE;
+	    pkts[j].pkt = pkt_buf[j];
+	    pkts[j].len = hdr_len + PAYLOAD_LEN;
+	}
+
+	pj_get_timestamp(&t0);
+	status = pjmedia_transport_srtp_encrypt_pkts(BATCH_CNT, pkts);
+	pj_get_timestamp(&t1);
+	t_enc.u64 += (t1.u64 - t0.u64);
+
+	if (status != PJ_SUCCESS) {
+	    app_perror(status, "  error encrypting packets");
+	    rc = -40;
+	    goto on_return;
+	}
+
+	pj_get_timestamp(&t0);
+	for (j = 0; j < BATCH_CNT; ++j) {
+	    status = pjmedia_transport_srtp_decrypt_pkt(srtp, PJ_TRUE,
+							pkts[j].pkt,
+							&pkts[j].len);
+	    if (status != PJ_SUCCESS)
+		break;
+	}
+	pj_get_timestamp(&t1);
+	t_dec.u64 += (t1.u64 - t0.u64);
+
+	if (status != PJ_SUCCESS) {
+	    app_perror(status, "  error decrypting packets");
+	    rc = -50;
+	    goto on_return;
+	}
+
+	/* Verify the round trip */
+	for (j = 0; j < BATCH_CNT; ++j) {
+	    if (pkts[j].len != (int)(sizeof(pjmedia_rtp_hdr) + PAYLOAD_LEN) ||
+		pj_memcmp(pkts[j].pkt, orig_pkt[j], pkts[j].len) != 0)
+	    {
+		PJ_LOG(3,(THIS_FILE, "  error: decrypted packet mismatch"));
+		rc = -60;
+		goto on_return;
+	    }
+	}
+    }
+
+    t0.u64 = 0;
+    enc_rate = (unsigned)(PKT_CNT * 1000000.0 /
+			  PJ_MAX(pj_elapsed_usec(&t0, &t_enc), 1));
+    dec_rate = (unsigned)(PKT_CNT * 1000000.0 /
+			  PJ_MAX(pj_elapsed_usec(&t0, &t_dec), 1));
+    PJ_LOG(3,(THIS_FILE, "  %-26s %12u %12u", ct->name, enc_rate, dec_rate));
+
+on_return:
+    pjmedia_transport_close(srtp);
+    return rc;
+}
+
+/*
+ * Verify SRTP encryption/decryption round trip with all crypto suites,
+ * and measure the number of packets protected/unprotected per second.
+ */
+int srtp_test(void)
+{
+    pjmedia_endpt *endpt;
+    pj_status_t status;
+    unsigned i;
+    int rc = 0;
+
+    status = pjmedia_endpt_create(mem, NULL, 0, &endpt);
+    if (status != PJ_SUCCESS)
+	return -1;
+
+    PJ_LOG(3,(THIS_FILE, "  SRTP benchmark, %d bytes payload, batch of %d",
+	      PAYLOAD_LEN, BATCH_CNT));
+    PJ_LOG(3,(THIS_FILE, "  %-26s %12s %12s", "Crypto", "protect/s",
+	      "unprotect/s"));
+    PJ_LOG(3,(THIS_FILE, "  ----------------------------------------------------"));
+
+    for (i = 0; i < PJ_ARRAY_SIZE(cryptos); ++i) {
+	rc = test_crypto(endpt, &cryptos[i]);
+	if (rc != 0)
+	    break;
+    }
+
+    pjmedia_endpt_destroy(endpt);
+    return rc;
+}
+
+#else
+
+int srtp_test(void)
+{
+    return 0;
+}
+
+#endif	/* PJMEDIA_HAS_SRTP */
@@ -89,6 +89,10 @@ int test_main(void)
     DO_TEST(vid_codec_test());
 #endif
 
+#if HAS_VID_CONF_TEST
+    DO_TEST(vid_conf_test());
+#endif
+
 #if HAS_SDP_NEG_TEST
     DO_TEST(sdp_neg_test());
 #endif
@@ -104,6 +108,30 @@ int test_main(void)
 #if HAS_CODEC_VECTOR_TEST
     DO_TEST(codec_test_vectors());
 #endif
+#if HAS_CODEC_POOL_TEST
+    DO_TEST(codec_pool_test());
+#endif
+#if HAS_SRTP_TEST
+    DO_TEST(srtp_test());
+#endif
+#if HAS_RESAMPLE_TEST
+    DO_TEST(resample_test());
+#endif
+#if HAS_G711_TEST
+    DO_TEST(g711_test());
+#endif
+#if HAS_PLC_TEST
+    DO_TEST(plc_test());
+#endif
+#if HAS_CLOCK_TEST
+    DO_TEST(clock_test());
+#endif
+#if HAS_RTP_PKT_POOL_TEST
+    DO_TEST(rtp_pkt_pool_test());
+#endif
+#if HAS_CONF_TEST
+    DO_TEST(conf_test());
+#endif
 
     PJ_LOG(3,(THIS_FILE," "));
 
@@ -25,6 +25,7 @@
 
 #define HAS_VID_DEV_TEST	PJMEDIA_HAS_VIDEO
 #define HAS_VID_PORT_TEST	PJMEDIA_HAS_VIDEO
+#define HAS_VID_CONF_TEST	PJMEDIA_HAS_VIDEO
 #ifndef HAS_VID_CODEC_TEST
     #define HAS_VID_CODEC_TEST	PJMEDIA_HAS_VIDEO
 #endif
@@ -32,6 +33,14 @@
 #define HAS_JBUF_TEST		1
 #define HAS_MIPS_TEST		1
 #define HAS_CODEC_VECTOR_TEST	1
+#define HAS_CODEC_POOL_TEST	1
+#define HAS_SRTP_TEST		PJMEDIA_HAS_SRTP
+#define HAS_RESAMPLE_TEST	1
+#define HAS_G711_TEST		1
+#define HAS_PLC_TEST		1
+#define HAS_CLOCK_TEST		1
+#define HAS_RTP_PKT_POOL_TEST	1
+#define HAS_CONF_TEST		1
 
 int session_test(void);
 int rtp_test(void);
@@ -40,9 +49,18 @@ int jbuf_main(void);
 int sdp_neg_test(void);
 int mips_test(void);
 int codec_test_vectors(void);
+int codec_pool_test(void);
+int srtp_test(void);
+int resample_test(void);
+int g711_test(void);
+int plc_test(void);
+int clock_test(void);
+int rtp_pkt_pool_test(void);
+int conf_test(void);
 int vid_codec_test(void);
 int vid_dev_test(void);
 int vid_port_test(void);
+int vid_conf_test(void);
 
 extern pj_pool_factory *mem;
 void app_perror(pj_status_t status, const char *title);
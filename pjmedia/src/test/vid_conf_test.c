@@ -0,0 +1,216 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#if defined(PJMEDIA_HAS_VIDEO) && (PJMEDIA_HAS_VIDEO != 0)
+
+#define THIS_FILE	"vid_conf_test.c"
+
+/* Bridge and ports frame rate, all sinks are rendered in every tick */
+#define FPS		50
+
+/* Duration of each benchmark run, in msec */
+#define DURATION	1000
+
+/* Maximum number of ports */
+#define MAX_PORTS	16
+
+/* Source and sink frame size */
+#define SRC_W		1280
+#define SRC_H		720
+#define SINK_W		1280
+#define SINK_H		720
+
+static struct bench_state
+{
+    unsigned	    sink_cnt;	    /* Number of sinks			*/
+    pj_timestamp    cur_ts;	    /* Bridge timestamp of current tick	*/
+    pj_timestamp    t_start;	    /* Time the current tick started	*/
+    unsigned	    put_cnt;	    /* Sinks delivered in current tick	*/
+    unsigned	    frame_cnt;	    /* Number of complete ticks		*/
+    pj_timestamp    t_total;	    /* Total rendering time		*/
+} bench;
+
+
+static pj_status_t src_get_frame(pjmedia_port *port, pjmedia_frame *frame)
+{
+    PJ_UNUSED_ARG(port);
+
+    /* The first get_frame() of a tick marks the start of the tick */
+    if (frame->timestamp.u64 != bench.cur_ts.u64) {
+	bench.cur_ts = frame->timestamp;
+	bench.put_cnt = 0;
+	pj_get_timestamp(&bench.t_start);
+    }
+
+    /* Just reuse the frame content, the bridge doesn't care */
+    frame->type = PJMEDIA_FRAME_TYPE_VIDEO;
+    return PJ_SUCCESS;
+}
+
+static pj_status_t sink_put_frame(pjmedia_port *port, pjmedia_frame *frame)
+{
+    PJ_UNUSED_ARG(port);
+
+    if (frame->size == 0 || frame->timestamp.u64 != bench.cur_ts.u64)
+	return PJ_SUCCESS;
+
+    /* The last put_frame() of a tick marks the end of the tick */
+    if (++bench.put_cnt == bench.sink_cnt) {
+	pj_timestamp now;
+
+	pj_get_timestamp(&now);
+	bench.t_total.u64 += (now.u64 - bench.t_start.u64);
+	++bench.frame_cnt;
+    }
+
+    return PJ_SUCCESS;
+}
+
+static void init_port(pjmedia_port *port, const char *name, unsigned w,
+		      unsigned h)
+{
+    pjmedia_format fmt;
+    pj_str_t str_name = pj_str((char*)name);
+
+    pj_bzero(port, sizeof(*port));
+    pjmedia_format_init_video(&fmt, PJMEDIA_FORMAT_I420, w, h, FPS, 1);
+    pjmedia_port_info_init2(&port->info, &str_name, 0x1234,
+			    PJMEDIA_DIR_ENCODING_DECODING, &fmt);
+}
+
+/* Connect every source to every sink and measure the rendering time */
+static int bench_conf(pj_pool_t *pool, unsigned src_cnt, unsigned sink_cnt,
+		      unsigned worker_cnt)
+{
+    pjmedia_vid_conf_setting opt;
+    pjmedia_vid_conf *conf;
+    pjmedia_port ports[MAX_PORTS];
+    unsigned slots[MAX_PORTS];
+    unsigned i, j;
+    pj_status_t status;
+    int rc = 0;
+
+    pj_assert(src_cnt + sink_cnt <= MAX_PORTS);
+
+    pjmedia_vid_conf_setting_default(&opt);
+    opt.frame_rate = FPS;
+    opt.worker_cnt = worker_cnt;
+
+    status = pjmedia_vid_conf_create(pool, &opt, &conf);
+    if (status != PJ_SUCCESS)
+	return -10;
+
+    pj_bzero(&bench, sizeof(bench));
+    bench.sink_cnt = sink_cnt;
+    bench.cur_ts.u64 = (pj_uint64_t)-1;
+
+    for (i = 0; i < src_cnt + sink_cnt; ++i) {
+	pjmedia_port *port = &ports[i];
+
+	if (i < src_cnt) {
+	    init_port(port, "source", SRC_W, SRC_H);
+	    port->get_frame = &src_get_frame;
+	} else {
+	    init_port(port, "sink", SINK_W, SINK_H);
+	    port->put_frame = &sink_put_frame;
+	}
+
+	status = pjmedia_vid_conf_add_port(conf, pool, port, NULL, NULL,
+					   &slots[i]);
+	if (status != PJ_SUCCESS) {
+	    rc = -20;
+	    goto on_return;
+	}
+    }
+
+    for (i = 0; i < src_cnt; ++i) {
+	for (j = src_cnt; j < src_cnt + sink_cnt; ++j) {
+	    status = pjmedia_vid_conf_connect_port(conf, slots[i], slots[j],
+						   NULL);
+	    if (status != PJ_SUCCESS) {
+		rc = -30;
+		goto on_return;
+	    }
+	}
+    }
+
+    pj_thread_sleep(DURATION);
+
+on_return:
+    /* Destroy the bridge (and its clock) before reading the result */
+    pjmedia_vid_conf_destroy(conf);
+
+    if (rc == 0 && bench.frame_cnt == 0) {
+	PJ_LOG(3,(THIS_FILE, "  error: no frame rendered"));
+	rc = -40;
+    } else if (rc == 0) {
+	pj_timestamp zero;
+	pj_uint32_t usec;
+
+	zero.u64 = 0;
+	usec = pj_elapsed_usec(&zero, &bench.t_total) / bench.frame_cnt;
+	PJ_LOG(3,(THIS_FILE, "  %2dx%-2d %13d %7d %11d", sink_cnt, src_cnt,
+		  worker_cnt, bench.frame_cnt, usec));
+    }
+
+    return rc;
+}
+
+/*
+ * Benchmark the video conference bridge rendering, i.e: the time needed
+ * to render all sources into all sinks in one frame time.
+ */
+int vid_conf_test(void)
+{
+    static const struct {
+	unsigned src_cnt;
+	unsigned sink_cnt;
+    } configs[] =
+    {
+	{ 1, 1 },
+	{ 4, 1 },
+	{ 4, 4 },
+	{ 4, 8 },
+    };
+    unsigned worker_cnt[] = { 0, 2, 4 };
+    pj_pool_t *pool;
+    unsigned i, j;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "vidconftest", 1000, 1000, NULL);
+
+    PJ_LOG(3,(THIS_FILE, "  Video conference rendering, %dx%d sources to "
+	      "%dx%d sinks", SRC_W, SRC_H, SINK_W, SINK_H));
+    PJ_LOG(3,(THIS_FILE, "  sinks x sources workers  frames  usec/frame"));
+    PJ_LOG(3,(THIS_FILE, "  ------------------------------------------"));
+
+    for (i = 0; i < PJ_ARRAY_SIZE(configs) && rc == 0; ++i) {
+	for (j = 0; j < PJ_ARRAY_SIZE(worker_cnt) && rc == 0; ++j) {
+	    rc = bench_conf(pool, configs[i].src_cnt, configs[i].sink_cnt,
+			    worker_cnt[j]);
+	}
+    }
+
+    pj_pool_release(pool);
+    return rc;
+}
+
+
+#endif /* PJMEDIA_HAS_VIDEO */
@@ -133,6 +133,21 @@
 #endif
 
 
+/**
+ * Number of authentication keys cached by each STUN session, see
+ * #pj_stun_auth_cache. Each entry remembers the long term credential key
+ * derived from a username, realm, and password, and the precomputed
+ * HMAC-SHA1 key schedule of a MESSAGE-INTEGRITY key, so that requests,
+ * responses, and keep-alives using the same credential don't need to
+ * recalculate them. Set to zero to disable the cache.
+ *
+ * Default: 4
+ */
+#ifndef PJ_STUN_AUTH_CACHE_SIZE
+#   define PJ_STUN_AUTH_CACHE_SIZE		    4
+#endif
+
+
 /**
  * Enable pre-RFC3489bis-07 style of STUN MESSAGE-INTEGRITY and FINGERPRINT
  * calculation. By default this should be disabled since the calculation is
@@ -344,6 +359,19 @@
 #endif
 
 
+/**
+ * Default maximum number of connectivity checks that an ICE check pacer
+ * (see #pj_ice_sess_pacer_create()) may start in one tick, summed over
+ * all ICE sessions using the pacer. With the default tick interval of
+ * PJ_ICE_TA_VAL, this limits the pacer to 5000 checks per second.
+ *
+ * Default: 100
+ */
+#ifndef PJ_ICE_PACER_MAX_CHECKS
+#   define PJ_ICE_PACER_MAX_CHECKS		    100
+#endif
+
+
 /**
  * According to ICE Section 8.2. Updating States, if an In-Progress pair in 
  * the check list is for the same component as a nominated pair, the agent 
@@ -170,6 +170,9 @@ typedef struct pj_ice_sess pj_ice_sess;
 /** Forward declaration for pj_ice_sess_check */
 typedef struct pj_ice_sess_check pj_ice_sess_check;
 
+/** Forward declaration for pj_ice_sess_pacer */
+typedef struct pj_ice_sess_pacer pj_ice_sess_pacer;
+
 
 /**
  * This structure describes ICE component. 
@@ -607,9 +610,72 @@ typedef struct pj_ice_sess_options
      */
     int			controlled_agent_want_nom_timeout;
 
+    /**
+     * Optional connectivity check pacer. When set, the periodic checks of
+     * the session are started by the pacer, which serves all of its
+     * sessions from a single timer and limits the total number of checks
+     * started per tick, instead of by a timer of the session's own. See
+     * #pj_ice_sess_pacer_create(). The pacer must outlive the session.
+     *
+     * Default value is NULL (the session paces its own checks).
+     */
+    pj_ice_sess_pacer  *pacer;
+
 } pj_ice_sess_options;
 
 
+/**
+ * This structure describes the settings of ICE check pacer.
+ */
+typedef struct pj_ice_sess_pacer_cfg
+{
+    /**
+     * The tick interval, in msec. Each session served by the pacer starts
+     * at most one check per tick.
+     *
+     * Default value is PJ_ICE_TA_VAL.
+     */
+    unsigned		interval;
+
+    /**
+     * Maximum number of checks started in one tick, over all sessions.
+     * Sessions that don't get a turn in a tick are served first in the
+     * next tick.
+     *
+     * Default value is PJ_ICE_PACER_MAX_CHECKS.
+     */
+    unsigned		max_checks;
+
+} pj_ice_sess_pacer_cfg;
+
+
+/**
+ * This structure describes the statistics of ICE check pacer.
+ */
+typedef struct pj_ice_sess_pacer_stat
+{
+    unsigned		queue_cnt;	/**< # of sessions waiting now.	    */
+    unsigned		max_queue_cnt;	/**< Max # of sessions waiting.	    */
+    pj_uint32_t		tick_cnt;	/**< # of ticks run.		    */
+    pj_uint32_t		check_cnt;	/**< # of checks started.	    */
+    pj_uint32_t		defer_cnt;	/**< # of times a waiting session
+					     was deferred to the next tick
+					     because of max_checks.	    */
+} pj_ice_sess_pacer_stat;
+
+
+/**
+ * This structure is used by the check pacer to queue ICE session, and
+ * should not be used by application.
+ */
+typedef struct pj_ice_sess_pacer_entry
+{
+    PJ_DECL_LIST_MEMBER(struct pj_ice_sess_pacer_entry);
+    pj_ice_sess		*ice;		/**< The ICE session.		    */
+    pj_bool_t		 queued;	/**< Is it in the pacer queue?	    */
+} pj_ice_sess_pacer_entry;
+
+
 /**
  * This structure describes the ICE session. For this version of PJNATH,
  * an ICE session corresponds to a single media stream (unlike the ICE
@@ -672,6 +738,9 @@ struct pj_ice_sess
     
     /* Valid list */
     pj_ice_sess_checklist valid_list;		    /**< Valid list.	    */
+
+    /* Check pacer */
+    pj_ice_sess_pacer_entry pacer_entry;	    /**< Pacer queue entry  */
     
     /** Temporary buffer for misc stuffs to avoid using stack too much */
     union {
@@ -724,6 +793,57 @@ PJ_DECL(void) pj_ice_calc_foundation(pj_pool_t *pool,
  */
 PJ_DECL(void) pj_ice_sess_options_default(pj_ice_sess_options *opt);
 
+/**
+ * Initialize ICE check pacer settings with library default values.
+ *
+ * @param cfg		The pacer settings.
+ */
+PJ_DECL(void) pj_ice_sess_pacer_cfg_default(pj_ice_sess_pacer_cfg *cfg);
+
+/**
+ * Create ICE connectivity check pacer. A pacer is meant to be shared by
+ * many ICE sessions (e.g. all sessions of a media server), by setting it
+ * in the \a pacer field of #pj_ice_sess_options. Instead of each session
+ * running its own Ta timer, the pacer runs a single timer and in each tick
+ * starts the next check of the waiting sessions in round-robin order, up
+ * to the configured maximum number of checks per tick. This bounds the
+ * check packet rate and the timer heap load regardless of the number of
+ * sessions starting at the same time.
+ *
+ * @param stun_cfg	The STUN configuration, containing the pool factory
+ *			and the timer heap to be used by the pacer. The
+ *			timer heap must be the one used by the sessions.
+ * @param cfg		Optional pacer settings, if NULL the default
+ *			settings will be used.
+ * @param p_pacer	Pointer to receive the pacer instance.
+ *
+ * @return		PJ_SUCCESS on success, or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_ice_sess_pacer_create(pj_stun_config *stun_cfg,
+					      const pj_ice_sess_pacer_cfg *cfg,
+					      pj_ice_sess_pacer **p_pacer);
+
+/**
+ * Get the statistics of ICE check pacer.
+ *
+ * @param pacer		The pacer.
+ * @param stat		Pointer to receive the statistics.
+ *
+ * @return		PJ_SUCCESS on success, or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_ice_sess_pacer_get_stat(pj_ice_sess_pacer *pacer,
+						pj_ice_sess_pacer_stat *stat);
+
+/**
+ * Destroy ICE check pacer. Application must only destroy the pacer after
+ * all ICE sessions using it have been destroyed.
+ *
+ * @param pacer		The pacer.
+ *
+ * @return		PJ_SUCCESS on success, or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_ice_sess_pacer_destroy(pj_ice_sess_pacer *pacer);
+
 /**
  * Create ICE session with the specified role and number of components.
  * Application would typically need to create an ICE session before
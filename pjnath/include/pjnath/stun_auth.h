@@ -371,6 +371,73 @@ PJ_DECL(void) pj_stun_create_key(pj_pool_t *pool,
 				 pj_stun_passwd_type data_type,
 				 const pj_str_t *data);
 
+/**
+ * Opaque declaration of STUN authentication key cache. The cache keeps a
+ * small number of recently used keys, so that the long term credential
+ * key (the MD5 digest of the username, realm, and password) and the
+ * HMAC-SHA1 key schedule of the MESSAGE-INTEGRITY key don't have to be
+ * recalculated for every message authenticated with the same credential.
+ * Entries are looked up by the SHA-1 digest of the credential, hence a
+ * credential change never returns a stale key, and the password itself
+ * is not kept in the cache.
+ *
+ * The cache is not thread safe, the owner (such as the STUN session)
+ * must serialize the access.
+ */
+typedef struct pj_stun_auth_cache pj_stun_auth_cache;
+
+
+/**
+ * Create authentication key cache.
+ *
+ * @param pool		Pool to allocate the cache.
+ * @param size		Number of entries, for each of the long term key
+ *			and the HMAC-SHA1 key tables. Use
+ *			PJ_STUN_AUTH_CACHE_SIZE for the default.
+ * @param p_cache	Pointer to receive the cache.
+ *
+ * @return		PJ_SUCCESS on success or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_stun_auth_cache_create(pj_pool_t *pool,
+					       unsigned size,
+					       pj_stun_auth_cache **p_cache);
+
+/**
+ * Create authentication key, just like #pj_stun_create_key(), but take
+ * the long term credential key from the cache when the same username,
+ * realm, and password has been used recently.
+ *
+ * @param cache		The cache, or NULL to always calculate the key.
+ * @param pool		Pool to allocate memory for the key.
+ * @param key		String to receive the key.
+ * @param realm		The realm of the credential, if long term credential
+ *			is to be used.
+ * @param username	The username.
+ * @param data_type	Password encoding.
+ * @param data		The password.
+ */
+PJ_DECL(void) pj_stun_auth_cache_create_key(pj_stun_auth_cache *cache,
+					    pj_pool_t *pool,
+					    pj_str_t *key,
+					    const pj_str_t *realm,
+					    const pj_str_t *username,
+					    pj_stun_passwd_type data_type,
+					    const pj_str_t *data);
+
+/**
+ * Get the precomputed HMAC-SHA1 key schedule of the specified
+ * MESSAGE-INTEGRITY key, calculating it if it's not in the cache yet.
+ *
+ * @param cache		The cache.
+ * @param key		The key, as generated by #pj_stun_create_key().
+ *
+ * @return		The precomputed key. It is valid until the next
+ *			call to this function with the same cache.
+ */
+PJ_DECL(const pj_hmac_sha1_key*)
+pj_stun_auth_cache_get_hmac(pj_stun_auth_cache *cache, const pj_str_t *key);
+
+
 /**
  * Verify credential in the STUN request. Note that before calling this
  * function, application must have checked that the message contains
@@ -407,6 +474,37 @@ PJ_DECL(pj_status_t) pj_stun_authenticate_request(const pj_uint8_t *pkt,
 						  pj_stun_req_cred_info *info,
 					          pj_stun_msg **p_response);
 
+/**
+ * Variant of #pj_stun_authenticate_request() which uses the
+ * authentication key cache to derive the key and the HMAC-SHA1 key
+ * schedule of the credential.
+ *
+ * @param pkt		The original packet which has been parsed into
+ *			the message.
+ * @param pkt_len	The length of the packet.
+ * @param msg		The parsed message to be verified.
+ * @param cred		Pointer to credential to be used to authenticate
+ *			the message.
+ * @param cache		The authentication key cache, or NULL.
+ * @param pool		If response is to be created, then memory will
+ *			be allocated from this pool.
+ * @param info		Optional pointer to receive authentication
+ *			information.
+ * @param p_response	Optional pointer to receive the response message
+ *			then the credential in the request fails to
+ *			authenticate.
+ *
+ * @return		PJ_SUCCESS if credential is verified successfully.
+ */
+PJ_DECL(pj_status_t) pj_stun_authenticate_request2(const pj_uint8_t *pkt,
+						   unsigned pkt_len,
+						   const pj_stun_msg *msg,
+						   pj_stun_auth_cred *cred,
+						   pj_stun_auth_cache *cache,
+						   pj_pool_t *pool,
+						   pj_stun_req_cred_info *info,
+						   pj_stun_msg **p_response);
+
 
 /**
  * Determine if STUN message can be authenticated. Some STUN error
@@ -444,6 +542,24 @@ PJ_DECL(pj_status_t) pj_stun_authenticate_response(const pj_uint8_t *pkt,
 					           const pj_stun_msg *msg,
 					           const pj_str_t *key);
 
+/**
+ * Variant of #pj_stun_authenticate_response() which takes the key with
+ * its HMAC-SHA1 key schedule already precomputed.
+ *
+ * @param pkt		The original packet which has been parsed into
+ *			the message.
+ * @param pkt_len	The length of the packet.
+ * @param msg		The parsed message to be verified.
+ * @param hkey		The precomputed key, for example as returned by
+ *			#pj_stun_auth_cache_get_hmac().
+ *
+ * @return		PJ_SUCCESS if credential is verified successfully.
+ */
+PJ_DECL(pj_status_t) pj_stun_authenticate_response2(const pj_uint8_t *pkt,
+						    unsigned pkt_len,
+						    const pj_stun_msg *msg,
+						    const pj_hmac_sha1_key *hkey);
+
 
 /**
  * @}
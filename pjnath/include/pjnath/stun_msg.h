@@ -26,6 +26,7 @@
  */
 
 #include <pjnath/types.h>
+#include <pjlib-util/hmac_sha1.h>
 #include <pj/sock.h>
 
 
@@ -1391,6 +1392,30 @@ PJ_DECL(pj_status_t) pj_stun_msg_encode(pj_stun_msg *msg,
 					const pj_str_t *key,
 				        pj_size_t *p_msg_len);
 
+/**
+ * Variant of #pj_stun_msg_encode() which takes the MESSAGE-INTEGRITY key
+ * with its HMAC-SHA1 key schedule already precomputed, for example by
+ * #pj_stun_auth_cache_get_hmac(). This avoids hashing the key pads for
+ * every message sent with the same credential.
+ *
+ * @param msg		The STUN message to be printed.
+ * @param pkt_buf	The buffer to be filled with the packet.
+ * @param buf_size	Size of the buffer.
+ * @param options	Options, which currently must be zero.
+ * @param hkey		The precomputed key, must be specified if the
+ *			message contains MESSAGE-INTEGRITY attribute.
+ * @param p_msg_len	Upon return, it will be filed with the size of
+ *			the packet in bytes, or negative value on error.
+ *
+ * @return		PJ_SUCCESS on success or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_stun_msg_encode2(pj_stun_msg *msg,
+					 pj_uint8_t *pkt_buf,
+					 pj_size_t buf_size,
+					 unsigned options,
+					 const pj_hmac_sha1_key *hkey,
+					 pj_size_t *p_msg_len);
+
 /**
  * Check that the PDU is potentially a valid STUN message. This function
  * is useful when application needs to multiplex STUN packets with other
@@ -1837,6 +1862,223 @@ PJ_DECL(pj_status_t) pj_stun_msg_add_empty_attr(pj_pool_t *pool,
 						pj_stun_msg *msg,
 						int attr_type);
 
+
+/**
+ * This structure describes a STUN attribute referenced in place in the
+ * packet by #pj_stun_msg_view.
+ */
+typedef struct pj_stun_attr_view
+{
+    /**
+     * Attribute type, in host byte order.
+     */
+    pj_uint16_t		type;
+
+    /**
+     * Attribute value length, not including padding.
+     */
+    pj_uint16_t		length;
+
+    /**
+     * Pointer to the attribute value in the packet.
+     */
+    const pj_uint8_t   *value;
+
+} pj_stun_attr_view;
+
+
+/**
+ * This structure describes a STUN message parsed by
+ * #pj_stun_msg_view_parse(). Unlike #pj_stun_msg, the attributes are
+ * not decoded nor allocated, but referenced in place in the packet, so
+ * the packet must remain valid as long as the view is used. This is
+ * suitable for hot paths where only the header or a few attributes are
+ * needed, such as keep-alive and consent freshness traffic.
+ */
+typedef struct pj_stun_msg_view
+{
+    /**
+     * STUN message header, in host byte order.
+     */
+    pj_stun_msg_hdr	hdr;
+
+    /**
+     * The packet.
+     */
+    const pj_uint8_t   *pdu;
+
+    /**
+     * Number of attributes in the STUN message.
+     */
+    unsigned		attr_count;
+
+    /**
+     * Array of STUN attributes.
+     */
+    pj_stun_attr_view	attr[PJ_STUN_MAX_ATTR];
+
+} pj_stun_msg_view;
+
+
+/**
+ * Parse STUN packet into message view, without allocating memory nor
+ * decoding the attribute values.
+ *
+ * @param pdu		The packet to be parsed.
+ * @param pdu_len	The length of the packet.
+ * @param options	Parsing flags, according to pj_stun_decode_options.
+ *			If PJ_STUN_CHECK_PACKET is specified, the packet
+ *			is validated with #pj_stun_msg_check() first.
+ * @param view		The message view to be initialized.
+ *
+ * @return		PJ_SUCCESS if the packet has been parsed
+ *			successfully.
+ */
+PJ_DECL(pj_status_t) pj_stun_msg_view_parse(const pj_uint8_t *pdu,
+					    pj_size_t pdu_len,
+					    unsigned options,
+					    pj_stun_msg_view *view);
+
+/**
+ * Find STUN attribute in the STUN message view, starting from the
+ * specified index.
+ *
+ * @param view		The message view.
+ * @param attr_type	The attribute type to be found, from pj_stun_attr_type.
+ * @param start_index	The start index of the attribute in the message.
+ *
+ * @return		The attribute, or NULL if it cannot be found.
+ */
+PJ_DECL(const pj_stun_attr_view*)
+pj_stun_msg_view_find_attr(const pj_stun_msg_view *view,
+			   int attr_type,
+			   unsigned start_index);
+
+/**
+ * Get the value of 32bit integer attribute in the message view, such as
+ * PRIORITY or LIFETIME attribute.
+ *
+ * @param attr		The attribute.
+ * @param value		Pointer to receive the value, in host byte order.
+ *
+ * @return		PJ_SUCCESS on success, or PJNATH_ESTUNINATTRLEN
+ *			if the attribute length is not valid.
+ */
+PJ_DECL(pj_status_t) pj_stun_attr_view_get_uint(const pj_stun_attr_view *attr,
+						pj_uint32_t *value);
+
+/**
+ * Get the address of socket address attribute in the message view, such
+ * as MAPPED-ADDRESS or XOR-MAPPED-ADDRESS attribute. The XOR-ed address
+ * attributes are decoded accordingly.
+ *
+ * @param view		The message view.
+ * @param attr		The attribute.
+ * @param addr		Pointer to receive the address.
+ *
+ * @return		PJ_SUCCESS on success or the appropriate error code.
+ */
+PJ_DECL(pj_status_t)
+pj_stun_attr_view_get_sockaddr(const pj_stun_msg_view *view,
+			       const pj_stun_attr_view *attr,
+			       pj_sockaddr *addr);
+
+/**
+ * Verify the MESSAGE-INTEGRITY of the message view with the specified key,
+ * using the same rules as #pj_stun_authenticate_response().
+ *
+ * @param view		The message view.
+ * @param key		The key, as generated by #pj_stun_create_key().
+ *
+ * @return		PJ_SUCCESS if MESSAGE-INTEGRITY is present and valid,
+ *			or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_stun_msg_view_verify_msgint(const pj_stun_msg_view *view,
+						    const pj_str_t *key);
+
+
+/**
+ * This structure describes a pre-encoded STUN message, which can be
+ * rendered many times with different transaction IDs (for example the
+ * STUN Binding requests of an ICE check or keep-alive). Only the
+ * transaction ID, MESSAGE-INTEGRITY and FINGERPRINT are recalculated on
+ * each render, instead of encoding every attribute again.
+ */
+typedef struct pj_stun_msg_tmpl
+{
+    /**
+     * The encoded message.
+     */
+    pj_uint8_t	       *pdu;
+
+    /**
+     * Length of the encoded message.
+     */
+    unsigned		pdu_len;
+
+    /**
+     * Offset of MESSAGE-INTEGRITY attribute in the message, or zero if
+     * the message doesn't have one.
+     */
+    unsigned		msgint_pos;
+
+    /**
+     * Offset of FINGERPRINT attribute in the message, or zero if the
+     * message doesn't have one.
+     */
+    unsigned		fingerprint_pos;
+
+    /**
+     * The key to calculate MESSAGE-INTEGRITY.
+     */
+    pj_str_t		key;
+
+    /**
+     * The precomputed HMAC-SHA1 key schedule of the key.
+     */
+    pj_hmac_sha1_key	hkey;
+
+} pj_stun_msg_tmpl;
+
+
+/**
+ * Create message template from STUN message. The message must not contain
+ * attributes whose encoding depends on the transaction ID, i.e. XOR-ed
+ * IPv6 address attributes.
+ *
+ * @param pool		Pool to allocate the template.
+ * @param msg		The STUN message.
+ * @param key		The key to calculate MESSAGE-INTEGRITY, must be
+ *			specified if the message contains MESSAGE-INTEGRITY
+ *			attribute.
+ * @param p_tmpl	Pointer to receive the template.
+ *
+ * @return		PJ_SUCCESS on success or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_stun_msg_tmpl_create(pj_pool_t *pool,
+					     pj_stun_msg *msg,
+					     const pj_str_t *key,
+					     pj_stun_msg_tmpl **p_tmpl);
+
+/**
+ * Render the message template with the specified transaction ID. The
+ * result is identical to encoding the original message with that
+ * transaction ID with #pj_stun_msg_encode().
+ *
+ * @param tmpl		The template.
+ * @param tsx_id	The transaction ID.
+ * @param buf		Buffer to receive the encoded message.
+ * @param buf_size	Size of the buffer.
+ * @param p_msg_len	Pointer to receive the length of the message.
+ *
+ * @return		PJ_SUCCESS on success or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_stun_msg_tmpl_render(const pj_stun_msg_tmpl *tmpl,
+					     const pj_uint8_t tsx_id[12],
+					     pj_uint8_t *buf,
+					     pj_size_t buf_size,
+					     pj_size_t *p_msg_len);
+
 /**
  * @}
  */
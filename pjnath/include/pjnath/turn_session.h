@@ -453,6 +453,28 @@ typedef struct pj_turn_session_info
      */
     int		    lifetime;
 
+    /**
+     * Number of data packets sent to peers through the relay, either
+     * with ChannelData or Send Indication.
+     */
+    pj_uint32_t	    tx_pkt_cnt;
+
+    /**
+     * Number of payload bytes sent to peers through the relay.
+     */
+    pj_uint32_t	    tx_bytes;
+
+    /**
+     * Number of data packets received from peers through the relay,
+     * either with ChannelData or Data Indication.
+     */
+    pj_uint32_t	    rx_pkt_cnt;
+
+    /**
+     * Number of payload bytes received from peers through the relay.
+     */
+    pj_uint32_t	    rx_bytes;
+
 } pj_turn_session_info;
 
 
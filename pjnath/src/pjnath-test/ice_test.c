@@ -124,6 +124,9 @@ static void ice_on_ice_complete(pj_ice_strans *ice_st,
 			        pj_status_t status);
 static void destroy_sess(struct test_sess *sess, unsigned wait_msec);
 
+/* Check pacer to be used by the ICE stream transports, if any */
+static pj_ice_sess_pacer *test_pacer;
+
 #if USE_IPV6
 
 static pj_bool_t enable_ipv6_test()
@@ -241,6 +244,7 @@ static int create_ice_strans(struct test_sess *test_sess,
     pj_memcpy(&ice_cfg.stun_cfg, test_sess->stun_cfg, sizeof(pj_stun_config));
     if ((ept->cfg.enable_stun & SRV)==SRV || (ept->cfg.enable_turn & SRV)==SRV)
 	ice_cfg.resolver = test_sess->resolver;
+    ice_cfg.opt.pacer = test_pacer;
 
     if (flag & CLIENT_IPV4) {
 	set_stun_turn_cfg(ept, &ice_cfg, serveripv4, PJ_FALSE);
@@ -1136,6 +1140,49 @@ int ice_test(void)
 	}
     }
 
+    /* Test with check pacer, allowing only one check per tick for both
+     * endpoints, so the sessions must take turn.
+     */
+    {
+	struct sess_cfg_t *cfg = &sess_cfg[PJ_ARRAY_SIZE(sess_cfg)-1];
+	pj_ice_sess_pacer_cfg pacer_cfg;
+	pj_ice_sess_pacer_stat stat;
+
+	PJ_LOG(3,(THIS_FILE, "  %s with check pacer", cfg->title));
+
+	pj_ice_sess_pacer_cfg_default(&pacer_cfg);
+	pacer_cfg.max_checks = 1;
+	rc = pj_ice_sess_pacer_create(&stun_cfg, &pacer_cfg, &test_pacer);
+	if (rc != PJ_SUCCESS) {
+	    rc = -100;
+	    goto on_return;
+	}
+
+	cfg->ua1.answer_delay = cfg->ua2.answer_delay = 50;
+	cfg->ua1.role = ROLE1;
+	cfg->ua2.role = ROLE2;
+	cfg->ua1.comp_cnt = cfg->ua2.comp_cnt = 2;
+	rc = perform_test("Controlled/Controlling, 1 check per tick",
+			  &stun_cfg, cfg->server_flag, &cfg->ua1, &cfg->ua2);
+
+	pj_ice_sess_pacer_get_stat(test_pacer, &stat);
+	pj_ice_sess_pacer_destroy(test_pacer);
+	test_pacer = NULL;
+
+	if (rc != 0)
+	    goto on_return;
+
+	PJ_LOG(3,(THIS_FILE, INDENT "pacer: %d ticks, %d checks, "
+		  "%d deferred, max %d waiting", stat.tick_cnt,
+		  stat.check_cnt, stat.defer_cnt, stat.max_queue_cnt));
+
+	if (stat.check_cnt == 0 || stat.check_cnt > stat.tick_cnt) {
+	    PJ_LOG(3,(THIS_FILE, INDENT "err: pacer exceeded its budget"));
+	    rc = -110;
+	    goto on_return;
+	}
+    }
+
 on_return:
     destroy_stun_config(&stun_cfg);
     pj_pool_release(pool);
@@ -957,6 +957,333 @@ static int handle_unknown_non_mandatory(void)
 }
 
 
+/* Address attributes with invalid length or family must be rejected by
+ * the view without reading past the attribute.
+ */
+static int malformed_view_test(void)
+{
+    static const struct
+    {
+	pj_uint8_t	 family;
+	pj_uint16_t	 length;
+	pj_status_t	 expected;
+    } attrs[] =
+    {
+	{ 1, 0, PJNATH_ESTUNINATTRLEN },
+	{ 1, 2, PJNATH_ESTUNINATTRLEN },
+	{ 1, 20, PJNATH_ESTUNINATTRLEN },
+	{ 2, 8, PJNATH_ESTUNINATTRLEN },
+	{ 3, 8, PJNATH_EINVAF },
+    };
+    pj_uint8_t buf[200];
+    pj_stun_msg_view view;
+    pj_sockaddr addr;
+    unsigned i, len;
+    pj_status_t status;
+
+    /* Binding response header */
+    pj_bzero(buf, sizeof(buf));
+    buf[0] = 0x01; buf[1] = 0x01;
+    buf[4] = 0x21; buf[5] = 0x12; buf[6] = 0xA4; buf[7] = 0x42;
+    len = 20;
+
+    /* XOR-MAPPED-ADDRESS attributes, zero filled */
+    for (i=0; i<PJ_ARRAY_SIZE(attrs); ++i) {
+	buf[len+0] = 0x00; buf[len+1] = 0x20;
+	buf[len+2] = 0; buf[len+3] = (pj_uint8_t)attrs[i].length;
+	if (attrs[i].length >= 2)
+	    buf[len+5] = attrs[i].family;
+	len += 4 + ((attrs[i].length + 3) & ~3);
+    }
+    buf[3] = (pj_uint8_t)(len - 20);
+
+    status = pj_stun_msg_view_parse(buf, len, PJ_STUN_IS_DATAGRAM, &view);
+    if (status != PJ_SUCCESS || view.attr_count != PJ_ARRAY_SIZE(attrs)) {
+	PJ_LOG(1,(THIS_FILE, "    error parsing malformed attributes"));
+	return -4700;
+    }
+
+    for (i=0; i<view.attr_count; ++i) {
+	status = pj_stun_attr_view_get_sockaddr(&view, &view.attr[i], &addr);
+	if (status != attrs[i].expected) {
+	    PJ_LOG(1,(THIS_FILE, "    error: malformed attribute %d "
+		      "accepted", i));
+	    return -4710;
+	}
+    }
+
+    return 0;
+}
+
+
+/* Parse message with view and render message template */
+static int msg_view_test(void)
+{
+    pj_pool_t *pool = pj_pool_create(mem, "msgview", 1000, 1000, NULL);
+    struct test_vector *v = &test_vectors[0];
+    pj_uint8_t tsx_id[12] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+    pj_stun_msg_view view;
+    const pj_stun_attr_view *attr;
+    pj_stun_msg_tmpl *tmpl;
+    pj_stun_msg *msg;
+    pj_sockaddr addr[3], tmp_addr;
+    pj_uint8_t buf[600], buf2[600];
+    pj_str_t key, s1, s2, r;
+    pj_size_t len, len2;
+    pj_uint32_t val;
+    unsigned i;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  message view and template"));
+
+    pj_stun_create_key(pool, &key, pj_cstr(&r, v->realm),
+		       pj_cstr(&s1, v->username), PJ_STUN_PASSWD_PLAIN,
+		       pj_cstr(&s2, v->password));
+
+    /* Parse and authenticate the test vector */
+    status = pj_stun_msg_view_parse((pj_uint8_t*)v->pdu, v->pdu_len,
+				    PJ_STUN_IS_DATAGRAM | PJ_STUN_CHECK_PACKET,
+				    &view);
+    if (status != PJ_SUCCESS) {
+	app_perror("    error parsing view", status);
+	rc = -4510;
+	goto on_return;
+    }
+
+    if (view.hdr.type != v->msg_type || view.attr_count != 5 ||
+	pj_memcmp(view.hdr.tsx_id, v->tsx_id, 12))
+    {
+	PJ_LOG(1,(THIS_FILE, "    error: invalid message view"));
+	rc = -4520;
+	goto on_return;
+    }
+
+    attr = pj_stun_msg_view_find_attr(&view, PJ_STUN_ATTR_PRIORITY, 0);
+    if (!attr || pj_stun_attr_view_get_uint(attr, &val) != PJ_SUCCESS ||
+	val != 0x6e0001ff)
+    {
+	PJ_LOG(1,(THIS_FILE, "    error: invalid PRIORITY"));
+	rc = -4530;
+	goto on_return;
+    }
+
+    if (pj_stun_msg_view_verify_msgint(&view, &key) != PJ_SUCCESS) {
+	PJ_LOG(1,(THIS_FILE, "    error: MESSAGE-INTEGRITY check failed"));
+	rc = -4540;
+	goto on_return;
+    }
+
+    /* Tampered message must fail authentication */
+    pj_memcpy(buf, v->pdu, v->pdu_len);
+    buf[24] ^= 0x01;
+    pj_stun_msg_view_parse(buf, v->pdu_len, PJ_STUN_IS_DATAGRAM, &view);
+    if (pj_stun_msg_view_verify_msgint(&view, &key) == PJ_SUCCESS) {
+	PJ_LOG(1,(THIS_FILE, "    error: tampered message authenticated"));
+	rc = -4550;
+	goto on_return;
+    }
+
+    /* Template rendered with the tsx ID of the test vector must
+     * produce the test vector.
+     */
+    msg = v->create(pool, v);
+    if (msg == NULL) {
+	rc = -4560;
+	goto on_return;
+    }
+
+    status = pj_stun_msg_tmpl_create(pool, msg, &key, &tmpl);
+    if (status != PJ_SUCCESS) {
+	app_perror("    error creating template", status);
+	rc = -4570;
+	goto on_return;
+    }
+
+    status = pj_stun_msg_tmpl_render(tmpl, (pj_uint8_t*)v->tsx_id,
+				     buf, sizeof(buf), &len);
+    if (status != PJ_SUCCESS || len != v->pdu_len ||
+	cmp_buf(buf, (pj_uint8_t*)v->pdu, (unsigned)len) != (unsigned)-1)
+    {
+	PJ_LOG(1,(THIS_FILE, "    error: template rendering mismatch"));
+	rc = -4580;
+	goto on_return;
+    }
+
+    /* And with another tsx ID, must be the same as encoding the message */
+    pj_stun_msg_tmpl_render(tmpl, tsx_id, buf, sizeof(buf), &len);
+    pj_memcpy(msg->hdr.tsx_id, tsx_id, sizeof(tsx_id));
+    pj_stun_msg_encode(msg, buf2, sizeof(buf2), 0, &key, &len2);
+    if (len != len2 || cmp_buf(buf, buf2, (unsigned)len) != (unsigned)-1) {
+	PJ_LOG(1,(THIS_FILE, "    error: template rendering mismatch (2)"));
+	rc = -4590;
+	goto on_return;
+    }
+
+    /* Address attributes */
+    pj_sockaddr_parse(pj_AF_INET(), 0, pj_cstr(&s1, "192.0.2.1:32853"),
+		      &addr[0]);
+    pj_sockaddr_parse(pj_AF_INET(), 0, pj_cstr(&s1, "192.0.2.2:3478"),
+		      &addr[1]);
+
+    pj_stun_msg_create(pool, PJ_STUN_BINDING_RESPONSE, PJ_STUN_MAGIC,
+		       tsx_id, &msg);
+    pj_stun_msg_add_sockaddr_attr(pool, msg, PJ_STUN_ATTR_XOR_MAPPED_ADDR,
+				  PJ_TRUE, &addr[0], sizeof(addr[0]));
+    pj_stun_msg_add_sockaddr_attr(pool, msg, PJ_STUN_ATTR_MAPPED_ADDR,
+				  PJ_FALSE, &addr[1], sizeof(addr[1]));
+#if USE_IPV6
+    pj_sockaddr_parse(pj_AF_INET6(), 0,
+		      pj_cstr(&s1, "[2001:db8:1234:5678:11:2233:4455:6677]:32853"),
+		      &addr[2]);
+    pj_stun_msg_add_sockaddr_attr(pool, msg, PJ_STUN_ATTR_XOR_MAPPED_ADDR,
+				  PJ_TRUE, &addr[2], sizeof(addr[2]));
+#endif
+    pj_stun_msg_encode(msg, buf, sizeof(buf), 0, NULL, &len);
+
+    status = pj_stun_msg_view_parse(buf, len, PJ_STUN_IS_DATAGRAM, &view);
+    if (status != PJ_SUCCESS || view.attr_count != msg->attr_count) {
+	PJ_LOG(1,(THIS_FILE, "    error parsing address attributes"));
+	rc = -4600;
+	goto on_return;
+    }
+
+    for (i=0; i<view.attr_count; ++i) {
+	status = pj_stun_attr_view_get_sockaddr(&view, &view.attr[i],
+						&tmp_addr);
+	if (status != PJ_SUCCESS || pj_sockaddr_cmp(&tmp_addr, &addr[i])) {
+	    PJ_LOG(1,(THIS_FILE, "    error: address attribute %d mismatch",
+		      i));
+	    rc = -4610;
+	    goto on_return;
+	}
+    }
+
+#if USE_IPV6
+    /* Template doesn't support XOR-ed IPv6 address */
+    if (pj_stun_msg_tmpl_create(pool, msg, NULL, &tmpl) != PJ_ENOTSUP) {
+	PJ_LOG(1,(THIS_FILE, "    error: expecting PJ_ENOTSUP"));
+	rc = -4620;
+	goto on_return;
+    }
+#endif
+
+    rc = malformed_view_test();
+
+on_return:
+    pj_pool_release(pool);
+    return rc;
+}
+
+
+/* Authentication key cache must give the same results as without cache */
+static int auth_cache_test(void)
+{
+    pj_pool_t *pool = pj_pool_create(mem, "authcache", 1000, 1000, NULL);
+    struct test_vector *v = &test_vectors[0];
+    pj_stun_auth_cache *cache;
+    pj_stun_auth_cred cred;
+    const pj_hmac_sha1_key *hkey;
+    pj_stun_msg *msg;
+    pj_uint8_t buf[600];
+    pj_str_t key, key2, realm, user, passwd;
+    pj_size_t len;
+    unsigned i, round;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  authentication key cache"));
+
+    /* Small cache, so that entries get evicted */
+    status = pj_stun_auth_cache_create(pool, 2, &cache);
+    if (status != PJ_SUCCESS) {
+	rc = -5010;
+	goto on_return;
+    }
+
+    /* Long term keys, cycling through more credentials than the cache size */
+    for (round=0; round<3; ++round) {
+	for (i=0; i<3; ++i) {
+	    char username[16];
+
+	    pj_ansi_snprintf(username, sizeof(username), "user%d", i);
+	    pj_cstr(&user, username);
+	    pj_cstr(&realm, (i==2 ? "\"realm\"" : "realm"));
+	    pj_cstr(&passwd, "secret");
+
+	    pj_stun_create_key(pool, &key, &realm, &user,
+			       PJ_STUN_PASSWD_PLAIN, &passwd);
+	    pj_stun_auth_cache_create_key(cache, pool, &key2, &realm, &user,
+					  PJ_STUN_PASSWD_PLAIN, &passwd);
+	    if (pj_strcmp(&key, &key2)) {
+		PJ_LOG(1,(THIS_FILE, "    error: long term key mismatch"));
+		rc = -5020;
+		goto on_return;
+	    }
+	}
+    }
+
+    /* Short term key is the password */
+    pj_stun_auth_cache_create_key(cache, pool, &key, NULL,
+				  pj_cstr(&user, v->username),
+				  PJ_STUN_PASSWD_PLAIN,
+				  pj_cstr(&passwd, v->password));
+    if (pj_strcmp(&key, &passwd)) {
+	PJ_LOG(1,(THIS_FILE, "    error: short term key mismatch"));
+	rc = -5030;
+	goto on_return;
+    }
+
+    /* Encoding with the cached key schedule must match the test vector */
+    hkey = pj_stun_auth_cache_get_hmac(cache, &key);
+    msg = v->create(pool, v);
+    status = pj_stun_msg_encode2(msg, buf, sizeof(buf), 0, hkey, &len);
+    if (status != PJ_SUCCESS || len != v->pdu_len ||
+	pj_memcmp(buf, v->pdu, len))
+    {
+	PJ_LOG(1,(THIS_FILE, "    error: encoding with cached key mismatch"));
+	rc = -5040;
+	goto on_return;
+    }
+
+    status = pj_stun_authenticate_response2(buf, (unsigned)len, msg, hkey);
+    if (status != PJ_SUCCESS) {
+	rc = -5050;
+	goto on_return;
+    }
+
+    /* Authenticate request, twice so that the second one hits the cache */
+    pj_bzero(&cred, sizeof(cred));
+    cred.type = PJ_STUN_AUTH_CRED_STATIC;
+    cred.data.static_cred.username = pj_str(v->username);
+    cred.data.static_cred.data = pj_str(v->password);
+
+    for (round=0; round<2; ++round) {
+	status = pj_stun_authenticate_request2(buf, (unsigned)len, msg, &cred,
+					       cache, pool, NULL, NULL);
+	if (status != PJ_SUCCESS) {
+	    PJ_LOG(1,(THIS_FILE, "    error: request authentication failed"));
+	    rc = -5060;
+	    goto on_return;
+	}
+    }
+
+    /* Changed password must not be satisfied by the cached key */
+    cred.data.static_cred.data = pj_str("wrong password");
+    status = pj_stun_authenticate_request2(buf, (unsigned)len, msg, &cred,
+					   cache, pool, NULL, NULL);
+    if (status == PJ_SUCCESS) {
+	PJ_LOG(1,(THIS_FILE, "    error: wrong password accepted"));
+	rc = -5070;
+	goto on_return;
+    }
+
+on_return:
+    pj_pool_release(pool);
+    return rc;
+}
+
+
 int stun_test(void)
 {
     int pad, rc;
@@ -984,3 +1311,212 @@ on_return:
     return rc;
 }
 
+
+int stun_view_test(void)
+{
+    int pad, rc;
+
+    /* The test vectors use space for padding */
+    pad = pj_stun_set_padding_char(32);
+    rc = msg_view_test();
+    pj_stun_set_padding_char(pad);
+
+    return rc;
+}
+
+
+int stun_auth_cache_test(void)
+{
+    int pad, rc;
+
+    /* The test vectors use space for padding */
+    pad = pj_stun_set_padding_char(32);
+    rc = auth_cache_test();
+    pj_stun_set_padding_char(pad);
+
+    return rc;
+}
+
+
+
+/* Number of iterations of the benchmark */
+#define PERF_LOOP   100000
+
+/*
+ * Compare the speed of full decoding and encoding of STUN message with the
+ * message view and template, and authentication with and without the
+ * authentication key cache.
+ */
+int stun_perf_test(void)
+{
+    pj_pool_t *pool = pj_pool_create(mem, "stunperf", 4000, 4000, NULL);
+    struct test_vector *v = &test_vectors[0];
+    pj_uint8_t tsx_id[12];
+    pj_stun_msg_view view;
+    pj_stun_msg_tmpl *tmpl;
+    pj_stun_auth_cache *cache;
+    pj_stun_auth_cred cred;
+    pj_pool_t *auth_pool;
+    pj_stun_msg *msg, *rx_msg;
+    pj_uint8_t buf[600], buf2[600];
+    pj_str_t key, s1, s2, r;
+    pj_timestamp t0, t1;
+    pj_uint32_t usec[7];
+    pj_size_t len, len2;
+    unsigned i;
+    pj_status_t status;
+    int rc = 0;
+
+    pj_stun_create_key(pool, &key, pj_cstr(&r, v->realm),
+		       pj_cstr(&s1, v->username), PJ_STUN_PASSWD_PLAIN,
+		       pj_cstr(&s2, v->password));
+    pj_stun_auth_cache_create(pool, PJ_STUN_AUTH_CACHE_SIZE, &cache);
+
+    /* Decode */
+    pj_get_timestamp(&t0);
+    for (i=0; i<PERF_LOOP; ++i) {
+	pj_pool_t *tmp_pool = pj_pool_create(mem, "decode", 1000, 1000, NULL);
+
+	status = pj_stun_msg_decode(tmp_pool, (pj_uint8_t*)v->pdu, v->pdu_len,
+				    PJ_STUN_IS_DATAGRAM | PJ_STUN_CHECK_PACKET,
+				    &msg, NULL, NULL);
+	pj_pool_release(tmp_pool);
+	if (status != PJ_SUCCESS) {
+	    rc = -10;
+	    goto on_return;
+	}
+    }
+    pj_get_timestamp(&t1);
+    usec[0] = pj_elapsed_usec(&t0, &t1);
+
+    /* Parse view */
+    pj_get_timestamp(&t0);
+    for (i=0; i<PERF_LOOP; ++i) {
+	status = pj_stun_msg_view_parse((pj_uint8_t*)v->pdu, v->pdu_len,
+					PJ_STUN_IS_DATAGRAM |
+					  PJ_STUN_CHECK_PACKET,
+					&view);
+	if (status != PJ_SUCCESS) {
+	    rc = -20;
+	    goto on_return;
+	}
+    }
+    pj_get_timestamp(&t1);
+    usec[1] = pj_elapsed_usec(&t0, &t1);
+
+    /* Encode, with new tsx ID each time */
+    msg = v->create(pool, v);
+    pj_bzero(tsx_id, sizeof(tsx_id));
+    pj_get_timestamp(&t0);
+    for (i=0; i<PERF_LOOP; ++i) {
+	pj_memcpy(tsx_id, &i, sizeof(i));
+	pj_memcpy(msg->hdr.tsx_id, tsx_id, sizeof(tsx_id));
+	status = pj_stun_msg_encode(msg, buf, sizeof(buf), 0, &key, &len);
+	if (status != PJ_SUCCESS) {
+	    rc = -30;
+	    goto on_return;
+	}
+    }
+    pj_get_timestamp(&t1);
+    usec[2] = pj_elapsed_usec(&t0, &t1);
+
+    /* Render template */
+    status = pj_stun_msg_tmpl_create(pool, msg, &key, &tmpl);
+    if (status != PJ_SUCCESS) {
+	rc = -40;
+	goto on_return;
+    }
+    pj_get_timestamp(&t0);
+    for (i=0; i<PERF_LOOP; ++i) {
+	pj_memcpy(tsx_id, &i, sizeof(i));
+	status = pj_stun_msg_tmpl_render(tmpl, tsx_id, buf2, sizeof(buf2),
+					 &len2);
+	if (status != PJ_SUCCESS) {
+	    rc = -50;
+	    goto on_return;
+	}
+    }
+    pj_get_timestamp(&t1);
+    usec[3] = pj_elapsed_usec(&t0, &t1);
+
+    /* The last rendered message must be the same as the last encoded */
+    if (len != len2 || pj_memcmp(buf, buf2, len)) {
+	PJ_LOG(1,(THIS_FILE, "    error: template rendering mismatch"));
+	rc = -60;
+	goto on_return;
+    }
+
+    /* Encode with the key schedule from the cache, as STUN session does */
+    pj_get_timestamp(&t0);
+    for (i=0; i<PERF_LOOP; ++i) {
+	pj_memcpy(msg->hdr.tsx_id, &i, sizeof(i));
+	status = pj_stun_msg_encode2(msg, buf2, sizeof(buf2), 0,
+				     pj_stun_auth_cache_get_hmac(cache, &key),
+				     &len2);
+	if (status != PJ_SUCCESS) {
+	    rc = -70;
+	    goto on_return;
+	}
+    }
+    pj_get_timestamp(&t1);
+    usec[4] = pj_elapsed_usec(&t0, &t1);
+
+    if (len != len2 || pj_memcmp(buf, buf2, len)) {
+	PJ_LOG(1,(THIS_FILE, "    error: cached key encoding mismatch"));
+	rc = -80;
+	goto on_return;
+    }
+
+    /* Authenticate the request, without and with the key cache */
+    status = pj_stun_msg_decode(pool, (pj_uint8_t*)v->pdu, v->pdu_len,
+				PJ_STUN_IS_DATAGRAM | PJ_STUN_CHECK_PACKET,
+				&rx_msg, NULL, NULL);
+    if (status != PJ_SUCCESS) {
+	rc = -90;
+	goto on_return;
+    }
+
+    pj_bzero(&cred, sizeof(cred));
+    cred.type = PJ_STUN_AUTH_CRED_STATIC;
+    cred.data.static_cred.username = pj_str(v->username);
+    cred.data.static_cred.data = pj_str(v->password);
+
+    auth_pool = pj_pool_create(mem, "auth", 1000, 1000, NULL);
+    for (i=0; i<2; ++i) {
+	pj_stun_auth_cache *c = (i==0 ? NULL : cache);
+	unsigned j;
+
+	pj_get_timestamp(&t0);
+	for (j=0; j<PERF_LOOP; ++j) {
+	    pj_pool_reset(auth_pool);
+	    status = pj_stun_authenticate_request2((pj_uint8_t*)v->pdu,
+						   v->pdu_len, rx_msg, &cred,
+						   c, auth_pool, NULL, NULL);
+	    if (status != PJ_SUCCESS)
+		break;
+	}
+	pj_get_timestamp(&t1);
+	usec[5+i] = pj_elapsed_usec(&t0, &t1);
+
+	if (status != PJ_SUCCESS) {
+	    pj_pool_release(auth_pool);
+	    rc = -100;
+	    goto on_return;
+	}
+    }
+    pj_pool_release(auth_pool);
+
+    PJ_LOG(3,(THIS_FILE, "  STUN Binding request with MESSAGE-INTEGRITY and "
+	      "FINGERPRINT, %d iterations:", PERF_LOOP));
+    PJ_LOG(3,(THIS_FILE, "    decode:          %6d usec", usec[0]));
+    PJ_LOG(3,(THIS_FILE, "    view parse:      %6d usec", usec[1]));
+    PJ_LOG(3,(THIS_FILE, "    encode:          %6d usec", usec[2]));
+    PJ_LOG(3,(THIS_FILE, "    template render: %6d usec", usec[3]));
+    PJ_LOG(3,(THIS_FILE, "    encode (cached): %6d usec", usec[4]));
+    PJ_LOG(3,(THIS_FILE, "    authenticate:    %6d usec", usec[5]));
+    PJ_LOG(3,(THIS_FILE, "    auth (cached):   %6d usec", usec[6]));
+
+on_return:
+    pj_pool_release(pool);
+    return rc;
+}
@@ -218,6 +218,18 @@ static int test_inner(void)
     DO_TEST(sess_auth_test());
 #endif
 
+#if INCLUDE_STUN_VIEW_TEST
+    DO_TEST(stun_view_test());
+#endif
+
+#if INCLUDE_STUN_AUTH_CACHE_TEST
+    DO_TEST(stun_auth_cache_test());
+#endif
+
+#if INCLUDE_STUN_PERF_TEST
+    DO_TEST(stun_perf_test());
+#endif
+
 #if INCLUDE_ICE_TEST
     DO_TEST(ice_test());
 #endif
@@ -230,6 +242,10 @@ static int test_inner(void)
     DO_TEST(turn_sock_test());
 #endif
 
+#if INCLUDE_TURN_SESS_TEST
+    DO_TEST(turn_sess_test());
+#endif
+
 #if INCLUDE_CONCUR_TEST
     DO_TEST(concur_test());
 #endif
@@ -22,9 +22,13 @@
 #include <pjnath.h>
 
 #define INCLUDE_STUN_TEST	    0
+#define INCLUDE_STUN_VIEW_TEST	    1
+#define INCLUDE_STUN_AUTH_CACHE_TEST 1
+#define INCLUDE_STUN_PERF_TEST	    0
 #define INCLUDE_ICE_TEST	    1
 #define INCLUDE_STUN_SOCK_TEST	    0
 #define INCLUDE_TURN_SOCK_TEST	    0
+#define INCLUDE_TURN_SESS_TEST	    1
 #define INCLUDE_CONCUR_TEST    	    0
 
 #define GET_AF(use_ipv6) (use_ipv6?pj_AF_INET6():pj_AF_INET())
@@ -42,9 +46,13 @@
 #endif
 
 int stun_test(void);
+int stun_view_test(void);
+int stun_auth_cache_test(void);
+int stun_perf_test(void);
 int sess_auth_test(void);
 int stun_sock_test(void);
 int turn_sock_test(void);
+int turn_sess_test(void);
 int ice_test(void);
 int concur_test(void);
 int test_main(void);
@@ -0,0 +1,277 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+/*
+ * TURN client session test, without TURN server and sockets. The test
+ * answers the requests sent by the session itself.
+ */
+
+#define THIS_FILE	"turn_sess_test.c"
+
+/* Number of permissions that stay installed during the churn */
+#define LIVE_PERM_CNT	4
+
+/* Number of permissions added and deleted in the churn, and the round
+ * after which the memory usage must be stable.
+ */
+#define CHURN_CNT	2000
+#define WARMUP_CNT	200
+
+/* Completed STUN transactions are destroyed after 300 ms, poll a bit longer
+ * before checking the memory usage.
+ */
+#define TSX_DESTROY_WAIT 400
+
+static struct
+{
+    pj_turn_state_t	 state;
+    pj_uint8_t		 tx_pkt[1000];
+    unsigned		 tx_len;
+} g;
+
+static pj_status_t turn_on_send_pkt(pj_turn_session *sess,
+				    const pj_uint8_t *pkt,
+				    unsigned pkt_len,
+				    const pj_sockaddr_t *dst_addr,
+				    unsigned addr_len)
+{
+    PJ_UNUSED_ARG(sess);
+    PJ_UNUSED_ARG(dst_addr);
+    PJ_UNUSED_ARG(addr_len);
+
+    if (pkt_len > sizeof(g.tx_pkt))
+	return PJ_ETOOBIG;
+
+    pj_memcpy(g.tx_pkt, pkt, pkt_len);
+    g.tx_len = pkt_len;
+    return PJ_SUCCESS;
+}
+
+static void turn_on_state(pj_turn_session *sess,
+			  pj_turn_state_t old_state,
+			  pj_turn_state_t new_state)
+{
+    PJ_UNUSED_ARG(sess);
+    PJ_UNUSED_ARG(old_state);
+
+    g.state = new_state;
+}
+
+/* Answer the last request sent by the session */
+static pj_status_t respond(pj_turn_session *sess, int err_code)
+{
+    pj_pool_t *pool;
+    pj_stun_msg *req, *resp;
+    pj_uint8_t buf[1000];
+    pj_size_t len;
+    pj_status_t status;
+
+    if (g.tx_len == 0)
+	return PJ_ENOTFOUND;
+
+    pool = pj_pool_create(mem, "turnresp", 1000, 1000, NULL);
+
+    status = pj_stun_msg_decode(pool, g.tx_pkt, g.tx_len,
+				PJ_STUN_IS_DATAGRAM | PJ_STUN_CHECK_PACKET,
+				&req, NULL, NULL);
+    g.tx_len = 0;
+    if (status != PJ_SUCCESS)
+	goto on_return;
+
+    status = pj_stun_msg_create_response(pool, req, err_code, NULL, &resp);
+    if (status != PJ_SUCCESS)
+	goto on_return;
+
+    if (req->hdr.type == PJ_STUN_ALLOCATE_REQUEST) {
+	pj_sockaddr relay_addr;
+	pj_str_t s;
+
+	pj_sockaddr_parse(pj_AF_INET(), 0, pj_cstr(&s, "192.0.2.1:49152"),
+			  &relay_addr);
+	pj_stun_msg_add_sockaddr_attr(pool, resp,
+				      PJ_STUN_ATTR_XOR_RELAYED_ADDR, PJ_TRUE,
+				      &relay_addr, sizeof(relay_addr));
+	pj_stun_msg_add_uint_attr(pool, resp, PJ_STUN_ATTR_LIFETIME, 600);
+    }
+
+    status = pj_stun_msg_encode(resp, buf, sizeof(buf), 0, NULL, &len);
+    if (status == PJ_SUCCESS)
+	status = pj_turn_session_on_rx_pkt(sess, buf, len, NULL);
+
+on_return:
+    pj_pool_release(pool);
+    return status;
+}
+
+/* Install permission for the peer and answer the CreatePermission */
+static pj_status_t set_perm(pj_turn_session *sess, pj_uint32_t ip,
+			    int err_code)
+{
+    pj_sockaddr addr;
+    pj_status_t status;
+
+    pj_sockaddr_init(pj_AF_INET(), &addr, NULL, 0);
+    addr.ipv4.sin_addr.s_addr = pj_htonl(ip);
+
+    status = pj_turn_session_set_perm(sess, 1, &addr, 1);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    return respond(sess, err_code);
+}
+
+/*
+ * Permissions that the server rejects are deleted by the session. Adding
+ * and deleting them must not grow the memory usage of the session, and
+ * must not lose the other permissions.
+ */
+static int perm_churn_test(pj_stun_config *stun_cfg)
+{
+    pj_caching_pool cp;
+    pj_stun_config sess_cfg;
+    pj_turn_session_cb cb;
+    pj_turn_alloc_param alloc_param;
+    pj_turn_session *sess;
+    pj_size_t used_size = 0;
+    pj_str_t srv;
+    unsigned i;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  permission add/delete churn"));
+
+    pj_bzero(&g, sizeof(g));
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_send_pkt = &turn_on_send_pkt;
+    cb.on_state = &turn_on_state;
+
+    /* The session gets its own pool factory, so that only its memory is
+     * measured (the timer heap grows with the pending transactions).
+     */
+    pj_caching_pool_init(&cp, NULL, 0);
+    sess_cfg = *stun_cfg;
+    sess_cfg.pf = &cp.factory;
+
+    status = pj_turn_session_create(&sess_cfg, "turnsess", pj_AF_INET(),
+				    PJ_TURN_TP_UDP, NULL, &cb, 0, NULL,
+				    &sess);
+    if (status != PJ_SUCCESS) {
+	pj_caching_pool_destroy(&cp);
+	return -10;
+    }
+
+    status = pj_turn_session_set_server(sess, pj_cstr(&srv, "127.0.0.1"),
+					3478, NULL);
+    if (status != PJ_SUCCESS || g.state != PJ_TURN_STATE_RESOLVED) {
+	rc = -20;
+	goto on_return;
+    }
+
+    pj_turn_alloc_param_default(&alloc_param);
+    status = pj_turn_session_alloc(sess, &alloc_param);
+    if (status == PJ_SUCCESS)
+	status = respond(sess, 0);
+    if (status != PJ_SUCCESS || g.state != PJ_TURN_STATE_READY) {
+	app_perror("    error allocating", status);
+	rc = -30;
+	goto on_return;
+    }
+
+    for (i = 0; i < LIVE_PERM_CNT; ++i) {
+	if (set_perm(sess, 0x0A000001 + i, 0) != PJ_SUCCESS) {
+	    rc = -40;
+	    goto on_return;
+	}
+    }
+
+    for (i = 0; i < CHURN_CNT; ++i) {
+	unsigned j;
+
+	/* New permission, rejected by the server */
+	status = set_perm(sess, 0xC6336400 + i, PJ_STUN_SC_FORBIDDEN);
+	if (status != PJ_SUCCESS) {
+	    rc = -50;
+	    goto on_return;
+	}
+
+	/* The installed permissions must still be found, otherwise new
+	 * ones would be created and the memory usage grows.
+	 */
+	for (j = 0; j < LIVE_PERM_CNT; ++j) {
+	    if (set_perm(sess, 0x0A000001 + j, 0) != PJ_SUCCESS) {
+		rc = -60;
+		goto on_return;
+	    }
+	}
+
+	if (i == WARMUP_CNT) {
+	    poll_events(stun_cfg, TSX_DESTROY_WAIT, PJ_FALSE);
+	    used_size = cp.used_size;
+	}
+    }
+
+    poll_events(stun_cfg, TSX_DESTROY_WAIT, PJ_FALSE);
+    if (cp.used_size > used_size) {
+	PJ_LOG(3,(THIS_FILE, "    error: memory usage grows from %lu to "
+		  "%lu bytes", (unsigned long)used_size,
+		  (unsigned long)cp.used_size));
+	rc = -70;
+	goto on_return;
+    }
+
+    if (g.state != PJ_TURN_STATE_READY) {
+	rc = -80;
+	goto on_return;
+    }
+
+on_return:
+    pj_turn_session_destroy(sess, PJ_SUCCESS);
+    poll_events(stun_cfg, TSX_DESTROY_WAIT, PJ_FALSE);
+    pj_caching_pool_destroy(&cp);
+    return rc;
+}
+
+int turn_sess_test(void)
+{
+    pj_pool_t *pool;
+    pj_stun_config stun_cfg;
+    struct pjlib_state pjlib_state;
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "TURN client session test"));
+
+    pool = pj_pool_create(mem, "turnsesstest", 4000, 4000, NULL);
+    rc = create_stun_config(pool, &stun_cfg);
+    if (rc != PJ_SUCCESS) {
+	pj_pool_release(pool);
+	return -1;
+    }
+
+    capture_pjlib_state(&stun_cfg, &pjlib_state);
+
+    rc = perm_churn_test(&stun_cfg);
+
+    if (rc == 0)
+	rc = check_pjlib_state(&stun_cfg, &pjlib_state);
+
+    destroy_stun_config(&stun_cfg);
+    pj_pool_release(pool);
+    return rc;
+}
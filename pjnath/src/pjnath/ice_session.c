@@ -23,6 +23,8 @@
 #include <pj/assert.h>
 #include <pj/guid.h>
 #include <pj/hash.h>
+#include <pj/list.h>
+#include <pj/lock.h>
 #include <pj/log.h>
 #include <pj/os.h>
 #include <pj/pool.h>
@@ -126,6 +128,24 @@ typedef struct timer_data
 } timer_data;
 
 
+/* ICE connectivity check pacer. The pacer lock is never held while
+ * acquiring the group lock of a session, so sessions may call the pacer
+ * with their group lock held.
+ */
+struct pj_ice_sess_pacer
+{
+    pj_pool_t		    *pool;	/* Pool.			    */
+    pj_timer_heap_t	    *timer_heap;/* Timer heap.			    */
+    pj_lock_t		    *lock;	/* Lock protecting the queue.	    */
+    pj_ice_sess_pacer_cfg    cfg;	/* Settings.			    */
+    pj_timer_entry	     timer;	/* The tick timer.		    */
+    pj_bool_t		     in_tick;	/* Tick is running.		    */
+    pj_ice_sess_pacer_entry  queue;	/* Sessions waiting for a turn.	    */
+    pj_ice_sess		   **batch;	/* Sessions served in current tick. */
+    pj_ice_sess_pacer_stat   stat;	/* Statistics.			    */
+};
+
+
 /* This is the data that will be attached as token to outgoing
  * STUN messages.
  */
@@ -143,6 +163,8 @@ static pj_status_t start_periodic_check(pj_timer_heap_t *th,
 static void start_nominated_check(pj_ice_sess *ice);
 static void periodic_timer(pj_timer_heap_t *th, 
 			  pj_timer_entry *te);
+static void pacer_enqueue(pj_ice_sess_pacer *pacer, pj_ice_sess *ice);
+static void pacer_dequeue(pj_ice_sess_pacer *pacer, pj_ice_sess *ice);
 static void handle_incoming_check(pj_ice_sess *ice,
 				  const pj_ice_rx_check *rcheck);
 
@@ -323,6 +345,7 @@ PJ_DEF(void) pj_ice_sess_options_default(pj_ice_sess_options *opt)
     opt->nominated_check_delay = PJ_ICE_NOMINATED_CHECK_DELAY;
     opt->controlled_agent_want_nom_timeout = 
 	ICE_CONTROLLED_AGENT_WAIT_NOMINATION_TIMEOUT;
+    opt->pacer = NULL;
 }
 
 /*
@@ -359,6 +382,8 @@ PJ_DEF(pj_status_t) pj_ice_sess_create(pj_stun_config *stun_cfg,
     pj_ice_sess_options_default(&ice->opt);
 
     pj_timer_entry_init(&ice->timer, TIMER_NONE, (void*)ice, &on_timer);
+    pj_list_init(&ice->pacer_entry);
+    ice->pacer_entry.ice = ice;
 
     pj_ansi_snprintf(ice->obj_name, sizeof(ice->obj_name),
 		     name, ice);
@@ -503,6 +528,9 @@ static void destroy_ice(pj_ice_sess *ice,
                                    &ice->clist.timer,
                                    PJ_FALSE);
 
+    if (ice->opt.pacer)
+	pacer_dequeue(ice->opt.pacer, ice);
+
     pj_grp_lock_dec_ref(ice->grp_lock);
     pj_grp_lock_release(ice->grp_lock);
 }
@@ -1860,32 +1888,17 @@ static pj_status_t perform_check(pj_ice_sess *ice,
 }
 
 
-/* Start periodic check for the specified checklist.
- * This callback is called by timer on every Ta (20msec by default)
+/* Start the next check of the checklist, i.e: the check with highest
+ * priority in Waiting state, or in Frozen state if there is none.
+ * Returns PJ_TRUE if a check was started, meaning that the checklist
+ * should be scheduled again after Ta. Group lock must be held.
  */
-static pj_status_t start_periodic_check(pj_timer_heap_t *th, 
-					pj_timer_entry *te)
+static pj_bool_t perform_periodic_check(pj_ice_sess *ice,
+					pj_ice_sess_checklist *clist)
 {
-    timer_data *td;
-    pj_ice_sess *ice;
-    pj_ice_sess_checklist *clist;
     unsigned i, start_count=0;
     pj_status_t status;
 
-    td = (struct timer_data*) te->user_data;
-    ice = td->ice;
-    clist = td->clist;
-
-    pj_grp_lock_acquire(ice->grp_lock);
-
-    if (ice->is_destroying) {
-	pj_grp_lock_release(ice->grp_lock);
-	return PJ_SUCCESS;
-    }
-
-    /* Set timer ID to FALSE first */
-    te->id = PJ_FALSE;
-
     /* Set checklist state to Running */
     clist_set_state(ice, clist, PJ_ICE_SESS_CHECKLIST_ST_RUNNING);
 
@@ -1932,9 +1945,38 @@ static pj_status_t start_periodic_check(pj_timer_heap_t *th,
 	}
     }
 
+    pj_log_pop_indent();
+    return start_count != 0;
+}
+
+
+/* Start periodic check for the specified checklist.
+ * This callback is called by timer on every Ta (20msec by default)
+ */
+static pj_status_t start_periodic_check(pj_timer_heap_t *th, 
+					pj_timer_entry *te)
+{
+    timer_data *td;
+    pj_ice_sess *ice;
+    pj_ice_sess_checklist *clist;
+
+    td = (struct timer_data*) te->user_data;
+    ice = td->ice;
+    clist = td->clist;
+
+    pj_grp_lock_acquire(ice->grp_lock);
+
+    if (ice->is_destroying) {
+	pj_grp_lock_release(ice->grp_lock);
+	return PJ_SUCCESS;
+    }
+
+    /* Set timer ID to FALSE first */
+    te->id = PJ_FALSE;
+
     /* Cannot start check because there's no suitable candidate pair.
      */
-    if (start_count!=0) {
+    if (perform_periodic_check(ice, clist)) {
 	/* Schedule for next timer */
 	pj_time_val timeout = {0, PJ_ICE_TA_VAL};
 
@@ -1944,7 +1986,6 @@ static pj_status_t start_periodic_check(pj_timer_heap_t *th,
     }
 
     pj_grp_lock_release(ice->grp_lock);
-    pj_log_pop_indent();
     return PJ_SUCCESS;
 }
 
@@ -1992,16 +2033,20 @@ static void start_nominated_check(pj_ice_sess *ice)
     }
 
     /* And (re)start the periodic check */
-    pj_timer_heap_cancel_if_active(ice->stun_cfg.timer_heap,
-                                   &ice->clist.timer, PJ_FALSE);
-
-    delay.sec = delay.msec = 0;
-    status = pj_timer_heap_schedule_w_grp_lock(ice->stun_cfg.timer_heap,
-                                               &ice->clist.timer, &delay,
-                                               PJ_TRUE,
-                                               ice->grp_lock);
-    if (status == PJ_SUCCESS) {
-	LOG5((ice->obj_name, "Periodic timer rescheduled.."));
+    if (ice->opt.pacer) {
+	pacer_enqueue(ice->opt.pacer, ice);
+    } else {
+	pj_timer_heap_cancel_if_active(ice->stun_cfg.timer_heap,
+				       &ice->clist.timer, PJ_FALSE);
+
+	delay.sec = delay.msec = 0;
+	status = pj_timer_heap_schedule_w_grp_lock(ice->stun_cfg.timer_heap,
+						   &ice->clist.timer, &delay,
+						   PJ_TRUE,
+						   ice->grp_lock);
+	if (status == PJ_SUCCESS) {
+	    LOG5((ice->obj_name, "Periodic timer rescheduled.."));
+	}
     }
 
     ice->is_nominating = PJ_TRUE;
@@ -2016,6 +2061,226 @@ static void periodic_timer(pj_timer_heap_t *th,
 }
 
 
+/* Schedule pacer tick. Pacer lock must be held. */
+static void pacer_schedule(pj_ice_sess_pacer *pacer, unsigned msec)
+{
+    pj_time_val delay;
+
+    if (pacer->in_tick || pacer->timer.id != PJ_FALSE)
+	return;
+
+    delay.sec = 0;
+    delay.msec = msec;
+    pj_time_val_normalize(&delay);
+    pj_timer_heap_schedule_w_grp_lock(pacer->timer_heap, &pacer->timer,
+				      &delay, PJ_TRUE, NULL);
+}
+
+/* Queue the session to get its turn in the next pacer tick. Does nothing
+ * if the session is already queued.
+ */
+static void pacer_enqueue(pj_ice_sess_pacer *pacer, pj_ice_sess *ice)
+{
+    pj_lock_acquire(pacer->lock);
+
+    if (!ice->pacer_entry.queued) {
+	pj_list_push_back(&pacer->queue, &ice->pacer_entry);
+	ice->pacer_entry.queued = PJ_TRUE;
+	if (++pacer->stat.queue_cnt > pacer->stat.max_queue_cnt)
+	    pacer->stat.max_queue_cnt = pacer->stat.queue_cnt;
+    }
+
+    /* Start ticking if the pacer is idle. Otherwise the running tick will
+     * reschedule the timer when it's done.
+     */
+    pacer_schedule(pacer, 0);
+
+    pj_lock_release(pacer->lock);
+}
+
+/* Remove the session from the pacer queue */
+static void pacer_dequeue(pj_ice_sess_pacer *pacer, pj_ice_sess *ice)
+{
+    pj_lock_acquire(pacer->lock);
+
+    if (ice->pacer_entry.queued) {
+	pj_list_erase(&ice->pacer_entry);
+	ice->pacer_entry.queued = PJ_FALSE;
+	--pacer->stat.queue_cnt;
+    }
+
+    pj_lock_release(pacer->lock);
+}
+
+/* Pacer tick: start the next check of up to max_checks waiting sessions.
+ * The checks are started after the sessions are taken out of the queue,
+ * so the pacer lock is not held while acquiring the sessions' group lock.
+ */
+static void pacer_on_timer(pj_timer_heap_t *th, pj_timer_entry *te)
+{
+    pj_ice_sess_pacer *pacer = (pj_ice_sess_pacer*) te->user_data;
+    unsigned i, cnt = 0, check_cnt = 0;
+
+    PJ_UNUSED_ARG(th);
+
+    pj_lock_acquire(pacer->lock);
+
+    te->id = PJ_FALSE;
+    pacer->in_tick = PJ_TRUE;
+    ++pacer->stat.tick_cnt;
+
+    while (cnt < pacer->cfg.max_checks && !pj_list_empty(&pacer->queue)) {
+	pj_ice_sess_pacer_entry *entry = pacer->queue.next;
+
+	pj_list_erase(entry);
+	entry->queued = PJ_FALSE;
+	pj_grp_lock_add_ref(entry->ice->grp_lock);
+	pacer->batch[cnt++] = entry->ice;
+    }
+    pacer->stat.queue_cnt -= cnt;
+    pacer->stat.defer_cnt += pacer->stat.queue_cnt;
+
+    pj_lock_release(pacer->lock);
+
+    for (i=0; i<cnt; ++i) {
+	pj_ice_sess *ice = pacer->batch[i];
+
+	pj_grp_lock_acquire(ice->grp_lock);
+
+	/* The session may have been queued again (e.g. nominated check is
+	 * started) while it was waiting for its turn. In that case just
+	 * wait for the next tick.
+	 */
+	if (!ice->is_destroying && !ice->pacer_entry.queued &&
+	    ice->clist.count > 0)
+	{
+	    if (perform_periodic_check(ice, &ice->clist)) {
+		++check_cnt;
+
+		/* Queue again for the next check in the next tick */
+		pacer_enqueue(pacer, ice);
+	    }
+	}
+
+	pj_grp_lock_release(ice->grp_lock);
+	pj_grp_lock_dec_ref(ice->grp_lock);
+    }
+
+    pj_lock_acquire(pacer->lock);
+
+    pacer->stat.check_cnt += check_cnt;
+    pacer->in_tick = PJ_FALSE;
+    if (!pj_list_empty(&pacer->queue))
+	pacer_schedule(pacer, pacer->cfg.interval);
+
+    pj_lock_release(pacer->lock);
+}
+
+
+/*
+ * Initialize pacer settings with default values.
+ */
+PJ_DEF(void) pj_ice_sess_pacer_cfg_default(pj_ice_sess_pacer_cfg *cfg)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->interval = PJ_ICE_TA_VAL;
+    cfg->max_checks = PJ_ICE_PACER_MAX_CHECKS;
+}
+
+
+/*
+ * Create ICE check pacer.
+ */
+PJ_DEF(pj_status_t) pj_ice_sess_pacer_create(pj_stun_config *stun_cfg,
+					     const pj_ice_sess_pacer_cfg *cfg,
+					     pj_ice_sess_pacer **p_pacer)
+{
+    pj_pool_t *pool;
+    pj_ice_sess_pacer *pacer;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(stun_cfg && stun_cfg->pf && stun_cfg->timer_heap &&
+		     p_pacer, PJ_EINVAL);
+
+    pool = pj_pool_create(stun_cfg->pf, "icepacer%p", 512, 512, NULL);
+    if (!pool)
+	return PJ_ENOMEM;
+
+    pacer = PJ_POOL_ZALLOC_T(pool, pj_ice_sess_pacer);
+    pacer->pool = pool;
+    pacer->timer_heap = stun_cfg->timer_heap;
+
+    if (cfg)
+	pj_memcpy(&pacer->cfg, cfg, sizeof(*cfg));
+    else
+	pj_ice_sess_pacer_cfg_default(&pacer->cfg);
+
+    if (pacer->cfg.interval == 0)
+	pacer->cfg.interval = PJ_ICE_TA_VAL;
+    if (pacer->cfg.max_checks == 0)
+	pacer->cfg.max_checks = PJ_ICE_PACER_MAX_CHECKS;
+
+    status = pj_lock_create_recursive_mutex(pool, pool->obj_name,
+					    &pacer->lock);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(pool);
+	return status;
+    }
+
+    pacer->batch = (pj_ice_sess**)
+		   pj_pool_calloc(pool, pacer->cfg.max_checks,
+				  sizeof(pj_ice_sess*));
+    pj_list_init(&pacer->queue);
+    pj_timer_entry_init(&pacer->timer, PJ_FALSE, pacer, &pacer_on_timer);
+
+    PJ_LOG(4,(pool->obj_name, "ICE check pacer created, interval=%dms, "
+	      "max %d checks/tick", pacer->cfg.interval,
+	      pacer->cfg.max_checks));
+
+    *p_pacer = pacer;
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Get pacer statistics.
+ */
+PJ_DEF(pj_status_t) pj_ice_sess_pacer_get_stat(pj_ice_sess_pacer *pacer,
+					       pj_ice_sess_pacer_stat *stat)
+{
+    PJ_ASSERT_RETURN(pacer && stat, PJ_EINVAL);
+
+    pj_lock_acquire(pacer->lock);
+    pj_memcpy(stat, &pacer->stat, sizeof(*stat));
+    pj_lock_release(pacer->lock);
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Destroy ICE check pacer.
+ */
+PJ_DEF(pj_status_t) pj_ice_sess_pacer_destroy(pj_ice_sess_pacer *pacer)
+{
+    PJ_ASSERT_RETURN(pacer, PJ_EINVAL);
+
+    pj_lock_acquire(pacer->lock);
+
+    /* All sessions should have been destroyed */
+    pj_assert(pj_list_empty(&pacer->queue));
+
+    pj_timer_heap_cancel_if_active(pacer->timer_heap, &pacer->timer,
+				   PJ_FALSE);
+    pj_lock_release(pacer->lock);
+
+    pj_lock_destroy(pacer->lock);
+    pj_pool_release(pacer->pool);
+
+    return PJ_SUCCESS;
+}
+
+
 /* Utility: find string in string array */
 static const pj_str_t *find_str(const pj_str_t *strlist[], unsigned count,
 				const pj_str_t *str)
@@ -2134,12 +2399,17 @@ PJ_DEF(pj_status_t) pj_ice_sess_start_check(pj_ice_sess *ice)
      * instead to reduce stack usage:
      * return start_periodic_check(ice->stun_cfg.timer_heap, &clist->timer);
      */
-    delay.sec = delay.msec = 0;
-    status = pj_timer_heap_schedule_w_grp_lock(ice->stun_cfg.timer_heap,
-                                               &clist->timer, &delay,
-                                               PJ_TRUE, ice->grp_lock);
-    if (status != PJ_SUCCESS) {
-	clist->timer.id = PJ_FALSE;
+    if (ice->opt.pacer) {
+	pacer_enqueue(ice->opt.pacer, ice);
+	status = PJ_SUCCESS;
+    } else {
+	delay.sec = delay.msec = 0;
+	status = pj_timer_heap_schedule_w_grp_lock(ice->stun_cfg.timer_heap,
+						   &clist->timer, &delay,
+						   PJ_TRUE, ice->grp_lock);
+	if (status != PJ_SUCCESS) {
+	    clist->timer.id = PJ_FALSE;
+	}
     }
 
     pj_grp_lock_release(ice->grp_lock);
@@ -3088,7 +3358,31 @@ PJ_DEF(pj_status_t) pj_ice_sess_on_rx_pkt(pj_ice_sess *ice,
     status = pj_stun_msg_check((const pj_uint8_t*)pkt, pkt_size, 
     			       PJ_STUN_IS_DATAGRAM |
     			         PJ_STUN_NO_FINGERPRINT_CHECK);
-    if (status == PJ_SUCCESS) {
+    if (status == PJ_SUCCESS &&
+	((((const pj_uint8_t*)pkt)[0] << 8) |
+	  ((const pj_uint8_t*)pkt)[1]) == PJ_STUN_BINDING_INDICATION)
+    {
+	pj_stun_msg_view view;
+
+	/* Binding Indication keep-alives are received periodically for
+	 * every component and carry nothing for us, so just parse them
+	 * in place instead of decoding them with the STUN session.
+	 */
+	status = pj_stun_msg_view_parse((const pj_uint8_t*)pkt, pkt_size,
+					PJ_STUN_IS_DATAGRAM |
+					  PJ_STUN_CHECK_PACKET,
+					&view);
+	if (status == PJ_SUCCESS) {
+	    LOG5((ice->obj_name, "Received Binding Indication keep-alive "
+		  "for component %d", comp_id));
+	} else {
+	    pj_strerror(status, ice->tmp.errmsg, sizeof(ice->tmp.errmsg));
+	    LOG4((ice->obj_name, "Error processing incoming message: %s",
+		  ice->tmp.errmsg));
+	}
+	pj_grp_lock_release(ice->grp_lock);
+
+    } else if (status == PJ_SUCCESS) {
 	status = pj_stun_session_on_rx_pkt(comp->stun_sess, pkt, pkt_size,
 					   PJ_STUN_IS_DATAGRAM, msg_data,
 					   NULL, src_addr, src_addr_len);
@@ -70,6 +70,16 @@ PJ_DEF(void) pj_stun_req_cred_info_dup( pj_pool_t *pool,
 }
 
 
+/* Remove the quotes around realm or username */
+static void remove_quote(pj_str_t *s)
+{
+    if (s->slen && *s->ptr=='"')
+	s->ptr++, s->slen--;
+    if (s->slen && s->ptr[s->slen-1]=='"')
+	s->slen--;
+}
+
+
 /* Calculate HMAC-SHA1 key for long term credential, by getting
  * MD5 digest of username, realm, and password. 
  */
@@ -90,14 +100,9 @@ static void calc_md5_key(pj_uint8_t digest[16],
 
     pj_md5_init(&ctx);
 
-#define REMOVE_QUOTE(s)	if (s.slen && *s.ptr=='"') \
-			    s.ptr++, s.slen--; \
-			if (s.slen && s.ptr[s.slen-1]=='"') \
-			    s.slen--;
-
     /* Add username */
     s = *username;
-    REMOVE_QUOTE(s);
+    remove_quote(&s);
     pj_md5_update(&ctx, (pj_uint8_t*)s.ptr, (unsigned)s.slen);
 
     /* Add single colon */
@@ -105,11 +110,9 @@ static void calc_md5_key(pj_uint8_t digest[16],
 
     /* Add realm */
     s = *realm;
-    REMOVE_QUOTE(s);
+    remove_quote(&s);
     pj_md5_update(&ctx, (pj_uint8_t*)s.ptr, (unsigned)s.slen);
 
-#undef REMOVE_QUOTE
-
     /* Another colon */
     pj_md5_update(&ctx, (pj_uint8_t*)":", 1);
 
@@ -149,6 +152,170 @@ PJ_DEF(void) pj_stun_create_key(pj_pool_t *pool,
 }
 
 
+/* Authentication key cache entry. Entries are identified by the SHA-1
+ * digest of their input, so the password itself is never kept.
+ */
+typedef struct auth_cache_entry
+{
+    pj_uint32_t	     last_used;	    /* Cache clock of last use, 0: unused */
+    pj_uint8_t	     id[PJ_SHA1_DIGEST_SIZE]; /* SHA-1 digest of input	  */
+    pj_uint8_t	     md5_key[16];   /* Long term key (lt_key table)	  */
+    pj_hmac_sha1_key hkey;	    /* Key schedule (hmac table)	  */
+} auth_cache_entry;
+
+struct pj_stun_auth_cache
+{
+    unsigned	      size;	    /* Number of entries in each table	  */
+    pj_uint32_t	      clock;	    /* Incremented on every lookup	  */
+    auth_cache_entry *lt_key;	    /* "username:realm:password" -> MD5	  */
+    auth_cache_entry *hmac;	    /* Key -> HMAC-SHA1 key schedule	  */
+};
+
+
+/*
+ * Create authentication key cache.
+ */
+PJ_DEF(pj_status_t) pj_stun_auth_cache_create(pj_pool_t *pool,
+					      unsigned size,
+					      pj_stun_auth_cache **p_cache)
+{
+    pj_stun_auth_cache *cache;
+
+    PJ_ASSERT_RETURN(pool && size && p_cache, PJ_EINVAL);
+
+    cache = PJ_POOL_ZALLOC_T(pool, pj_stun_auth_cache);
+    cache->size = size;
+    cache->lt_key = (auth_cache_entry*)
+		    pj_pool_calloc(pool, size, sizeof(auth_cache_entry));
+    cache->hmac = (auth_cache_entry*)
+		  pj_pool_calloc(pool, size, sizeof(auth_cache_entry));
+
+    *p_cache = cache;
+    return PJ_SUCCESS;
+}
+
+
+/* Find the entry with the specified input digest. If it's not found, the
+ * least recently used entry is taken over for the digest and *found is
+ * set to PJ_FALSE, so the caller must recalculate its value.
+ */
+static auth_cache_entry *cache_lookup(pj_stun_auth_cache *cache,
+				      auth_cache_entry *table,
+				      const pj_uint8_t id[],
+				      pj_bool_t *found)
+{
+    auth_cache_entry *lru = &table[0];
+    unsigned i;
+
+    for (i=0; i<cache->size; ++i) {
+	auth_cache_entry *e = &table[i];
+
+	if (e->last_used && pj_memcmp(e->id, id, PJ_SHA1_DIGEST_SIZE) == 0) {
+	    e->last_used = ++cache->clock;
+	    *found = PJ_TRUE;
+	    return e;
+	}
+	if (e->last_used < lru->last_used)
+	    lru = e;
+    }
+
+    lru->last_used = ++cache->clock;
+    pj_memcpy(lru->id, id, PJ_SHA1_DIGEST_SIZE);
+    *found = PJ_FALSE;
+    return lru;
+}
+
+
+/*
+ * Create authentication key, with the long term key taken from the cache.
+ */
+PJ_DEF(void) pj_stun_auth_cache_create_key(pj_stun_auth_cache *cache,
+					   pj_pool_t *pool,
+					   pj_str_t *key,
+					   const pj_str_t *realm,
+					   const pj_str_t *username,
+					   pj_stun_passwd_type data_type,
+					   const pj_str_t *data)
+{
+    pj_uint8_t id[PJ_SHA1_DIGEST_SIZE];
+    pj_sha1_context sctx;
+    auth_cache_entry *e;
+    pj_str_t user, rlm;
+    pj_bool_t found;
+
+    PJ_ASSERT_ON_FAIL(pool && key && username && data, return);
+
+    /* Only the long term key needs to be calculated */
+    if (cache == NULL || realm == NULL || realm->slen == 0 ||
+	data_type != PJ_STUN_PASSWD_PLAIN)
+    {
+	pj_stun_create_key(pool, key, realm, username, data_type, data);
+	return;
+    }
+
+    /* Identify the entry by the digest of the MD5 input, as built by
+     * calc_md5_key().
+     */
+    user = *username;
+    remove_quote(&user);
+    rlm = *realm;
+    remove_quote(&rlm);
+
+    pj_sha1_init(&sctx);
+    pj_sha1_update(&sctx, (pj_uint8_t*)user.ptr, (unsigned)user.slen);
+    pj_sha1_update(&sctx, (pj_uint8_t*)":", 1);
+    pj_sha1_update(&sctx, (pj_uint8_t*)rlm.ptr, (unsigned)rlm.slen);
+    pj_sha1_update(&sctx, (pj_uint8_t*)":", 1);
+    pj_sha1_update(&sctx, (pj_uint8_t*)data->ptr, (unsigned)data->slen);
+    pj_sha1_final(&sctx, id);
+
+    e = cache_lookup(cache, cache->lt_key, id, &found);
+    if (!found) {
+	pj_str_t lt_key;
+
+	pj_stun_create_key(pool, &lt_key, realm, username, data_type, data);
+	pj_assert(lt_key.slen == 16);
+	pj_memcpy(e->md5_key, lt_key.ptr, 16);
+	*key = lt_key;
+	return;
+    }
+
+    key->ptr = (char*) pj_pool_alloc(pool, 16);
+    pj_memcpy(key->ptr, e->md5_key, 16);
+    key->slen = 16;
+}
+
+
+/*
+ * Get the precomputed HMAC-SHA1 key schedule of the key.
+ */
+PJ_DEF(const pj_hmac_sha1_key*)
+pj_stun_auth_cache_get_hmac(pj_stun_auth_cache *cache, const pj_str_t *key)
+{
+    pj_uint8_t id[PJ_SHA1_DIGEST_SIZE];
+    pj_sha1_context sctx;
+    auth_cache_entry *e;
+    pj_bool_t found;
+
+    PJ_ASSERT_RETURN(cache && key, NULL);
+
+    /* With short term credential the key is the password itself, so
+     * identify the entry by the key digest instead.
+     */
+    pj_sha1_init(&sctx);
+    pj_sha1_update(&sctx, (pj_uint8_t*)key->ptr, (unsigned)key->slen);
+    pj_sha1_final(&sctx, id);
+
+    e = cache_lookup(cache, cache->hmac, id, &found);
+    if (!found) {
+	pj_hmac_sha1_key_init(&e->hkey, (const pj_uint8_t*)key->ptr,
+			      (unsigned)key->slen);
+    }
+
+    return &e->hkey;
+}
+
+
 /*unused PJ_INLINE(pj_uint16_t) GET_VAL16(const pj_uint8_t *pdu, unsigned pos)
 {
     return (pj_uint16_t) ((pdu[pos] << 8) + pdu[pos+1]);
@@ -219,6 +386,21 @@ PJ_DEF(pj_status_t) pj_stun_authenticate_request(const pj_uint8_t *pkt,
 					         pj_pool_t *pool,
 						 pj_stun_req_cred_info *p_info,
 					         pj_stun_msg **p_response)
+{
+    return pj_stun_authenticate_request2(pkt, pkt_len, msg, cred, NULL,
+					 pool, p_info, p_response);
+}
+
+
+/* Verify credential in the request, using the key cache */
+PJ_DEF(pj_status_t) pj_stun_authenticate_request2(const pj_uint8_t *pkt,
+						  unsigned pkt_len,
+						  const pj_stun_msg *msg,
+						  pj_stun_auth_cred *cred,
+						  pj_stun_auth_cache *cache,
+						  pj_pool_t *pool,
+						  pj_stun_req_cred_info *p_info,
+						  pj_stun_msg **p_response)
 {
     pj_stun_req_cred_info tmp_info;
     const pj_stun_msgint_attr *amsgi;
@@ -228,6 +410,8 @@ PJ_DEF(pj_status_t) pj_stun_authenticate_request(const pj_uint8_t *pkt,
     const pj_stun_realm_attr *arealm;
     const pj_stun_realm_attr *anonce;
     pj_hmac_sha1_context ctx;
+    pj_hmac_sha1_key tmp_hkey;
+    const pj_hmac_sha1_key *hkey;
     pj_uint8_t digest[PJ_SHA1_DIGEST_SIZE];
     pj_stun_status err_code;
     const char *err_text = NULL;
@@ -325,9 +509,10 @@ PJ_DEF(pj_status_t) pj_stun_authenticate_request(const pj_uint8_t *pkt,
 	if (username_ok) {
 	    pj_strdup(pool, &p_info->username, 
 		      &cred->data.static_cred.username);
-	    pj_stun_create_key(pool, &p_info->auth_key, &p_info->realm,
-			       &auser->value, cred->data.static_cred.data_type,
-			       &cred->data.static_cred.data);
+	    pj_stun_auth_cache_create_key(cache, pool, &p_info->auth_key,
+					  &p_info->realm, &auser->value,
+					  cred->data.static_cred.data_type,
+					  &cred->data.static_cred.data);
 	} else {
 	    /* Username mismatch */
 	    /* According to rfc3489bis-10 Sec 10.1.2/10.2.2, we should 
@@ -348,9 +533,9 @@ PJ_DEF(pj_status_t) pj_stun_authenticate_request(const pj_uint8_t *pkt,
 					      &data_type, &password);
 	if (rc == PJ_SUCCESS) {
 	    pj_strdup(pool, &p_info->username, &auser->value);
-	    pj_stun_create_key(pool, &p_info->auth_key, 
-			       (arealm?&arealm->value:NULL), &auser->value, 
-			       data_type, &password);
+	    pj_stun_auth_cache_create_key(cache, pool, &p_info->auth_key,
+					  (arealm?&arealm->value:NULL),
+					  &auser->value, data_type, &password);
 	} else {
 	    err_code = PJ_STUN_SC_UNAUTHORIZED;
 	    goto on_auth_failed;
@@ -442,8 +627,14 @@ PJ_DEF(pj_status_t) pj_stun_authenticate_request(const pj_uint8_t *pkt,
     }
 
     /* Now calculate HMAC of the message. */
-    pj_hmac_sha1_init(&ctx, (pj_uint8_t*)p_info->auth_key.ptr, 
-		      (unsigned)p_info->auth_key.slen);
+    if (cache) {
+	hkey = pj_stun_auth_cache_get_hmac(cache, &p_info->auth_key);
+    } else {
+	pj_hmac_sha1_key_init(&tmp_hkey, (pj_uint8_t*)p_info->auth_key.ptr,
+			      (unsigned)p_info->auth_key.slen);
+	hkey = &tmp_hkey;
+    }
+    pj_hmac_sha1_init_key(&ctx, hkey);
 
 #if PJ_STUN_OLD_STYLE_MI_FINGERPRINT
     /* Pre rfc3489bis-06 style of calculation */
@@ -473,7 +664,7 @@ PJ_DEF(pj_status_t) pj_stun_authenticate_request(const pj_uint8_t *pkt,
     	pj_hmac_sha1_update(&ctx, zeroes, 64-((amsgi_pos+20) & 0x3F));
     }
 #endif
-    pj_hmac_sha1_final(&ctx, digest);
+    pj_hmac_sha1_final_key(&ctx, hkey, digest);
 
 
     /* Compare HMACs */
@@ -545,6 +736,21 @@ PJ_DEF(pj_status_t) pj_stun_authenticate_response(const pj_uint8_t *pkt,
 					          unsigned pkt_len,
 					          const pj_stun_msg *msg,
 					          const pj_str_t *key)
+{
+    pj_hmac_sha1_key hkey;
+
+    PJ_ASSERT_RETURN(pkt && pkt_len && msg && key, PJ_EINVAL);
+
+    pj_hmac_sha1_key_init(&hkey, (pj_uint8_t*)key->ptr, (unsigned)key->slen);
+    return pj_stun_authenticate_response2(pkt, pkt_len, msg, &hkey);
+}
+
+
+/* Authenticate MESSAGE-INTEGRITY in the response, with precomputed key */
+PJ_DEF(pj_status_t) pj_stun_authenticate_response2(const pj_uint8_t *pkt,
+						   unsigned pkt_len,
+						   const pj_stun_msg *msg,
+						   const pj_hmac_sha1_key *hkey)
 {
     const pj_stun_msgint_attr *amsgi;
     unsigned i, amsgi_pos;
@@ -552,7 +758,7 @@ PJ_DEF(pj_status_t) pj_stun_authenticate_response(const pj_uint8_t *pkt,
     pj_hmac_sha1_context ctx;
     pj_uint8_t digest[PJ_SHA1_DIGEST_SIZE];
 
-    PJ_ASSERT_RETURN(pkt && pkt_len && msg && key, PJ_EINVAL);
+    PJ_ASSERT_RETURN(pkt && pkt_len && msg && hkey, PJ_EINVAL);
 
     /* First check that MESSAGE-INTEGRITY is present */
     amsgi = (const pj_stun_msgint_attr*)
@@ -587,7 +793,7 @@ PJ_DEF(pj_status_t) pj_stun_authenticate_response(const pj_uint8_t *pkt,
     }
 
     /* Now calculate HMAC of the message. */
-    pj_hmac_sha1_init(&ctx, (pj_uint8_t*)key->ptr, (unsigned)key->slen);
+    pj_hmac_sha1_init_key(&ctx, hkey);
 
 #if PJ_STUN_OLD_STYLE_MI_FINGERPRINT
     /* Pre rfc3489bis-06 style of calculation */
@@ -617,7 +823,7 @@ PJ_DEF(pj_status_t) pj_stun_authenticate_response(const pj_uint8_t *pkt,
     	pj_hmac_sha1_update(&ctx, zeroes, 64-((amsgi_pos+20) & 0x3F));
     }
 #endif
-    pj_hmac_sha1_final(&ctx, digest);
+    pj_hmac_sha1_final_key(&ctx, hkey, digest);
 
     /* Compare HMACs */
     if (pj_memcmp(amsgi->hmac, digest, 20)) {
@@ -2583,6 +2583,27 @@ PJ_DEF(pj_status_t) pj_stun_msg_encode(pj_stun_msg *msg,
 				       unsigned options,
 				       const pj_str_t *key,
 				       pj_size_t *p_msg_len)
+{
+    pj_hmac_sha1_key hkey;
+
+    if (key == NULL)
+	return pj_stun_msg_encode2(msg, buf, buf_size, options, NULL,
+				   p_msg_len);
+
+    pj_hmac_sha1_key_init(&hkey, (const pj_uint8_t*)key->ptr,
+			  (unsigned)key->slen);
+    return pj_stun_msg_encode2(msg, buf, buf_size, options, &hkey,
+			       p_msg_len);
+}
+
+/*
+ * Print the message structure to a buffer, with precomputed key.
+ */
+PJ_DEF(pj_status_t) pj_stun_msg_encode2(pj_stun_msg *msg,
+					pj_uint8_t *buf, pj_size_t buf_size,
+					unsigned options,
+					const pj_hmac_sha1_key *hkey,
+					pj_size_t *p_msg_len)
 {
     pj_uint8_t *start = buf;
     pj_stun_msgint_attr *amsgint = NULL;
@@ -2706,7 +2727,7 @@ PJ_DEF(pj_status_t) pj_stun_msg_encode(pj_stun_msg *msg,
 	pj_hmac_sha1_context ctx;
 
 	/* Key MUST be specified */
-	PJ_ASSERT_RETURN(key, PJ_EINVALIDOP);
+	PJ_ASSERT_RETURN(hkey, PJ_EINVALIDOP);
 
 	/* MESSAGE-INTEGRITY must be the last attribute in the message, or
 	 * the last attribute before FINGERPRINT.
@@ -2729,8 +2750,7 @@ PJ_DEF(pj_status_t) pj_stun_msg_encode(pj_stun_msg *msg,
 	/* Calculate HMAC-SHA1 digest, add zero padding to input
 	 * if necessary to make the input 64 bytes aligned.
 	 */
-	pj_hmac_sha1_init(&ctx, (const pj_uint8_t*)key->ptr, 
-			  (unsigned)key->slen);
+	pj_hmac_sha1_init_key(&ctx, hkey);
 	pj_hmac_sha1_update(&ctx, (const pj_uint8_t*)start, 
 			    (unsigned)(buf-start));
 #if PJ_STUN_OLD_STYLE_MI_FINGERPRINT
@@ -2741,7 +2761,7 @@ PJ_DEF(pj_status_t) pj_stun_msg_encode(pj_stun_msg *msg,
 	    pj_hmac_sha1_update(&ctx, zeroes, 64-((buf-start) & 0x3F));
 	}
 #endif	/* PJ_STUN_OLD_STYLE_MI_FINGERPRINT */
-	pj_hmac_sha1_final(&ctx, amsgint->hmac);
+	pj_hmac_sha1_final_key(&ctx, hkey, amsgint->hmac);
 
 	/* Put this attribute in the message */
 	status = encode_msgint_attr(amsgint, buf, (unsigned)buf_size, 
@@ -2831,3 +2851,364 @@ PJ_DEF(pj_stun_attr_hdr*) pj_stun_attr_clone( pj_pool_t *pool,
 }
 
 
+
+
+//////////////////////////////////////////////////////////////////////////////
+/*
+ * STUN message view.
+ */
+
+/*
+ * Parse STUN packet into message view.
+ */
+PJ_DEF(pj_status_t) pj_stun_msg_view_parse(const pj_uint8_t *pdu,
+					   pj_size_t pdu_len,
+					   unsigned options,
+					   pj_stun_msg_view *view)
+{
+    const pj_uint8_t *p;
+    unsigned body_len;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pdu && view, PJ_EINVAL);
+
+    /* Check if this is a STUN message, if necessary */
+    if (options & PJ_STUN_CHECK_PACKET) {
+	status = pj_stun_msg_check(pdu, pdu_len, options);
+	if (status != PJ_SUCCESS)
+	    return status;
+    } else if (pdu_len < sizeof(pj_stun_msg_hdr) ||
+	       GETVAL16H(pdu, 2) + sizeof(pj_stun_msg_hdr) > pdu_len)
+    {
+	return PJNATH_EINSTUNMSGLEN;
+    }
+
+    view->hdr.type = GETVAL16H(pdu, 0);
+    view->hdr.length = GETVAL16H(pdu, 2);
+    view->hdr.magic = GETVAL32H(pdu, 4);
+    pj_memcpy(view->hdr.tsx_id, pdu+8, sizeof(view->hdr.tsx_id));
+    view->pdu = pdu;
+    view->attr_count = 0;
+
+    /* Parse attributes, just record their position */
+    p = pdu + sizeof(pj_stun_msg_hdr);
+    body_len = view->hdr.length;
+
+    while (body_len >= ATTR_HDR_LEN) {
+	pj_stun_attr_view *attr;
+	unsigned attr_len = GETVAL16H(p, 2);
+	unsigned padded_len = ((attr_len + 3) & (~3)) + ATTR_HDR_LEN;
+
+	if (body_len < padded_len)
+	    return PJNATH_ESTUNINATTRLEN;
+
+	if (view->attr_count >= PJ_STUN_MAX_ATTR)
+	    return PJNATH_ESTUNTOOMANYATTR;
+
+	attr = &view->attr[view->attr_count++];
+	attr->type = GETVAL16H(p, 0);
+	attr->length = (pj_uint16_t)attr_len;
+	attr->value = p + ATTR_HDR_LEN;
+
+	p += padded_len;
+	body_len -= padded_len;
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Find STUN attribute in the STUN message view.
+ */
+PJ_DEF(const pj_stun_attr_view*)
+pj_stun_msg_view_find_attr(const pj_stun_msg_view *view,
+			   int attr_type,
+			   unsigned start_index)
+{
+    PJ_ASSERT_RETURN(view, NULL);
+
+    for (; start_index < view->attr_count; ++start_index) {
+	if (view->attr[start_index].type == attr_type)
+	    return &view->attr[start_index];
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Get the value of 32bit integer attribute.
+ */
+PJ_DEF(pj_status_t) pj_stun_attr_view_get_uint(const pj_stun_attr_view *attr,
+					       pj_uint32_t *value)
+{
+    PJ_ASSERT_RETURN(attr && value, PJ_EINVAL);
+
+    if (attr->length != 4)
+	return PJNATH_ESTUNINATTRLEN;
+
+    *value = GETVAL32H(attr->value, 0);
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Get the address of socket address attribute.
+ */
+PJ_DEF(pj_status_t)
+pj_stun_attr_view_get_sockaddr(const pj_stun_msg_view *view,
+			       const pj_stun_attr_view *attr,
+			       pj_sockaddr *addr)
+{
+    const struct attr_desc *adesc;
+    pj_bool_t xor_ed;
+    pj_uint16_t port;
+
+    PJ_ASSERT_RETURN(view && attr && addr, PJ_EINVAL);
+
+    adesc = find_attr_desc(attr->type);
+    if (adesc == NULL || (adesc->decode_attr != &decode_sockaddr_attr &&
+			  adesc->decode_attr != &decode_xored_sockaddr_attr))
+    {
+	return PJ_EINVAL;
+    }
+    xor_ed = (adesc->decode_attr == &decode_xored_sockaddr_attr);
+
+    /* Check address family and length, as in decode_sockaddr_attr(),
+     * before reading the value.
+     */
+    if (attr->length < 4)
+	return PJNATH_ESTUNINATTRLEN;
+
+    if (attr->value[1] == 1) {
+	if (attr->length != STUN_GENERIC_IPV4_ADDR_LEN)
+	    return PJNATH_ESTUNINATTRLEN;
+    } else if (attr->value[1] == 2) {
+	if (attr->length != STUN_GENERIC_IPV6_ADDR_LEN)
+	    return PJNATH_ESTUNINATTRLEN;
+    } else {
+	return PJNATH_EINVAF;
+    }
+
+    port = GETVAL16H(attr->value, 2);
+    if (xor_ed)
+	port ^= (pj_uint16_t)(PJ_STUN_MAGIC >> 16);
+
+    if (attr->value[1] == 1) {
+	pj_uint32_t ip = GETVAL32H(attr->value, 4);
+
+	if (xor_ed)
+	    ip ^= PJ_STUN_MAGIC;
+
+	pj_sockaddr_init(pj_AF_INET(), addr, NULL, port);
+	addr->ipv4.sin_addr.s_addr = pj_htonl(ip);
+
+    } else {
+	pj_uint8_t *dst;
+	unsigned i;
+
+	pj_sockaddr_init(pj_AF_INET6(), addr, NULL, port);
+	dst = (pj_uint8_t*) &addr->ipv6.sin6_addr;
+	pj_memcpy(dst, attr->value + 4, 16);
+
+	/* XOR with the concatenation of the magic cookie and the
+	 * transaction ID, which follow each other in the header.
+	 */
+	if (xor_ed) {
+	    for (i=0; i<16; ++i)
+		dst[i] ^= view->pdu[4+i];
+	}
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Verify the MESSAGE-INTEGRITY of the message view.
+ */
+PJ_DEF(pj_status_t) pj_stun_msg_view_verify_msgint(const pj_stun_msg_view *view,
+						   const pj_str_t *key)
+{
+    const pj_stun_attr_view *amsgi;
+    unsigned amsgi_pos;
+    pj_hmac_sha1_context ctx;
+    pj_uint8_t digest[20];
+
+    PJ_ASSERT_RETURN(view && key, PJ_EINVAL);
+
+    amsgi = pj_stun_msg_view_find_attr(view, PJ_STUN_ATTR_MESSAGE_INTEGRITY,
+				       0);
+    if (amsgi == NULL)
+	return PJ_STATUS_FROM_STUN_CODE(PJ_STUN_SC_UNAUTHORIZED);
+
+    if (amsgi->length != 20)
+	return PJNATH_ESTUNINATTRLEN;
+
+    /* Position of MESSAGE-INTEGRITY relative to the message body */
+    amsgi_pos = (unsigned)(amsgi->value - ATTR_HDR_LEN - view->pdu) - 20;
+
+    pj_hmac_sha1_init(&ctx, (pj_uint8_t*)key->ptr, (unsigned)key->slen);
+
+#if PJ_STUN_OLD_STYLE_MI_FINGERPRINT
+    /* Pre rfc3489bis-06 style of calculation */
+    pj_hmac_sha1_update(&ctx, view->pdu, 20);
+#else
+    /* The length in the header must only cover up to MESSAGE-INTEGRITY */
+    if (amsgi_pos + 24 != view->hdr.length) {
+	pj_uint8_t hdr_copy[20];
+	pj_memcpy(hdr_copy, view->pdu, 20);
+	PUTVAL16H(hdr_copy, 2, (pj_uint16_t)(amsgi_pos+24));
+	pj_hmac_sha1_update(&ctx, hdr_copy, 20);
+    } else {
+	pj_hmac_sha1_update(&ctx, view->pdu, 20);
+    }
+#endif	/* PJ_STUN_OLD_STYLE_MI_FINGERPRINT */
+
+    pj_hmac_sha1_update(&ctx, view->pdu+20, amsgi_pos);
+#if PJ_STUN_OLD_STYLE_MI_FINGERPRINT
+    if ((amsgi_pos+20) & 0x3F) {
+	pj_uint8_t zeroes[64];
+	pj_bzero(zeroes, sizeof(zeroes));
+	pj_hmac_sha1_update(&ctx, zeroes, 64-((amsgi_pos+20) & 0x3F));
+    }
+#endif
+    pj_hmac_sha1_final(&ctx, digest);
+
+    if (pj_memcmp(amsgi->value, digest, 20))
+	return PJ_STATUS_FROM_STUN_CODE(PJ_STUN_SC_UNAUTHORIZED);
+
+    return PJ_SUCCESS;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+/*
+ * STUN message template.
+ */
+
+/*
+ * Create message template from STUN message.
+ */
+PJ_DEF(pj_status_t) pj_stun_msg_tmpl_create(pj_pool_t *pool,
+					    pj_stun_msg *msg,
+					    const pj_str_t *key,
+					    pj_stun_msg_tmpl **p_tmpl)
+{
+    pj_uint8_t buf[PJ_STUN_MAX_PKT_LEN];
+    pj_stun_msg_view view;
+    pj_stun_msg_tmpl *tmpl;
+    const pj_stun_attr_view *attr;
+    pj_size_t len;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && msg && p_tmpl, PJ_EINVAL);
+
+    /* XOR-ed IPv6 address depends on the transaction ID */
+    for (i=0; i<msg->attr_count; ++i) {
+	const struct attr_desc *adesc = find_attr_desc(msg->attr[i]->type);
+
+	if (adesc && adesc->decode_attr == &decode_xored_sockaddr_attr &&
+	    ((pj_stun_sockaddr_attr*)msg->attr[i])->sockaddr.addr.sa_family ==
+		pj_AF_INET6())
+	{
+	    return PJ_ENOTSUP;
+	}
+    }
+
+    tmpl = PJ_POOL_ZALLOC_T(pool, pj_stun_msg_tmpl);
+    if (key) {
+	pj_strdup(pool, &tmpl->key, key);
+	pj_hmac_sha1_key_init(&tmpl->hkey, (const pj_uint8_t*)key->ptr,
+			      (unsigned)key->slen);
+    }
+
+    status = pj_stun_msg_encode2(msg, buf, sizeof(buf), 0,
+				 (key ? &tmpl->hkey : NULL), &len);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    tmpl->pdu = (pj_uint8_t*) pj_pool_alloc(pool, len);
+    pj_memcpy(tmpl->pdu, buf, len);
+    tmpl->pdu_len = (unsigned)len;
+
+    /* Locate MESSAGE-INTEGRITY and FINGERPRINT */
+    status = pj_stun_msg_view_parse(tmpl->pdu, len, 0, &view);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    attr = pj_stun_msg_view_find_attr(&view, PJ_STUN_ATTR_MESSAGE_INTEGRITY,
+				      0);
+    if (attr)
+	tmpl->msgint_pos = (unsigned)(attr->value - ATTR_HDR_LEN - tmpl->pdu);
+
+    attr = pj_stun_msg_view_find_attr(&view, PJ_STUN_ATTR_FINGERPRINT, 0);
+    if (attr)
+	tmpl->fingerprint_pos = (unsigned)(attr->value - ATTR_HDR_LEN -
+					   tmpl->pdu);
+
+    *p_tmpl = tmpl;
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Render the message template with the specified transaction ID.
+ */
+PJ_DEF(pj_status_t) pj_stun_msg_tmpl_render(const pj_stun_msg_tmpl *tmpl,
+					    const pj_uint8_t tsx_id[12],
+					    pj_uint8_t *buf,
+					    pj_size_t buf_size,
+					    pj_size_t *p_msg_len)
+{
+    PJ_ASSERT_RETURN(tmpl && tsx_id && buf, PJ_EINVAL);
+
+    if (buf_size < tmpl->pdu_len)
+	return PJ_ETOOSMALL;
+
+    pj_memcpy(buf, tmpl->pdu, tmpl->pdu_len);
+    pj_memcpy(buf+8, tsx_id, 12);
+
+    /* Recalculate MESSAGE-INTEGRITY, see pj_stun_msg_encode() */
+    if (tmpl->msgint_pos) {
+	pj_hmac_sha1_context ctx;
+	unsigned pos = tmpl->msgint_pos;
+
+#if !PJ_STUN_OLD_STYLE_MI_FINGERPRINT
+	PUTVAL16H(buf, 2, (pj_uint16_t)(pos - 20 + 24));
+#endif
+	pj_hmac_sha1_init_key(&ctx, &tmpl->hkey);
+	pj_hmac_sha1_update(&ctx, buf, pos);
+#if PJ_STUN_OLD_STYLE_MI_FINGERPRINT
+	if (pos & 0x3F) {
+	    pj_uint8_t zeroes[64];
+	    pj_bzero(zeroes, sizeof(zeroes));
+	    pj_hmac_sha1_update(&ctx, zeroes, 64-(pos & 0x3F));
+	}
+#endif
+	pj_hmac_sha1_final_key(&ctx, &tmpl->hkey, buf + pos + ATTR_HDR_LEN);
+    }
+
+    /* Recalculate FINGERPRINT */
+    if (tmpl->fingerprint_pos) {
+	unsigned pos = tmpl->fingerprint_pos;
+	pj_uint32_t crc;
+
+#if !PJ_STUN_OLD_STYLE_MI_FINGERPRINT
+	PUTVAL16H(buf, 2, (pj_uint16_t)(pos - 20 + 8));
+#endif
+	crc = pj_crc32_calc(buf, pos);
+	crc ^= STUN_XOR_FINGERPRINT;
+	PUTVAL32H(buf, pos + ATTR_HDR_LEN, crc);
+    }
+
+    /* Restore the final message length */
+    PUTVAL16H(buf, 2, (pj_uint16_t)(tmpl->pdu_len - 20));
+
+    if (p_msg_len)
+	*p_msg_len = tmpl->pdu_len;
+
+    return PJ_SUCCESS;
+}
@@ -41,6 +41,7 @@ struct pj_stun_session
 
     pj_stun_auth_type	 auth_type;
     pj_stun_auth_cred	 cred;
+    pj_stun_auth_cache	*auth_cache;
     int			 auth_retry;
     pj_str_t		 next_nonce;
     pj_str_t		 server_realm;
@@ -562,6 +563,11 @@ PJ_DEF(pj_status_t) pj_stun_session_create( pj_stun_config *cfg,
 
     pj_stun_session_set_software_name(sess, &cfg->software_name);
 
+#if PJ_STUN_AUTH_CACHE_SIZE
+    pj_stun_auth_cache_create(pool, PJ_STUN_AUTH_CACHE_SIZE,
+			      &sess->auth_cache);
+#endif
+
     sess->rx_pool = pj_pool_create(sess->cfg->pf, name,
 				   PJNATH_POOL_LEN_STUN_TDATA,
 				   PJNATH_POOL_INC_STUN_TDATA, NULL);
@@ -716,11 +722,12 @@ static pj_status_t get_auth(pj_stun_session *sess,
 	tdata->auth_info.username = sess->cred.data.static_cred.username;
 	tdata->auth_info.nonce = sess->cred.data.static_cred.nonce;
 
-	pj_stun_create_key(tdata->pool, &tdata->auth_info.auth_key, 
-			   &tdata->auth_info.realm,
-			   &tdata->auth_info.username,
-			   sess->cred.data.static_cred.data_type,
-			   &sess->cred.data.static_cred.data);
+	pj_stun_auth_cache_create_key(sess->auth_cache, tdata->pool,
+				      &tdata->auth_info.auth_key,
+				      &tdata->auth_info.realm,
+				      &tdata->auth_info.username,
+				      sess->cred.data.static_cred.data_type,
+				      &sess->cred.data.static_cred.data);
 
     } else if (sess->cred.type == PJ_STUN_AUTH_CRED_DYNAMIC) {
 	pj_str_t password;
@@ -737,9 +744,11 @@ static pj_status_t get_auth(pj_stun_session *sess,
 	if (rc != PJ_SUCCESS)
 	    return rc;
 
-	pj_stun_create_key(tdata->pool, &tdata->auth_info.auth_key, 
-			   &tdata->auth_info.realm, &tdata->auth_info.username,
-			   data_type, &password);
+	pj_stun_auth_cache_create_key(sess->auth_cache, tdata->pool,
+				      &tdata->auth_info.auth_key,
+				      &tdata->auth_info.realm,
+				      &tdata->auth_info.username,
+				      data_type, &password);
 
     } else {
 	pj_assert(!"Unknown credential type");
@@ -749,6 +758,26 @@ static pj_status_t get_auth(pj_stun_session *sess,
     return PJ_SUCCESS;
 }
 
+/* Get the precomputed HMAC-SHA1 key schedule of the authentication key.
+ * When the message to be encoded is specified, return NULL if it doesn't
+ * have MESSAGE-INTEGRITY.
+ */
+static const pj_hmac_sha1_key *get_hmac_key(pj_stun_session *sess,
+					    const pj_stun_msg *msg,
+					    const pj_str_t *auth_key,
+					    pj_hmac_sha1_key *tmp_hkey)
+{
+    if (msg && !pj_stun_msg_find_attr(msg, PJ_STUN_ATTR_MESSAGE_INTEGRITY, 0))
+	return NULL;
+
+    if (sess->auth_cache)
+	return pj_stun_auth_cache_get_hmac(sess->auth_cache, auth_key);
+
+    pj_hmac_sha1_key_init(tmp_hkey, (const pj_uint8_t*)auth_key->ptr,
+			  (unsigned)auth_key->slen);
+    return tmp_hkey;
+}
+
 PJ_DEF(pj_status_t) pj_stun_session_create_req(pj_stun_session *sess,
 					       int method,
 					       pj_uint32_t magic,
@@ -947,6 +976,7 @@ PJ_DEF(pj_status_t) pj_stun_session_send_msg( pj_stun_session *sess,
 					      unsigned addr_len,
 					      pj_stun_tx_data *tdata)
 {
+    pj_hmac_sha1_key tmp_hkey;
     pj_status_t status;
 
     PJ_ASSERT_RETURN(sess && addr_len && server && tdata, PJ_EINVAL);
@@ -977,10 +1007,12 @@ PJ_DEF(pj_status_t) pj_stun_session_send_msg( pj_stun_session *sess,
     }
 
     /* Encode message */
-    status = pj_stun_msg_encode(tdata->msg, (pj_uint8_t*)tdata->pkt, 
-    				tdata->max_len, 0, 
-    				&tdata->auth_info.auth_key,
-				&tdata->pkt_size);
+    status = pj_stun_msg_encode2(tdata->msg, (pj_uint8_t*)tdata->pkt,
+				 tdata->max_len, 0,
+				 get_hmac_key(sess, tdata->msg,
+					      &tdata->auth_info.auth_key,
+					      &tmp_hkey),
+				 &tdata->pkt_size);
     if (status != PJ_SUCCESS) {
 	pj_stun_msg_destroy_tdata(sess, tdata);
 	LOG_ERR_(sess, "STUN encode() error", status);
@@ -1195,6 +1227,7 @@ static pj_status_t send_response(pj_stun_session *sess, void *token,
 {
     pj_uint8_t *out_pkt;
     pj_size_t out_max_len, out_len;
+    pj_hmac_sha1_key tmp_hkey;
     pj_status_t status;
 
     /* Apply options */
@@ -1209,8 +1242,10 @@ static pj_status_t send_response(pj_stun_session *sess, void *token,
     out_pkt = (pj_uint8_t*) pj_pool_alloc(pool, out_max_len);
 
     /* Encode */
-    status = pj_stun_msg_encode(response, out_pkt, out_max_len, 0, 
-				&auth_info->auth_key, &out_len);
+    status = pj_stun_msg_encode2(response, out_pkt, out_max_len, 0,
+				 get_hmac_key(sess, response, &auth_info->auth_key,
+					      &tmp_hkey),
+				 &out_len);
     if (status != PJ_SUCCESS) {
 	LOG_ERR_(sess, "Error encoding message", status);
 	return status;
@@ -1245,9 +1280,9 @@ static pj_status_t authenticate_req(pj_stun_session *sess,
 	return PJ_SUCCESS;
     }
 
-    status = pj_stun_authenticate_request(pkt, pkt_len, rdata->msg, 
-					  &sess->cred, tmp_pool, &rdata->info,
-					  &response);
+    status = pj_stun_authenticate_request2(pkt, pkt_len, rdata->msg,
+					   &sess->cred, sess->auth_cache,
+					   tmp_pool, &rdata->info, &response);
     if (status != PJ_SUCCESS && response != NULL) {
 	PJ_PERROR(5,(SNAME(sess), status, "Message authentication failed"));
 	send_response(sess, token, tmp_pool, response, &rdata->info, 
@@ -1288,8 +1323,12 @@ static pj_status_t on_incoming_response(pj_stun_session *sess,
 	tdata->auth_info.auth_key.slen != 0 && 
 	pj_stun_auth_valid_for_msg(msg))
     {
-	status = pj_stun_authenticate_response(pkt, pkt_len, msg, 
-					       &tdata->auth_info.auth_key);
+	pj_hmac_sha1_key tmp_hkey;
+	const pj_hmac_sha1_key *hkey;
+
+	hkey = get_hmac_key(sess, NULL, &tdata->auth_info.auth_key,
+			    &tmp_hkey);
+	status = pj_stun_authenticate_response2(pkt, pkt_len, msg, hkey);
 	if (status != PJ_SUCCESS) {
 	    PJ_PERROR(5,(SNAME(sess), status,
 			 "Response authentication failed"));
@@ -54,6 +54,7 @@ struct pj_stun_sock
     pj_timer_entry	 ka_timer;	/* Keep alive timer.	    */
 
     pj_sockaddr		 srv_addr;	/* Resolved server addr	    */
+    pj_uint16_t		 srv_port;	/* Port for getaddrinfo	    */
     pj_sockaddr		 mapped_addr;	/* Our public address	    */
 
     pj_dns_srv_async_query *q;		/* Pending DNS query	    */
@@ -98,6 +99,12 @@ static void dns_srv_resolver_cb(void *user_data,
 				pj_status_t status,
 				const pj_dns_srv_record *rec);
 
+/* Asynchronous getaddrinfo() callback */
+static void getaddrinfo_cb(void *user_data,
+			   pj_status_t status,
+			   unsigned count,
+			   const pj_addrinfo ai[]);
+
 /* Start sending STUN Binding request */
 static pj_status_t get_mapped_addr(pj_stun_sock *stun_sock);
 
@@ -457,21 +464,29 @@ PJ_DEF(pj_status_t) pj_stun_sock_start( pj_stun_sock *stun_sock,
     } else {
 
 	if (status != PJ_SUCCESS) {
-	    pj_addrinfo ai;
-	    unsigned cnt = 1;
-
-	    status = pj_getaddrinfo(stun_sock->af, domain, &cnt, &ai);
-	    if (cnt == 0)
-		status = PJ_EAFNOTSUP;
-
-	    if (status != PJ_SUCCESS) {
+	    /* Resolve the host name in the background, processing will
+	     * resume in getaddrinfo_cb(). The reference keeps the socket
+	     * alive until the callback is called.
+	     */
+	    stun_sock->srv_port = default_port;
+	    stun_sock->last_err = PJ_SUCCESS;
+	    pj_grp_lock_add_ref(stun_sock->grp_lock);
+
+	    status = pj_getaddrinfo_async(stun_sock->af, domain,
+					  &getaddrinfo_cb, stun_sock);
+	    if (status == PJ_EPENDING) {
+		status = PJ_SUCCESS;
+	    } else if (status == PJ_SUCCESS) {
+		/* Callback has been called, e.g. the result is cached */
+		status = stun_sock->last_err;
+	    } else {
+		pj_grp_lock_dec_ref(stun_sock->grp_lock);
 		PJ_PERROR(4,(stun_sock->obj_name, status,
-			     "Failed in pj_getaddrinfo()"));
-	        pj_grp_lock_release(stun_sock->grp_lock);
-		return status;
+			     "Failed in pj_getaddrinfo_async()"));
 	    }
 
-	    pj_sockaddr_cp(&stun_sock->srv_addr, &ai.ai_addr);
+	    pj_grp_lock_release(stun_sock->grp_lock);
+	    return status;
 	}
 
 	pj_sockaddr_set_port(&stun_sock->srv_addr, (pj_uint16_t)default_port);
@@ -626,6 +641,45 @@ static void dns_srv_resolver_cb(void *user_data,
 }
 
 
+/* Asynchronous getaddrinfo() callback */
+static void getaddrinfo_cb(void *user_data,
+			   pj_status_t status,
+			   unsigned count,
+			   const pj_addrinfo ai[])
+{
+    pj_stun_sock *stun_sock = (pj_stun_sock*) user_data;
+
+    pj_grp_lock_acquire(stun_sock->grp_lock);
+
+    if (stun_sock->is_destroying) {
+	pj_grp_lock_release(stun_sock->grp_lock);
+	pj_grp_lock_dec_ref(stun_sock->grp_lock);
+	return;
+    }
+
+    if (status == PJ_SUCCESS && count == 0)
+	status = PJ_EAFNOTSUP;
+
+    if (status != PJ_SUCCESS) {
+	stun_sock->last_err = status;
+	sess_fail(stun_sock, PJ_STUN_SOCK_DNS_OP, status);
+    } else {
+	pj_sockaddr_cp(&stun_sock->srv_addr, &ai[0].ai_addr);
+	pj_sockaddr_set_port(&stun_sock->srv_addr, stun_sock->srv_port);
+
+	/* Start sending Binding request */
+	stun_sock->last_err = get_mapped_addr(stun_sock);
+	if (stun_sock->last_err != PJ_SUCCESS) {
+	    PJ_PERROR(4,(stun_sock->obj_name, stun_sock->last_err,
+			 "Failed in sending Binding request"));
+	}
+    }
+
+    pj_grp_lock_release(stun_sock->grp_lock);
+    pj_grp_lock_dec_ref(stun_sock->grp_lock);
+}
+
+
 /* Start sending STUN Binding request */
 static pj_status_t get_mapped_addr(pj_stun_sock *stun_sock)
 {
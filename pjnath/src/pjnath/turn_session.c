@@ -23,7 +23,6 @@
 #include <pj/addr_resolv.h>
 #include <pj/assert.h>
 #include <pj/errno.h>
-#include <pj/hash.h>
 #include <pj/lock.h>
 #include <pj/log.h>
 #include <pj/os.h>
@@ -33,8 +32,8 @@
 
 #define PJ_TURN_CHANNEL_MIN	    0x4000
 #define PJ_TURN_CHANNEL_MAX	    0x7FFF  /* inclusive */
-#define PJ_TURN_CHANNEL_HTABLE_SIZE 8
-#define PJ_TURN_PERM_HTABLE_SIZE    8
+#define PJ_TURN_CHANNEL_HTABLE_SIZE 8   /* initial size, power of two */
+#define PJ_TURN_PERM_HTABLE_SIZE    8   /* initial size, power of two */
 
 static const char *state_names[] = 
 {
@@ -101,6 +100,34 @@ struct perm_t
      * request fails.
      */
     void	   *req_token;
+
+    /* Next deleted permission in the free list */
+    struct perm_t  *next;
+};
+
+/* Slot of the peer table. An empty slot has NULL key, a deleted slot
+ * has non-NULL key and NULL value. The key of a deleted slot is never
+ * dereferenced, so the entry it belonged to may be reused.
+ */
+struct peer_slot
+{
+    pj_uint32_t		 hval;
+    const pj_sockaddr	*key;
+    void		*val;
+};
+
+/* Open addressing (linear probing) table, keyed by IP address and port
+ * number. It is used to lookup channels by the peer address and
+ * permissions by the peer IP address (with zero port number), without
+ * hashing the whole socket address and walking hash buckets for every
+ * relayed packet.
+ */
+struct peer_tbl
+{
+    unsigned		 cap;	/* Number of slots, power of two.	*/
+    unsigned		 cnt;	/* Number of live entries.		*/
+    unsigned		 used;	/* Number of live and deleted entries.	*/
+    struct peer_slot	*slot;
 };
 
 struct conn_bind_t
@@ -150,8 +177,21 @@ struct pj_turn_session
     pj_sockaddr		 mapped_addr;
     pj_sockaddr		 relay_addr;
 
-    pj_hash_table_t	*ch_table;
-    pj_hash_table_t	*perm_table;
+    struct peer_tbl	 ch_table;
+    struct peer_tbl	 perm_table;
+    struct perm_t	*perm_free;	/* Deleted permissions to reuse. */
+
+    /* Bound channels, indexed by (channel number - PJ_TURN_CHANNEL_MIN).
+     * Channel numbers are assigned sequentially, so the array grows
+     * together with next_ch.
+     */
+    struct ch_t		**ch_arr;
+    unsigned		 ch_arr_size;
+
+    pj_uint32_t		 tx_pkt_cnt;
+    pj_uint32_t		 tx_bytes;
+    pj_uint32_t		 rx_pkt_cnt;
+    pj_uint32_t		 rx_bytes;
 
     pj_uint32_t		 send_ind_tsx_id[3];
     /* tx_pkt must be 16bit aligned */
@@ -205,6 +245,8 @@ static struct perm_t *lookup_perm(pj_turn_session *sess,
 				  pj_bool_t update);
 static void invalidate_perm(pj_turn_session *sess,
 			    struct perm_t *perm);
+static void peer_tbl_init(pj_pool_t *pool, struct peer_tbl *tbl,
+			  unsigned cap);
 static void on_timer_event(pj_timer_heap_t *th, pj_timer_entry *e);
 
 
@@ -281,11 +323,11 @@ PJ_DEF(pj_status_t) pj_turn_session_create( const pj_stun_config *cfg,
     /* Copy callback */
     pj_memcpy(&sess->cb, cb, sizeof(*cb));
 
-    /* Peer hash table */
-    sess->ch_table = pj_hash_create(pool, PJ_TURN_CHANNEL_HTABLE_SIZE);
+    /* Peer table */
+    peer_tbl_init(pool, &sess->ch_table, PJ_TURN_CHANNEL_HTABLE_SIZE);
 
-    /* Permission hash table */
-    sess->perm_table = pj_hash_create(pool, PJ_TURN_PERM_HTABLE_SIZE);
+    /* Permission table */
+    peer_tbl_init(pool, &sess->perm_table, PJ_TURN_PERM_HTABLE_SIZE);
 
     /* Session lock */
     if (grp_lock) {
@@ -505,6 +547,11 @@ PJ_DEF(pj_status_t) pj_turn_session_get_info( pj_turn_session *sess,
     pj_memcpy(&info->relay_addr, &sess->relay_addr, 
 	      sizeof(sess->relay_addr));
 
+    info->tx_pkt_cnt = sess->tx_pkt_cnt;
+    info->tx_bytes = sess->tx_bytes;
+    info->rx_pkt_cnt = sess->rx_pkt_cnt;
+    info->rx_bytes = sess->rx_bytes;
+
     return PJ_SUCCESS;
 }
 
@@ -835,7 +882,6 @@ PJ_DEF(pj_status_t) pj_turn_session_set_perm( pj_turn_session *sess,
 					      unsigned options)
 {
     pj_stun_tx_data *tdata;
-    pj_hash_iterator_t it_buf, *it;
     void *req_token;
     unsigned i, attr_added=0;
     pj_status_t status;
@@ -909,12 +955,9 @@ on_error:
 	pj_stun_msg_destroy_tdata(sess->stun, tdata);
     }
     /* invalidate perm structures associated with this request */
-    it = pj_hash_first(sess->perm_table, &it_buf);
-    while (it) {
-	struct perm_t *perm = (struct perm_t*)
-			      pj_hash_this(sess->perm_table, it);
-	it = pj_hash_next(sess->perm_table, it);
-	if (perm->req_token == req_token)
+    for (i=0; i<sess->perm_table.cap; ++i) {
+	struct perm_t *perm = (struct perm_t*)sess->perm_table.slot[i].val;
+	if (perm && perm->req_token == req_token)
 	    invalidate_perm(sess, perm);
     }
     pj_grp_lock_release(sess->grp_lock);
@@ -1041,6 +1084,10 @@ PJ_DEF(pj_status_t) pj_turn_session_sendto( pj_turn_session *sess,
 	status = sess->cb.on_send_pkt(sess, sess->tx_pkt, total_len,
 				      sess->srv_addr,
 				      pj_sockaddr_get_len(sess->srv_addr));
+	if (status == PJ_SUCCESS || status == PJ_EPENDING) {
+	    ++sess->tx_pkt_cnt;
+	    sess->tx_bytes += pkt_len;
+	}
 
     } else {
 	/* Use Send Indication. */
@@ -1082,6 +1129,10 @@ PJ_DEF(pj_status_t) pj_turn_session_sendto( pj_turn_session *sess,
 				      (unsigned)send_ind_len,
 				      sess->srv_addr,
 				      pj_sockaddr_get_len(sess->srv_addr));
+	if (status == PJ_SUCCESS || status == PJ_EPENDING) {
+	    ++sess->tx_pkt_cnt;
+	    sess->tx_bytes += pkt_len;
+	}
     }
 
 on_return:
@@ -1295,6 +1346,9 @@ PJ_DEF(pj_status_t) pj_turn_session_on_rx_pkt2(
 	    goto on_return;
 	}
 
+	++sess->rx_pkt_cnt;
+	sess->rx_bytes += cd.length;
+
 	/* Notify application */
 	if (sess->cb.on_rx_data) {
 	    (*sess->cb.on_rx_data)(sess, ((pj_uint8_t*)prm->pkt)+sizeof(cd), 
@@ -1676,7 +1730,7 @@ static void stun_on_request_complete(pj_stun_session *stun,
 	    /* Iterate the permission table and invalidate all permissions
 	     * that are related to this request.
 	     */
-	    pj_hash_iterator_t it_buf, *it;
+	    unsigned i;
 	    char ipstr[PJ_INET6_ADDRSTRLEN+10];
 	    int err_code;
 	    char errbuf[PJ_ERR_MSG_SIZE];
@@ -1702,13 +1756,11 @@ static void stun_on_request_complete(pj_stun_session *stun,
 		reason = pj_strerror(status, errbuf, sizeof(errbuf));
 	    }
 
-	    it = pj_hash_first(sess->perm_table, &it_buf);
-	    while (it) {
+	    for (i=0; i<sess->perm_table.cap; ++i) {
 		struct perm_t *perm = (struct perm_t*)
-				      pj_hash_this(sess->perm_table, it);
-		it = pj_hash_next(sess->perm_table, it);
+				      sess->perm_table.slot[i].val;
 
-		if (perm->req_token == token) {
+		if (perm && perm->req_token == token) {
 		    PJ_LOG(1,(sess->obj_name, 
 			      "CreatePermission failed for IP %s: %d/%.*s",
 			      pj_sockaddr_print(&perm->addr, ipstr, 
@@ -1850,6 +1902,9 @@ static pj_status_t stun_on_rx_indication(pj_stun_session *stun,
 	return PJ_EINVALIDOP;
     }
 
+    ++sess->rx_pkt_cnt;
+    sess->rx_bytes += data_attr->length;
+
     /* Notify application */
     if (sess->cb.on_rx_data) {
 	(*sess->cb.on_rx_data)(sess, data_attr->data, data_attr->length, 
@@ -1934,6 +1989,172 @@ static void dns_srv_resolver_cb(void *user_data,
 }
 
 
+/*
+ * Hash the IP address and port number of a peer.
+ */
+static pj_uint32_t peer_hash(const pj_sockaddr *addr)
+{
+    pj_uint32_t h;
+
+    if (addr->addr.sa_family == pj_AF_INET()) {
+	h = addr->ipv4.sin_addr.s_addr;
+	h ^= (pj_uint32_t)addr->ipv4.sin_port << 16;
+    } else {
+	const pj_uint32_t *a = addr->ipv6.sin6_addr.u6_addr32;
+	h = a[0] ^ a[1] ^ a[2] ^ a[3];
+	h ^= (pj_uint32_t)addr->ipv6.sin6_port << 16;
+    }
+
+    /* Mix the bits, since the table index is taken from the low bits */
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+
+    return h;
+}
+
+static pj_bool_t peer_addr_eq(const pj_sockaddr *a1, const pj_sockaddr *a2)
+{
+    if (a1->addr.sa_family != a2->addr.sa_family)
+	return PJ_FALSE;
+
+    if (a1->addr.sa_family == pj_AF_INET()) {
+	return a1->ipv4.sin_addr.s_addr == a2->ipv4.sin_addr.s_addr &&
+	       a1->ipv4.sin_port == a2->ipv4.sin_port;
+    } else {
+	return a1->ipv6.sin6_port == a2->ipv6.sin6_port &&
+	       pj_memcmp(&a1->ipv6.sin6_addr, &a2->ipv6.sin6_addr,
+			 sizeof(pj_in6_addr)) == 0;
+    }
+}
+
+static void peer_tbl_init(pj_pool_t *pool, struct peer_tbl *tbl,
+			  unsigned cap)
+{
+    pj_assert(cap && (cap & (cap-1)) == 0);
+
+    tbl->cap = cap;
+    tbl->cnt = tbl->used = 0;
+    tbl->slot = (struct peer_slot*)
+		pj_pool_calloc(pool, cap, sizeof(struct peer_slot));
+}
+
+/*
+ * Find the slot of the specified key, or the empty slot where the key
+ * should be inserted.
+ */
+static struct peer_slot *peer_tbl_find(const struct peer_tbl *tbl,
+				       const pj_sockaddr *key,
+				       pj_uint32_t hval)
+{
+    unsigned mask = tbl->cap - 1;
+    unsigned i;
+
+    for (i = hval & mask; ; i = (i + 1) & mask) {
+	struct peer_slot *slot = &tbl->slot[i];
+
+	if (slot->key == NULL)
+	    return slot;
+
+	if (slot->val && slot->hval == hval && peer_addr_eq(slot->key, key))
+	    return slot;
+    }
+}
+
+/*
+ * Remove the deleted slots without reallocating the table. Each deleted
+ * slot is removed by shifting back the following entries of the cluster
+ * that may take its place (Knuth's Algorithm R for linear probing).
+ * Entries are only moved back along their probe sequence, so a deleted
+ * slot never moves in front of the scan position.
+ */
+static void peer_tbl_purge(struct peer_tbl *tbl)
+{
+    unsigned mask = tbl->cap - 1;
+    unsigned i = 0;
+
+    while (i < tbl->cap) {
+	unsigned hole, j;
+
+	if (tbl->slot[i].key == NULL || tbl->slot[i].val != NULL) {
+	    ++i;
+	    continue;
+	}
+
+	for (hole = j = i; ; ) {
+	    unsigned home;
+
+	    j = (j + 1) & mask;
+	    if (tbl->slot[j].key == NULL)
+		break;
+
+	    /* Entry stays if its home is cyclically in (hole, j] */
+	    home = tbl->slot[j].hval & mask;
+	    if (hole <= j ? (hole < home && home <= j) :
+			    (hole < home || home <= j))
+	    {
+		continue;
+	    }
+
+	    tbl->slot[hole] = tbl->slot[j];
+	    hole = j;
+	}
+
+	tbl->slot[hole].key = NULL;
+	tbl->slot[hole].val = NULL;
+	--tbl->used;
+    }
+
+    pj_assert(tbl->used == tbl->cnt);
+}
+
+/*
+ * Add new entry, the key must not exist in the table. The key must
+ * remain valid as long as the entry is in the table.
+ */
+static void peer_tbl_add(pj_pool_t *pool, struct peer_tbl *tbl,
+			 const pj_sockaddr *key, pj_uint32_t hval,
+			 void *val)
+{
+    struct peer_slot *slot;
+
+    /* Keep the load factor below 3/4, counting deleted slots. If the
+     * live entries need more room, grow the table, leaving the old slots
+     * in the pool as with other session allocations. Otherwise just
+     * purge the deleted slots, so adding and deleting permissions
+     * doesn't grow the session pool.
+     */
+    if ((tbl->used + 1) * 4 > tbl->cap * 3) {
+	if ((tbl->cnt + 1) * 2 > tbl->cap) {
+	    struct peer_tbl old = *tbl;
+	    unsigned i;
+
+	    peer_tbl_init(pool, tbl, old.cap * 2);
+	    for (i = 0; i < old.cap; ++i) {
+		if (old.slot[i].val) {
+		    *peer_tbl_find(tbl, old.slot[i].key, old.slot[i].hval) =
+			old.slot[i];
+		    ++tbl->cnt;
+		    ++tbl->used;
+		}
+	    }
+	} else {
+	    peer_tbl_purge(tbl);
+	}
+    }
+
+    slot = peer_tbl_find(tbl, key, hval);
+    pj_assert(slot->key == NULL);
+
+    slot->hval = hval;
+    slot->key = key;
+    slot->val = val;
+    ++tbl->cnt;
+    ++tbl->used;
+}
+
 /*
  * Lookup peer descriptor from its address.
  */
@@ -1943,19 +2164,18 @@ static struct ch_t *lookup_ch_by_addr(pj_turn_session *sess,
 				      pj_bool_t update,
 				      pj_bool_t bind_channel)
 {
-    pj_uint32_t hval = 0;
+    pj_uint32_t hval = peer_hash((const pj_sockaddr*)addr);
     struct ch_t *ch;
 
     ch = (struct ch_t*) 
-	 pj_hash_get(sess->ch_table, addr, addr_len, &hval);
+	 peer_tbl_find(&sess->ch_table, (const pj_sockaddr*)addr, hval)->val;
     if (ch == NULL && update) {
 	ch = PJ_POOL_ZALLOC_T(sess->pool, struct ch_t);
 	ch->num = PJ_TURN_INVALID_CHANNEL;
 	pj_memcpy(&ch->addr, addr, addr_len);
 
 	/* Register by peer address */
-	pj_hash_set(sess->pool, sess->ch_table, &ch->addr, addr_len,
-		    hval, ch);
+	peer_tbl_add(sess->pool, &sess->ch_table, &ch->addr, hval, ch);
     }
 
     if (ch && update) {
@@ -1963,15 +2183,31 @@ static struct ch_t *lookup_ch_by_addr(pj_turn_session *sess,
 	ch->expiry.sec += PJ_TURN_PERM_TIMEOUT - sess->ka_interval - 1;
 
 	if (bind_channel) {
-	    pj_uint32_t hval2 = 0;
+	    unsigned idx = ch->num - PJ_TURN_CHANNEL_MIN;
+
 	    /* Register by channel number */
 	    pj_assert(ch->num != PJ_TURN_INVALID_CHANNEL && ch->bound);
 
-	    if (pj_hash_get(sess->ch_table, &ch->num, 
-			    sizeof(ch->num), &hval2)==0) {
-		pj_hash_set(sess->pool, sess->ch_table, &ch->num,
-			    sizeof(ch->num), hval2, ch);
+	    if (idx >= sess->ch_arr_size) {
+		unsigned size = sess->ch_arr_size ? sess->ch_arr_size : 
+			        PJ_TURN_CHANNEL_HTABLE_SIZE;
+		struct ch_t **arr;
+
+		while (size <= idx)
+		    size *= 2;
+
+		arr = (struct ch_t**)
+		      pj_pool_calloc(sess->pool, size, sizeof(struct ch_t*));
+		if (sess->ch_arr_size) {
+		    pj_memcpy(arr, sess->ch_arr,
+			      sess->ch_arr_size * sizeof(struct ch_t*));
+		}
+		sess->ch_arr = arr;
+		sess->ch_arr_size = size;
 	    }
+
+	    if (sess->ch_arr[idx] == NULL)
+		sess->ch_arr[idx] = ch;
 	}
     }
 
@@ -1994,8 +2230,13 @@ static struct ch_t *lookup_ch_by_addr(pj_turn_session *sess,
 static struct ch_t *lookup_ch_by_chnum(pj_turn_session *sess,
 					 pj_uint16_t chnum)
 {
-    return (struct ch_t*) pj_hash_get(sess->ch_table, &chnum, 
-				      sizeof(chnum), NULL);
+    unsigned idx = (unsigned)chnum - PJ_TURN_CHANNEL_MIN;
+
+    /* Channel numbers below the minimum wrap to a large index */
+    if (idx >= sess->ch_arr_size)
+	return NULL;
+
+    return sess->ch_arr[idx];
 }
 
 
@@ -2007,7 +2248,7 @@ static struct perm_t *lookup_perm(pj_turn_session *sess,
 				  unsigned addr_len,
 				  pj_bool_t update)
 {
-    pj_uint32_t hval = 0;
+    pj_uint32_t hval;
     pj_sockaddr perm_addr;
     struct perm_t *perm;
 
@@ -2019,15 +2260,23 @@ static struct perm_t *lookup_perm(pj_turn_session *sess,
     }
 
     /* lookup and create if it doesn't exist and wanted */
+    hval = peer_hash((const pj_sockaddr*)addr);
     perm = (struct perm_t*) 
-	   pj_hash_get(sess->perm_table, addr, addr_len, &hval);
+	   peer_tbl_find(&sess->perm_table, (const pj_sockaddr*)addr,
+			 hval)->val;
     if (perm == NULL && update) {
-	perm = PJ_POOL_ZALLOC_T(sess->pool, struct perm_t);
+	if (sess->perm_free) {
+	    perm = sess->perm_free;
+	    sess->perm_free = perm->next;
+	    pj_bzero(perm, sizeof(*perm));
+	} else {
+	    perm = PJ_POOL_ZALLOC_T(sess->pool, struct perm_t);
+	}
 	pj_memcpy(&perm->addr, addr, addr_len);
 	perm->hval = hval;
 
-	pj_hash_set(sess->pool, sess->perm_table, &perm->addr, addr_len,
-		    perm->hval, perm);
+	peer_tbl_add(sess->pool, &sess->perm_table, &perm->addr,
+		     perm->hval, perm);
     }
 
     if (perm && update) {
@@ -2045,12 +2294,21 @@ static struct perm_t *lookup_perm(pj_turn_session *sess,
 static void invalidate_perm(pj_turn_session *sess,
 			    struct perm_t *perm)
 {
-    pj_hash_set(NULL, sess->perm_table, &perm->addr,
-		pj_sockaddr_get_len(&perm->addr), perm->hval, NULL);
+    struct peer_slot *slot;
+
+    slot = peer_tbl_find(&sess->perm_table, &perm->addr, perm->hval);
+    if (slot->val == perm) {
+	/* Keep the key so the probe sequence is not broken */
+	slot->val = NULL;
+	--sess->perm_table.cnt;
+
+	perm->next = sess->perm_free;
+	sess->perm_free = perm;
+    }
 }
 
 /*
- * Scan permission's hash table to refresh the permission.
+ * Scan permission table to refresh the permission.
  */
 static unsigned refresh_permissions(pj_turn_session *sess, 
 				    const pj_time_val *now)
@@ -2058,15 +2316,14 @@ static unsigned refresh_permissions(pj_turn_session *sess,
     pj_stun_tx_data *tdata = NULL;
     unsigned count = 0;
     void *req_token = NULL;
-    pj_hash_iterator_t *it, itbuf;
+    unsigned i;
     pj_status_t status;
 
-    it = pj_hash_first(sess->perm_table, &itbuf);
-    while (it) {
-	struct perm_t *perm = (struct perm_t*)
-			      pj_hash_this(sess->perm_table, it);
+    for (i=0; i<sess->perm_table.cap; ++i) {
+	struct perm_t *perm = (struct perm_t*)sess->perm_table.slot[i].val;
 
-	it = pj_hash_next(sess->perm_table, it);
+	if (perm == NULL)
+	    continue;
 
 	if (perm->expiry.sec-1 <= now->sec) {
 	    if (perm->renew) {
@@ -2149,7 +2406,7 @@ static void on_timer_event(pj_timer_heap_t *th, pj_timer_entry *e)
     
     if (eid == TIMER_KEEP_ALIVE) {
 	pj_time_val now;
-	pj_hash_iterator_t itbuf, *it;
+	unsigned i;
 	pj_bool_t resched = PJ_TRUE;
 	pj_bool_t pkt_sent = PJ_FALSE;
 
@@ -2172,12 +2429,10 @@ static void on_timer_event(pj_timer_heap_t *th, pj_timer_entry *e)
 	    pkt_sent = PJ_TRUE;
 	}
 
-	/* Scan hash table to refresh bound channels */
-	it = pj_hash_first(sess->ch_table, &itbuf);
-	while (it) {
-	    struct ch_t *ch = (struct ch_t*) 
-			      pj_hash_this(sess->ch_table, it);
-	    if (ch->bound && PJ_TIME_VAL_LTE(ch->expiry, now)) {
+	/* Scan bound channels to refresh them */
+	for (i=0; i<sess->ch_arr_size; ++i) {
+	    struct ch_t *ch = sess->ch_arr[i];
+	    if (ch && ch->bound && PJ_TIME_VAL_LTE(ch->expiry, now)) {
 
 		/* Send ChannelBind to refresh channel binding and 
 		 * permission.
@@ -2186,8 +2441,6 @@ static void on_timer_event(pj_timer_heap_t *th, pj_timer_entry *e)
 					     pj_sockaddr_get_len(&ch->addr));
 		pkt_sent = PJ_TRUE;
 	    }
-
-	    it = pj_hash_next(sess->ch_table, it);
 	}
 
 	/* Scan permission table to refresh permissions */
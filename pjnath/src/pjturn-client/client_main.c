@@ -33,6 +33,10 @@
 //#define OPTIONS		PJ_STUN_NO_AUTHENTICATE
 #define OPTIONS		0
 
+/* Benchmark settings */
+#define BENCH_PKT_LEN	160		    /* Payload size		*/
+#define BENCH_BURST	32		    /* Packets per burst per dir.	*/
+
 
 struct peer
 {
@@ -55,6 +59,14 @@ static struct global
     pj_sockaddr		 relay_addr;
 
     struct peer		 peer[2];
+
+    /* Benchmark counters */
+    struct {
+	pj_uint32_t	 client_tx;
+	pj_uint32_t	 client_rx;
+	pj_uint32_t	 peer_tx;
+	pj_uint32_t	 peer_rx;
+    } bench;
 } g;
 
 static struct options
@@ -68,6 +80,7 @@ static struct options
     pj_bool_t	 use_fingerprint;
     char	*stun_server;
     char	*nameserver;
+    unsigned	 bench_duration;
 } o;
 
 
@@ -321,6 +334,11 @@ static void turn_on_rx_data(pj_turn_sock *relay,
 {
     char addrinfo[80];
 
+    if (o.bench_duration) {
+	++g.bench.client_rx;
+	return;
+    }
+
     pj_sockaddr_print(peer_addr, addrinfo, sizeof(addrinfo), 3);
 
     PJ_LOG(3,(THIS_FILE, "Client received %d bytes data from %s: %.*s",
@@ -390,6 +408,11 @@ static pj_bool_t stun_sock_on_rx_data(pj_stun_sock *stun_sock,
     struct peer *peer = (struct peer*) pj_stun_sock_get_user_data(stun_sock);
     char straddr[PJ_INET6_ADDRSTRLEN+10];
 
+    if (o.bench_duration) {
+	++g.bench.peer_rx;
+	return PJ_TRUE;
+    }
+
     ((char*)pkt)[pkt_len] = '\0';
 
     pj_sockaddr_print(src_addr, straddr, sizeof(straddr), 3);
@@ -462,6 +485,14 @@ static void console_main(void)
 	    break;
 	case 'd':
 	    pj_pool_factory_dump(&g.cp.factory, PJ_TRUE);
+	    if (g.relay) {
+		pj_turn_session_info info;
+
+		pj_turn_sock_get_info(g.relay, &info);
+		printf("Relayed data: tx %u pkts/%u bytes, rx %u pkts/%u bytes\n",
+		       info.tx_pkt_cnt, info.tx_bytes,
+		       info.rx_pkt_cnt, info.rx_bytes);
+	    }
 	    break;
 	case 's':
 	    if (g.relay == NULL) {
@@ -536,6 +567,113 @@ static void console_main(void)
 }
 
 
+/* Wait until cond is true, or timeout (in msec) */
+#define WAIT_UNTIL(cond, timeout)   { \
+				      unsigned t_; \
+				      for (t_=0; !(cond) && t_<timeout; \
+					   t_+=10) \
+					  pj_thread_sleep(10); \
+				    }
+
+/*
+ * Benchmark the relay throughput of the server: bind a channel to peer 0,
+ * then send data from the client to the peer and from the peer to the
+ * client as fast as possible, and count the packets that go through.
+ */
+static pj_status_t bench_main(void)
+{
+    struct peer *peer = &g.peer[0];
+    pj_uint8_t pkt[BENCH_PKT_LEN];
+    pj_timestamp t0, t1;
+    pj_uint32_t msec;
+    pj_status_t status;
+
+    pj_memset(pkt, 'x', sizeof(pkt));
+
+    WAIT_UNTIL(pj_sockaddr_has_addr(&peer->mapped_addr), 5000);
+    if (!pj_sockaddr_has_addr(&peer->mapped_addr)) {
+	PJ_LOG(1,(THIS_FILE, "Error: peer0 has no mapped address"));
+	return PJ_ETIMEDOUT;
+    }
+
+    status = create_relay();
+    if (status != PJ_SUCCESS)
+	return status;
+
+    WAIT_UNTIL(pj_sockaddr_has_addr(&g.relay_addr), 5000);
+    if (!g.relay || !pj_sockaddr_has_addr(&g.relay_addr)) {
+	PJ_LOG(1,(THIS_FILE, "Error: allocation failed"));
+	return PJ_ETIMEDOUT;
+    }
+
+    status = pj_turn_sock_bind_channel(g.relay, &peer->mapped_addr,
+				       pj_sockaddr_get_len(&peer->mapped_addr));
+    if (status != PJ_SUCCESS) {
+	my_perror("pj_turn_sock_bind_channel() failed", status);
+	return status;
+    }
+
+    /* Give ChannelBind some time to complete */
+    pj_thread_sleep(500);
+
+    PJ_LOG(3,(THIS_FILE, "Relaying %d bytes packets for %d seconds..",
+	      BENCH_PKT_LEN, o.bench_duration));
+
+    pj_bzero(&g.bench, sizeof(g.bench));
+    pj_get_timestamp(&t0);
+    do {
+	unsigned i;
+
+	for (i=0; i<BENCH_BURST && g.relay; ++i) {
+	    status = pj_turn_sock_sendto(g.relay, pkt, sizeof(pkt),
+					 &peer->mapped_addr,
+					 pj_sockaddr_get_len(&peer->mapped_addr));
+	    if (status == PJ_SUCCESS || status == PJ_EPENDING)
+		++g.bench.client_tx;
+
+	    status = pj_stun_sock_sendto(peer->stun_sock, NULL, pkt,
+					 sizeof(pkt), 0, &g.relay_addr,
+					 pj_sockaddr_get_len(&g.relay_addr));
+	    if (status == PJ_SUCCESS || status == PJ_EPENDING)
+		++g.bench.peer_tx;
+	}
+	pj_thread_sleep(1);
+
+	pj_get_timestamp(&t1);
+	msec = pj_elapsed_msec(&t0, &t1);
+    } while (msec < o.bench_duration * 1000 && g.relay);
+
+    /* Wait for the packets in flight */
+    pj_thread_sleep(200);
+
+    if (msec == 0)
+	msec = 1;
+
+    printf("\nClient -> peer: %u sent, %u relayed, %u pkt/s\n",
+	   g.bench.client_tx, g.bench.peer_rx,
+	   (unsigned)((pj_uint64_t)g.bench.peer_rx * 1000 / msec));
+    printf("Peer -> client: %u sent, %u relayed, %u pkt/s\n",
+	   g.bench.peer_tx, g.bench.client_rx,
+	   (unsigned)((pj_uint64_t)g.bench.client_rx * 1000 / msec));
+    printf("Total relayed : %u pkt/s\n",
+	   (unsigned)((pj_uint64_t)(g.bench.peer_rx + g.bench.client_rx) *
+		      1000 / msec));
+
+    if (g.relay) {
+	pj_turn_session_info info;
+
+	pj_turn_sock_get_info(g.relay, &info);
+	printf("TURN session  : tx %u pkt/s (%u KB/s), rx %u pkt/s (%u KB/s)\n",
+	       (unsigned)((pj_uint64_t)info.tx_pkt_cnt * 1000 / msec),
+	       (unsigned)((pj_uint64_t)info.tx_bytes / msec),
+	       (unsigned)((pj_uint64_t)info.rx_pkt_cnt * 1000 / msec),
+	       (unsigned)((pj_uint64_t)info.rx_bytes / msec));
+    }
+
+    return PJ_SUCCESS;
+}
+
+
 static void usage(void)
 {
     puts("Usage: pjturn_client TURN-SERVER [OPTIONS]");
@@ -550,6 +688,7 @@ static void usage(void)
     puts(" --fingerprint, -F     Use fingerprint for outgoing requests");
     puts(" --stun-srv, -S  NAME  Use this STUN srv instead of TURN for Binding discovery");
     puts(" --nameserver, -N IP   Activate DNS SRV, use this DNS server");
+    puts(" --bench, -B SECS      Run relay benchmark for SECS seconds and quit");
     puts(" --help, -h");
 }
 
@@ -563,13 +702,14 @@ int main(int argc, char *argv[])
 	{ "tcp",        0, 0, 'T'},
 	{ "help",	0, 0, 'h'},
 	{ "stun-srv",   1, 0, 'S'},
-	{ "nameserver", 1, 0, 'N'}
+	{ "nameserver", 1, 0, 'N'},
+	{ "bench",	1, 0, 'B'}
     };
     int c, opt_id;
     char *pos;
     pj_status_t status;
 
-    while((c=pj_getopt_long(argc,argv, "r:u:p:S:N:hFT", long_options, &opt_id))!=-1) {
+    while((c=pj_getopt_long(argc,argv, "r:u:p:S:N:B:hFT", long_options, &opt_id))!=-1) {
 	switch (c) {
 	case 'r':
 	    o.realm = pj_optarg;
@@ -595,6 +735,9 @@ int main(int argc, char *argv[])
 	case 'N':
 	    o.nameserver = pj_optarg;
 	    break;
+	case 'B':
+	    o.bench_duration = atoi(pj_optarg);
+	    break;
 	default:
 	    printf("Argument \"%s\" is not valid. Use -h to see help",
 		   argv[pj_optind]);
@@ -622,7 +765,10 @@ int main(int argc, char *argv[])
     //if ((status=create_relay()) != 0)
     //	goto on_return;
     
-    console_main();
+    if (o.bench_duration)
+	status = bench_main();
+    else
+	console_main();
 
 on_return:
     client_shutdown();
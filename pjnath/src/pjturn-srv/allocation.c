@@ -17,9 +17,18 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
+/* recvmmsg() and sendmmsg() need _GNU_SOURCE */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#   define _GNU_SOURCE
+#endif
+
 #include "turn.h"
 #include "auth.h"
 
+#if PJ_TURN_SRV_HAS_MMSG
+#   include <sys/socket.h>
+#endif
+
 
 #define THIS_FILE   "allocation.c"
 
@@ -40,6 +49,25 @@ enum {
 #define MAX_LIFETIME		600
 #define DEF_LIFETIME		300
 
+#define CH_HDR_LEN		sizeof(pj_turn_channel_data)
+#define CH_LOOKUP_IDX(ch)	((ch) & (PJ_TURN_SRV_CH_LOOKUP_SIZE-1))
+
+#if PJ_TURN_SRV_HAS_MMSG
+/* Buffers to relay packets from peers to clients in batches. There is one
+ * per relay shard, used only by the shard thread.
+ */
+struct relay_batch
+{
+    struct mmsghdr	rx_msg[PJ_TURN_SRV_MAX_BATCH];
+    struct iovec	rx_iov[PJ_TURN_SRV_MAX_BATCH];
+    pj_sockaddr		src_addr[PJ_TURN_SRV_MAX_BATCH];
+    struct mmsghdr	tx_msg[PJ_TURN_SRV_MAX_BATCH];
+    struct iovec	tx_iov[PJ_TURN_SRV_MAX_BATCH];
+    char		buf[PJ_TURN_SRV_MAX_BATCH]
+			   [CH_HDR_LEN + PJ_TURN_MAX_PKT_LEN];
+};
+#endif
+
 
 /* Parsed Allocation request. */
 typedef struct alloc_request
@@ -715,8 +743,10 @@ static pj_status_t create_relay(pj_turn_srv *srv,
     pj_bzero(&icb, sizeof(icb));
     icb.on_read_complete = &on_rx_from_peer;
 
-    status = pj_ioqueue_register_sock(pool, srv->core.ioqueue, relay->tp.sock,
-				      relay, &icb, &relay->tp.key);
+    relay->tp.shard = pj_turn_srv_get_relay_shard(srv);
+    status = pj_ioqueue_register_sock(pool, relay->tp.shard->ioqueue,
+				      relay->tp.sock, relay, &icb,
+				      &relay->tp.key);
     if (status != PJ_SUCCESS) {
 	PJ_LOG(4,(THIS_FILE, "pj_ioqueue_register_sock() failed: err %d",
 		  status));
@@ -838,10 +868,12 @@ static pj_turn_permission *check_permission_expiry(pj_turn_permission *perm)
 		pj_sockaddr_get_addr(&perm->hkey.peer_addr),
 	        pj_sockaddr_get_addr_len(&perm->hkey.peer_addr), 0, NULL);
 
-    /* Remove from channel hash table, if assigned a channel number */
+    /* Remove from channel tables, if assigned a channel number */
     if (perm->channel != PJ_TURN_INVALID_CHANNEL) {
 	pj_hash_set(NULL, alloc->ch_table, &perm->channel,
 		    sizeof(perm->channel), 0, NULL);
+	if (alloc->ch_lookup[CH_LOOKUP_IDX(perm->channel)] == perm)
+	    alloc->ch_lookup[CH_LOOKUP_IDX(perm->channel)] = NULL;
     }
 
     return NULL;
@@ -874,9 +906,17 @@ lookup_permission_by_chnum(pj_turn_allocation *alloc,
     pj_uint16_t chnum16 = (pj_uint16_t)chnum;
     pj_turn_permission *perm;
 
-    /* Lookup in peer hash table */
+    /* Lookup in the lookup table first */
+    perm = alloc->ch_lookup[CH_LOOKUP_IDX(chnum)];
+    if (perm && perm->channel == chnum16)
+	return check_permission_expiry(perm);
+
+    /* Lookup in channel hash table */
     perm = (pj_turn_permission*) pj_hash_get(alloc->ch_table, &chnum16,
 					    sizeof(chnum16), NULL);
+    if (perm)
+	alloc->ch_lookup[CH_LOOKUP_IDX(chnum)] = perm;
+
     return perm ? check_permission_expiry(perm) : NULL;
 }
 
@@ -999,12 +1039,17 @@ on_return:
 
 /*
  * Handle incoming packet from peer. This function is called by
- * on_rx_from_peer().
+ * on_rx_from_peer(). The packet buffer must have room for ChannelData
+ * header in front of it, so that ChannelData can be built in place.
+ *
+ * If send_now is PJ_FALSE and the packet is to be relayed as ChannelData,
+ * the ChannelData is not sent but its length is returned, and it starts
+ * CH_HDR_LEN bytes before the packet. Otherwise zero is returned.
  */
-static void handle_peer_pkt(pj_turn_allocation *alloc,
-			    pj_turn_relay_res *rel,
-			    char *pkt, pj_size_t len,
-			    const pj_sockaddr *src_addr)
+static pj_size_t handle_peer_pkt(pj_turn_allocation *alloc,
+				 char *pkt, pj_size_t len,
+				 const pj_sockaddr *src_addr,
+				 pj_bool_t send_now)
 {
     pj_turn_permission *perm;
 
@@ -1013,7 +1058,7 @@ static void handle_peer_pkt(pj_turn_allocation *alloc,
 				     pj_sockaddr_get_len(src_addr));
     if (perm == NULL) {
 	/* No permission, discard data */
-	return;
+	return 0;
     }
 
     /* Send Data Indication or ChannelData, depends on whether
@@ -1021,7 +1066,7 @@ static void handle_peer_pkt(pj_turn_allocation *alloc,
      */
     if (perm->channel != PJ_TURN_INVALID_CHANNEL) {
 	/* Send ChannelData */
-	pj_turn_channel_data *cd = (pj_turn_channel_data*)rel->tp.tx_pkt;
+	pj_turn_channel_data *cd = (pj_turn_channel_data*)(pkt - CH_HDR_LEN);
 
 	if (len > PJ_TURN_MAX_PKT_LEN) {
 	    char peer_addr[80];
@@ -1029,19 +1074,18 @@ static void handle_peer_pkt(pj_turn_allocation *alloc,
 	    PJ_LOG(4,(alloc->obj_name, "Client %s: discarded data from %s "
 		      "because it's too long (%d bytes)",
 		      alloc->info, peer_addr, len));
-	    return;
+	    return 0;
 	}
 
-	/* Init header */
+	/* Init header, the data is already in place */
 	cd->ch_number = pj_htons(perm->channel);
 	cd->length = pj_htons((pj_uint16_t)len);
 
-	/* Copy data */
-	pj_memcpy(rel->tp.tx_pkt+sizeof(pj_turn_channel_data), pkt, len);
+	if (!send_now)
+	    return len + CH_HDR_LEN;
 
 	/* Send to client */
-	alloc->transport->sendto(alloc->transport, rel->tp.tx_pkt,
-			         len+sizeof(pj_turn_channel_data), 0,
+	alloc->transport->sendto(alloc->transport, cd, len + CH_HDR_LEN, 0,
 			         &alloc->hkey.clt_addr,
 			         pj_sockaddr_get_len(&alloc->hkey.clt_addr));
     } else {
@@ -1053,7 +1097,7 @@ static void handle_peer_pkt(pj_turn_allocation *alloc,
 					    PJ_STUN_DATA_INDICATION, &tdata);
 	if (status != PJ_SUCCESS) {
 	    alloc_err(alloc, "Error creating Data indication", status);
-	    return;
+	    return 0;
 	}
 
 	pj_stun_msg_add_sockaddr_attr(tdata->pool, tdata->msg,
@@ -1068,7 +1112,103 @@ static void handle_peer_pkt(pj_turn_allocation *alloc,
 				 pj_sockaddr_get_len(&alloc->hkey.clt_addr),
 				 tdata);
     }
+
+    return 0;
+}
+
+#if PJ_TURN_SRV_HAS_MMSG
+/*
+ * Receive the packets queued in the relay socket with recvmmsg() and
+ * relay the ChannelData ones to the UDP client with one sendmmsg().
+ * This is called by the shard thread with the allocation locked.
+ */
+static void relay_batch(pj_turn_relay_res *rel)
+{
+    pj_turn_relay_shard *shard = rel->tp.shard;
+    pj_turn_allocation *alloc = rel->allocation;
+    pj_turn_listener *lis = alloc->transport->listener;
+    pj_bool_t udp_client = (lis->tp_type == PJ_TURN_TP_UDP);
+    struct relay_batch *b;
+    int i, cnt, tx_cnt;
+
+    if (!shard->batch) {
+	shard->batch = pj_pool_zalloc(shard->pool, sizeof(struct relay_batch));
+    }
+    b = (struct relay_batch*) shard->batch;
+
+    do {
+	for (i=0; i<PJ_TURN_SRV_MAX_BATCH; ++i) {
+	    struct msghdr *hdr = &b->rx_msg[i].msg_hdr;
+
+	    b->rx_iov[i].iov_base = b->buf[i] + CH_HDR_LEN;
+	    b->rx_iov[i].iov_len = PJ_TURN_MAX_PKT_LEN;
+	    pj_bzero(hdr, sizeof(*hdr));
+	    hdr->msg_name = &b->src_addr[i];
+	    hdr->msg_namelen = sizeof(b->src_addr[i]);
+	    hdr->msg_iov = &b->rx_iov[i];
+	    hdr->msg_iovlen = 1;
+	}
+
+	cnt = recvmmsg((int)rel->tp.sock, b->rx_msg, PJ_TURN_SRV_MAX_BATCH,
+		       MSG_DONTWAIT, NULL);
+	if (cnt <= 0)
+	    break;
+
+	++shard->batch_cnt;
+	shard->rx_cnt += cnt;
+
+	for (i=0, tx_cnt=0; i<cnt; ++i) {
+	    pj_size_t len;
+
+	    /* Discard packet that didn't fit in the buffer, as
+	     * on_rx_from_peer() does.
+	     */
+	    if (b->rx_msg[i].msg_hdr.msg_flags & MSG_TRUNC)
+		continue;
+
+	    len = handle_peer_pkt(alloc, b->buf[i] + CH_HDR_LEN,
+				  b->rx_msg[i].msg_len, &b->src_addr[i],
+				  !udp_client);
+	    if (len) {
+		struct msghdr *hdr = &b->tx_msg[tx_cnt].msg_hdr;
+
+		b->tx_iov[tx_cnt].iov_base = b->buf[i];
+		b->tx_iov[tx_cnt].iov_len = len;
+		pj_bzero(hdr, sizeof(*hdr));
+		hdr->msg_name = &alloc->hkey.clt_addr;
+		hdr->msg_namelen = pj_sockaddr_get_len(&alloc->hkey.clt_addr);
+		hdr->msg_iov = &b->tx_iov[tx_cnt];
+		hdr->msg_iovlen = 1;
+		++tx_cnt;
+	    }
+	}
+
+	/* sendmmsg() stops at the first message that fails, e.g. when the
+	 * socket buffer is full. Retry the rest, and send them one by one
+	 * if it keeps failing.
+	 */
+	for (i=0; i<tx_cnt; ) {
+	    int sent = sendmmsg((int)lis->sock, b->tx_msg + i, tx_cnt - i, 0);
+	    if (sent <= 0)
+		break;
+	    i += sent;
+	    shard->tx_cnt += sent;
+	}
+	for (; i<tx_cnt; ++i) {
+	    pj_status_t status;
+
+	    status = alloc->transport->sendto(alloc->transport,
+					      b->tx_iov[i].iov_base,
+					      b->tx_iov[i].iov_len, 0,
+					      &alloc->hkey.clt_addr,
+					      b->tx_msg[i].msg_hdr.msg_namelen);
+	    if (status == PJ_SUCCESS)
+		++shard->tx_cnt;
+	}
+
+    } while (cnt == PJ_TURN_SRV_MAX_BATCH);
 }
+#endif	/* PJ_TURN_SRV_HAS_MMSG */
 
 /*
  * ioqueue notification on RX packets from the relay socket.
@@ -1087,15 +1227,32 @@ static void on_rx_from_peer(pj_ioqueue_key_t *key,
 
     do {
 	if (bytes_read > 0) {
-	    handle_peer_pkt(rel->allocation, rel, rel->tp.rx_pkt,
-			    bytes_read, &rel->tp.src_addr);
+	    ++rel->tp.shard->rx_cnt;
+
+	    /* Discard packet that didn't fit in the buffer. The read is one
+	     * byte longer than the maximum, so the packet would have been
+	     * silently truncated otherwise.
+	     */
+	    if (bytes_read <= PJ_TURN_MAX_PKT_LEN) {
+		handle_peer_pkt(rel->allocation, rel->tp.rx_pkt + CH_HDR_LEN,
+				bytes_read, &rel->tp.src_addr, PJ_TRUE);
+	    }
+
+#if PJ_TURN_SRV_HAS_MMSG
+	    /* Relay the rest of the queued packets in batches. The batch
+	     * buffers belong to the shard thread.
+	     */
+	    if (pj_thread_this() == rel->tp.shard->thread)
+		relay_batch(rel);
+#endif
 	}
 
 	/* Read next packet */
-	bytes_read = sizeof(rel->tp.rx_pkt);
+	bytes_read = PJ_TURN_MAX_PKT_LEN + 1;
 	rel->tp.src_addr_len = sizeof(rel->tp.src_addr);
 	status = pj_ioqueue_recvfrom(key, op_key,
-				     rel->tp.rx_pkt, &bytes_read, 0,
+				     rel->tp.rx_pkt + CH_HDR_LEN,
+				     &bytes_read, 0,
 				     &rel->tp.src_addr,
 				     &rel->tp.src_addr_len);
 
@@ -1285,6 +1442,7 @@ static pj_status_t stun_on_rx_request(pj_stun_session *sess,
 	pj_assert(sizeof(p2->channel)==2);
 	pj_hash_set(alloc->pool, alloc->ch_table, &p2->channel,
 		    sizeof(p2->channel), 0, p2);
+	alloc->ch_lookup[CH_LOOKUP_IDX(p2->channel)] = p2;
 
 	/* Update */
 	refresh_permission(p2);
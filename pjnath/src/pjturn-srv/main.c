@@ -57,6 +57,11 @@ static void dump_status(pj_turn_srv *srv)
     printf("TCP port range : %u %u %u (next/min/max)\n", srv->ports.next_tcp,
 	   srv->ports.min_tcp, srv->ports.max_tcp);
     printf("Clients #      : %u\n", pj_hash_count(srv->tables.alloc));
+    for (i=0; i<srv->relay.cnt; ++i) {
+	pj_turn_relay_shard *shard = &srv->relay.shard[i];
+	printf("Relay shard %u  : %u rx, %u tx in %u batches\n", shard->id,
+	       shard->rx_cnt, shard->tx_cnt, shard->batch_cnt);
+    }
 
     puts("");
 
@@ -29,10 +29,12 @@
 #define MAX_PORT		65535
 #define MAX_LISTENERS		16
 #define MAX_THREADS		2
+#define MAX_RELAY_SHARDS	2
 #define MAX_NET_EVENTS		1000
 
 /* Prototypes */
 static int server_thread_proc(void *arg);
+static int relay_thread_proc(void *arg);
 static pj_status_t on_tx_stun_msg( pj_stun_session *sess,
 				   void *token,
 				   const void *pkt,
@@ -180,6 +182,28 @@ PJ_DEF(pj_status_t) pj_turn_srv_create(pj_pool_factory *pf,
 	    goto on_error;
     }
 
+    /* Create relay shards, each with its own ioqueue and thread */
+    srv->relay.cnt = MAX_RELAY_SHARDS;
+    srv->relay.shard = (pj_turn_relay_shard*)
+		       pj_pool_calloc(pool, srv->relay.cnt,
+				      sizeof(pj_turn_relay_shard));
+    for (i=0; i<srv->relay.cnt; ++i) {
+	pj_turn_relay_shard *shard = &srv->relay.shard[i];
+
+	shard->id = i;
+	shard->server = srv;
+	shard->pool = pj_pool_create(pf, "relay%p", 1000, 1000, NULL);
+
+	status = pj_ioqueue_create(shard->pool, MAX_HANDLES, &shard->ioqueue);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+	status = pj_thread_create(shard->pool, "relay%p", &relay_thread_proc,
+				  shard, 0, 0, &shard->thread);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+    }
+
     /* We're done. Application should add listeners now */
     PJ_LOG(4,(srv->obj_name, "TURN server v%s is running",
 	      pj_get_version()));
@@ -263,6 +287,36 @@ static int server_thread_proc(void *arg)
     return 0;
 }
 
+/*
+ * Relay shard thread proc.
+ */
+static int relay_thread_proc(void *arg)
+{
+    pj_turn_relay_shard *shard = (pj_turn_relay_shard*)arg;
+
+    while (!shard->server->core.quit) {
+	pj_time_val timeout = {0, 100};
+	pj_ioqueue_poll(shard->ioqueue, &timeout);
+    }
+
+    return 0;
+}
+
+/*
+ * Get the relay shard for a new relay socket.
+ */
+PJ_DEF(pj_turn_relay_shard*) pj_turn_srv_get_relay_shard(pj_turn_srv *srv)
+{
+    pj_turn_relay_shard *shard;
+
+    pj_lock_acquire(srv->core.lock);
+    shard = &srv->relay.shard[srv->relay.next];
+    srv->relay.next = (srv->relay.next + 1) % srv->relay.cnt;
+    pj_lock_release(srv->core.lock);
+
+    return shard;
+}
+
 /*
  * Destroy the server.
  */
@@ -280,6 +334,13 @@ PJ_DEF(pj_status_t) pj_turn_srv_destroy(pj_turn_srv *srv)
 	    srv->core.thread[i] = NULL;
 	}
     }
+    for (i=0; i<srv->relay.cnt; ++i) {
+	if (srv->relay.shard[i].thread) {
+	    pj_thread_join(srv->relay.shard[i].thread);
+	    pj_thread_destroy(srv->relay.shard[i].thread);
+	    srv->relay.shard[i].thread = NULL;
+	}
+    }
 
     /* Destroy all allocations FIRST */
     if (srv->tables.alloc) {
@@ -319,6 +380,21 @@ PJ_DEF(pj_status_t) pj_turn_srv_destroy(pj_turn_srv *srv)
 	srv->core.timer_heap = NULL;
     }
 
+    /* Destroy relay shards */
+    for (i=0; i<srv->relay.cnt; ++i) {
+	pj_turn_relay_shard *shard = &srv->relay.shard[i];
+
+	if (shard->ioqueue) {
+	    pj_ioqueue_destroy(shard->ioqueue);
+	    shard->ioqueue = NULL;
+	}
+	if (shard->pool) {
+	    pj_pool_release(shard->pool);
+	    shard->pool = NULL;
+	}
+    }
+    srv->relay.cnt = 0;
+
     /* Destroy ioqueue */
     if (srv->core.ioqueue) {
 	pj_ioqueue_destroy(srv->core.ioqueue);
@@ -30,10 +30,33 @@ typedef struct pj_turn_permission   pj_turn_permission;
 typedef struct pj_turn_allocation   pj_turn_allocation;
 typedef struct pj_turn_srv	    pj_turn_srv;
 typedef struct pj_turn_pkt	    pj_turn_pkt;
+typedef struct pj_turn_relay_shard  pj_turn_relay_shard;
 
 
 #define PJ_TURN_INVALID_LIS_ID	    ((unsigned)-1)
 
+/**
+ * Use recvmmsg() and sendmmsg() to relay packets from peers to clients
+ * in batches.
+ */
+#ifndef PJ_TURN_SRV_HAS_MMSG
+#   if defined(PJ_LINUX) && PJ_LINUX!=0
+#	define PJ_TURN_SRV_HAS_MMSG	1
+#   else
+#	define PJ_TURN_SRV_HAS_MMSG	0
+#   endif
+#endif
+
+/**
+ * Maximum number of packets received or sent in one batch.
+ */
+#define PJ_TURN_SRV_MAX_BATCH	    32
+
+/**
+ * Size of the channel lookup table of an allocation. Must be power of two.
+ */
+#define PJ_TURN_SRV_CH_LOOKUP_SIZE  64
+
 /** 
  * Get transport type name string.
  */
@@ -80,20 +103,24 @@ struct pj_turn_relay_res
 	/** Transport/relay ioqueue */
 	pj_ioqueue_key_t    *key;
 
+	/** Relay shard which polls this socket */
+	pj_turn_relay_shard *shard;
+
 	/** Read operation key. */
 	pj_ioqueue_op_key_t read_key;
 
-	/** The incoming packet buffer */
-	char		    rx_pkt[PJ_TURN_MAX_PKT_LEN];
+	/** The incoming packet buffer. The packet is received after room
+	 *  for ChannelData header, so it can be relayed in place. The extra
+	 *  byte is to detect packets longer than PJ_TURN_MAX_PKT_LEN.
+	 */
+	char		    rx_pkt[sizeof(pj_turn_channel_data) +
+				   PJ_TURN_MAX_PKT_LEN + 1];
 
 	/** Source address of the packet. */
 	pj_sockaddr	    src_addr;
 
 	/** Source address length */
 	int		    src_addr_len;
-
-	/** The outgoing packet buffer. This must be 3wbit aligned. */
-	char		    tx_pkt[PJ_TURN_MAX_PKT_LEN+4];
     } tp;
 };
 
@@ -160,6 +187,11 @@ struct pj_turn_allocation
 
     /** Channel hash table (keyed by channel number) */
     pj_hash_table_t	*ch_table;
+
+    /** Channel lookup table, indexed by the lower bits of the channel
+     *  number, in front of the channel hash table.
+     */
+    pj_turn_permission	*ch_lookup[PJ_TURN_SRV_CH_LOOKUP_SIZE];
 };
 
 
@@ -374,6 +406,42 @@ PJ_DECL(void) pj_turn_transport_dec_ref(pj_turn_transport *transport,
 /*
  * TURN Server API
  */
+/**
+ * This structure describes relay shard. The relay sockets are distributed
+ * among the shards, and each shard polls its own ioqueue in its own
+ * thread, so that relaying data doesn't compete with signaling in the
+ * server worker threads.
+ */
+struct pj_turn_relay_shard
+{
+    /** Shard index. */
+    unsigned		 id;
+
+    /** Server instance. */
+    pj_turn_srv		*server;
+
+    /** Pool, only used by the shard thread. */
+    pj_pool_t		*pool;
+
+    /** Ioqueue for the relay sockets. */
+    pj_ioqueue_t	*ioqueue;
+
+    /** Shard thread. */
+    pj_thread_t		*thread;
+
+    /** Batch buffers, allocated by the shard thread on first use. */
+    void		*batch;
+
+    /** Number of packets received from peers. */
+    pj_uint32_t		 rx_cnt;
+
+    /** Number of packets relayed to clients by the batch relay. */
+    pj_uint32_t		 tx_cnt;
+
+    /** Number of batches. */
+    pj_uint32_t		 batch_cnt;
+};
+
 /**
  * This structure describes TURN pj_turn_srv instance.
  */
@@ -428,6 +496,19 @@ struct pj_turn_srv
 
     } core;
 
+    /** Relay shards */
+    struct {
+	/** Number of shards */
+	unsigned	     cnt;
+
+	/** Array of shards */
+	pj_turn_relay_shard *shard;
+
+	/** Shard to assign to the next relay */
+	unsigned	     next;
+
+    } relay;
+
     
     /** Hash tables */
     struct {
@@ -497,6 +578,11 @@ PJ_DECL(pj_status_t) pj_turn_srv_register_allocation(pj_turn_srv *srv,
 PJ_DECL(pj_status_t) pj_turn_srv_unregister_allocation(pj_turn_srv *srv,
 						       pj_turn_allocation *alloc);
 
+/**
+ * Get the relay shard for a new relay socket.
+ */
+PJ_DECL(pj_turn_relay_shard*) pj_turn_srv_get_relay_shard(pj_turn_srv *srv);
+
 /**
  * This callback is called by UDP listener on incoming packet.
  */
@@ -36,6 +36,7 @@
 #define THIS_FILE   "aectest.c"
 #define PTIME	    20
 #define TAIL_LENGTH 200
+#define MAX_LEGS    256
 
 static const char *desc = 
 " FILE		    						    \n"
@@ -59,6 +60,8 @@ static const char *desc =
 "      Default is 25 ms. See note below.                            \n"
 "  -l  Set the echo tail length in ms. Default is 200 ms	    \n"
 "  -r  Set repeat count (default=1)                                 \n"
+"  -n  Number of echo cancellers run on the same signal, to measure \n"
+"      the load of a gateway running EC on every leg (default=1)    \n"
 "  -a  Algorithm: 0=default, 1=speex, 2=echo suppress, 3=WebRtc	    \n"
 "  -i  Interactive						    \n"
 "\n"
@@ -96,16 +99,18 @@ int main(int argc, char *argv[])
     pjmedia_port  *wav_rec;
     pjmedia_port  *wav_out;
     pj_status_t status;
-    pjmedia_echo_state *ec;
+    pjmedia_echo_state *ec[MAX_LEGS];
+    pjmedia_echo_job jobs[MAX_LEGS];
     pjmedia_frame play_frame, rec_frame;
     unsigned opt = 0;
     unsigned latency_ms = 25;
     unsigned tail_ms = TAIL_LENGTH;
-    pj_timestamp t0, t1;
+    unsigned spf, leg, leg_cnt = 1, frame_cnt = 0;
+    pj_timestamp t0, t1, t_ec;
     int i, repeat=1, interactive=0, c;
 
     pj_optind = 0;
-    while ((c=pj_getopt(argc, argv, "d:l:a:r:i")) !=-1) {
+    while ((c=pj_getopt(argc, argv, "d:l:a:r:n:i")) !=-1) {
 	switch (c) {
 	case 'd':
 	    latency_ms = atoi(pj_optarg);
@@ -148,6 +153,14 @@ int main(int argc, char *argv[])
 		return 1;
 	    }
 	    break;
+	case 'n':
+	    leg_cnt = atoi(pj_optarg);
+	    if (leg_cnt < 1 || leg_cnt > MAX_LEGS) {
+		puts("Invalid number of echo cancellers");
+		puts(desc);
+		return 1;
+	    }
+	    break;
 	case 'i':
 	    interactive = 1;
 	    break;
@@ -224,41 +237,59 @@ int main(int argc, char *argv[])
 	return 1;
     }
 
-    /* Create echo canceller */
-    status = pjmedia_echo_create2(pool, PJMEDIA_PIA_SRATE(&wav_play->info),
-				  PJMEDIA_PIA_CCNT(&wav_play->info),
-				  PJMEDIA_PIA_SPF(&wav_play->info),
-				  tail_ms, latency_ms,
-				  opt, &ec);
-    if (status != PJ_SUCCESS) {
-	app_perror(THIS_FILE, "Error creating EC", status);
-	return 1;
+    /* Create echo canceller(s) */
+    spf = PJMEDIA_PIA_SPF(&wav_play->info);
+    for (leg=0; leg < leg_cnt; ++leg) {
+	status = pjmedia_echo_create2(pool, PJMEDIA_PIA_SRATE(&wav_play->info),
+				      PJMEDIA_PIA_CCNT(&wav_play->info),
+				      spf, tail_ms, latency_ms,
+				      opt, &ec[leg]);
+	if (status != PJ_SUCCESS) {
+	    app_perror(THIS_FILE, "Error creating EC", status);
+	    return 1;
+	}
+
+	/* Each leg cancels its own copy of the recorded frame */
+	jobs[leg].echo = ec[leg];
+	jobs[leg].rec_frm = (pj_int16_t*) pj_pool_alloc(pool, spf << 1);
+	jobs[leg].play_frm = NULL;
     }
 
 
     /* Processing loop */
-    play_frame.buf = pj_pool_alloc(pool, PJMEDIA_PIA_SPF(&wav_play->info)<<1);
-    rec_frame.buf = pj_pool_alloc(pool, PJMEDIA_PIA_SPF(&wav_play->info)<<1);
+    play_frame.buf = pj_pool_alloc(pool, spf << 1);
+    rec_frame.buf = pj_pool_alloc(pool, spf << 1);
+    t_ec.u64 = 0;
     pj_get_timestamp(&t0);
     for (i=0; i < repeat; ++i) {
 	for (;;) {
-	    play_frame.size = PJMEDIA_PIA_SPF(&wav_play->info) << 1;
+	    pj_timestamp ts0, ts1;
+
+	    play_frame.size = spf << 1;
 	    status = pjmedia_port_get_frame(wav_play, &play_frame);
 	    if (status != PJ_SUCCESS)
 		break;
 
-	    status = pjmedia_echo_playback(ec, (short*)play_frame.buf);
-
-	    rec_frame.size = PJMEDIA_PIA_SPF(&wav_play->info) << 1;
+	    rec_frame.size = spf << 1;
 	    status = pjmedia_port_get_frame(wav_rec, &rec_frame);
 	    if (status != PJ_SUCCESS)
 		break;
 
-	    status = pjmedia_echo_capture(ec, (short*)rec_frame.buf, 0);
+	    for (leg=0; leg < leg_cnt; ++leg)
+		pjmedia_copy_samples(jobs[leg].rec_frm,
+				     (pj_int16_t*)rec_frame.buf, spf);
+
+	    pj_get_timestamp(&ts0);
+	    for (leg=0; leg < leg_cnt; ++leg)
+		pjmedia_echo_playback(ec[leg], (short*)play_frame.buf);
 
-	    //status = pjmedia_echo_cancel(ec, (short*)rec_frame.buf, 
-	    //			     (short*)play_frame.buf, 0, NULL);
+	    status = pjmedia_echo_cancel_batch(leg_cnt, jobs, 0);
+	    pj_get_timestamp(&ts1);
+	    t_ec.u64 += (ts1.u64 - ts0.u64);
+	    ++frame_cnt;
 
+	    pjmedia_copy_samples((pj_int16_t*)rec_frame.buf, jobs[0].rec_frm,
+				 spf);
 	    pjmedia_port_put_frame(wav_out, &rec_frame);
 	}
 
@@ -271,7 +302,23 @@ int main(int argc, char *argv[])
 	 (PJMEDIA_PIA_SRATE(&wav_out->info) * PJMEDIA_PIA_CCNT(&wav_out->info));
     PJ_LOG(3,(THIS_FILE, "Processed %3d.%03ds audio",
 	      i / 1000, i % 1000));
-    PJ_LOG(3,(THIS_FILE, "Completed in %u msec\n", pj_elapsed_msec(&t0, &t1)));
+    PJ_LOG(3,(THIS_FILE, "Completed in %u msec", pj_elapsed_msec(&t0, &t1)));
+
+    /* EC processing time per frame, for all legs and per leg */
+    if (frame_cnt) {
+	pj_timestamp zero;
+	pj_uint64_t nsec, leg_nsec;
+
+	zero.u64 = 0;
+	nsec = (pj_uint64_t)pj_elapsed_usec(&zero, &t_ec) * 1000 / frame_cnt;
+	leg_nsec = nsec / leg_cnt;
+	PJ_LOG(3,(THIS_FILE, "EC time per %d ms frame: %u.%03u ms for %d "
+		  "leg(s), %u.%03u usec per leg\n",
+		  spf * 1000 / PJMEDIA_PIA_SRATE(&wav_play->info),
+		  (unsigned)(nsec / 1000000), (unsigned)(nsec / 1000 % 1000),
+		  leg_cnt, (unsigned)(leg_nsec / 1000),
+		  (unsigned)(leg_nsec % 1000)));
+    }
 
     /* Destroy file port(s) */
     status = pjmedia_port_destroy( wav_play );
@@ -282,7 +329,8 @@ int main(int argc, char *argv[])
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
 
     /* Destroy ec */
-    pjmedia_echo_destroy(ec);
+    for (leg=0; leg < leg_cnt; ++leg)
+	pjmedia_echo_destroy(ec[leg]);
 
     /* Release application pool */
     pj_pool_release( pool );
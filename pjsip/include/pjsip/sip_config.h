@@ -855,6 +855,36 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Maximum number of resolved targets kept in the SIP resolver target cache.
+ * The cache stores the sorted server list of each (domain, transport, port)
+ * resolved with the DNS resolver, so that new transactions and dialogs to
+ * the same destination (e.g. an outbound proxy) don't repeat the DNS SRV
+ * and A/AAAA lookups. Entries expire after the lowest TTL of the DNS
+ * records used. Set to zero to disable the cache.
+ *
+ * Default: 32
+ *
+ * @see PJSIP_RESOLVE_CACHE_MAX_TTL
+ */
+#ifndef PJSIP_RESOLVE_CACHE_MAX_ENTRIES
+#   define PJSIP_RESOLVE_CACHE_MAX_ENTRIES	    32
+#endif
+
+
+/**
+ * Maximum life-time of an entry in the SIP resolver target cache, in
+ * seconds, regardless of the TTL of the DNS records.
+ *
+ * Default: 300 (5 minutes, same as PJ_DNS_RESOLVER_MAX_TTL)
+ *
+ * @see PJSIP_RESOLVE_CACHE_MAX_ENTRIES
+ */
+#ifndef PJSIP_RESOLVE_CACHE_MAX_TTL
+#   define PJSIP_RESOLVE_CACHE_MAX_TTL		    (5*60)
+#endif
+
+
 /**
  * Enable TLS SIP transport support. For most systems this means that
  * OpenSSL must be installed.
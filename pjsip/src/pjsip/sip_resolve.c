@@ -26,7 +26,10 @@
 #include <pj/array.h>
 #include <pj/assert.h>
 #include <pj/ctype.h>
+#include <pj/hash.h>
+#include <pj/list.h>
 #include <pj/log.h>
+#include <pj/os.h>
 #include <pj/pool.h>
 #include <pj/rand.h>
 #include <pj/string.h>
@@ -34,6 +37,9 @@
 
 #define THIS_FILE   "sip_resolve.c"
 
+#define HAS_TARGET_CACHE    (PJSIP_HAS_RESOLVER && \
+			     PJSIP_RESOLVE_CACHE_MAX_ENTRIES > 0)
+
 struct naptr_target
 {
     pj_str_t		    res_type;	    /**< e.g. "_sip._udp"   */
@@ -46,6 +52,9 @@ struct naptr_target
 struct query
 {
     char		    *objname;
+    pjsip_resolver_t	    *resolver;
+    int			     af;
+    pj_uint32_t		     ttl;	    /* Lowest TTL of A/AAAA answers */
 
     pj_dns_type		     query_type;
     void		    *token;
@@ -69,10 +78,42 @@ struct query
 };
 
 
+/* Hostname resolution with pj_getaddrinfo_async() */
+struct gai_query
+{
+    void		    *token;
+    pjsip_resolver_callback *cb;
+    pjsip_host_info	     target;
+    pjsip_transport_type_e   type;
+};
+
+
+/* Resolved target cache entry */
+struct target_cache
+{
+    PJ_DECL_LIST_MEMBER(struct target_cache);
+    pj_hash_entry_buf	     hbuf;
+    char		     key[PJ_MAX_HOSTNAME+32];
+    unsigned		     keylen;
+    pj_time_val		     expiry;
+    pjsip_server_addresses   server;
+};
+
+
 struct pjsip_resolver_t
 {
     pj_dns_resolver *res;
     pjsip_ext_resolver *ext_res;
+
+#if HAS_TARGET_CACHE
+    /* Resolved target cache, shared by all transactions */
+    pj_pool_t		*pool;
+    pj_mutex_t		*mutex;
+    pj_hash_table_t	*cache;
+    struct target_cache	 lru;	    /* Cached entries, MRU first    */
+    struct target_cache	 free_ent;  /* Flushed entries		    */
+    unsigned		 cache_cnt; /* Number of allocated entries  */
+#endif
 };
 
 
@@ -85,6 +126,8 @@ static void dns_a_callback(void *user_data,
 static void dns_aaaa_callback(void *user_data,
 			      pj_status_t status,
 			      pj_dns_parsed_packet *response);
+static void gai_callback(void *user_data, pj_status_t status,
+			 unsigned count, const pj_addrinfo ai[]);
 
 
 /*
@@ -97,12 +140,224 @@ PJ_DEF(pj_status_t) pjsip_resolver_create( pj_pool_t *pool,
 
     PJ_ASSERT_RETURN(pool && p_res, PJ_EINVAL);
     resolver = PJ_POOL_ZALLOC_T(pool, pjsip_resolver_t);
+
+#if HAS_TARGET_CACHE
+    {
+	pj_status_t status;
+
+	resolver->pool = pj_pool_create(pool->factory, "sipres%p",
+					1000, 1000, NULL);
+	if (!resolver->pool)
+	    return PJ_ENOMEM;
+
+	status = pj_mutex_create_simple(resolver->pool, "sipres%p",
+					&resolver->mutex);
+	if (status != PJ_SUCCESS) {
+	    pj_pool_release(resolver->pool);
+	    return status;
+	}
+
+	resolver->cache = pj_hash_create(resolver->pool,
+					 PJSIP_RESOLVE_CACHE_MAX_ENTRIES);
+	pj_list_init(&resolver->lru);
+	pj_list_init(&resolver->free_ent);
+    }
+#endif
+
     *p_res = resolver;
 
     return PJ_SUCCESS;
 }
 
 
+#if HAS_TARGET_CACHE
+
+/* Build the target cache key, return zero if the target can't be cached */
+static unsigned get_cache_key(char *key, pjsip_transport_type_e type,
+			      int port, int af, const pj_str_t *host)
+{
+    int len;
+
+    if (host->slen >= PJ_MAX_HOSTNAME)
+	return 0;
+
+    len = pj_ansi_snprintf(key, PJ_MAX_HOSTNAME+32, "%d:%d:%d:%.*s",
+			   type, port, af, (int)host->slen, host->ptr);
+    if (len < 0 || len >= PJ_MAX_HOSTNAME+32)
+	return 0;
+
+    return (unsigned)len;
+}
+
+/* Remove all entries from the target cache */
+static void flush_target_cache(pjsip_resolver_t *resolver)
+{
+    pj_mutex_lock(resolver->mutex);
+    while (!pj_list_empty(&resolver->lru)) {
+	struct target_cache *ent = resolver->lru.next;
+
+	pj_hash_set_np_lower(resolver->cache, ent->key, ent->keylen, 0,
+			     ent->hbuf, NULL);
+	pj_list_erase(ent);
+	pj_list_push_back(&resolver->free_ent, ent);
+    }
+    pj_mutex_unlock(resolver->mutex);
+}
+
+/*
+ * Order the servers with the same priority with the weighted random
+ * selection of RFC 2782, so that every transaction served from the
+ * cache gets its own selection.
+ */
+static void select_by_weight(pjsip_server_addresses *addr)
+{
+    unsigned i;
+
+    for (i = 0; i + 1 < addr->count; ++i) {
+	unsigned j, end, sum = 0, r;
+
+	for (end = i; end < addr->count &&
+		      addr->entry[end].priority == addr->entry[i].priority;
+	     ++end)
+	{
+	    sum += addr->entry[end].weight;
+	}
+
+	if (end - i < 2)
+	    continue;
+
+	/* Zero weight entries come first in the running sum */
+	r = pj_rand() % (sum + 1);
+	for (j = i; j < end && (r != 0 || addr->entry[j].weight != 0); ++j)
+	    ;
+	if (j == end) {
+	    for (j = i, sum = 0; j < end; ++j) {
+		sum += addr->entry[j].weight;
+		if (addr->entry[j].weight && sum >= r)
+		    break;
+	    }
+	    if (j == end)
+		j = i;
+	}
+
+	if (j != i) {
+	    char tmp[sizeof(addr->entry[0])];
+
+	    pj_memcpy(tmp, &addr->entry[i], sizeof(tmp));
+	    pj_memcpy(&addr->entry[i], &addr->entry[j], sizeof(tmp));
+	    pj_memcpy(&addr->entry[j], tmp, sizeof(tmp));
+	}
+    }
+}
+
+/* Get the servers of the target from the cache */
+static pj_bool_t get_cached_target(pjsip_resolver_t *resolver,
+				   const pjsip_host_info *target,
+				   pjsip_transport_type_e type,
+				   int af,
+				   pjsip_server_addresses *addr)
+{
+    char key[PJ_MAX_HOSTNAME+32];
+    unsigned keylen;
+    struct target_cache *ent;
+    pj_time_val now;
+    long expires;
+
+    keylen = get_cache_key(key, type, target->addr.port, af,
+			   &target->addr.host);
+    if (keylen == 0)
+	return PJ_FALSE;
+
+    pj_gettickcount(&now);
+
+    pj_mutex_lock(resolver->mutex);
+
+    ent = (struct target_cache*)
+	  pj_hash_get_lower(resolver->cache, key, keylen, NULL);
+    if (!ent || PJ_TIME_VAL_GTE(now, ent->expiry)) {
+	/* Expired entry will be refreshed when the new result arrives */
+	pj_mutex_unlock(resolver->mutex);
+	return PJ_FALSE;
+    }
+
+    pj_memcpy(addr, &ent->server, sizeof(*addr));
+    expires = ent->expiry.sec - now.sec;
+    pj_list_erase(ent);
+    pj_list_push_front(&resolver->lru, ent);
+
+    pj_mutex_unlock(resolver->mutex);
+
+    select_by_weight(addr);
+
+    PJ_LOG(5,(THIS_FILE, "Target '%.*s:%d' type=%s resolved from cache, "
+	      "%d server(s), expires in %ds",
+	      (int)target->addr.host.slen, target->addr.host.ptr,
+	      target->addr.port, pjsip_transport_get_type_name(type),
+	      addr->count, (int)expires));
+
+    return PJ_TRUE;
+}
+
+/* Save the servers of the query target to the cache */
+static void cache_target(struct query *query,
+			 const pjsip_server_addresses *addr,
+			 unsigned ttl)
+{
+    pjsip_resolver_t *resolver = query->resolver;
+    char key[PJ_MAX_HOSTNAME+32];
+    unsigned keylen;
+    pj_uint32_t hval = 0;
+    struct target_cache *ent;
+
+    if (ttl == 0 || addr->count == 0)
+	return;
+    if (ttl > PJSIP_RESOLVE_CACHE_MAX_TTL)
+	ttl = PJSIP_RESOLVE_CACHE_MAX_TTL;
+
+    keylen = get_cache_key(key, query->naptr[0].type,
+			   query->req.target.addr.port, query->af,
+			   &query->req.target.addr.host);
+    if (keylen == 0)
+	return;
+
+    pj_mutex_lock(resolver->mutex);
+
+    ent = (struct target_cache*)
+	  pj_hash_get_lower(resolver->cache, key, keylen, &hval);
+    if (ent) {
+	pj_list_erase(ent);
+    } else {
+	if (!pj_list_empty(&resolver->free_ent)) {
+	    ent = resolver->free_ent.next;
+	    pj_list_erase(ent);
+	} else if (resolver->cache_cnt < PJSIP_RESOLVE_CACHE_MAX_ENTRIES) {
+	    ent = PJ_POOL_ZALLOC_T(resolver->pool, struct target_cache);
+	    ++resolver->cache_cnt;
+	} else {
+	    /* Evict the least recently used entry */
+	    ent = resolver->lru.prev;
+	    pj_list_erase(ent);
+	    pj_hash_set_np_lower(resolver->cache, ent->key, ent->keylen, 0,
+				 ent->hbuf, NULL);
+	}
+
+	pj_memcpy(ent->key, key, keylen);
+	ent->keylen = keylen;
+	pj_hash_set_np_lower(resolver->cache, ent->key, ent->keylen, hval,
+			     ent->hbuf, ent);
+    }
+
+    pj_memcpy(&ent->server, addr, sizeof(*addr));
+    pj_gettickcount(&ent->expiry);
+    ent->expiry.sec += ttl;
+    pj_list_push_front(&resolver->lru, ent);
+
+    pj_mutex_unlock(resolver->mutex);
+}
+
+#endif	/* HAS_TARGET_CACHE */
+
+
 /*
  * Public API to set the DNS resolver instance for the SIP resolver.
  */
@@ -111,6 +366,10 @@ PJ_DEF(pj_status_t) pjsip_resolver_set_resolver(pjsip_resolver_t *res,
 {
 #if PJSIP_HAS_RESOLVER
     res->res = dns_res;
+#if HAS_TARGET_CACHE
+    /* Cached targets were resolved with the previous resolver */
+    flush_target_cache(res);
+#endif
     return PJ_SUCCESS;
 #else
     PJ_UNUSED_ARG(res);
@@ -161,6 +420,14 @@ PJ_DEF(void) pjsip_resolver_destroy(pjsip_resolver_t *resolver)
 #endif
 	resolver->res = NULL;
     }
+
+#if HAS_TARGET_CACHE
+    if (resolver->mutex) {
+	pj_mutex_destroy(resolver->mutex);
+	resolver->mutex = NULL;
+    }
+    pj_pool_safe_release(&resolver->pool);
+#endif
 }
 
 /*
@@ -186,6 +453,57 @@ static int get_ip_addr_ver(const pj_str_t *host)
 }
 
 
+/*
+ * Set the transport type, port number, and length of the addresses
+ * resolved for the target without DNS SRV.
+ */
+static void finish_resolved_addr(const pjsip_host_info *target,
+				 pjsip_transport_type_e type,
+				 pjsip_server_addresses *svr_addr)
+{
+    char addr_str[PJ_INET6_ADDRSTRLEN+10];
+    pj_uint16_t srv_port;
+    unsigned i;
+
+    for (i = 0; i < svr_addr->count; i++) {
+	/* After address resolution, update IPv6 bitflag in
+	 * transport type.
+	 */
+	if (svr_addr->entry[i].addr.addr.sa_family == pj_AF_INET6()) {
+	    type |= PJSIP_TRANSPORT_IPV6;
+	} else {
+	    type &= ~PJSIP_TRANSPORT_IPV6;
+	}
+
+	/* Set the port number */
+	if (target->addr.port == 0) {
+	   srv_port = (pj_uint16_t)
+		      pjsip_transport_get_default_port_for_type(type);
+	} else {
+	   srv_port = (pj_uint16_t)target->addr.port;
+	}
+	pj_sockaddr_set_port(&svr_addr->entry[i].addr, srv_port);
+
+	PJ_LOG(5,(THIS_FILE, 
+		  "Target '%.*s:%d' type=%s resolved to "
+		  "'%s' type=%s (%s)",
+		  (int)target->addr.host.slen,
+		  target->addr.host.ptr,
+		  target->addr.port,
+		  pjsip_transport_get_type_name(target->type),
+		  pj_sockaddr_print(&svr_addr->entry[i].addr, addr_str,
+				    sizeof(addr_str), 3),
+		  pjsip_transport_get_type_name(type),
+		  pjsip_transport_get_type_desc(type)));
+
+	svr_addr->entry[i].priority = 0;
+	svr_addr->entry[i].weight = 0;
+	svr_addr->entry[i].type = type;
+	svr_addr->entry[i].addr_len = 
+			    pj_sockaddr_get_len(&svr_addr->entry[i].addr);
+    }
+}
+
 /*
  * This is the main function for performing server resolution.
  */
@@ -268,10 +586,6 @@ PJ_DEF(void) pjsip_resolve( pjsip_resolver_t *resolver,
      * we can just finish the resolution now using pj_gethostbyname()
      */
     if (ip_addr_ver || resolver->res == NULL) {
-	char addr_str[PJ_INET6_ADDRSTRLEN+10];
-	pj_uint16_t srv_port;
-	unsigned i;
-
 	if (ip_addr_ver != 0) {
 	    /* Target is an IP address, no need to resolve */
 	    svr_addr.count = 1;
@@ -311,8 +625,7 @@ PJ_DEF(void) pjsip_resolve( pjsip_resolver_t *resolver,
 			     &svr_addr.entry[0].addr.ipv6.sin6_addr);
 	    }
 	} else {
-	    pj_addrinfo ai[PJSIP_MAX_RESOLVED_ADDRESSES];
-	    unsigned count;
+	    struct gai_query *gq;
 
 	    PJ_LOG(5,(THIS_FILE,
 		      "DNS resolver not available, target '%.*s:%d' type=%s "
@@ -322,10 +635,19 @@ PJ_DEF(void) pjsip_resolve( pjsip_resolver_t *resolver,
 		      target->addr.port,
 		      pjsip_transport_get_type_name(target->type)));
 
-	    /* Resolve */
-	    count = PJSIP_MAX_RESOLVED_ADDRESSES;
-	    status = pj_getaddrinfo(af, &target->addr.host, &count, ai);
-	    if (status != PJ_SUCCESS) {
+	    /* Resolve in the background, so that the calling (worker)
+	     * thread doesn't block when the name server is slow.
+	     */
+	    gq = PJ_POOL_ZALLOC_T(pool, struct gai_query);
+	    gq->token = token;
+	    gq->cb = cb;
+	    gq->target = *target;
+	    pj_strdup(pool, &gq->target.addr.host, &target->addr.host);
+	    gq->type = type;
+
+	    status = pj_getaddrinfo_async(af, &gq->target.addr.host,
+					  &gai_callback, gq);
+	    if (status != PJ_SUCCESS && status != PJ_EPENDING) {
 		/* "Normalize" error to PJ_ERESOLVE. This is a special error
 		 * because it will be translated to SIP status 502 by
 		 * sip_transaction.c
@@ -333,51 +655,10 @@ PJ_DEF(void) pjsip_resolve( pjsip_resolver_t *resolver,
 		status = PJ_ERESOLVE;
 		goto on_error;
 	    }
-
-	    svr_addr.count = count;
-	    for (i = 0; i < count; i++) {
-	        pj_sockaddr_cp(&svr_addr.entry[i].addr, &ai[i].ai_addr);
-	    }
+	    return;
 	}
 
-	for (i = 0; i < svr_addr.count; i++) {
-	    /* After address resolution, update IPv6 bitflag in
-	     * transport type.
-	     */
-	    af = svr_addr.entry[i].addr.addr.sa_family;
-	    if (af == pj_AF_INET6()) {
-	        type |= PJSIP_TRANSPORT_IPV6;
-	    } else {
-	        type &= ~PJSIP_TRANSPORT_IPV6;
-	    }
-
-	    /* Set the port number */
-	    if (target->addr.port == 0) {
-	       srv_port = (pj_uint16_t)
-		          pjsip_transport_get_default_port_for_type(type);
-	    } else {
-	       srv_port = (pj_uint16_t)target->addr.port;
-	    }
-	    pj_sockaddr_set_port(&svr_addr.entry[i].addr, srv_port);
-
-	    PJ_LOG(5,(THIS_FILE, 
-		      "Target '%.*s:%d' type=%s resolved to "
-		      "'%s' type=%s (%s)",
-		      (int)target->addr.host.slen,
-		      target->addr.host.ptr,
-		      target->addr.port,
-		      pjsip_transport_get_type_name(target->type),
-		      pj_sockaddr_print(&svr_addr.entry[i].addr, addr_str,
-				        sizeof(addr_str), 3),
-		      pjsip_transport_get_type_name(type),
-		      pjsip_transport_get_type_desc(type)));
-
-	    svr_addr.entry[i].priority = 0;
-	    svr_addr.entry[i].weight = 0;
-	    svr_addr.entry[i].type = type;
-	    svr_addr.entry[i].addr_len = 
-				pj_sockaddr_get_len(&svr_addr.entry[i].addr);
-	}
+	finish_resolved_addr(target, type, &svr_addr);
 
 	/* Call the callback. */
 	(*cb)(status, token, &svr_addr);
@@ -389,9 +670,20 @@ PJ_DEF(void) pjsip_resolve( pjsip_resolver_t *resolver,
     /* Target is not an IP address so we need to resolve it. */
 #if PJSIP_HAS_RESOLVER
 
+#if HAS_TARGET_CACHE
+    /* Use the cached servers if this target has been resolved recently */
+    if (get_cached_target(resolver, target, type, af, &svr_addr)) {
+	(*cb)(PJ_SUCCESS, token, &svr_addr);
+	return;
+    }
+#endif
+
     /* Build the query state */
     query = PJ_POOL_ZALLOC_T(pool, struct query);
     query->objname = THIS_FILE;
+    query->resolver = resolver;
+    query->af = af;
+    query->ttl = 0xFFFFFFFF;
     query->token = token;
     query->cb = cb;
     query->req.target = *target;
@@ -521,6 +813,39 @@ on_error:
     }
 }
 
+/*
+ * This callback is called when target is resolved with getaddrinfo().
+ */
+static void gai_callback(void *user_data, pj_status_t status,
+			 unsigned count, const pj_addrinfo ai[])
+{
+    struct gai_query *gq = (struct gai_query*) user_data;
+    pjsip_server_addresses svr_addr;
+    unsigned i;
+
+    if (status != PJ_SUCCESS) {
+	PJ_PERROR(4,(THIS_FILE, status,
+		     "Failed to resolve '%.*s'",
+		     (int)gq->target.addr.host.slen,
+		     gq->target.addr.host.ptr));
+	/* "Normalize" error to PJ_ERESOLVE, see pjsip_resolve() */
+	(*gq->cb)(PJ_ERESOLVE, gq->token, NULL);
+	return;
+    }
+
+    if (count > PJSIP_MAX_RESOLVED_ADDRESSES)
+	count = PJSIP_MAX_RESOLVED_ADDRESSES;
+
+    svr_addr.count = count;
+    for (i = 0; i < count; i++) {
+	pj_sockaddr_cp(&svr_addr.entry[i].addr, &ai[i].ai_addr);
+    }
+
+    finish_resolved_addr(&gq->target, gq->type, &svr_addr);
+
+    (*gq->cb)(PJ_SUCCESS, gq->token, &svr_addr);
+}
+
 #if PJSIP_HAS_RESOLVER
 
 /* 
@@ -544,6 +869,12 @@ static void dns_a_callback(void *user_data,
 	rec.addr_count = 0;
 	status = pj_dns_parse_addr_response(pkt, &rec);
 
+	/* For response from the resolver cache, this is the time left */
+	for (i = 0; i < pkt->hdr.anscount; ++i) {
+	    if (pkt->ans[i].ttl < query->ttl)
+		query->ttl = pkt->ans[i].ttl;
+	}
+
 	/* Build server addresses and call callback */
 	for (i = 0; i < rec.addr_count &&
 		    srv->count < PJSIP_MAX_RESOLVED_ADDRESSES; ++i)
@@ -573,9 +904,12 @@ static void dns_a_callback(void *user_data,
 
     /* Call the callback if all DNS queries have been completed */
     if (query->object == NULL && query->object6 == NULL) {
-	if (srv->count > 0)
+	if (srv->count > 0) {
+#if HAS_TARGET_CACHE
+	    cache_target(query, srv, query->ttl);
+#endif
 	    (*query->cb)(PJ_SUCCESS, query->token, &query->server);
-	else
+	} else
 	    (*query->cb)(query->last_error, query->token, NULL);
     }
 }
@@ -602,6 +936,12 @@ static void dns_aaaa_callback(void *user_data,
 	rec.addr_count = 0;
 	status = pj_dns_parse_addr_response(pkt, &rec);
 
+	/* For response from the resolver cache, this is the time left */
+	for (i = 0; i < pkt->hdr.anscount; ++i) {
+	    if (pkt->ans[i].ttl < query->ttl)
+		query->ttl = pkt->ans[i].ttl;
+	}
+
 	/* Build server addresses and call callback */
 	for (i = 0; i < rec.addr_count &&
 		    srv->count < PJSIP_MAX_RESOLVED_ADDRESSES; ++i)
@@ -632,9 +972,12 @@ static void dns_aaaa_callback(void *user_data,
 
     /* Call the callback if all DNS queries have been completed */
     if (query->object == NULL && query->object6 == NULL) {
-	if (srv->count > 0)
+	if (srv->count > 0) {
+#if HAS_TARGET_CACHE
+	    cache_target(query, srv, query->ttl);
+#endif
 	    (*query->cb)(PJ_SUCCESS, query->token, &query->server);
-	else
+	} else
 	    (*query->cb)(query->last_error, query->token, NULL);
     }
 }
@@ -688,6 +1031,10 @@ static void srv_resolver_cb(void *user_data,
 	}
     }
 
+#if HAS_TARGET_CACHE
+    cache_target(query, &srv, rec->ttl);
+#endif
+
     /* Call the callback */
     (*query->cb)(PJ_SUCCESS, query->token, &srv);
 }
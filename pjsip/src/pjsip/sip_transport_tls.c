@@ -1947,13 +1947,15 @@ static pj_bool_t on_connect_complete(pj_ssl_sock_t *ssock,
     tls->has_pending_connect = PJ_FALSE;
 
     PJ_LOG(4,(tls->base.obj_name, 
-	      "TLS transport %s is connected to %s",
+	      "TLS transport %s is connected to %s (%s handshake, %d ms)",
 	      pj_addr_str_print(&tls->base.local_name.host, 
 				tls->base.local_name.port, local_addr_buf, 
 				sizeof(local_addr_buf), 1),
 	      pj_addr_str_print(&tls->base.remote_name.host, 
 				tls->base.remote_name.port, remote_addr_buf, 
-				sizeof(remote_addr_buf), 1)));
+				sizeof(remote_addr_buf), 1),
+	      (ssl_info.session_reused ? "resumed" : "full"),
+	      ssl_info.handshake_time));
 
     /* Start pending read */
     status = tls_start_read(tls);
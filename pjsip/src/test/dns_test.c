@@ -495,6 +495,66 @@ static int round_robin_test(pj_pool_t *pool)
 }
 
 
+/*
+ * Resolved target cache test: the second resolution of the same target
+ * must be served from the SIP resolver cache even when the DNS record
+ * has changed, until the cache is flushed by setting the resolver.
+ */
+static int target_cache_test(pj_pool_t *pool, pj_dns_resolver *resv,
+			     pjsip_server_addresses *ref,
+			     pjsip_server_addresses *ref2)
+{
+    pj_dns_parsed_packet pkt;
+    pj_dns_parsed_query q;
+    pj_dns_parsed_rr ans;
+    pj_str_t tmp;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, " Performing resolved target cache test.."));
+
+    status = test_resolve("target is resolved", pool,
+			  PJSIP_TRANSPORT_UNSPECIFIED, "example.com", 5060,
+			  ref);
+    if (status != PJ_SUCCESS)
+	return 10;
+
+    /* Change the A record of the target */
+    pj_bzero(&pkt, sizeof(pkt));
+    pj_bzero(&ans, sizeof(ans));
+    pkt.hdr.flags = PJ_DNS_SET_QR(1);
+    pkt.hdr.qdcount = 1;
+    pkt.q = &q;
+    q.name = pj_str("example.com");
+    q.type = PJ_DNS_TYPE_A;
+    q.dnsclass = PJ_DNS_CLASS_IN;
+    pkt.hdr.anscount = 1;
+    pkt.ans = &ans;
+    ans.name = q.name;
+    ans.type = PJ_DNS_TYPE_A;
+    ans.dnsclass = PJ_DNS_CLASS_IN;
+    ans.ttl = 3600;
+    ans.rdata.a.ip_addr = pj_inet_addr(pj_cstr(&tmp, "9.9.9.9"));
+    pj_dns_resolver_add_entry(resv, &pkt, PJ_FALSE);
+
+    status = test_resolve("target is resolved from cache", pool,
+			  PJSIP_TRANSPORT_UNSPECIFIED, "example.com", 5060,
+			  ref);
+    if (status != PJ_SUCCESS)
+	return 20;
+
+    /* Setting the resolver flushes the cache */
+    pjsip_endpt_set_resolver(endpt, resv);
+
+    status = test_resolve("target is resolved again after flush", pool,
+			  PJSIP_TRANSPORT_UNSPECIFIED, "example.com", 5060,
+			  ref2);
+    if (status != PJ_SUCCESS)
+	return 30;
+
+    return PJ_SUCCESS;
+}
+
+
 #define C(expr)	    status = expr; \
 		    if (status != PJ_SUCCESS) app_perror(THIS_FILE, "Error", status);
 
@@ -634,6 +694,15 @@ int resolve_test(void)
     if (round_robin_test(pool) != 0)
 	return -170;
 
+    /* Resolved target cache test */
+    {
+	pjsip_server_addresses ref, ref2;
+	create_ref(&ref, PJSIP_TRANSPORT_UDP, "5.5.5.5", 5060);
+	create_ref(&ref2, PJSIP_TRANSPORT_UDP, "9.9.9.9", 5060);
+	if (target_cache_test(pool, resv, &ref, &ref2) != 0)
+	    return -175;
+    }
+
     /* Timeout test */
     {
 	status = test_resolve("timeout test", pool, PJSIP_TRANSPORT_UNSPECIFIED, "an.invalid.address", 0, NULL);